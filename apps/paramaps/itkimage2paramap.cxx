@@ -3,6 +3,7 @@
 
 // DCMQI includes
 #undef HAVE_SSTREAM // Avoid redefinition warning
+#include "dcmqi/NumpyIO.h"
 #include "dcmqi/ParaMapConverter.h"
 #include "dcmqi/internal/VersionConfigure.h"
 
@@ -21,10 +22,23 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
   }
 
-  FloatReaderType::Pointer reader = FloatReaderType::New();
-  reader->SetFileName(inputFileName.c_str());
-  reader->Update();
-  FloatImageType::Pointer parametricMapImage = reader->GetOutput();
+  // arrays are mapped and used in place; the mapping has to outlive the image
+  dcmqi::NumpyIO::MappedArray mappedArray;
+  FloatImageType::Pointer parametricMapImage;
+  if(dcmqi::NumpyIO::isArrayFile(inputFileName)){
+    if(!dcmqi::NumpyIO::mapArray(inputFileName, geometryFileName, mappedArray))
+      return EXIT_FAILURE;
+    if(mappedArray.dtype != "f4"){
+      cerr << "ERROR: Parametric map arrays must be of type float32" << endl;
+      return EXIT_FAILURE;
+    }
+    parametricMapImage = dcmqi::NumpyIO::importImage<FloatImageType>(mappedArray);
+  } else {
+    FloatReaderType::Pointer reader = FloatReaderType::New();
+    reader->SetFileName(inputFileName.c_str());
+    reader->Update();
+    parametricMapImage = reader->GetOutput();
+  }
 
   if(dicomDirectory.size()){
     if (!helper::pathExists(dicomDirectory))
@@ -3,27 +3,95 @@
 
 // DCMQI includes
 #undef HAVE_SSTREAM // Avoid redefinition warning
+#include "dcmqi/ConversionJob.h"
+#include "dcmqi/NrrdIO.h"
+#include "dcmqi/NumpyIO.h"
 #include "dcmqi/ParaMapConverter.h"
+#include "dcmqi/TarWriter.h"
 #include "dcmqi/internal/VersionConfigure.h"
 
+// STD includes
+#include <memory>
+
 
 typedef dcmqi::Helper helper;
 
 
 int main(int argc, char *argv[])
 {
+  PARSE_ARGS;
+
+  // "-" as output directory writes the output files as tar archive to stdout, and all
+  // messages to stderr
+  const bool streamOutput = outputDirName == "-";
+  std::ostream outputStream(std::cout.rdbuf());
+  if (streamOutput) {
+    helper::setBinaryStandardOutput();
+    std::cout.rdbuf(std::cerr.rdbuf());
+  }
+
   std::cout << dcmqi_INFO << std::endl;
 
-  PARSE_ARGS;
+  if (streamOutput && outputType != "nrrd" && outputType != "npy") {
+    std::cerr << "ERROR: Only nrrd and npy output can be written to stdout!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!manifestFileName.empty()) {
+    if (streamOutput) {
+      std::cerr << "ERROR: Output to stdout is not supported with a manifest!" << std::endl;
+      return EXIT_FAILURE;
+    }
+    ifstream manifest(manifestFileName.c_str());
+    if (!manifest) {
+      std::cerr << "ERROR: Failed to open manifest " << manifestFileName << std::endl;
+      return EXIT_FAILURE;
+    }
+    // items of the manifest use the command line arguments as defaults
+    Json::Value defaults;
+    defaults["type"] = "paramap2itkimage";
+    if (!outputDirName.empty())
+      defaults["outputDirectory"] = outputDirName;
+    if (!prefix.empty())
+      defaults["prefix"] = prefix;
+    defaults["outputType"] = outputType;
+
+    size_t numberOfJobs = 0;
+    size_t failures = 0;
+    try {
+      failures = dcmqi::ConversionJob::runManifest(manifest, defaults, threads > 0 ? unsigned(threads) : 0u,
+                                                   std::cout, journalFileName, &numberOfJobs);
+    } catch (int) {
+      // the error has been reported already
+      return EXIT_FAILURE;
+    }
+    std::cerr << "Converted " << numberOfJobs - failures << " of " << numberOfJobs << " objects" << std::endl;
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
 
-  if(helper::isUndefinedOrPathDoesNotExist(inputFileName, "Input DICOM file")
-     || helper::isUndefinedOrPathDoesNotExist(outputDirName, "Output directory"))
+  // "-" as input reads the parametric map from stdin
+  const bool streamInput = inputFileName == "-";
+  if((!streamInput && helper::isUndefinedOrPathDoesNotExist(inputFileName, "Input DICOM file"))
+     || (!streamOutput && helper::isUndefinedOrPathDoesNotExist(outputDirName, "Output directory")))
     return EXIT_FAILURE;
 
   DcmFileFormat sliceFF;
-  std::cout << "Opening input file " << inputFileName.c_str() << std::endl;
-  CHECK_COND(sliceFF.loadFile(inputFileName.c_str()));
-  DcmDataset* dataset = sliceFF.getDataset();
+  std::unique_ptr<DcmDataset> streamDataset;
+  DcmDataset* dataset = NULL;
+  if (streamInput) {
+    std::cout << "Reading input from stdin" << std::endl;
+    vector<char> inputBytes;
+    if (!helper::readStandardInput(inputBytes))
+      return EXIT_FAILURE;
+    streamDataset.reset(helper::loadDatasetFromBuffer(inputBytes.empty() ? NULL : &inputBytes[0], inputBytes.size()));
+    if (!streamDataset)
+      return EXIT_FAILURE;
+    dataset = streamDataset.get();
+  } else {
+    std::cout << "Opening input file " << inputFileName.c_str() << std::endl;
+    CHECK_COND(sliceFF.loadFile(inputFileName.c_str()));
+    dataset = sliceFF.getDataset();
+  }
 
   try {
     pair <FloatImageType::Pointer, string> result =  dcmqi::ParaMapConverter::paramap2itkimage(dataset);
@@ -32,16 +100,38 @@ int main(int argc, char *argv[])
 
     typedef itk::ImageFileWriter<FloatImageType> WriterType;
     string outputPrefix = prefix.empty() ? "" : prefix + "-";
-    WriterType::Pointer writer = WriterType::New();
+    // with output to stdout, the files are named without directory in the archive
+    dcmqi::TarWriter archive(outputStream);
+    dcmqi::TarWriter* outputArchive = streamOutput ? &archive : NULL;
+    const string outputPath = streamOutput ? outputPrefix : outputDirName + "/" + outputPrefix;
     stringstream imageFileNameSStream;
-    imageFileNameSStream << outputDirName << "/" << outputPrefix << "pmap" << fileExtension;
-    writer->SetFileName(imageFileNameSStream.str().c_str());
-    writer->SetInput(result.first);
-    writer->SetUseCompression(1);
-    writer->Update();
+    imageFileNameSStream << outputPath << "pmap" << fileExtension;
+    if (outputType == "npy") {
+      Json::Value arrayInfo;
+      if (!dcmqi::NumpyIO::writeArray(result.first, imageFileNameSStream.str(), &arrayInfo, outputArchive))
+        return EXIT_FAILURE;
+      arrayInfo["fileName"] = outputPrefix + "pmap" + fileExtension;
+      Json::Value arrays(Json::arrayValue);
+      arrays.append(arrayInfo);
+      if (!dcmqi::NumpyIO::writeGeometry(dcmqi::NumpyIO::getGeometry(result.first), arrays,
+                                         outputPath + "geometry.json", outputArchive))
+        return EXIT_FAILURE;
+    } else if (streamOutput) {
+      if (!dcmqi::NrrdIO::writeImage(result.first, imageFileNameSStream.str(), outputArchive))
+        return EXIT_FAILURE;
+    } else {
+      WriterType::Pointer writer = WriterType::New();
+      writer->SetFileName(imageFileNameSStream.str().c_str());
+      writer->SetInput(result.first);
+      writer->SetUseCompression(1);
+      writer->Update();
+    }
+
+    if (streamOutput)
+      return archive.addFile(outputPath + "meta.json", result.second) && archive.finish() ? EXIT_SUCCESS : EXIT_FAILURE;
 
     stringstream jsonOutput;
-    jsonOutput << outputDirName << "/" << outputPrefix << "meta.json";
+    jsonOutput << outputPath << "meta.json";
 
     ofstream outputFile;
     outputFile.open(jsonOutput.str().c_str());
@@ -0,0 +1,129 @@
+// Runs conversions concurrently through AsyncConverter and checks that the messages of every
+// conversion are collected in its own result.
+//
+// Usage: AsyncConverterTest <SEG with overlapping segments> <Label Map SEG>
+
+// DCMQI includes
+#include "dcmqi/AsyncConverter.h"
+#include "dcmqi/ConversionContext.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcfilefo.h>
+
+// STD includes
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+namespace {
+
+  // Lets the tasks continue only once all of them are running
+  class Rendezvous {
+  public:
+    explicit Rendezvous(int count) : m_count(count), m_arrived(0) {}
+
+    void wait() {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_arrived++;
+      m_condition.notify_all();
+      m_condition.wait(lock, [this](){ return m_arrived >= m_count; });
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    int m_count;
+    int m_arrived;
+  };
+
+  bool check(bool condition, const std::string &message) {
+    if(!condition)
+      std::cerr << "ERROR: " << message << std::endl;
+    return condition;
+  }
+
+  bool contains(const std::string &text, const std::string &part) {
+    return text.find(part) != std::string::npos;
+  }
+
+  // Checks that the log consists of the expected number of lines written by the named task
+  bool checkLog(const std::string &log, const std::string &name, int numberOfLines) {
+    std::istringstream stream(log);
+    std::string line;
+    int lines = 0;
+    while(std::getline(stream, line)){
+      if(line.compare(0, name.size() + 1, name + " ") != 0){
+        std::cerr << "ERROR: Log of " << name << " contains \"" << line << "\"" << std::endl;
+        return false;
+      }
+      lines++;
+    }
+    return check(lines == numberOfLines, "Log of " + name + " is incomplete");
+  }
+
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc != 3){
+    std::cerr << "Usage: " << argv[0] << " <SEG with overlapping segments> <Label Map SEG>" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const int numberOfLines = 1000;
+  bool ok = true;
+  dcmqi::AsyncConverter converter(2);
+
+  // Both tasks write their messages at the same time
+  {
+    Rendezvous rendezvous(2);
+    auto writer = [&rendezvous, numberOfLines](const std::string &name) {
+      return std::function<int()>([&rendezvous, numberOfLines, name](){
+        rendezvous.wait();
+        for(int i=0;i<numberOfLines;i++)
+          dcmqi::ConversionContext::out() << name << " " << i << std::endl;
+        dcmqi::ConversionContext::err() << name << " done" << std::endl;
+        return 0;
+      });
+    };
+    std::future<dcmqi::AsyncConverter::Result<int> > first = converter.submit<int>(writer("first"));
+    std::future<dcmqi::AsyncConverter::Result<int> > second = converter.submit<int>(writer("second"));
+    dcmqi::AsyncConverter::Result<int> firstResult = first.get();
+    dcmqi::AsyncConverter::Result<int> secondResult = second.get();
+
+    ok &= check(firstResult.success && secondResult.success, "Writing tasks failed");
+    ok &= checkLog(firstResult.log, "first", numberOfLines);
+    ok &= checkLog(secondResult.log, "second", numberOfLines);
+    ok &= check(firstResult.errors == "first done\n", "Unexpected errors of first: " + firstResult.errors);
+    ok &= check(secondResult.errors == "second done\n", "Unexpected errors of second: " + secondResult.errors);
+  }
+
+  // Two conversions that report different progress messages
+  DcmFileFormat overlappingFF, labelmapFF;
+  if(!check(overlappingFF.loadFile(argv[1]).good(), std::string("Cannot read ") + argv[1])
+     || !check(labelmapFF.loadFile(argv[2]).good(), std::string("Cannot read ") + argv[2]))
+    return EXIT_FAILURE;
+
+  std::future<dcmqi::AsyncConverter::SegmentationImagesResult> overlapping =
+    converter.dcmSegmentation2itkimage(overlappingFF.getDataset(), true);
+  std::future<dcmqi::AsyncConverter::SegmentationImagesResult> labelmap =
+    converter.dcmSegmentation2itkimage(labelmapFF.getDataset());
+  dcmqi::AsyncConverter::SegmentationImagesResult overlappingResult = overlapping.get();
+  dcmqi::AsyncConverter::SegmentationImagesResult labelmapResult = labelmap.get();
+
+  const std::string mergeMessage = "groups of non-overlapping segments";
+  const std::string labelmapMessage = "Label map segmentation:";
+  ok &= check(overlappingResult.success, "Conversion of " + std::string(argv[1]) + " failed: " + overlappingResult.errors);
+  ok &= check(labelmapResult.success, "Conversion of " + std::string(argv[2]) + " failed: " + labelmapResult.errors);
+  ok &= check(overlappingResult.value.images.size() == 2, "Expected 2 images of non-overlapping segments");
+  ok &= check(labelmapResult.value.images.size() == 1, "Expected 1 label map image");
+  ok &= check(contains(overlappingResult.log, mergeMessage) && !contains(overlappingResult.log, labelmapMessage),
+              "Unexpected log of " + std::string(argv[1]) + ":\n" + overlappingResult.log);
+  ok &= check(contains(labelmapResult.log, labelmapMessage) && !contains(labelmapResult.log, mergeMessage),
+              "Unexpected log of " + std::string(argv[2]) + ":\n" + labelmapResult.log);
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
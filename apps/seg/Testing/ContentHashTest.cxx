@@ -0,0 +1,49 @@
+// Checks the SHA-256 digests of ContentHash against the known answers of FIPS 180-2.
+
+// DCMQI includes
+#include "dcmqi/ContentHash.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+  bool check(const std::string &name, const std::string &digest, const std::string &expected) {
+    if(digest == expected)
+      return true;
+    std::cerr << "ERROR: Digest of " << name << " is " << digest << " instead of " << expected << std::endl;
+    return false;
+  }
+
+  std::string digestOf(const std::string &message) {
+    dcmqi::ContentHash hash;
+    hash.update(message.data(), message.size());
+    return hash.getHexDigest();
+  }
+
+}
+
+int main(int, char*[])
+{
+  bool ok = true;
+  ok &= check("the empty message", digestOf(""),
+              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  ok &= check("\"abc\"", digestOf("abc"),
+              "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  // 56 bytes, so the padding needs a second block
+  ok &= check("the two block message", digestOf("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+              "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+  // one million "a", added in pieces that do not align with the blocks
+  dcmqi::ContentHash hash;
+  const std::string piece(999, 'a');
+  for(int i=0;i<1001;i++)
+    hash.update(piece.data(), piece.size());
+  hash.update(piece.data(), 1);
+  ok &= check("one million \"a\"", hash.getHexDigest(),
+              "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
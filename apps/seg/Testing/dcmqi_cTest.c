@@ -0,0 +1,185 @@
+/*
+ * Converts a label image into a DICOM Segmentation object and back through the C interface of
+ * the dcmqi_c library, and checks that voxels and geometry are preserved.
+ *
+ * Usage: dcmqi_cTest <metadata.json> <source DICOM files...>
+ *
+ * The label image has the geometry of the ct-3slice series.
+ */
+
+#include "dcmqi/dcmqi_c.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const uint32_t SIZE[3] = { 512, 512, 3 };
+static const double ORIGIN[3] = { -235.2, -226.8, -128.69 };
+static const double SPACING[3] = { 0.810547, 0.810547, 1.0 };
+
+/* Reads a whole file; the returned buffer is terminated by a zero byte */
+static char* readFile(const char* fileName, size_t* size) {
+  FILE* file = fopen(fileName, "rb");
+  char* data = NULL;
+  long length;
+  if(file == NULL) {
+    fprintf(stderr, "ERROR: Cannot open %s\n", fileName);
+    return NULL;
+  }
+  if(fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+    data = (char*)malloc((size_t)length + 1);
+    if(data != NULL && fread(data, 1, (size_t)length, file) == (size_t)length) {
+      data[length] = 0;
+      *size = (size_t)length;
+    } else {
+      free(data);
+      data = NULL;
+    }
+  }
+  fclose(file);
+  if(data == NULL)
+    fprintf(stderr, "ERROR: Cannot read %s\n", fileName);
+  return data;
+}
+
+/* Label 1 in a box that moves along the columns from slice to slice, so that a wrong slice
+ * order is detected as well */
+static int16_t* makeLabels(void) {
+  size_t sliceSize = (size_t)SIZE[0] * SIZE[1];
+  int16_t* labels = (int16_t*)calloc(sliceSize * SIZE[2], sizeof(int16_t));
+  uint32_t x, y, z;
+  if(labels == NULL)
+    return NULL;
+  for(z = 0; z < SIZE[2]; z++)
+    for(y = 150; y < 230; y++)
+      for(x = 100 + 20 * z; x < 200 + 20 * z; x++)
+        labels[z * sliceSize + (size_t)y * SIZE[0] + x] = 1;
+  return labels;
+}
+
+static int checkStatus(int status, const dcmqi_result* result, const char* what) {
+  if(status == DCMQI_OK)
+    return 1;
+  fprintf(stderr, "ERROR: %s failed with status %d\n%s", what, status, dcmqi_result_errors(result));
+  return 0;
+}
+
+static int checkGeometry(const dcmqi_geometry* expected, const dcmqi_geometry* actual) {
+  int i, ok = 1;
+  for(i = 0; i < 3; i++) {
+    if(actual->size[i] != expected->size[i]) {
+      fprintf(stderr, "ERROR: Size %d is %u instead of %u\n", i, actual->size[i], expected->size[i]);
+      ok = 0;
+    }
+    if(fabs(actual->origin[i] - expected->origin[i]) > 1e-3) {
+      fprintf(stderr, "ERROR: Origin %d is %f instead of %f\n", i, actual->origin[i], expected->origin[i]);
+      ok = 0;
+    }
+    if(fabs(actual->spacing[i] - expected->spacing[i]) > 1e-4) {
+      fprintf(stderr, "ERROR: Spacing %d is %f instead of %f\n", i, actual->spacing[i], expected->spacing[i]);
+      ok = 0;
+    }
+  }
+  for(i = 0; i < 9; i++) {
+    if(fabs(actual->direction[i] - expected->direction[i]) > 1e-6) {
+      fprintf(stderr, "ERROR: Direction %d is %f instead of %f\n", i, actual->direction[i], expected->direction[i]);
+      ok = 0;
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char* argv[]) {
+  dcmqi_geometry geometry;
+  dcmqi_geometry outputGeometry;
+  const void** sourceData = NULL;
+  size_t* sourceSizes = NULL;
+  size_t sourceCount, metadataSize, voxelCount, segSize, i;
+  char* metadata = NULL;
+  int16_t* labels = NULL;
+  const int16_t* outputLabels = NULL;
+  const void* segData = NULL;
+  dcmqi_result* segResult = NULL;
+  dcmqi_result* labelResult = NULL;
+  int status, ok = 0;
+
+  if(argc < 3) {
+    fprintf(stderr, "Usage: %s <metadata.json> <source DICOM files...>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  if(dcmqi_api_version() != DCMQI_C_API_VERSION) {
+    fprintf(stderr, "ERROR: Library implements version %d of the interface instead of %d\n",
+            dcmqi_api_version(), DCMQI_C_API_VERSION);
+    return EXIT_FAILURE;
+  }
+
+  memset(&geometry, 0, sizeof(geometry));
+  geometry.struct_size = sizeof(geometry);
+  memset(&outputGeometry, 0, sizeof(outputGeometry));
+  outputGeometry.struct_size = sizeof(outputGeometry);
+  for(i = 0; i < 3; i++) {
+    geometry.size[i] = SIZE[i];
+    geometry.origin[i] = ORIGIN[i];
+    geometry.spacing[i] = SPACING[i];
+    geometry.direction[4 * i] = 1.0;
+  }
+  voxelCount = (size_t)SIZE[0] * SIZE[1] * SIZE[2];
+
+  sourceCount = (size_t)(argc - 2);
+  sourceData = (const void**)calloc(sourceCount, sizeof(void*));
+  sourceSizes = (size_t*)calloc(sourceCount, sizeof(size_t));
+  metadata = readFile(argv[1], &metadataSize);
+  labels = makeLabels();
+  if(sourceData == NULL || sourceSizes == NULL || metadata == NULL || labels == NULL)
+    goto cleanup;
+  for(i = 0; i < sourceCount; i++) {
+    sourceData[i] = readFile(argv[i + 2], &sourceSizes[i]);
+    if(sourceData[i] == NULL)
+      goto cleanup;
+  }
+
+  status = dcmqi_labelmaps_to_seg(sourceData, sourceSizes, sourceCount,
+                                  (const int16_t* const*)&labels, &geometry, 1,
+                                  metadata, 1, &segResult);
+  if(!checkStatus(status, segResult, "dcmqi_labelmaps_to_seg")
+     || !checkStatus(dcmqi_result_dicom(segResult, &segData, &segSize), segResult, "dcmqi_result_dicom"))
+    goto cleanup;
+
+  status = dcmqi_seg_to_labelmaps(segData, segSize, 0, &labelResult);
+  if(!checkStatus(status, labelResult, "dcmqi_seg_to_labelmaps"))
+    goto cleanup;
+  if(dcmqi_result_image_count(labelResult) != 1) {
+    fprintf(stderr, "ERROR: Expected 1 label image, got %lu\n", (unsigned long)dcmqi_result_image_count(labelResult));
+    goto cleanup;
+  }
+  if(!checkStatus(dcmqi_result_label_image(labelResult, 0, &outputGeometry, &outputLabels),
+                  labelResult, "dcmqi_result_label_image")
+     || !checkGeometry(&geometry, &outputGeometry))
+    goto cleanup;
+
+  for(i = 0; i < voxelCount; i++) {
+    if(outputLabels[i] != labels[i]) {
+      fprintf(stderr, "ERROR: Voxel %lu is %d instead of %d\n", (unsigned long)i, outputLabels[i], labels[i]);
+      goto cleanup;
+    }
+  }
+  if(strstr(dcmqi_result_metadata(labelResult), "\"labelID\"") == NULL) {
+    fprintf(stderr, "ERROR: Metadata of the label image is missing\n");
+    goto cleanup;
+  }
+  ok = 1;
+
+cleanup:
+  dcmqi_result_free(labelResult);
+  dcmqi_result_free(segResult);
+  if(sourceData != NULL) {
+    for(i = 0; i < sourceCount; i++)
+      free((void*)sourceData[i]);
+  }
+  free(sourceData);
+  free(sourceSizes);
+  free(metadata);
+  free(labels);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,5 +1,7 @@
 // CLP includes
 #include "dcmqi/Itk2DicomConverter.h"
+#include "dcmqi/LabelFileReader.h"
+#include "dcmqi/NumpyIO.h"
 #include "itkimage2segimageCLP.h"
 
 // DCMQI includes
@@ -9,7 +11,11 @@
 // DCMTK includes
 #include <dcmtk/oflog/configrt.h>
 
+// STD includes
+#include <memory>
+
 typedef dcmqi::Helper helper;
+typedef dcmqi::Itk2DicomConverter::LabelBuffer LabelBuffer;
 
 int main(int argc, char *argv[])
 {
@@ -28,20 +34,125 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
   }
 
+  if(tileSize > 0){
+    // Tiled 2D output: the label image is streamed by the converter, and only the
+    // header of the source image is needed
+    if(segImageFiles.size() != 1){
+      cerr << "Error: Tiled output requires exactly one input segmentation image!" << endl;
+      return EXIT_FAILURE;
+    }
+    if(dcmqi::NumpyIO::isArrayFile(segImageFiles[0])){
+      cerr << "Error: Tiled output requires an input segmentation image readable by ITK!" << endl;
+      return EXIT_FAILURE;
+    }
+    if(dicomDirectory.size()){
+      vector<string> dicomFileList = helper::getFileListRecursively(dicomDirectory.c_str());
+      dicomImageFiles.insert(dicomImageFiles.end(), dicomFileList.begin(), dicomFileList.end());
+    }
+    if(dicomImageFiles.empty() || !helper::pathsExist(dicomImageFiles))
+      return EXIT_FAILURE;
+
+    DcmFileFormat sourceFF;
+    // do not load pixel data of the (possibly huge) source image
+    CHECK_COND(sourceFF.loadFile(dicomImageFiles[0].c_str(), EXS_Unknown, EGL_noChange, 4096));
+
+    ifstream metainfoStream(metaDataFileName.c_str(), ios_base::binary);
+    std::string metadata( (std::istreambuf_iterator<char>(metainfoStream) ),
+                         (std::istreambuf_iterator<char>()));
+
+    try {
+      DcmDataset* result = dcmqi::Itk2DicomConverter::itkimage2dcmTiledSegmentation(sourceFF.getDataset(), segImageFiles[0],
+                                                                                   metadata, tileSize, skipEmptySlices);
+      if (result == NULL){
+        std::cerr << "ERROR: Conversion failed." << std::endl;
+        return EXIT_FAILURE;
+      }
+      DcmFileFormat segdocFF(result);
+      // the tiles are RLE compressed already
+      CHECK_COND(segdocFF.saveFile(outputSEGFileName.c_str(), EXS_RLELossless));
+      std::cout << "Saved segmentation as " << outputSEGFileName << endl;
+      delete result;
+      return EXIT_SUCCESS;
+    } catch (int e) {
+      std::cerr << "Fatal error encountered." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // with read-ahead, the label images are read by the converter one at a time, not up front
+  const bool pipelined = readAhead > 0;
+  if(pipelined){
+    if(segmentationType != "BINARY" || frameOrder != "SEGMENT"){
+      cerr << "Error: Read-ahead is only supported for BINARY segmentations with SEGMENT frame order!" << endl;
+      return EXIT_FAILURE;
+    }
+    for(size_t segFileNumber=0; segFileNumber<segImageFiles.size(); segFileNumber++){
+      if(dcmqi::NumpyIO::isArrayFile(segImageFiles[segFileNumber])){
+        cerr << "Error: Read-ahead requires input segmentation images readable by ITK!" << endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
   vector<ShortImageType::Pointer> segmentations;
+  // probability maps are read instead of label images for FRACTIONAL output
+  vector<FloatImageType::Pointer> probabilityMaps;
+  // label buffers of all label inputs; arrays of other types than int16 are only available as such
+  vector<LabelBuffer> labelBuffers;
+  // .npy and raw inputs are mapped and used in place, so the mappings must outlive the conversion
+  vector<std::shared_ptr<dcmqi::NumpyIO::MappedArray> > mappedArrays;
+  const bool fractional = segmentationType == "FRACTIONAL";
 
-  for(size_t segFileNumber=0; segFileNumber<segImageFiles.size(); segFileNumber++){
-    ShortReaderType::Pointer reader = ShortReaderType::New();
-    reader->SetFileName(segImageFiles[segFileNumber]);
-    reader->Update();
-    cout << "Loaded segmentation from " << segImageFiles[segFileNumber] << endl;
+  ShortImageType::SizeType ref_size;
+  for(size_t segFileNumber=0; !pipelined && segFileNumber<segImageFiles.size(); segFileNumber++){
+    ShortImageType::SizeType cmp_size;
+    if(dcmqi::NumpyIO::isArrayFile(segImageFiles[segFileNumber])){
+      std::shared_ptr<dcmqi::NumpyIO::MappedArray> array(new dcmqi::NumpyIO::MappedArray());
+      if(!dcmqi::NumpyIO::mapArray(segImageFiles[segFileNumber], geometryFileName, *array))
+        return EXIT_FAILURE;
+      mappedArrays.push_back(array);
+      cout << "Mapped array of type " << array->dtype << " from " << segImageFiles[segFileNumber] << endl;
 
-    ShortImageType::Pointer labelImage = reader->GetOutput();
-    segmentations.push_back(labelImage);
+      if(fractional){
+        if(array->dtype != "f4"){
+          cerr << "Error: Probability map arrays must be of type float32!" << endl;
+          return EXIT_FAILURE;
+        }
+        probabilityMaps.push_back(dcmqi::NumpyIO::importImage<FloatImageType>(*array));
+        cmp_size = probabilityMaps.back()->GetLargestPossibleRegion().GetSize();
+      } else {
+        LabelBuffer labelBuffer;
+        if(!dcmqi::NumpyIO::getLabelBuffer(*array, labelBuffer)){
+          cerr << "Error: Label arrays must be of type uint8, uint16, int16 or uint32!" << endl;
+          return EXIT_FAILURE;
+        }
+        labelBuffers.push_back(labelBuffer);
+        segmentations.push_back(array->dtype == "i2" ? dcmqi::NumpyIO::importImage<ShortImageType>(*array)
+                                                     : ShortImageType::Pointer());
+        for(int i=0;i<3;i++)
+          cmp_size[i] = labelBuffer.size[i];
+      }
+    } else if(fractional){
+      FloatReaderType::Pointer reader = FloatReaderType::New();
+      reader->SetFileName(segImageFiles[segFileNumber]);
+      reader->Update();
+      cout << "Loaded probability map from " << segImageFiles[segFileNumber] << endl;
 
-    ShortImageType::SizeType ref_size, cmp_size;
-    ref_size = segmentations[0]->GetLargestPossibleRegion().GetSize();
-    cmp_size = labelImage->GetLargestPossibleRegion().GetSize();
+      probabilityMaps.push_back(reader->GetOutput());
+      cmp_size = probabilityMaps.back()->GetLargestPossibleRegion().GetSize();
+    } else {
+      ShortReaderType::Pointer reader = ShortReaderType::New();
+      reader->SetFileName(segImageFiles[segFileNumber]);
+      reader->Update();
+      cout << "Loaded segmentation from " << segImageFiles[segFileNumber] << endl;
+
+      ShortImageType::Pointer labelImage = reader->GetOutput();
+      segmentations.push_back(labelImage);
+      labelBuffers.push_back(LabelBuffer::fromImage(labelImage));
+      cmp_size = labelImage->GetLargestPossibleRegion().GetSize();
+    }
+    if(segFileNumber == 0)
+      ref_size = cmp_size;
     if(ref_size[0] != cmp_size[0] || ref_size[1] != cmp_size[1]){
       cerr << "Error: In-plane dimensions of segmentations are inconsistent!" << endl;
       cerr << ref_size << " vs " << cmp_size << endl;
@@ -49,6 +160,12 @@ int main(int argc, char *argv[])
     }
   }
 
+  if(segmentationType == "LABELMAP"
+     && find(segmentations.begin(), segmentations.end(), ShortImageType::Pointer()) != segmentations.end()){
+    cerr << "Error: LABELMAP segmentations can only be created from int16 label arrays!" << endl;
+    return EXIT_FAILURE;
+  }
+
   if (verbose) {
     // Display DCMTK debug, warning, and error logs in the console
     // For some reason, this code has no effect if it is called too early (e.g., directly after PARSE_ARGS)
@@ -98,7 +215,10 @@ int main(int argc, char *argv[])
     Json::Value reorderedSegmentAttributes;
     vector<int> fileOrder(segImageFiles.size());
     fill(fileOrder.begin(), fileOrder.end(), -1);
-    vector<ShortImageType::Pointer> segmentationsReordered(segImageFiles.size());
+    vector<ShortImageType::Pointer> segmentationsReordered(segmentations.size());
+    vector<FloatImageType::Pointer> probabilityMapsReordered(probabilityMaps.size());
+    vector<LabelBuffer> labelBuffersReordered(labelBuffers.size());
+    vector<string> segImageFilesReordered(segImageFiles.size());
     for(size_t filePosition=0;filePosition<segImageFiles.size();filePosition++){
       for(size_t mappingPosition=0;mappingPosition<segImageFiles.size();mappingPosition++){
         string mappingItem = metaRoot["segmentAttributesFileMapping"][static_cast<int>(mappingPosition)].asCString();
@@ -116,13 +236,33 @@ int main(int argc, char *argv[])
     cout << "Order of input ITK images updated as shown below based on the segmentAttributesFileMapping attribute:" << endl;
     for(size_t i=0;i<segImageFiles.size();i++){
       cout << " image " << i << " moved to position " << fileOrder[i] << endl;
-      segmentationsReordered[fileOrder[i]] = segmentations[i];
+      segImageFilesReordered[fileOrder[i]] = segImageFiles[i];
+      if(fractional)
+        probabilityMapsReordered[fileOrder[i]] = probabilityMaps[i];
+      else if(!pipelined) {
+        segmentationsReordered[fileOrder[i]] = segmentations[i];
+        labelBuffersReordered[fileOrder[i]] = labelBuffers[i];
+      }
     }
     segmentations = segmentationsReordered;
+    probabilityMaps = probabilityMapsReordered;
+    labelBuffers = labelBuffersReordered;
+    segImageFiles = segImageFilesReordered;
   }
 
   try {
-    DcmDataset* result = dcmqi::Itk2DicomConverter::itkimage2dcmSegmentation(dcmDatasets, segmentations, metadata, skipEmptySlices);
+    DcmDataset* result = NULL;
+    if(fractional)
+      result = dcmqi::Itk2DicomConverter::itkimage2dcmFractionalSegmentation(dcmDatasets, probabilityMaps, metadata,
+                                                                            maxFractionalValue, skipEmptySlices);
+    else if(pipelined){
+      dcmqi::LabelFileReader labelReader(segImageFiles, unsigned(readAhead));
+      result = dcmqi::Itk2DicomConverter::itkimage2dcmSegmentation(dcmDatasets, labelReader, metadata, skipEmptySlices);
+    } else if(segmentationType == "LABELMAP")
+      result = dcmqi::Itk2DicomConverter::itkimage2dcmLabelmapSegmentation(dcmDatasets, segmentations, metadata, skipEmptySlices);
+    else
+      result = dcmqi::Itk2DicomConverter::itkimage2dcmSegmentation(dcmDatasets, labelBuffers, metadata, skipEmptySlices,
+                                                                  frameOrder == "POSITION");
 
     if (result == NULL){
       std::cerr << "ERROR: Conversion failed." << std::endl;
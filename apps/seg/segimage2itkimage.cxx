@@ -4,11 +4,20 @@
 
 // DCMQI includes
 #undef HAVE_SSTREAM // Avoid redefinition warning
+#include "dcmqi/ConversionJob.h"
 #include "dcmqi/Dicom2ItkConverter.h"
+#include "dcmqi/NrrdIO.h"
+#include "dcmqi/NumpyIO.h"
+#include "dcmqi/SharedMemoryIO.h"
+#include "dcmqi/TarWriter.h"
 #include "dcmqi/internal/VersionConfigure.h"
 
 // DCMTK includes
 #include <dcmtk/oflog/configrt.h>
+#include <dcmtk/ofstd/ofstd.h>
+
+// STD includes
+#include <memory>
 
 typedef dcmqi::Helper helper;
 typedef itk::ImageFileWriter<ShortImageType> WriterType;
@@ -16,34 +25,104 @@ typedef itk::ImageFileWriter<ShortImageType> WriterType;
 
 int main(int argc, char *argv[])
 {
-  std::cout << dcmqi_INFO << std::endl;
-
   PARSE_ARGS;
 
+  // "-" as output directory writes the output files as tar archive to stdout, and all
+  // messages to stderr. Shared memory output likewise keeps stdout for the announcements.
+  const bool sharedMemoryOutput = outputType == "shm";
+  const bool streamOutput = outputDirName == "-" && !sharedMemoryOutput;
+  std::ostream outputStream(std::cout.rdbuf());
+  if (streamOutput)
+    helper::setBinaryStandardOutput();
+  if (streamOutput || sharedMemoryOutput)
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+  std::cout << dcmqi_INFO << std::endl;
+
   if (verbose) {
     // Display DCMTK debug, warning, and error logs in the console
     dcmtk::log4cplus::BasicConfigurator::doConfigure();
   }
 
-  if (mergeSegments && outputType != "nrrd") {
+  // Slicer segmentations store the segments in as few layers as possible
+  const bool segmentationOutput = outputType == "seg.nrrd";
+  if (mergeSegments && outputType != "nrrd" && !segmentationOutput) {
     std::cerr << "ERROR: mergeSegments option is only supported when output format is NRRD!" << std::endl;
     return EXIT_FAILURE;
   }
 
-  if(helper::isUndefinedOrPathDoesNotExist(inputSEGFileName, "Input DICOM file")
-     || helper::isUndefinedOrPathDoesNotExist(outputDirName, "Output directory"))
+  if (streamOutput && outputType != "nrrd" && outputType != "npy" && outputType != "npy4d" && !segmentationOutput) {
+    std::cerr << "ERROR: Only nrrd, seg.nrrd, npy and npy4d output can be written to stdout!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!manifestFileName.empty()) {
+    if (streamOutput) {
+      std::cerr << "ERROR: Output to stdout is not supported with a manifest!" << std::endl;
+      return EXIT_FAILURE;
+    }
+    ifstream manifest(manifestFileName.c_str());
+    if (!manifest) {
+      std::cerr << "ERROR: Failed to open manifest " << manifestFileName << std::endl;
+      return EXIT_FAILURE;
+    }
+    // items of the manifest use the command line arguments as defaults
+    Json::Value defaults;
+    defaults["type"] = "segimage2itkimage";
+    if (!outputDirName.empty())
+      defaults["outputDirectory"] = outputDirName;
+    if (!prefix.empty())
+      defaults["prefix"] = prefix;
+    defaults["outputType"] = outputType;
+    defaults["mergeSegments"] = mergeSegments;
+
+    size_t numberOfJobs = 0;
+    size_t failures = 0;
+    try {
+      failures = dcmqi::ConversionJob::runManifest(manifest, defaults, threads > 0 ? unsigned(threads) : 0u,
+                                                   outputStream, journalFileName, &numberOfJobs);
+    } catch (int) {
+      // the error has been reported already
+      return EXIT_FAILURE;
+    }
+    std::cerr << "Converted " << numberOfJobs - failures << " of " << numberOfJobs << " objects" << std::endl;
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  // shared memory output does not write any files
+  if (sharedMemoryOutput && !dcmqi::SharedMemoryIO::isSupported()) {
+    std::cerr << "ERROR: Shared memory output is not supported on this platform!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // "-" as input reads the DICOM SEG from stdin
+  const bool streamInput = inputSEGFileName == "-";
+  if((!streamInput && helper::isUndefinedOrPathDoesNotExist(inputSEGFileName, "Input DICOM file"))
+     || (!sharedMemoryOutput && !streamOutput && helper::isUndefinedOrPathDoesNotExist(outputDirName, "Output directory")))
     return EXIT_FAILURE;
 
   DcmRLEDecoderRegistration::registerCodecs();
 
   DcmFileFormat sliceFF;
-  CHECK_COND(sliceFF.loadFile(inputSEGFileName.c_str()));
-  DcmDataset* dataset = sliceFF.getDataset();
+  std::unique_ptr<DcmDataset> streamDataset;
+  DcmDataset* dataset = NULL;
+  if (streamInput) {
+    vector<char> inputBytes;
+    if (!helper::readStandardInput(inputBytes))
+      return EXIT_FAILURE;
+    streamDataset.reset(helper::loadDatasetFromBuffer(inputBytes.empty() ? NULL : &inputBytes[0], inputBytes.size()));
+    if (!streamDataset)
+      return EXIT_FAILURE;
+    dataset = streamDataset.get();
+  } else {
+    CHECK_COND(sliceFF.loadFile(inputSEGFileName.c_str()));
+    dataset = sliceFF.getDataset();
+  }
 
   try {
     dcmqi::Dicom2ItkConverter converter;
     std::string metaInfo;
-    OFCondition result  =  converter.dcmSegmentation2itkimage(dataset, metaInfo, mergeSegments);
+    OFCondition result  =  converter.dcmSegmentation2itkimage(dataset, metaInfo, mergeSegments || segmentationOutput);
     if (result.bad())
     {
       std::cerr << "ERROR: Failed to convert DICOM SEG to ITK image: " << result.text() << std::endl;
@@ -51,15 +130,119 @@ int main(int argc, char *argv[])
     }
 
     string outputPrefix = prefix.empty() ? "" : prefix + "-";
+    // with output to stdout, the files are named without directory in the archive
+    dcmqi::TarWriter archive(outputStream);
+    dcmqi::TarWriter* outputArchive = streamOutput ? &archive : NULL;
+    const string outputPath = streamOutput ? outputPrefix : outputDirName + "/" + outputPrefix;
 
     string fileExtension = dcmqi::Helper::getFileExtensionFromType(outputType);
-    itk::SmartPointer<ShortImageType> itkImage = converter.begin();
+    Json::Value metaRoot;
+    if (sharedMemoryOutput || segmentationOutput) {
+      istringstream metaInfoStream(metaInfo);
+      metaInfoStream >> metaRoot;
+    }
+    stringstream sharedMemoryPrefix;
+    if (prefix.empty())
+      sharedMemoryPrefix << "/dcmqi-" << OFStandard::getProcessID() << "-";
+    else
+      sharedMemoryPrefix << "/" << outputPrefix;
+    Json::StreamWriterBuilder lineWriterBuilder;
+    lineWriterBuilder["indentation"] = "";
+    vector<string> sharedMemoryNames;
+
+    if (segmentationOutput) {
+      // all segment groups are written as layers of one file, without ITK images per group
+      vector<Uint16> voxels;
+      size_t numberOfLayers = 0;
+      ShortImageType::Pointer geometry;
+      result = converter.getLayers(voxels, numberOfLayers, geometry);
+      if (result.bad()) {
+        std::cerr << "ERROR: Failed to get segmentation layers: " << result.text() << std::endl;
+        return EXIT_FAILURE;
+      }
+      cout << "Writing " << numberOfLayers << " layers to " << outputPath << "segmentation" << fileExtension;
+      if (!dcmqi::NrrdIO::writeSegmentation(geometry, voxels, numberOfLayers, metaRoot["segmentAttributes"],
+                                            outputPath + "segmentation" + fileExtension, outputArchive))
+        return EXIT_FAILURE;
+      cout << " ... done" << endl;
+    }
+
+    bool numpyOutput = outputType == "npy" || outputType == "npy4d";
+    Json::Value numpyGeometry;
+    Json::Value numpyArrays(Json::arrayValue);
+    vector<ShortImageType::Pointer> channels;
+
+    itk::SmartPointer<ShortImageType> itkImage = segmentationOutput ? ShortImageType::Pointer() : converter.begin();
     size_t fileIndex = 1;
     while (itkImage)
     {
+      if (numpyGeometry.isNull())
+        numpyGeometry = dcmqi::NumpyIO::getGeometry(itkImage);
+
+      if (sharedMemoryOutput) {
+        // the object holds the metadata of the segments of this image only
+        Json::Value volumeMetaInfo = metaRoot;
+        volumeMetaInfo["segmentAttributes"] = Json::Value(Json::arrayValue);
+        volumeMetaInfo["segmentAttributes"].append(metaRoot["segmentAttributes"][Json::ArrayIndex(fileIndex-1)]);
+
+        stringstream nameSStream;
+        nameSStream << sharedMemoryPrefix.str() << fileIndex;
+        size_t objectSize = 0;
+        if (!dcmqi::SharedMemoryIO::publish(nameSStream.str(), itkImage, itkImage->GetBufferPointer(),
+                                            dcmqi::SharedMemoryIO::INT16,
+                                            Json::writeString(lineWriterBuilder, volumeMetaInfo), &objectSize)) {
+          // the output is incomplete, so the objects published so far are not handed over
+          for (size_t i = 0; i < sharedMemoryNames.size(); i++)
+            dcmqi::SharedMemoryIO::unlink(sharedMemoryNames[i]);
+          return EXIT_FAILURE;
+        }
+        sharedMemoryNames.push_back(nameSStream.str());
+
+        Json::Value announcement;
+        announcement["sharedMemory"] = nameSStream.str();
+        announcement["index"] = Json::UInt64(fileIndex);
+        announcement["bytes"] = Json::UInt64(objectSize);
+        outputStream << Json::writeString(lineWriterBuilder, announcement) << endl;
+        itkImage = converter.next();
+        fileIndex++;
+        continue;
+      }
+
+      if (outputType == "npy4d") {
+        // all images are written at once as channels of one array below
+        channels.push_back(itkImage);
+        itkImage = converter.next();
+        fileIndex++;
+        continue;
+      }
+
       stringstream imageFileNameSStream;
-      cout << "Writing itk image to " << outputDirName << "/" << outputPrefix << fileIndex << fileExtension;
-      imageFileNameSStream << outputDirName << "/" << outputPrefix << fileIndex << fileExtension;
+      imageFileNameSStream << outputPath << fileIndex << fileExtension;
+      cout << "Writing itk image to " << imageFileNameSStream.str();
+
+      if (numpyOutput) {
+        Json::Value arrayInfo;
+        if (!dcmqi::NumpyIO::writeArray(vector<ShortImageType::Pointer>(1, itkImage),
+                                        imageFileNameSStream.str(), &arrayInfo, outputArchive))
+          return EXIT_FAILURE;
+        stringstream arrayFileNameSStream;
+        arrayFileNameSStream << outputPrefix << fileIndex << fileExtension;
+        arrayInfo["fileName"] = arrayFileNameSStream.str();
+        numpyArrays.append(arrayInfo);
+        cout << " ... done" << endl;
+        itkImage = converter.next();
+        fileIndex++;
+        continue;
+      }
+
+      if (streamOutput) {
+        if (!dcmqi::NrrdIO::writeImage(itkImage, imageFileNameSStream.str(), outputArchive))
+          return EXIT_FAILURE;
+        cout << " ... done" << endl;
+        itkImage = converter.next();
+        fileIndex++;
+        continue;
+      }
 
       try {
         WriterType::Pointer writer = WriterType::New();
@@ -76,8 +259,30 @@ int main(int argc, char *argv[])
       fileIndex++;
     }
 
+    if (!channels.empty()) {
+      string arrayFileName = outputPrefix + "seg" + fileExtension;
+      cout << "Writing " << channels.size() << " images to " << outputPath << "seg" << fileExtension;
+      Json::Value arrayInfo;
+      if (!dcmqi::NumpyIO::writeArray(channels, outputPath + "seg" + fileExtension, &arrayInfo, outputArchive))
+        return EXIT_FAILURE;
+      arrayInfo["fileName"] = arrayFileName;
+      numpyArrays.append(arrayInfo);
+      cout << " ... done" << endl;
+    }
+
+    if (numpyOutput && !numpyGeometry.isNull()
+        && !dcmqi::NumpyIO::writeGeometry(numpyGeometry, numpyArrays,
+                                          outputPath + "geometry.json", outputArchive))
+      return EXIT_FAILURE;
+
+    if (sharedMemoryOutput)
+      return EXIT_SUCCESS;
+
+    if (streamOutput)
+      return archive.addFile(outputPath + "meta.json", metaInfo) && archive.finish() ? EXIT_SUCCESS : EXIT_FAILURE;
+
     stringstream jsonOutput;
-    jsonOutput << outputDirName << "/" << outputPrefix << "meta.json";
+    jsonOutput << outputPath << "meta.json";
 
     ofstream outputFile;
     outputFile.open(jsonOutput.str().c_str());
@@ -0,0 +1,61 @@
+// CLP includes
+#include "segimagebooleanCLP.h"
+
+// DCMQI includes
+#undef HAVE_SSTREAM // Avoid redefinition warning
+#include "dcmqi/Helper.h"
+#include "dcmqi/SegmentationEditor.h"
+#include "dcmqi/internal/VersionConfigure.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcrledrg.h>
+#include <dcmtk/oflog/configrt.h>
+
+typedef dcmqi::Helper helper;
+
+int main(int argc, char *argv[])
+{
+  std::cout << dcmqi_INFO << std::endl;
+
+  PARSE_ARGS;
+
+  if(helper::isUndefinedOrPathDoesNotExist(inputSEGFileName, "Input DICOM file")
+     || helper::isUndefined(outputSEGFileName, "Output DICOM file"))
+    return EXIT_FAILURE;
+
+  if(expressions.empty()){
+    cerr << "Error: No expression specified!" << endl;
+    return EXIT_FAILURE;
+  }
+  if(labels.size() > expressions.size()){
+    cerr << "Error: More segment labels than expressions specified!" << endl;
+    return EXIT_FAILURE;
+  }
+
+  if (verbose) {
+    // Display DCMTK debug, warning, and error logs in the console
+    dcmtk::log4cplus::BasicConfigurator::doConfigure();
+  }
+
+  DcmRLEDecoderRegistration::registerCodecs();
+
+  DcmFileFormat segFF;
+  CHECK_COND(segFF.loadFile(inputSEGFileName.c_str()));
+
+  try {
+    DcmDataset result;
+    OFCondition cond = dcmqi::SegmentationEditor::deriveSegments(segFF.getDataset(), expressions, labels,
+                                                                 keepInputSegments, result);
+    if(cond.bad()){
+      std::cerr << "ERROR: Failed to derive segments: " << cond.text() << std::endl;
+      return EXIT_FAILURE;
+    }
+    DcmFileFormat resultFF(&result);
+    CHECK_COND(resultFF.saveFile(outputSEGFileName.c_str(), EXS_LittleEndianExplicit));
+    std::cout << "Saved segmentation as " << outputSEGFileName << endl;
+  } catch (int e) {
+    std::cerr << "Fatal error encountered." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+// CLP includes
+#include "segimagecompareCLP.h"
+
+// DCMQI includes
+#undef HAVE_SSTREAM // Avoid redefinition warning
+#include "dcmqi/Helper.h"
+#include "dcmqi/SegmentationComparison.h"
+#include "dcmqi/internal/VersionConfigure.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcrledrg.h>
+#include <dcmtk/oflog/configrt.h>
+
+// STD includes
+#include <fstream>
+#include <memory>
+
+typedef dcmqi::Helper helper;
+
+int main(int argc, char *argv[])
+{
+  std::cout << dcmqi_INFO << std::endl;
+
+  PARSE_ARGS;
+
+  if(helper::isUndefinedOrPathDoesNotExist(referenceSEGFileName, "Reference DICOM file")
+     || helper::isUndefined(outputJSONFileName, "Output JSON file"))
+    return EXIT_FAILURE;
+
+  if(testSEGFileName.empty() == testImageFileName.empty()){
+    cerr << "Error: Either a test segmentation or a test label map must be specified!" << endl;
+    return EXIT_FAILURE;
+  }
+  if(!testSEGFileName.empty() && helper::isUndefinedOrPathDoesNotExist(testSEGFileName, "Test DICOM file"))
+    return EXIT_FAILURE;
+  if(!testImageFileName.empty() && helper::isUndefinedOrPathDoesNotExist(testImageFileName, "Test label map file"))
+    return EXIT_FAILURE;
+
+  // Pairs are given as <reference segment>:<test segment or label>
+  OFVector<dcmqi::SegmentationComparison::SegmentPair> pairs;
+  for(size_t i=0;i<segmentPairs.size();i++){
+    string reference = segmentPairs[i], test;
+    if(segmentPairs[i].find(':') != string::npos)
+      helper::splitString(segmentPairs[i], reference, test, ":");
+    int referenceNumber = atoi(reference.c_str());
+    int testNumber = test.empty() ? referenceNumber : atoi(test.c_str());
+    if(referenceNumber <= 0 || referenceNumber > 65535 || testNumber <= 0 || testNumber > 65535){
+      cerr << "Error: Invalid segment pair " << segmentPairs[i] << endl;
+      return EXIT_FAILURE;
+    }
+    pairs.push_back(dcmqi::SegmentationComparison::SegmentPair(referenceNumber, testNumber));
+  }
+
+  if (verbose) {
+    // Display DCMTK debug, warning, and error logs in the console
+    dcmtk::log4cplus::BasicConfigurator::doConfigure();
+  }
+
+  DcmRLEDecoderRegistration::registerCodecs();
+
+  try {
+    DcmFileFormat referenceFF, testFF;
+    CHECK_COND(referenceFF.loadFile(referenceSEGFileName.c_str()));
+
+    OFVector<dcmqi::SegmentationComparison::AgreementMetrics> metrics;
+    OFCondition cond;
+    if(!testSEGFileName.empty()){
+      CHECK_COND(testFF.loadFile(testSEGFileName.c_str()));
+      cond = dcmqi::SegmentationComparison::compare(referenceFF.getDataset(), testFF.getDataset(), pairs,
+                                                    surfaceDistances, metrics);
+    } else {
+      ShortReaderType::Pointer reader = ShortReaderType::New();
+      reader->SetFileName(testImageFileName.c_str());
+      reader->Update();
+      cond = dcmqi::SegmentationComparison::compare(referenceFF.getDataset(), reader->GetOutput(), pairs,
+                                                    surfaceDistances, metrics);
+    }
+    if(cond.bad()){
+      std::cerr << "ERROR: Failed to compare segmentations: " << cond.text() << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    Json::StreamWriterBuilder styledBuilder;
+    styledBuilder["indentation"] = "  ";
+    std::unique_ptr<Json::StreamWriter> writer(styledBuilder.newStreamWriter());
+    ofstream outputFile(outputJSONFileName.c_str());
+    writer->write(dcmqi::SegmentationComparison::getJSON(metrics), &outputFile);
+    outputFile << std::endl;
+    if(!outputFile){
+      std::cerr << "ERROR: Failed to write " << outputJSONFileName << std::endl;
+      return EXIT_FAILURE;
+    }
+    for(size_t i=0;i<metrics.size();i++)
+      std::cout << "Segment " << metrics[i].segments.first << " vs " << metrics[i].segments.second
+                << ": Dice " << metrics[i].getDice() << std::endl;
+    std::cout << "Saved comparison of " << metrics.size() << " segment pair(s) as " << outputJSONFileName << std::endl;
+    return EXIT_SUCCESS;
+  } catch (int e) {
+    std::cerr << "Fatal error encountered." << std::endl;
+    return EXIT_FAILURE;
+  } catch (itk::ExceptionObject& e) {
+    std::cerr << "ERROR: " << e.GetDescription() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
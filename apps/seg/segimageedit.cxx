@@ -0,0 +1,106 @@
+// CLP includes
+#include "segimageeditCLP.h"
+
+// DCMQI includes
+#undef HAVE_SSTREAM // Avoid redefinition warning
+#include "dcmqi/Itk2DicomConverter.h"
+#include "dcmqi/SegmentationEditor.h"
+#include "dcmqi/internal/VersionConfigure.h"
+
+// DCMTK includes
+#include <dcmtk/oflog/configrt.h>
+
+typedef dcmqi::Helper helper;
+
+int main(int argc, char *argv[])
+{
+  std::cout << dcmqi_INFO << std::endl;
+
+  PARSE_ARGS;
+
+  if(helper::isUndefinedOrPathDoesNotExist(inputSEGFileName, "Input DICOM file")
+     || helper::isUndefined(outputSEGFileName, "Output DICOM file"))
+    return EXIT_FAILURE;
+
+  if(segmentNumbers.empty() && segImageFiles.empty()){
+    cerr << "Error: Neither segments to be removed nor new segments specified!" << endl;
+    return EXIT_FAILURE;
+  }
+
+  if (verbose) {
+    // Display DCMTK debug, warning, and error logs in the console
+    dcmtk::log4cplus::BasicConfigurator::doConfigure();
+  }
+
+  DcmRLEDecoderRegistration::registerCodecs();
+
+  DcmFileFormat segFF;
+  CHECK_COND(segFF.loadFile(inputSEGFileName.c_str()));
+
+  OFVector<Uint16> editedSegments;
+  for(size_t i=0;i<segmentNumbers.size();i++){
+    if(segmentNumbers[i] <= 0 || segmentNumbers[i] > 65535){
+      cerr << "Error: Invalid segment number " << segmentNumbers[i] << endl;
+      return EXIT_FAILURE;
+    }
+    editedSegments.push_back(segmentNumbers[i]);
+  }
+
+  try {
+    // Encode the new segments only
+    DcmDataset* newSegments = NULL;
+    if(!segImageFiles.empty()){
+      if(helper::isUndefinedOrPathsDoNotExist(segImageFiles, "Input image files")
+         || helper::isUndefinedOrPathDoesNotExist(metaDataFileName, "Input metadata file"))
+        return EXIT_FAILURE;
+
+      vector<ShortImageType::Pointer> segmentations;
+      for(size_t segFileNumber=0; segFileNumber<segImageFiles.size(); segFileNumber++){
+        ShortReaderType::Pointer reader = ShortReaderType::New();
+        reader->SetFileName(segImageFiles[segFileNumber]);
+        reader->Update();
+        segmentations.push_back(reader->GetOutput());
+      }
+
+      if(dicomDirectory.size()){
+        vector<string> dicomFileList = helper::getFileListRecursively(dicomDirectory.c_str());
+        dicomImageFiles.insert(dicomImageFiles.end(), dicomFileList.begin(), dicomFileList.end());
+      }
+      vector<DcmDataset*> dcmDatasets = helper::loadDatasets(dicomImageFiles);
+      if(dcmDatasets.empty()){
+        cerr << "Error: no DICOM could be loaded from the specified list/directory" << endl;
+        return EXIT_FAILURE;
+      }
+
+      ifstream metainfoStream(metaDataFileName.c_str(), ios_base::binary);
+      std::string metadata( (std::istreambuf_iterator<char>(metainfoStream) ),
+                           (std::istreambuf_iterator<char>()));
+
+      newSegments = dcmqi::Itk2DicomConverter::itkimage2dcmSegmentation(dcmDatasets, segmentations, metadata, skipEmptySlices);
+      for(size_t i=0;i<dcmDatasets.size();i++) {
+        delete dcmDatasets[i];
+      }
+      if(newSegments == NULL){
+        std::cerr << "ERROR: Encoding of the new segments failed." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    DcmDataset result;
+    OFCondition cond = dcmqi::SegmentationEditor::editSegments(segFF.getDataset(), newSegments, editedSegments, result);
+    delete newSegments;
+    if(cond.bad()){
+      std::cerr << "ERROR: Failed to edit segmentation: " << cond.text() << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    DcmFileFormat resultFF(&result);
+    CHECK_COND(resultFF.saveFile(outputSEGFileName.c_str(), EXS_LittleEndianExplicit));
+    std::cout << "Saved segmentation as " << outputSEGFileName << endl;
+
+    return EXIT_SUCCESS;
+  } catch (int e) {
+    std::cerr << "Fatal error encountered." << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,70 @@
+// CLP includes
+#include "segimageinfoCLP.h"
+
+// DCMQI includes
+#undef HAVE_SSTREAM // Avoid redefinition warning
+#include "dcmqi/Helper.h"
+#include "dcmqi/SegmentationInfo.h"
+#include "dcmqi/internal/VersionConfigure.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcrledrg.h>
+#include <dcmtk/oflog/configrt.h>
+
+// STD includes
+#include <fstream>
+#include <memory>
+
+typedef dcmqi::Helper helper;
+
+int main(int argc, char *argv[])
+{
+  PARSE_ARGS;
+
+  // Keep the standard output clean if the summary goes there
+  if(!outputJSONFileName.empty())
+    std::cout << dcmqi_INFO << std::endl;
+
+  if(helper::isUndefinedOrPathDoesNotExist(inputSEGFileName, "Input DICOM file"))
+    return EXIT_FAILURE;
+
+  if (verbose) {
+    // Display DCMTK debug, warning, and error logs in the console
+    dcmtk::log4cplus::BasicConfigurator::doConfigure();
+  }
+
+  DcmFileFormat segFF;
+  if(checkOverlap){
+    DcmRLEDecoderRegistration::registerCodecs();
+    CHECK_COND(segFF.loadFile(inputSEGFileName.c_str()));
+  } else {
+    // Stop parsing before Pixel Data, everything else is in the header
+    CHECK_COND(segFF.loadFileUntilTag(inputSEGFileName.c_str(), EXS_Unknown, EGL_noChange,
+                                      DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData));
+  }
+
+  Json::Value info;
+  OFCondition cond = dcmqi::SegmentationInfo::getInfo(segFF.getDataset(), checkOverlap, info);
+  if(cond.bad()){
+    std::cerr << "ERROR: Failed to summarize segmentation: " << cond.text() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Json::StreamWriterBuilder styledBuilder;
+  styledBuilder["indentation"] = "  ";
+  std::unique_ptr<Json::StreamWriter> writer(styledBuilder.newStreamWriter());
+  if(outputJSONFileName.empty()){
+    writer->write(info, &std::cout);
+    std::cout << std::endl;
+  } else {
+    ofstream outputFile(outputJSONFileName.c_str());
+    writer->write(info, &outputFile);
+    outputFile << std::endl;
+    if(!outputFile){
+      std::cerr << "ERROR: Failed to write " << outputJSONFileName << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
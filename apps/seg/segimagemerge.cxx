@@ -0,0 +1,75 @@
+// CLP includes
+#include "segimagemergeCLP.h"
+
+// DCMQI includes
+#undef HAVE_SSTREAM // Avoid redefinition warning
+#include "dcmqi/Helper.h"
+#include "dcmqi/SegmentationEditor.h"
+#include "dcmqi/internal/VersionConfigure.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcrledrg.h>
+#include <dcmtk/oflog/configrt.h>
+
+typedef dcmqi::Helper helper;
+
+int main(int argc, char *argv[])
+{
+  std::cout << dcmqi_INFO << std::endl;
+
+  PARSE_ARGS;
+
+  if(helper::isUndefinedOrPathsDoNotExist(inputSEGFileNames, "Input DICOM files")
+     || helper::isUndefined(outputSEGFileName, "Output DICOM file"))
+    return EXIT_FAILURE;
+
+  if(inputSEGFileNames.size() < 2){
+    cerr << "Error: At least two input segmentations are required!" << endl;
+    return EXIT_FAILURE;
+  }
+
+  if (verbose) {
+    // Display DCMTK debug, warning, and error logs in the console
+    dcmtk::log4cplus::BasicConfigurator::doConfigure();
+  }
+
+  DcmRLEDecoderRegistration::registerCodecs();
+
+  vector<DcmFileFormat> segFFs(inputSEGFileNames.size());
+  OFVector<DcmDataset*> segDatasets;
+  for(size_t i=0;i<inputSEGFileNames.size();i++){
+    CHECK_COND(segFFs[i].loadFile(inputSEGFileNames[i].c_str()));
+    segDatasets.push_back(segFFs[i].getDataset());
+  }
+
+  // Source images are only needed to resample segmentations on a different grid
+  if(dicomDirectory.size()){
+    vector<string> dicomFileList = helper::getFileListRecursively(dicomDirectory.c_str());
+    dicomImageFiles.insert(dicomImageFiles.end(), dicomFileList.begin(), dicomFileList.end());
+  }
+  vector<DcmDataset*> dcmDatasets;
+  if(!dicomImageFiles.empty())
+    dcmDatasets = helper::loadDatasets(dicomImageFiles);
+
+  int status = EXIT_SUCCESS;
+  try {
+    DcmDataset result;
+    OFCondition cond = dcmqi::SegmentationEditor::mergeSegmentations(segDatasets, dcmDatasets, result);
+    if(cond.bad()){
+      std::cerr << "ERROR: Failed to merge segmentations: " << cond.text() << std::endl;
+      status = EXIT_FAILURE;
+    } else {
+      DcmFileFormat resultFF(&result);
+      CHECK_COND(resultFF.saveFile(outputSEGFileName.c_str(), EXS_LittleEndianExplicit));
+      std::cout << "Saved segmentation as " << outputSEGFileName << endl;
+    }
+  } catch (int e) {
+    std::cerr << "Fatal error encountered." << std::endl;
+    status = EXIT_FAILURE;
+  }
+
+  for(size_t i=0;i<dcmDatasets.size();i++) {
+    delete dcmDatasets[i];
+  }
+  return status;
+}
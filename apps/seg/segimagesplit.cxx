@@ -0,0 +1,67 @@
+// CLP includes
+#include "segimagesplitCLP.h"
+
+// ITK includes
+#include <itkMultiThreaderBase.h>
+
+// DCMQI includes
+#undef HAVE_SSTREAM // Avoid redefinition warning
+#include "dcmqi/Helper.h"
+#include "dcmqi/SegmentationEditor.h"
+#include "dcmqi/internal/VersionConfigure.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcrledrg.h>
+#include <dcmtk/oflog/configrt.h>
+
+// STD includes
+#include <atomic>
+
+typedef dcmqi::Helper helper;
+
+int main(int argc, char *argv[])
+{
+  std::cout << dcmqi_INFO << std::endl;
+
+  PARSE_ARGS;
+
+  if(helper::isUndefinedOrPathDoesNotExist(inputSEGFileName, "Input DICOM file")
+     || helper::isUndefinedOrPathDoesNotExist(outputDirName, "Output directory"))
+    return EXIT_FAILURE;
+
+  if (verbose) {
+    // Display DCMTK debug, warning, and error logs in the console
+    dcmtk::log4cplus::BasicConfigurator::doConfigure();
+  }
+
+  DcmRLEDecoderRegistration::registerCodecs();
+
+  DcmFileFormat segFF;
+  CHECK_COND(segFF.loadFile(inputSEGFileName.c_str()));
+
+  OFVector<DcmDataset*> results;
+  OFVector<Uint16> segmentNumbers;
+  OFCondition cond = dcmqi::SegmentationEditor::splitSegmentation(segFF.getDataset(), results, segmentNumbers);
+  if(cond.bad()){
+    std::cerr << "ERROR: Failed to split segmentation: " << cond.text() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The results do not share any data, so they can be written concurrently
+  string outputPrefix = prefix.empty() ? "" : prefix + "-";
+  std::atomic<int> failures(0);
+  itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+  threader->ParallelizeArray(0, results.size(), [&](itk::SizeValueType i){
+    string fileName = outputDirName + "/" + outputPrefix + std::to_string(segmentNumbers[i]) + ".dcm";
+    DcmFileFormat resultFF(results[i]);
+    if(resultFF.saveFile(fileName.c_str(), EXS_LittleEndianExplicit).bad()){
+      std::cerr << "ERROR: Failed to save " << fileName << std::endl;
+      failures++;
+    }
+    delete results[i];
+    results[i] = NULL;
+  }, nullptr);
+
+  std::cout << "Saved " << results.size() - failures << " segmentation(s) to " << outputDirName << std::endl;
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
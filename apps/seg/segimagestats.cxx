@@ -0,0 +1,151 @@
+// CLP includes
+#include "segimagestatsCLP.h"
+
+// DCMQI includes
+#undef HAVE_SSTREAM // Avoid redefinition warning
+#include "dcmqi/Helper.h"
+#include "dcmqi/SegmentationIntensityStatistics.h"
+#include "dcmqi/SegmentationStatistics.h"
+#include "dcmqi/internal/VersionConfigure.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcrledrg.h>
+#include <dcmtk/oflog/configrt.h>
+#include <dcmtk/ofstd/ofstd.h>
+
+// STD includes
+#include <fstream>
+#include <memory>
+
+typedef dcmqi::Helper helper;
+
+void writeJSON(const Json::Value& value, const string& fileName){
+  Json::StreamWriterBuilder styledBuilder;
+  styledBuilder["indentation"] = "  ";
+  std::unique_ptr<Json::StreamWriter> writer(styledBuilder.newStreamWriter());
+  ofstream outputFile(fileName.c_str());
+  writer->write(value, &outputFile);
+  outputFile << std::endl;
+  if(!outputFile){
+    std::cerr << "ERROR: Failed to write " << fileName << std::endl;
+    throw -1;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  std::cout << dcmqi_INFO << std::endl;
+
+  PARSE_ARGS;
+
+  if(helper::isUndefinedOrPathDoesNotExist(inputSEGFileName, "Input DICOM file")
+     || helper::isUndefined(outputJSONFileName, "Output JSON file"))
+    return EXIT_FAILURE;
+
+  if (verbose) {
+    // Display DCMTK debug, warning, and error logs in the console
+    dcmtk::log4cplus::BasicConfigurator::doConfigure();
+  }
+
+  if(sourceDirectory.size()){
+    if(!helper::pathExists(sourceDirectory))
+      return EXIT_FAILURE;
+    vector<string> sourceFileList = helper::getFileListRecursively(sourceDirectory.c_str());
+    sourceImageFiles.insert(sourceImageFiles.end(), sourceFileList.begin(), sourceFileList.end());
+  }
+  if(!helper::pathsExist(sourceImageFiles))
+    return EXIT_FAILURE;
+  if(!parametricMapFileName.empty()){
+    if(helper::isUndefinedOrPathDoesNotExist(parametricMapFileName, "Input parametric map file"))
+      return EXIT_FAILURE;
+    if(!sourceImageFiles.empty()){
+      std::cerr << "ERROR: Either source images or a parametric map can be given, not both" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if(histogramBins <= 0 || histogramMax <= histogramMin){
+    std::cerr << "ERROR: Invalid histogram parameters" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  DcmRLEDecoderRegistration::registerCodecs();
+
+  try {
+    Json::Value report;
+    if(!templateFileName.empty()){
+      if(helper::isUndefinedOrPathDoesNotExist(templateFileName, "Input template file"))
+        return EXIT_FAILURE;
+      ifstream templateStream(templateFileName.c_str(), ifstream::binary);
+      templateStream >> report;
+    } else {
+      report["@schema"] = "https://raw.githubusercontent.com/qiicr/dcmqi/master/doc/schemas/sr-tid1500-schema.json#";
+      report["SeriesDescription"] = "Measurements";
+      report["SeriesNumber"] = "1001";
+      report["InstanceNumber"] = "1";
+      report["observerContext"]["ObserverType"] = "DEVICE";
+      report["observerContext"]["DeviceObserverName"] = "dcmqi segimagestats";
+      report["VerificationFlag"] = "UNVERIFIED";
+      report["CompletionFlag"] = "COMPLETE";
+      report["activitySession"] = "1";
+      report["timePoint"] = "1";
+    }
+
+    DcmFileFormat segFF;
+    CHECK_COND(segFF.loadFile(inputSEGFileName.c_str()));
+
+    OFVector<dcmqi::SegmentationStatistics::SegmentStatistics> statistics;
+    OFCondition cond = dcmqi::SegmentationStatistics::computeStatistics(segFF.getDataset(), statistics);
+    Json::Value measurements;
+    if(cond.good())
+      cond = dcmqi::SegmentationStatistics::getMeasurements(segFF.getDataset(), statistics, measurements);
+    if(cond.bad()){
+      std::cerr << "ERROR: Failed to compute statistics: " << cond.text() << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // Intensity statistics, if a source is given
+    OFVector<dcmqi::SegmentationIntensityStatistics::IntensityStatistics> intensityStatistics;
+    if(!sourceImageFiles.empty() || !parametricMapFileName.empty()){
+      dcmqi::SegmentationIntensityStatistics intensity(histogramMin, histogramMax, OFstatic_cast(Uint32, histogramBins));
+      if(!parametricMapFileName.empty())
+        cond = intensity.setParametricMap(parametricMapFileName);
+      else
+        cond = intensity.setSourceSeries(sourceImageFiles);
+      if(cond.good())
+        cond = intensity.computeStatistics(segFF.getDataset(), intensityStatistics);
+      if(cond.bad()){
+        std::cerr << "ERROR: Failed to compute intensity statistics: " << cond.text() << std::endl;
+        return EXIT_FAILURE;
+      }
+      if(!intensity.getQuantity().isNull() && !intensity.getUnits().isNull())
+        dcmqi::SegmentationIntensityStatistics::addMeasurementItems(intensityStatistics, intensity.getQuantity(),
+                                                                    intensity.getUnits(), measurements);
+      else
+        std::cout << "WARNING: Quantity or units of the source are unknown, intensity statistics are only saved "
+                     "to the statistics file" << std::endl;
+    }
+
+    // The segmentation is the composite context, referenced by its file name
+    if(!report.isMember("compositeContext")){
+      OFFilename segFileName;
+      OFStandard::getFilenameFromPath(segFileName, OFFilename(inputSEGFileName.c_str()));
+      report["compositeContext"].append(segFileName.getCharPointer());
+    }
+    for(Json::ArrayIndex i=0;i<measurements.size();i++)
+      report["Measurements"].append(measurements[i]);
+
+    writeJSON(report, outputJSONFileName);
+    std::cout << "Saved " << measurements.size() << " measurement group(s) as " << outputJSONFileName << std::endl;
+
+    if(!statisticsFileName.empty()){
+      Json::Value segments = dcmqi::SegmentationStatistics::getStatisticsJSON(statistics);
+      dcmqi::SegmentationIntensityStatistics::addStatisticsJSON(intensityStatistics, segments);
+      writeJSON(segments, statisticsFileName);
+    }
+
+    return EXIT_SUCCESS;
+  } catch (int e) {
+    std::cerr << "Fatal error encountered." << std::endl;
+    return EXIT_FAILURE;
+  }
+}
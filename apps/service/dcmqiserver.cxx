@@ -0,0 +1,262 @@
+// CLP includes
+#include "dcmqiserverCLP.h"
+
+// DCMQI includes
+#undef HAVE_SSTREAM // Avoid redefinition warning
+#include "dcmqi/ConversionJob.h"
+#include "dcmqi/internal/VersionConfigure.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdict.h>
+
+// POSIX includes
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// STD includes
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+  // Set by a shutdown job or by SIGINT/SIGTERM
+  std::atomic<bool> stopping(false);
+
+  void requestStop(int) {
+    stopping = true;
+  }
+
+  // Client threads are detached; the service waits for them before stopping the workers
+  std::mutex clientMutex;
+  std::condition_variable clientsDone;
+  size_t activeClients = 0;
+
+  // Waits until a socket is readable, checking regularly whether the service stops
+  bool waitForInput(int socket) {
+    while (!stopping) {
+      struct pollfd descriptor;
+      descriptor.fd = socket;
+      descriptor.events = POLLIN;
+      descriptor.revents = 0;
+      int ready = poll(&descriptor, 1, 200);
+      if (ready > 0)
+        return true;
+      if (ready < 0 && errno != EINTR)
+        return false;
+    }
+    return false;
+  }
+
+  // Client connection; the status of its jobs is sent by the worker threads
+  class Connection {
+  public:
+    explicit Connection(int socket) : m_socket(socket), m_pendingJobs(0) {}
+    ~Connection() { close(m_socket); }
+
+    int getSocket() const { return m_socket; }
+
+    void send(const Json::Value &status) {
+      Json::StreamWriterBuilder builder;
+      builder["indentation"] = "";
+      const std::string line = Json::writeString(builder, status) + "\n";
+
+      std::lock_guard<std::mutex> lock(m_sendMutex);
+      size_t sent = 0;
+      while (sent < line.size()) {
+        ssize_t count = ::send(m_socket, line.data() + sent, line.size() - sent, 0);
+        if (count < 0 && errno == EINTR)
+          continue;
+        if (count <= 0)
+          return; // the client is gone, the job results are dropped
+        sent += size_t(count);
+      }
+    }
+
+    void beginJob() {
+      std::lock_guard<std::mutex> lock(m_jobMutex);
+      m_pendingJobs++;
+    }
+
+    void endJob() {
+      std::lock_guard<std::mutex> lock(m_jobMutex);
+      m_pendingJobs--;
+      m_jobsDone.notify_all();
+    }
+
+    void waitForJobs() {
+      std::unique_lock<std::mutex> lock(m_jobMutex);
+      m_jobsDone.wait(lock, [this](){ return m_pendingJobs == 0; });
+    }
+
+  private:
+    int m_socket;
+    std::mutex m_sendMutex;
+    std::mutex m_jobMutex;
+    std::condition_variable m_jobsDone;
+    size_t m_pendingJobs;
+  };
+
+  Json::Value errorStatus(const Json::Value &job, const std::string &message) {
+    Json::Value status;
+    if (job.isObject() && job.isMember("id"))
+      status["id"] = job["id"];
+    status["success"] = false;
+    status["outputs"] = Json::Value(Json::arrayValue);
+    status["log"] = "";
+    status["errors"] = message;
+    return status;
+  }
+
+  // Reads the jobs of a client line by line and queues them
+  void serve(std::shared_ptr<Connection> connection, dcmqi::AsyncConverter &converter) {
+    std::string buffer;
+    char chunk[4096];
+    while (waitForInput(connection->getSocket())) {
+      ssize_t count = recv(connection->getSocket(), chunk, sizeof(chunk), 0);
+      if (count < 0 && errno == EINTR)
+        continue;
+      if (count <= 0)
+        break;
+      buffer.append(chunk, size_t(count));
+
+      size_t end;
+      while ((end = buffer.find('\n')) != std::string::npos) {
+        const std::string line = buffer.substr(0, end);
+        buffer.erase(0, end + 1);
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+          continue;
+
+        Json::Value job;
+        Json::CharReaderBuilder readerBuilder;
+        std::unique_ptr<Json::CharReader> reader(readerBuilder.newCharReader());
+        std::string parseErrors;
+        if (!reader->parse(line.data(), line.data() + line.size(), &job, &parseErrors)) {
+          connection->send(errorStatus(job, "ERROR: Invalid job: " + parseErrors));
+          continue;
+        }
+        if (job.isObject() && job.get("type", "").asString() == "shutdown") {
+          stopping = true;
+          Json::Value status;
+          if (job.isMember("id"))
+            status["id"] = job["id"];
+          status["success"] = true;
+          connection->send(status);
+          break;
+        }
+        if (!dcmqi::ConversionJob::isValid(job)) {
+          connection->send(errorStatus(job, "ERROR: Job without a known \"type\""));
+          continue;
+        }
+
+        connection->beginJob();
+        dcmqi::ConversionJob::submit(converter, job, [connection](const Json::Value &status){
+          connection->send(status);
+          connection->endJob();
+        });
+      }
+    }
+    // results of running jobs are still sent before the connection is closed
+    connection->waitForJobs();
+
+    std::lock_guard<std::mutex> lock(clientMutex);
+    activeClients--;
+    clientsDone.notify_all();
+  }
+
+}
+
+int main(int argc, char *argv[])
+{
+  std::cout << dcmqi_INFO << std::endl;
+
+  PARSE_ARGS;
+
+  if (socketPath.empty()) {
+    std::cerr << "ERROR: Socket path must be specified!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    std::cerr << "ERROR: Socket path is too long: " << socketPath << std::endl;
+    return EXIT_FAILURE;
+  }
+  strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+  // a stale socket of an earlier run is replaced, any other file is left alone
+  struct stat existing;
+  if (lstat(socketPath.c_str(), &existing) == 0) {
+    if (!S_ISSOCK(existing.st_mode)) {
+      std::cerr << "ERROR: " << socketPath << " exists and is not a socket!" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (unlink(socketPath.c_str()) != 0) {
+      std::cerr << "ERROR: Failed to remove the existing socket " << socketPath << ": " << strerror(errno) << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  int listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenSocket < 0) {
+    std::cerr << "ERROR: Failed to create socket: " << strerror(errno) << std::endl;
+    return EXIT_FAILURE;
+  }
+  // only the user running the service may connect
+  mode_t previousMask = umask(077);
+  int bound = bind(listenSocket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+  umask(previousMask);
+  if (bound != 0 || listen(listenSocket, 16) != 0) {
+    std::cerr << "ERROR: Failed to listen on " << socketPath << ": " << strerror(errno) << std::endl;
+    close(listenSocket);
+    return EXIT_FAILURE;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, requestStop);
+  signal(SIGTERM, requestStop);
+
+  // load the DICOM dictionary before the first job needs it
+  dcmDataDict.rdlock();
+  dcmDataDict.rdunlock();
+
+  {
+    dcmqi::AsyncConverter converter(threads > 0 ? unsigned(threads) : 0u);
+    std::cout << "Listening on " << socketPath << std::endl;
+
+    while (waitForInput(listenSocket)) {
+      int clientSocket = accept(listenSocket, NULL, NULL);
+      if (clientSocket < 0) {
+        if (errno == EINTR || errno == ECONNABORTED)
+          continue;
+        std::cerr << "ERROR: Failed to accept connection: " << strerror(errno) << std::endl;
+        break;
+      }
+      std::shared_ptr<Connection> connection(new Connection(clientSocket));
+      {
+        std::lock_guard<std::mutex> lock(clientMutex);
+        activeClients++;
+      }
+      std::thread(serve, connection, std::ref(converter)).detach();
+    }
+    stopping = true;
+
+    std::unique_lock<std::mutex> lock(clientMutex);
+    clientsDone.wait(lock, [](){ return activeClients == 0; });
+  }
+
+  close(listenSocket);
+  unlink(socketPath.c_str());
+  std::cout << "Service stopped" << std::endl;
+  return EXIT_SUCCESS;
+}
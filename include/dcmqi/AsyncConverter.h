@@ -0,0 +1,189 @@
+#ifndef DCMQI_ASYNCCONVERTER_H
+#define DCMQI_ASYNCCONVERTER_H
+
+// STD includes
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// DCMQI includes
+#include "dcmqi/ConversionContext.h"
+#include "dcmqi/ConverterBase.h"
+
+namespace dcmqi {
+
+  /**
+   * @brief The AsyncConverter class runs conversions on a pool of worker threads.
+   *
+   * Conversions are queued and return either a future or invoke a callback on the worker
+   * thread once they are done. Each conversion runs in its own ConversionContext, so that its
+   * messages are collected in the result instead of being interleaved on the console.
+   *
+   * The datasets and images handed to a conversion must stay valid until it is done, and must
+   * not be accessed by other threads in the meantime. Conversions that parallelize internally
+   * use the ITK thread pool, which is independent of the workers of this class; messages written
+   * from those ITK threads are not part of the result (see ConversionContext).
+   */
+  class AsyncConverter {
+
+  public:
+
+    /// Outcome of a conversion along with the messages it produced
+    template<typename T>
+    struct Result {
+      Result() : value(), success(false) {}
+
+      /// Value returned by the conversion, only meaningful if it succeeded
+      T value;
+      /// Whether the conversion succeeded
+      bool success;
+      /// Progress messages
+      std::string log;
+      /// Warnings and errors
+      std::string errors;
+    };
+
+    /// Images and JSON metadata resulting from reading a DICOM Segmentation object
+    struct SegmentationImages {
+      std::vector<ShortImageType::Pointer> images;
+      std::string metaInfo;
+    };
+
+    typedef Result<DcmDataset*> DatasetResult;
+    typedef Result<SegmentationImages> SegmentationImagesResult;
+    typedef Result<std::pair<FloatImageType::Pointer, std::string> > ParametricMapResult;
+
+    /**
+     * @brief Starts the worker threads.
+     *
+     * @param numberOfThreads Number of conversions running at the same time, or 0 to use the
+     *        number of hardware threads.
+     */
+    explicit AsyncConverter(unsigned numberOfThreads=0);
+
+    /**
+     * @brief Waits for all queued conversions to finish and stops the worker threads.
+     */
+    ~AsyncConverter();
+
+    /**
+     * @brief Queues a conversion.
+     *
+     * The conversion fails if it throws, which includes the errors reported through CHECK_COND.
+     *
+     * @param conversion Function performing the conversion.
+     * @return Future of the result.
+     */
+    template<typename T>
+    std::future<Result<T> > submit(std::function<T()> conversion) {
+      std::shared_ptr<std::promise<Result<T> > > promise(new std::promise<Result<T> >());
+      std::future<Result<T> > future = promise->get_future();
+      enqueue([conversion, promise](){
+        Result<T> result;
+        run(conversion, result);
+        promise->set_value(std::move(result));
+      });
+      return future;
+    }
+
+    /**
+     * @brief Queues a conversion whose result is passed to a callback on the worker thread.
+     *
+     * @param conversion Function performing the conversion.
+     * @param callback Function receiving the result.
+     */
+    template<typename T>
+    void submit(std::function<T()> conversion, std::function<void(Result<T>&)> callback) {
+      enqueue([conversion, callback](){
+        Result<T> result;
+        run(conversion, result);
+        callback(result);
+      });
+    }
+
+    /**
+     * @brief Queues Itk2DicomConverter::itkimage2dcmSegmentation(). The resulting dataset is owned
+     *        by the caller.
+     */
+    std::future<DatasetResult> itkimage2dcmSegmentation(const std::vector<DcmDataset*> &dcmDatasets,
+                                                        const std::vector<ShortImageType::Pointer> &segmentations,
+                                                        const std::string &metaData,
+                                                        bool skipEmptySlices=true);
+
+    /**
+     * @brief Queues Dicom2ItkConverter::dcmSegmentation2itkimage() and collects all resulting images.
+     */
+    std::future<SegmentationImagesResult> dcmSegmentation2itkimage(DcmDataset* segDataset,
+                                                                   bool mergeSegments=false);
+
+    /**
+     * @brief Queues ParaMapConverter::itkimage2paramap(). The resulting dataset is owned by the caller.
+     */
+    std::future<DatasetResult> itkimage2paramap(const FloatImageType::Pointer &parametricMapImage,
+                                                const std::vector<DcmDataset*> &dcmDatasets,
+                                                const std::string &metaData);
+
+    /**
+     * @brief Queues ParaMapConverter::paramap2itkimage().
+     */
+    std::future<ParametricMapResult> paramap2itkimage(DcmDataset* pmapDataset);
+
+  protected:
+
+    /**
+     * @brief Runs a conversion in its own context and fills in the result.
+     */
+    template<typename T>
+    static void run(const std::function<T()> &conversion, Result<T> &result) {
+      std::ostringstream out, err;
+      {
+        ConversionContext context(out, err);
+        try {
+          result.value = conversion();
+          result.success = true;
+        } catch (int) {
+          // the error has been reported already
+        } catch (std::exception &e) {
+          err << "ERROR: " << e.what() << std::endl;
+        } catch (...) {
+          err << "ERROR: Unknown exception during conversion" << std::endl;
+        }
+      }
+      result.log = out.str();
+      result.errors = err.str();
+    }
+
+    /**
+     * @brief Adds a task to the queue of the workers.
+     */
+    void enqueue(std::function<void()> task);
+
+    /**
+     * @brief Processes queued tasks until the converter is destroyed.
+     */
+    void work();
+
+  private:
+
+    AsyncConverter(const AsyncConverter&);
+    AsyncConverter& operator=(const AsyncConverter&);
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()> > m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping;
+  };
+
+}
+
+#endif //DCMQI_ASYNCCONVERTER_H
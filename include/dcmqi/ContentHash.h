@@ -0,0 +1,50 @@
+#ifndef DCMQI_CONTENTHASH_H
+#define DCMQI_CONTENTHASH_H
+
+// STD includes
+#include <stdint.h>
+#include <string>
+
+namespace dcmqi {
+
+  /**
+   * @brief The ContentHash class computes SHA-256 digests, used to recognize conversions whose
+   * inputs did not change.
+   */
+  class ContentHash {
+
+  public:
+
+    ContentHash();
+
+    /// Adds bytes to the digest
+    void update(const void* data, size_t length);
+
+    /// Adds a string, preceded by its length so that consecutive strings cannot be confused
+    void update(const std::string &value);
+
+    /**
+     * @brief Adds the content of a file.
+     *
+     * @return false if the file cannot be read
+     */
+    bool updateFromFile(const std::string &fileName);
+
+    /// Finishes the digest and returns it as lowercase hex string
+    std::string getHexDigest();
+
+  protected:
+
+    void processBlock(const uint8_t* block);
+
+  private:
+
+    uint32_t m_state[8];
+    uint8_t m_buffer[64];
+    size_t m_bufferLength;
+    uint64_t m_totalLength;
+  };
+
+}
+
+#endif //DCMQI_CONTENTHASH_H
@@ -0,0 +1,71 @@
+#ifndef DCMQI_CONVERSIONCONTEXT_H
+#define DCMQI_CONVERSIONCONTEXT_H
+
+// STD includes
+#include <ostream>
+
+namespace dcmqi {
+
+  /**
+   * @brief The ConversionContext class routes the messages of the conversion running on the
+   * current thread.
+   *
+   * Library code writes its progress and error messages to out() and err() instead of
+   * std::cout and std::cerr. Without an active context these are the standard streams; while a
+   * context object exists, the messages of its thread go to the streams it was created with.
+   * Contexts can be nested, the innermost one is active. Several conversions can thus run
+   * concurrently in one process, each with its own log.
+   *
+   * The context is bound to the thread that created it. Code running on the ITK thread pool,
+   * e.g. the ParallelizeArray() workers of the statistics, comparison and editing operations,
+   * has no active context, so anything it writes to out() or err() goes to std::cout and
+   * std::cerr instead of the log of the conversion. Such code should collect its messages and
+   * report them after the parallel section.
+   */
+  class ConversionContext {
+
+  public:
+
+    /**
+     * @brief Activates a context for the current thread.
+     *
+     * @param out Stream receiving progress messages.
+     * @param err Stream receiving warnings and errors.
+     */
+    ConversionContext(std::ostream &out, std::ostream &err);
+
+    /**
+     * @brief Restores the context that was active before on this thread.
+     */
+    ~ConversionContext();
+
+    /**
+     * @brief Stream for progress messages of the current thread.
+     */
+    static std::ostream& out();
+
+    /**
+     * @brief Stream for warnings and errors of the current thread.
+     */
+    static std::ostream& err();
+
+    /**
+     * @brief Performs the process-wide setup needed by the converters, i.e. registers the
+     * decompression codecs and configures the DCMTK loggers. Safe to call from several threads,
+     * the setup happens only once.
+     */
+    static void initialize();
+
+  private:
+
+    ConversionContext(const ConversionContext&);
+    ConversionContext& operator=(const ConversionContext&);
+
+    std::ostream &m_out;
+    std::ostream &m_err;
+    ConversionContext* m_previous;
+  };
+
+}
+
+#endif //DCMQI_CONVERSIONCONTEXT_H
@@ -0,0 +1,164 @@
+#ifndef DCMQI_CONVERSIONJOB_H
+#define DCMQI_CONVERSIONJOB_H
+
+// STD includes
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// JSON includes
+#include <json/json.h>
+
+// DCMQI includes
+#include "dcmqi/AsyncConverter.h"
+
+namespace dcmqi {
+
+  /**
+   * @brief The ConversionJob class runs conversions described as JSON objects, as used by the
+   * conversion service and batch processing.
+   *
+   * The "type" of a job names the command line tool whose conversion it performs, and its other
+   * members are named like the long flags of that tool:
+   *
+   * - segimage2itkimage: inputDICOM, outputDirectory, prefix, outputType (ITK formats, seg.nrrd
+   *   or npy), mergeSegments
+   * - paramap2itkimage: inputDICOM, outputDirectory, prefix, outputType (ITK formats or npy)
+   * - itkimage2segimage: inputImageList, inputMetadata, inputDICOMList or inputDICOMDirectory,
+   *   outputDICOM, skip, segmentationType (BINARY or LABELMAP)
+   * - itkimage2paramap: inputImage, inputMetadata, inputDICOMList or inputDICOMDirectory,
+   *   outputDICOM
+   *
+   * Lists are given as JSON arrays. An optional "id" is copied to the status of the job.
+   */
+  class ConversionJob {
+
+  public:
+
+    /**
+     * @brief Runs a job. Progress and errors are reported through ConversionContext.
+     *
+     * @param job Description of the job.
+     * @return Array with the names of the files written by the job.
+     * @throws int if the job failed, after reporting the error.
+     */
+    static Json::Value run(const Json::Value &job);
+
+    /**
+     * @brief Queues a job on an AsyncConverter.
+     *
+     * @param converter Converter running the job.
+     * @param job Description of the job.
+     * @param callback Function receiving the status of the job, see getStatus(), on the worker thread.
+     */
+    static void submit(AsyncConverter &converter, const Json::Value &job,
+                       std::function<void(const Json::Value&)> callback);
+
+    /**
+     * @brief Creates the status of a finished job: its "id", "success", the "outputs" written,
+     * and the "log" and "errors" messages.
+     */
+    static Json::Value getStatus(const Json::Value &job, const AsyncConverter::Result<Json::Value> &result);
+
+    /**
+     * @brief Checks whether a job has a known type.
+     */
+    static bool isValid(const Json::Value &job);
+
+    /**
+     * @brief Runs the jobs of a manifest on a pool of worker threads.
+     *
+     * The manifest holds one job per line (JSON Lines); empty lines are skipped. Members missing
+     * in a job are taken from the defaults. Jobs without "id" get their line number as id. The
+     * status of each job is written as one JSON line as soon as it is done, so the order may
+     * differ from the manifest. Failing jobs do not affect the others.
+     *
+     * If a journal is given, each successful job is appended to it along with the hash of its
+     * inputs (see getInputHash()) and the dcmqi revision. Jobs whose hash matches a journal entry
+     * of the same revision, and whose outputs still exist, are skipped and reported with
+     * "skipped" set, so an interrupted run can be repeated and only does the remaining work.
+     *
+     * @param manifest Stream with the jobs.
+     * @param defaults Default members of the jobs.
+     * @param numberOfThreads Number of jobs running at the same time, or 0 to use the number of
+     *        hardware threads.
+     * @param status Stream receiving the status of each job.
+     * @param journalFileName Name of the journal file, created if needed; empty for no journal.
+     * @param numberOfJobs If not NULL, receives the number of jobs in the manifest.
+     * @return Number of jobs that failed, including invalid lines.
+     * @throws int if the journal cannot be opened, after reporting the error.
+     */
+    static size_t runManifest(std::istream &manifest, const Json::Value &defaults, unsigned numberOfThreads,
+                              std::ostream &status, const std::string &journalFileName="",
+                              size_t* numberOfJobs=NULL);
+
+    /**
+     * @brief Computes the SHA-256 hash identifying the work of a job: the dcmqi revision, the
+     * job members other than id and input file names, and the content of the inputs. For
+     * conversions to DICOM, these are the image and metadata files and the SOP Instance UIDs of
+     * the source images; for conversions from DICOM, the bytes of the DICOM object.
+     *
+     * @throws int if an input cannot be read, after reporting the error.
+     */
+    static std::string getInputHash(const Json::Value &job);
+
+  protected:
+
+    static Json::Value runSegimage2itkimage(const Json::Value &job);
+    static Json::Value runParamap2itkimage(const Json::Value &job);
+    static Json::Value runItkimage2segimage(const Json::Value &job);
+    static Json::Value runItkimage2paramap(const Json::Value &job);
+
+    /**
+     * @brief Gets a required string member of a job.
+     */
+    static std::string getString(const Json::Value &job, const std::string &key);
+
+    /**
+     * @brief Gets a list member of a job, which may also be given as a single string.
+     */
+    static std::vector<std::string> getStringList(const Json::Value &job, const std::string &key);
+
+    /**
+     * @brief Loads the source DICOM datasets of a job from inputDICOMList and inputDICOMDirectory.
+     */
+    static std::vector<DcmDataset*> loadSourceDatasets(const Json::Value &job);
+
+    /**
+     * @brief Gets the names of the source DICOM files of a job from inputDICOMList and
+     * inputDICOMDirectory.
+     */
+    static std::vector<std::string> getSourceFiles(const Json::Value &job);
+
+    /**
+     * @brief Reads the completed entries of the current revision from a journal, by input hash.
+     */
+    static std::map<std::string, Json::Value> readJournal(const std::string &journalFileName);
+
+    /**
+     * @brief Reads a whole text file.
+     */
+    static std::string readFile(const std::string &fileName);
+
+    /**
+     * @brief Writes an image with compression.
+     */
+    template<typename TImage>
+    static void writeImage(const typename TImage::Pointer &image, const std::string &fileName) {
+      try {
+        typename itk::ImageFileWriter<TImage>::Pointer writer = itk::ImageFileWriter<TImage>::New();
+        writer->SetFileName(fileName.c_str());
+        writer->SetInput(image);
+        writer->SetUseCompression(1);
+        writer->Update();
+      } catch (itk::ExceptionObject &error) {
+        ConversionContext::err() << "ERROR: Failed to write " << fileName << ": " << error << std::endl;
+        throw -1;
+      }
+    }
+  };
+
+}
+
+#endif //DCMQI_CONVERSIONJOB_H
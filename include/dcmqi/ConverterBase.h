@@ -17,6 +17,7 @@
 #include <dcmtk/dcmiod/iodmacro.h>
 #include <dcmtk/dcmiod/modenhequipment.h>
 #include <dcmtk/dcmiod/modequipment.h>
+#include <dcmtk/dcmiod/modfloatingpointimagepixel.h>
 #include <dcmtk/dcmfg/fginterface.h>
 #include <dcmtk/dcmfg/fgplanor.h>
 #include <dcmtk/dcmfg/fgplanpo.h>
@@ -41,6 +42,17 @@ typedef unsigned char CharPixelType;
 typedef itk::Image<ShortPixelType, 3> ShortImageType;
 typedef itk::Image<CharPixelType, 3> CharImageType;
 typedef itk::ImageFileReader<ShortImageType> ShortReaderType;
+typedef unsigned short UShortPixelType;
+typedef itk::Image<UShortPixelType, 2> UShortImage2DType;
+typedef itk::ImageFileReader<UShortImage2DType> UShortReader2DType;
+typedef IODFloatingPointImagePixelModule::value_type FloatPixelType;
+typedef itk::Image<FloatPixelType, 3> FloatImageType;
+typedef itk::ImageFileReader<FloatImageType> FloatReaderType;
+
+// Label Map Segmentation Storage (Sup 243), not yet known to all supported DCMTK versions
+#ifndef UID_LabelMapSegmentationStorage
+#define UID_LabelMapSegmentationStorage "1.2.840.10008.5.1.4.1.1.66.7"
+#endif
 
 namespace dcmqi {
 
@@ -60,7 +72,7 @@ namespace dcmqi {
       FGPlaneOrientationPatient *planorfg = OFstatic_cast(FGPlaneOrientationPatient*,
                                                           fgInterface.get(0, DcmFGTypes::EFG_PLANEORIENTPATIENT, isPerFrame));
       if(!planorfg){
-        cerr << "Plane Orientation (Patient) is missing, cannot parse input " << endl;
+        ConversionContext::err() << "Plane Orientation (Patient) is missing, cannot parse input " << endl;
         return EXIT_FAILURE;
       }
       OFString orientStr;
@@ -68,7 +80,7 @@ namespace dcmqi {
         if(planorfg->getImageOrientationPatient(orientStr, i).good()){
           rowDirection[i] = atof(orientStr.c_str());
         } else {
-          cerr << "Failed to get orientation " << i << endl;
+          ConversionContext::err() << "Failed to get orientation " << i << endl;
           return EXIT_FAILURE;
         }
       }
@@ -76,15 +88,15 @@ namespace dcmqi {
         if(planorfg->getImageOrientationPatient(orientStr, i).good()){
           colDirection[i-3] = atof(orientStr.c_str());
         } else {
-          cerr << "Failed to get orientation " << i << endl;
+          ConversionContext::err() << "Failed to get orientation " << i << endl;
           return EXIT_FAILURE;
         }
       }
       vnl_vector<double> sliceDirection = vnl_cross_3d(rowDirection, colDirection);
       sliceDirection.normalize();
 
-      cout << "Row direction: " << rowDirection << endl;
-      cout << "Col direction: " << colDirection << endl;
+      ConversionContext::out() << "Row direction: " << rowDirection << endl;
+      ConversionContext::out() << "Col direction: " << colDirection << endl;
 
       for(int i=0;i<3;i++){
         dir[i][0] = rowDirection[i];
@@ -92,7 +104,7 @@ namespace dcmqi {
         dir[i][2] = sliceDirection[i];
       }
 
-      cout << "Z direction: " << sliceDirection << endl;
+      ConversionContext::out() << "Z direction: " << sliceDirection << endl;
 
       return 0;
     }
@@ -138,7 +150,7 @@ namespace dcmqi {
           if(planposfg->getImagePositionPatient(planposStr, j).good()){
             refOrigin[j] = atof(planposStr.c_str());
           } else {
-            cerr << "Failed to read patient position" << endl;
+            ConversionContext::err() << "Failed to read patient position" << endl;
           }
         }
       }
@@ -149,12 +161,12 @@ namespace dcmqi {
                                                      fgInterface.get(frameId, DcmFGTypes::EFG_PLANEPOSPATIENT, isPerFrame));
 
         if(!planposfg){
-          cerr << "PlanePositionPatient is missing" << endl;
+          ConversionContext::err() << "PlanePositionPatient is missing" << endl;
           return EXIT_FAILURE;
         }
 
         if(!isPerFrame){
-          cerr << "PlanePositionPatient is required for each frame!" << endl;
+          ConversionContext::err() << "PlanePositionPatient is required for each frame!" << endl;
           return EXIT_FAILURE;
         }
 
@@ -169,7 +181,7 @@ namespace dcmqi {
             if(j<2)
               sOriginStr+='/';
           } else {
-            cerr << "Failed to read patient position" << endl;
+            ConversionContext::err() << "Failed to read patient position" << endl;
             return EXIT_FAILURE;
           }
         }
@@ -204,7 +216,7 @@ namespace dcmqi {
         }
       }
 
-      cout << "Total frames: " << numFrames << endl;
+      ConversionContext::out() << "Total frames: " << numFrames << endl;
 
       // it IS possible to have a segmentation object containing just one frame!
       if(numFrames>1){
@@ -223,17 +235,17 @@ namespace dcmqi {
         sliceSpacing = fabs(originDistances[0]-originDistances[1]);
         if (sliceSpacing == 0)
         {
-          cout << "Slice spacing is zero, trying to get/use it from DICOM file instead" << endl;
+          ConversionContext::out() << "Slice spacing is zero, trying to get/use it from DICOM file instead" << endl;
           // Get Slice Spacing as defined in Pixel Measures FG
           OFBool isPerFrame;
           FGPixelMeasures *pixelMeasures = OFstatic_cast(FGPixelMeasures*,
                                                          fgInterface.get(0, DcmFGTypes::EFG_PIXELMEASURES, isPerFrame));
           if(!pixelMeasures){
-            cerr << "Canont get Slice Spacing, Pixel Measures FG is missing!" << endl;
+            ConversionContext::err() << "Canont get Slice Spacing, Pixel Measures FG is missing!" << endl;
             return EXIT_FAILURE;
           }
           if(pixelMeasures->getSpacingBetweenSlices(sliceSpacing,0).good()){
-            cout << "Using Slice Spacing (from DICOM file): " << sliceSpacing << endl;
+            ConversionContext::out() << "Using Slice Spacing (from DICOM file): " << sliceSpacing << endl;
           }
         }
 
@@ -249,8 +261,8 @@ namespace dcmqi {
             if(it->second>1)
               overlappingFramesCnt++;
         }
-        cout << "Total frames with unique IPP: " << originDistances.size() << endl;
-        cout << "Total overlapping frames: " << overlappingFramesCnt << endl;
+        ConversionContext::out() << "Total frames with unique IPP: " << originDistances.size() << endl;
+        ConversionContext::out() << "Total overlapping frames: " << overlappingFramesCnt << endl;
       }
       else{
         // Single frame has zero extent
@@ -259,9 +271,9 @@ namespace dcmqi {
         // if specified in the file
         sliceSpacing = 1.0;
       }
-      cout << "Origin: " << imageOrigin << endl;
-      cout << "Slice extent: " << sliceExtent << endl;
-      cout << "Slice spacing: " << sliceSpacing << endl;
+      ConversionContext::out() << "Origin: " << imageOrigin << endl;
+      ConversionContext::out() << "Slice extent: " << sliceExtent << endl;
+      ConversionContext::out() << "Slice spacing: " << sliceSpacing << endl;
 
 
       return 0;
@@ -273,7 +285,7 @@ namespace dcmqi {
       FGPixelMeasures *pixelMeasures = OFstatic_cast(FGPixelMeasures*,
                                                      fgInterface.get(0, DcmFGTypes::EFG_PIXELMEASURES, isPerFrame));
       if(!pixelMeasures){
-        cerr << "Pixel measures FG is missing!" << endl;
+        ConversionContext::err() << "Pixel measures FG is missing!" << endl;
         return EXIT_FAILURE;
       }
 
@@ -291,7 +303,7 @@ namespace dcmqi {
       } else if(pixelMeasures->getSliceThickness(spacingFloat,0).good() && fabs(spacingFloat) > epsilon){
         // SliceThickness can be carried forward from the source images, and may not be what we need
         // As an example, this ePAD example has 1.25 carried from CT, but true computed thickness is 1!
-        cerr << "WARNING: SliceThickness is present and is " << spacingFloat << ". using it!" << endl;
+        ConversionContext::err() << "WARNING: SliceThickness is present and is " << spacingFloat << ". using it!" << endl;
         spacing[2] = spacingFloat;
       }
       return 0;
@@ -323,13 +335,13 @@ namespace dcmqi {
         }
         OFString sopInstanceUID;
         CHECK_COND(dcmDatasets[i]->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID));
-        cout << "SOPInstanceUID" << sopInstanceUID << " mapped" << endl;
+        ConversionContext::out() << "SOPInstanceUID" << sopInstanceUID << " mapped" << endl;
         slice2derimg[ippIndex[2]].push_back(i);
         if(slice2derimgPresent[ippIndex[2]] == false)
           slicesMapped++;
         slice2derimgPresent[ippIndex[2]] = true;
       }
-      cout << slicesMapped << " of " << slice2derimgPresent.size() << " slices mapped to source DICOM images" << endl;
+      ConversionContext::out() << slicesMapped << " of " << slice2derimgPresent.size() << " slices mapped to source DICOM images" << endl;
       return slice2derimg;
     }
 
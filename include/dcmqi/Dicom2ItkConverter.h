@@ -40,6 +40,8 @@ namespace dcmqi
  *   Note that if conversion fails, this can return a null pointer.
  * - Call next() to get the next ITK image result of the conversion, until
  *   it returns a null pointer.
+ * For Label Map Segmentations, the frames are copied from the pixel data of the
+ * dataset when the results are retrieved, so the dataset must not be deleted before.
  */
 class Dicom2ItkConverter : public ConverterBase
 {
@@ -67,11 +69,34 @@ public:
      */
     itk::SmartPointer<ShortImageType> next();
 
+    /** Get all results of the conversion as layers of one volume, with the layer index varying
+     *  fastest, i.e. voxel (layer, column, row, slice) is stored at
+     *  layer + layers * (column + columns * (row + rows * slice)). This is the layout of 3D Slicer
+     *  segmentation files. Each layer holds one segment group, and the voxels hold the label
+     *  values listed in the metadata. Binary frames are unpacked directly into the volume,
+     *  without creating an ITK image per group. Use instead of begin() and next(); not supported
+     *  for FRACTIONAL segmentations.
+     *  @param  voxels The resulting voxels
+     *  @param  numberOfLayers The resulting number of layers, i.e. segment groups
+     *  @param  geometry Resulting image (without pixel buffer) describing the geometry of a layer
+     *  @return EC_Normal if successful, error otherwise
+     */
+    OFCondition getLayers(std::vector<Uint16>& voxels, size_t& numberOfLayers, ShortImageType::Pointer& geometry);
+
     /** Get JSON the metadata of the conversion
      *  @return Metadata of the conversion
      */
     JSONSegmentationMetaInformationHandler getMetaInformation();
 
+    /** Set lookup table used to map segment numbers of Label Map Segmentations
+     *  to the label values in the resulting ITK image. The table is indexed by
+     *  segment number; segment numbers not covered by the table are kept as is.
+     *  Must be called before dcmSegmentation2itkimage(). Has no effect for
+     *  BINARY and FRACTIONAL segmentations.
+     *  @param  lut The lookup table
+     */
+    void setLabelmapLookupTable(const OFVector<Uint16>& lut);
+
 protected:
     /** Internal result loop, produced one result at a time (or null)
      *  @return Shared pointer to first/next ITK image resulting from the conversion
@@ -88,6 +113,32 @@ protected:
 
     OFCondition dcmSegmentation2itkimage(const bool mergeSegments = false);
 
+    /** Result loop for Label Map Segmentations, where each frame already holds
+     *  the segment numbers of a full slice and can be copied into the ITK image as is.
+     *  @return Shared pointer to the ITK image resulting from the conversion
+     */
+    itk::SmartPointer<ShortImageType> nextLabelmapResult();
+
+    /**
+     * Create a copy of a Label Map Segmentation dataset that can be loaded as
+     * FRACTIONAL segmentation by DcmSegmentation, which does not know about
+     * label maps. The copy has all attributes except the pixel data, which is
+     * replaced by single pixel placeholder frames; the frames are later copied
+     * from the pixel data of segDataset, see m_labelmapPixelData8/16.
+     *
+     * @param segDataset The Label Map Segmentation dataset.
+     * @param loadableDataset The resulting dataset.
+     * @return EC_Normal if successful, error otherwise
+     */
+    OFCondition prepareLabelmapDataset(DcmDataset& segDataset, DcmDataset& loadableDataset);
+
+    /**
+     *  Get the label value used in the ITK image for the given segment number.
+     *  @param  segmentNumber The DICOM segment number.
+     *  @return The label value
+     */
+    Uint16 getLabelForSegment(const Uint16 segmentNumber) const;
+
     /**
      * @brief Populates the metadata of a DICOM Segmentation object from a DICOM dataset.
      *
@@ -181,6 +232,22 @@ protected:
     /// OverlapUtil instance used by this class, used in DICOM segmentation
     /// to itk conversion
     OverlapUtil m_overlapUtil;
+
+    /// Whether the segmentation object is a Label Map Segmentation
+    bool m_isLabelmap;
+
+    /// Pixel data of 8-bit Label Map Segmentations, owned by the dataset (NULL for 16-bit)
+    const Uint8* m_labelmapPixelData8;
+
+    /// Pixel data of 16-bit Label Map Segmentations, owned by the dataset (NULL for 8-bit)
+    const Uint16* m_labelmapPixelData16;
+
+    /// Rows and columns of Label Map Segmentation frames; DcmSegmentation only knows the placeholders
+    Uint16 m_labelmapRows;
+    Uint16 m_labelmapColumns;
+
+    /// Lookup table mapping segment numbers to ITK label values (Label Map only)
+    OFVector<Uint16> m_labelmapLUT;
 };
 
 }
@@ -6,10 +6,13 @@
 #include <stdexcept>
 #include <vector>
 
+// DCMQI includes
+#include "dcmqi/ConversionContext.h"
+
 #define CHECK_COND(condition) \
   do { \
     if (condition.bad()) { \
-      std::cerr << "Condition failed: " << condition.text() << " in " __FILE__ << ":" << __LINE__ << std::endl; \
+      dcmqi::ConversionContext::err() << "Condition failed: " << condition.text() << " in " __FILE__ << ":" << __LINE__ << std::endl; \
       throw -1; \
     } \
 } while (0);
@@ -35,7 +35,7 @@ namespace dcmqi {
     template<typename T>
     static bool isUndefined(const T &var, const string &humanReadableName) {
       if (var.empty()) {
-        cerr << "Error: " << humanReadableName << " must be specified!" << endl;
+        ConversionContext::err() << "Error: " << humanReadableName << " must be specified!" << endl;
         return true;
       }
       return false;
@@ -46,6 +46,14 @@ namespace dcmqi {
     static string getFileExtensionFromType(const string& type);
     static vector<string> getFileListRecursively(string directory);
     static vector<DcmDataset*> loadDatasets(const vector<string>& dicomImageFiles);
+    // Parse a DICOM file held in memory (with or without preamble); returns NULL on failure
+    static DcmDataset* loadDatasetFromBuffer(const void* data, size_t size);
+    // Encode a dataset as DICOM file (Little Endian Explicit) in memory
+    static OFCondition saveDatasetToBuffer(DcmDataset* dataset, vector<char>& bytes);
+    // Read all of stdin in binary mode, e.g. a DICOM file piped to the converter
+    static bool readStandardInput(vector<char>& bytes);
+    // Switch stdout to binary mode, so that converted data written to it is not altered
+    static void setBinaryStandardOutput();
 
     static string floatToStr(float f);
     static void tokenizeString(string str, vector<string> &tokens, string delimiter);
@@ -4,6 +4,7 @@
 // DCMTK includes
 #include <dcmtk/dcmfg/fgderimg.h>
 #include <dcmtk/dcmfg/fgseg.h>
+#include <dcmtk/dcmdata/dcpixel.h>
 #include <dcmtk/dcmseg/segdoc.h>
 #include <dcmtk/dcmseg/segment.h>
 #include <dcmtk/dcmseg/segutils.h>
@@ -19,6 +20,7 @@
 
 // DCMQI includes
 #include "dcmqi/ConverterBase.h"
+#include "dcmqi/JSONSegmentationMetaInformationHandler.h"
 
 
 using namespace std;
@@ -36,6 +38,57 @@ namespace dcmqi {
 
     Itk2DicomConverter();
 
+    /**
+     * @brief Label volume in caller memory, which is read in place without copying.
+     *
+     * Geometry follows the ITK conventions: origin is the position of the first voxel, and
+     * column i of the direction matrix is the direction of image axis i.
+     */
+    struct LabelBuffer {
+      /// Supported voxel types
+      enum DataType { UINT8, UINT16, INT16, UINT32 };
+
+      LabelBuffer();
+
+      /// Describes the buffer of an image
+      static LabelBuffer fromImage(const ShortImageType::Pointer &image);
+
+      /// Pointer to the first voxel
+      const void* data;
+      /// Type of the voxels
+      DataType dataType;
+      /// Number of columns, rows and slices
+      size_t size[3];
+      /// Distance in bytes between neighboring columns, rows and slices
+      ptrdiff_t strides[3];
+      /// Voxel spacing (mm)
+      double spacing[3];
+      /// Position of the first voxel (mm)
+      double origin[3];
+      /// Direction matrix, row by row
+      double direction[9];
+    };
+
+    /**
+     * @brief Provides the label volumes of a conversion one at a time, so that they do not all
+     *        have to be held in memory.
+     */
+    class LabelSource {
+    public:
+      virtual ~LabelSource() {}
+
+      /// Number of label volumes provided
+      virtual size_t getNumberOfVolumes() const = 0;
+
+      /**
+       * @brief Provides the next label volume. Its buffer only needs to remain valid until the
+       *        next call, so the source may release a volume once the following one is requested.
+       *
+       * @return false if the volume could not be provided, after reporting the error
+       */
+      virtual bool next(LabelBuffer &buffer) = 0;
+    };
+
     /**
      * @brief Converts itk images data into a DICOM Segmentation object.
      *
@@ -43,12 +96,265 @@ namespace dcmqi {
      * @param segmentations A vector of itk images to be converted.
      * @param metaData A string containing the metadata to be used for the DICOM Segmentation object.
      * @param skipEmptySlices A boolean indicating whether to skip empty slices during the conversion.
+     * @param positionMajor A boolean indicating whether frames should be ordered by slice position
+     *        first and by segment second, so that all segments of a slice are stored next to each other.
+     *        The dimension organization lists Image Position Patient before Referenced Segment Number then.
      * @return A pointer to the resulting DICOM Segmentation object.
      */
     static DcmDataset* itkimage2dcmSegmentation(vector<DcmDataset*> dcmDatasets,
+                          vector<ShortImageType::Pointer> segmentations,
+                          const string &metaData,
+                          bool skipEmptySlices=true,
+                          bool positionMajor=false);
+
+    /**
+     * @brief Converts label volumes held in memory into a DICOM Segmentation object.
+     *
+     * Same as the overload taking itk images, but the labels are read directly from the
+     * given buffers, which may use any of the supported label types and memory layouts.
+     * Label values up to 2^32-1 can be used, as long as they are listed in the metadata.
+     *
+     * @param dcmDatasets A vector of DICOM datasets with the images that the segmentation is based on.
+     * @param labelBuffers A vector of label volumes to be converted.
+     * @param metaData A string containing the metadata to be used for the DICOM Segmentation object.
+     * @param skipEmptySlices A boolean indicating whether to skip empty slices during the conversion.
+     * @param positionMajor A boolean indicating whether frames should be ordered by slice position first.
+     * @return A pointer to the resulting DICOM Segmentation object, or NULL if the conversion failed.
+     */
+    static DcmDataset* itkimage2dcmSegmentation(vector<DcmDataset*> dcmDatasets,
+                          const vector<LabelBuffer> &labelBuffers,
+                          const string &metaData,
+                          bool skipEmptySlices=true,
+                          bool positionMajor=false);
+
+    /**
+     * @brief Converts label volumes requested one at a time into a DICOM Segmentation object.
+     *
+     * Same as the overload taking label buffers, with frames ordered by segment. Each volume is
+     * encoded completely before the next one is requested, so only one volume needs to be
+     * held in memory by the source.
+     *
+     * @param dcmDatasets A vector of DICOM datasets with the images that the segmentation is based on.
+     * @param labelSource Source of the label volumes to be converted.
+     * @param metaData A string containing the metadata to be used for the DICOM Segmentation object.
+     * @param skipEmptySlices A boolean indicating whether to skip empty slices during the conversion.
+     * @return A pointer to the resulting DICOM Segmentation object, or NULL if the conversion failed.
+     */
+    static DcmDataset* itkimage2dcmSegmentation(vector<DcmDataset*> dcmDatasets,
+                          LabelSource &labelSource,
+                          const string &metaData,
+                          bool skipEmptySlices=true);
+
+    /**
+     * @brief Converts itk images data into a DICOM Label Map Segmentation object.
+     *
+     * Each slice is encoded as a single 8-bit (up to 255 segments) or 16-bit frame,
+     * where the pixel values are the DICOM segment numbers. This is only possible
+     * if the labels of the input images do not overlap.
+     *
+     * @param dcmDatasets A vector of DICOM datasets with the images that the segmentation is based on.
+     * @param segmentations A vector of itk images to be converted.
+     * @param metaData A string containing the metadata to be used for the DICOM Segmentation object.
+     * @param skipEmptySlices A boolean indicating whether to skip slices without any label.
+     * @return A pointer to the resulting DICOM Segmentation object, or NULL if the conversion failed
+     *         (e.g. because the input labels overlap).
+     */
+    static DcmDataset* itkimage2dcmLabelmapSegmentation(vector<DcmDataset*> dcmDatasets,
                           vector<ShortImageType::Pointer> segmentations,
                           const string &metaData,
                           bool skipEmptySlices=true);
+
+    /**
+     * @brief Converts probability maps into a FRACTIONAL (PROBABILITY) DICOM Segmentation object.
+     *
+     * Each input image holds the probabilities (0..1) of a single segment, described by the
+     * only entry of the corresponding item of the segment attributes in the metadata. The
+     * probabilities are quantized to 0..maxFractionalValue and written as one 8-bit frame per
+     * slice and segment. All input images must share the same geometry.
+     *
+     * @param dcmDatasets A vector of DICOM datasets with the images that the segmentation is based on.
+     * @param probabilityMaps A vector of itk images with the probabilities of each segment.
+     * @param metaData A string containing the metadata to be used for the DICOM Segmentation object.
+     * @param maxFractionalValue Value (1..255) representing a probability of 1.
+     * @param skipEmptySlices A boolean indicating whether to skip frames where all probabilities quantize to 0.
+     * @return A pointer to the resulting DICOM Segmentation object, or NULL if the conversion failed.
+     */
+    static DcmDataset* itkimage2dcmFractionalSegmentation(vector<DcmDataset*> dcmDatasets,
+                          vector<FloatImageType::Pointer> probabilityMaps,
+                          const string &metaData,
+                          Uint16 maxFractionalValue=255,
+                          bool skipEmptySlices=true);
+
+    /**
+     * @brief Quantizes probabilities to fractional values, i.e. round(p*maxFractionalValue)
+     *        with p clamped to 0..1 and NaN mapped to 0. Uses SSE2 where available.
+     *
+     * @param probabilities The probabilities.
+     * @param count Number of probabilities.
+     * @param maxFractionalValue Value (1..255) representing a probability of 1.
+     * @param fractions The resulting fractional values, count bytes.
+     * @return true if any of the resulting values is non-zero
+     */
+    static bool quantizeProbabilities(const FloatPixelType* probabilities, size_t count,
+                                      Uint16 maxFractionalValue, Uint8* fractions);
+
+    /**
+     * @brief Converts a 2D label image (e.g. a whole slide image segmentation) into a tiled
+     *        DICOM Label Map Segmentation object.
+     *
+     * The label image is read from file in strips of tile height, so that the complete
+     * image does not have to be held in memory. This requires an ITK image IO that can stream,
+     * e.g. for uncompressed MetaImage (.mha/.mhd); other formats, including NRRD and compressed
+     * files, are read completely (once), with a warning. Labels are read as unsigned 16-bit values.
+     * Each tile is compressed with RLE Lossless as soon as it is complete, so the result holds
+     * encapsulated pixel data and must be written with the RLE Lossless transfer syntax.
+     * If all tiles are encoded, the result uses the TILED_FULL dimension organization;
+     * if empty tiles are skipped, TILED_SPARSE with per-frame slide positions is used instead.
+     *
+     * @param sourceDataset DICOM dataset of the image that was segmented.
+     * @param segImageFileName File name of the 2D label image.
+     * @param metaData A string containing the metadata to be used for the DICOM Segmentation object.
+     * @param tileSize Number of rows and columns of each tile.
+     * @param skipEmptyTiles A boolean indicating whether to skip tiles without any label.
+     * @return A pointer to the resulting DICOM Segmentation object, or NULL if the conversion failed.
+     */
+    static DcmDataset* itkimage2dcmTiledSegmentation(DcmDataset* sourceDataset,
+                          const string &segImageFileName,
+                          const string &metaData,
+                          unsigned tileSize=256,
+                          bool skipEmptyTiles=true);
+
+  protected:
+
+    /**
+     * @brief Encodes the label volumes of a source as BINARY segmentation. With positionMajor
+     *        frame order, the buffers of all volumes must remain valid until the end.
+     */
+    static DcmDataset* encodeSegmentation(vector<DcmDataset*> &dcmDatasets,
+                          LabelSource &labelSource,
+                          const string &metaData,
+                          bool skipEmptySlices,
+                          bool positionMajor);
+
+    /// Labels of a label volume with the first and last (exclusive) slice they occur in
+    typedef map<Uint32, pair<unsigned, unsigned> > LabelExtents;
+
+    /**
+     * @brief Finds the non-zero labels of a label volume and the slices they occur in.
+     *
+     * @return false if the volume contains negative values
+     */
+    static bool getLabelExtents(const LabelBuffer &buffer, LabelExtents &extents);
+
+    template<typename T>
+    static bool getLabelExtents(const LabelBuffer &buffer, LabelExtents &extents);
+
+    /**
+     * @brief Sets the pixels of a frame to 1 where the slice of a label volume has the given
+     *        label, and to 0 elsewhere.
+     */
+    static void getLabelFrame(const LabelBuffer &buffer, unsigned sliceNumber, Uint32 label, Uint8* frameData);
+
+    template<typename T>
+    static void getLabelFrame(const LabelBuffer &buffer, unsigned sliceNumber, Uint32 label, Uint8* frameData);
+
+    /**
+     * @brief Creates an image without pixel buffer that has the geometry of a label volume,
+     *        for use with the geometry helpers.
+     */
+    static ShortImageType::Pointer getGeometryImage(const LabelBuffer &buffer);
+
+    /**
+     * @brief Creates a DICOM segment from the attributes read from the JSON metadata.
+     *
+     * @param segmentAttributes Attributes of the segment.
+     * @return Newly created segment, or NULL if the attributes are incomplete.
+     */
+    static DcmSegment* createSegment(SegmentAttributes* segmentAttributes);
+
+    /**
+     * @brief Adds Plane Orientation and Pixel Measures as shared functional groups.
+     *
+     * @param segdoc The segmentation document.
+     * @param referenceImage Image defining the orientation and spacing.
+     */
+    static void addSharedFunctionalGroups(DcmSegmentation* segdoc, const ShortImageType::Pointer &referenceImage);
+
+    /**
+     * @brief Initializes the plane position functional group for the given slice.
+     *
+     * @param fgppp Plane Position (Patient) functional group to be updated.
+     * @param image Image defining the geometry.
+     * @param sliceNumber Slice (0-based) of the image.
+     */
+    static void setPlanePosition(FGPlanePosPatient* fgppp, const ShortImageType::Pointer &image, unsigned sliceNumber);
+
+    /**
+     * @brief Adds the derivation image item for the source images of a frame and
+     *        collects the referenced instances for the Common Instance Reference module.
+     *
+     * @param fgder Derivation Image functional group to be populated.
+     * @param siVector Source image datasets of the frame.
+     * @param refinstances Referenced instances to be extended.
+     * @param instanceUIDs SOP Instance UIDs already referenced.
+     */
+    static void addDerivationImageReferences(FGDerivationImage* fgder, OFVector<DcmDataset*> &siVector,
+                                             OFVector<SOPInstanceReferenceMacro*> &refinstances,
+                                             set<OFString> &instanceUIDs);
+
+    /**
+     * @brief Writes the segmentation document and patches in the extra meta information.
+     *
+     * @param segdoc The segmentation document.
+     * @param metaInfo Parsed JSON metadata.
+     * @param dcmDatasets Source image datasets.
+     * @param segmentsOverlap Value of SegmentsOverlap.
+     * @return The resulting dataset, or NULL if writing failed.
+     */
+    static DcmDataset* writeSegmentationDataset(DcmSegmentation* segdoc,
+                                                JSONSegmentationMetaInformationHandler &metaInfo,
+                                                vector<DcmDataset*> &dcmDatasets,
+                                                const string &segmentsOverlap);
+
+    /**
+     * @brief Turns the dataset written as FRACTIONAL segmentation into a Label Map Segmentation.
+     *
+     * @param dataset Dataset to be modified.
+     * @param pixelData Label map frames replacing the single pixel placeholder frames written by
+     *        DCMTK; the dataset takes ownership, also if the conversion fails.
+     * @param rows Rows of the label map frames.
+     * @param columns Columns of the label map frames.
+     * @param use16Bit Whether the frames have 16 instead of 8 bits per pixel.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition convertToLabelmapDataset(DcmDataset &dataset, DcmPixelData* pixelData,
+                                                Uint16 rows, Uint16 columns, bool use16Bit);
+
+    /**
+     * @brief Compresses a frame with RLE Lossless and appends it as fragment to a pixel sequence.
+     *
+     * @param pixelSequence Encapsulated pixel data, starting with the basic offset table item.
+     * @param frame Pixel values of the frame, row by row; only the low byte is used for 8 bits.
+     * @param rows Number of rows of the frame.
+     * @param columns Number of columns of the frame.
+     * @param use16Bit Whether the frame has 16 instead of 8 bits per pixel.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition addRLEFrame(DcmPixelSequence &pixelSequence, const Uint16* frame,
+                                   Uint16 rows, Uint16 columns, bool use16Bit);
+
+    /**
+     * @brief Adds the Total Pixel Matrix and slide position attributes of a tiled segmentation.
+     *
+     * @param dataset Dataset to be modified.
+     * @param image Image defining the geometry (only the image information is used).
+     * @param tilePositions 1-based column and row position of the top left pixel of each frame.
+     * @param tiledFull Whether all tiles are present, i.e. TILED_FULL can be used.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition addTiledImageAttributes(DcmDataset &dataset, const UShortImage2DType::Pointer &image,
+                                               const OFVector<std::pair<Uint32, Uint32> > &tilePositions,
+                                               bool tiledFull);
   };
 
 }
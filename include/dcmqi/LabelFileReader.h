@@ -0,0 +1,65 @@
+#ifndef DCMQI_LABELFILEREADER_H
+#define DCMQI_LABELFILEREADER_H
+
+// STD includes
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+// DCMQI includes
+#include "dcmqi/Itk2DicomConverter.h"
+
+namespace dcmqi {
+
+  /**
+   * @brief The LabelFileReader class reads the label images of a conversion in the background
+   * while the converter encodes them one at a time.
+   *
+   * Up to readAhead files are read concurrently with the encoding of the current one, and an
+   * image is released as soon as the converter requests the next one, so at most readAhead+1
+   * images are held in memory at any time, independent of the number of files.
+   */
+  class LabelFileReader : public Itk2DicomConverter::LabelSource {
+
+  public:
+
+    /**
+     * @param fileNames Label image files, in the order of the segment attributes.
+     * @param readAhead Number of files read while the current one is encoded, at least 1.
+     */
+    LabelFileReader(const std::vector<std::string> &fileNames, unsigned readAhead);
+
+    /// Waits for reads still running
+    virtual ~LabelFileReader();
+
+    virtual size_t getNumberOfVolumes() const;
+
+    virtual bool next(Itk2DicomConverter::LabelBuffer &buffer);
+
+  protected:
+
+    /// Image read by a background thread, or the reason it could not be read
+    struct ReadResult {
+      ShortImageType::Pointer image;
+      std::string error;
+    };
+
+    static ReadResult read(const std::string &fileName);
+
+  private:
+
+    LabelFileReader(const LabelFileReader&);
+    LabelFileReader& operator=(const LabelFileReader&);
+
+    std::vector<std::string> m_fileNames;
+    unsigned m_readAhead;
+    size_t m_nextRead;
+    size_t m_nextVolume;
+    std::deque<std::future<ReadResult> > m_pendingReads;
+    ShortImageType::Pointer m_current;
+  };
+
+}
+
+#endif //DCMQI_LABELFILEREADER_H
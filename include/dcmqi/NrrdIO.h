@@ -0,0 +1,103 @@
+#ifndef DCMQI_NRRDIO_H
+#define DCMQI_NRRDIO_H
+
+// STD includes
+#include <string>
+#include <vector>
+
+// JSON includes
+#include <json/json.h>
+
+// DCMQI includes
+#include "dcmqi/ConverterBase.h"
+#include "dcmqi/TarWriter.h"
+
+namespace dcmqi {
+
+  /**
+   * @brief The NrrdIO class writes images as NRRD files without going through an ITK image
+   * writer, which can only write to named files.
+   *
+   * The files use the LPS space of ITK, so that ITK and 3D Slicer read them with the same
+   * geometry as the files written by itk::NrrdImageIO. Images use raw encoding; segmentations
+   * are compressed.
+   */
+  class NrrdIO {
+
+  public:
+
+    /**
+     * @brief Writes a label image.
+     *
+     * @param image Image to write.
+     * @param fileName Name of the file, or of the file in the archive.
+     * @param archive If not NULL, the file is added to this archive instead of the file system.
+     * @return true if successful
+     */
+    static bool writeImage(const ShortImageType::Pointer &image, const std::string &fileName,
+                           TarWriter* archive=NULL);
+
+    /**
+     * @brief Writes a float image.
+     */
+    static bool writeImage(const FloatImageType::Pointer &image, const std::string &fileName,
+                           TarWriter* archive=NULL);
+
+    /**
+     * @brief Writes a segmentation in the format of 3D Slicer (.seg.nrrd): the layers of the
+     * segmentation are stored as first axis of a 4D image, or as 3D image if there is a single
+     * layer, and the segments are described by key/value pairs. The voxels are compressed as one
+     * gzip stream, in unsigned char if all label values fit.
+     *
+     * @param geometry Image providing size and geometry of a layer; its buffer is not used.
+     * @param voxels Label values, layer index varying fastest, see
+     *        Dicom2ItkConverter::getLayers().
+     * @param numberOfLayers Number of layers.
+     * @param segmentAttributes Attributes of the segments by layer, as in the segimage2itkimage
+     *        metadata.
+     * @param fileName Name of the file, or of the file in the archive.
+     * @param archive If not NULL, the file is added to this archive instead of the file system.
+     * @return true if successful
+     */
+    static bool writeSegmentation(const itk::ImageBase<3>* geometry, const std::vector<Uint16> &voxels,
+                                  size_t numberOfLayers, const Json::Value &segmentAttributes,
+                                  const std::string &fileName, TarWriter* archive=NULL);
+
+  protected:
+
+    /**
+     * @brief Creates the header of an image, including the empty line ending it.
+     *
+     * @param image Image providing size and geometry.
+     * @param type NRRD type name of the voxels, e.g. "short".
+     * @param numberOfLayers If larger than 1, the image has a leading list axis of this size.
+     * @param encoding NRRD encoding of the voxels.
+     * @param keyValuePairs Lines of key/value pairs added at the end of the header.
+     */
+    static std::string getHeader(const itk::ImageBase<3>* image, const std::string &type,
+                                 size_t numberOfLayers=1, const std::string &encoding="raw",
+                                 const std::string &keyValuePairs="");
+
+    /**
+     * @brief Creates the key/value pairs describing the segments of a segmentation.
+     */
+    static std::string getSegmentFields(const itk::ImageBase<3>* geometry, const std::vector<Uint16> &voxels,
+                                        size_t numberOfLayers, const Json::Value &segmentAttributes);
+
+    /**
+     * @brief Compresses label values as gzip stream, in one or two bytes per value.
+     *
+     * @return false if compression failed
+     */
+    static bool compress(const std::vector<Uint16> &voxels, bool singleByte, std::string &compressed);
+
+    /**
+     * @brief Writes the header followed by the voxels to a file or archive.
+     */
+    static bool write(const std::string &fileName, TarWriter* archive, const std::string &header,
+                      const void* voxels, size_t length);
+  };
+
+}
+
+#endif //DCMQI_NRRDIO_H
@@ -0,0 +1,231 @@
+#ifndef DCMQI_NUMPYIO_H
+#define DCMQI_NUMPYIO_H
+
+// STD includes
+#include <string>
+#include <vector>
+
+// ITK includes
+#include <itkImportImageFilter.h>
+
+// JSON includes
+#include <json/json.h>
+
+// DCMQI includes
+#include "dcmqi/ConverterBase.h"
+#include "dcmqi/Itk2DicomConverter.h"
+#include "dcmqi/TarWriter.h"
+
+namespace dcmqi {
+
+  /**
+   * @brief The NumpyIO class writes images as NumPy .npy arrays and maps such arrays, or raw
+   * voxel files, into memory for conversion.
+   *
+   * The arrays are uncompressed and in C order, i.e. with shape (slices, rows, columns) and
+   * columns varying fastest, which is the memory layout of ITK images. The header is padded so
+   * that the voxels start at a multiple of 64 bytes, and the arrays can be memory-mapped as is
+   * (e.g. with numpy.load(fileName, mmap_mode='r')). Since .npy has no notion of geometry, it is
+   * stored in a separate JSON file along with the data offset of each array.
+   */
+  class NumpyIO {
+
+  public:
+
+    /**
+     * @brief Read-only memory mapping of a 3D array file along with its geometry.
+     *
+     * Images and label buffers created from the mapping refer to the mapped voxels, so the
+     * mapping must outlive them.
+     */
+    class MappedArray {
+
+    public:
+
+      MappedArray();
+      ~MappedArray();
+
+      /// Pointer to the first voxel
+      const void* getData() const { return m_base + dataOffset; }
+
+      /// NumPy type string without byte order character, e.g. "i2"
+      std::string dtype;
+      /// Number of slices, rows and columns
+      std::vector<size_t> shape;
+      /// Offset of the first voxel in the file
+      size_t dataOffset;
+      /// Voxel spacing (mm), in image axis order
+      double spacing[3];
+      /// Position of the first voxel (mm)
+      double origin[3];
+      /// Direction matrix, row by row
+      double direction[9];
+
+    protected:
+
+      friend class NumpyIO;
+
+      bool map(const std::string &fileName);
+      void unmap();
+
+    private:
+
+      MappedArray(const MappedArray&);
+      MappedArray& operator=(const MappedArray&);
+
+      const char* m_base;
+      size_t m_length;
+#ifdef _WIN32
+      void* m_file;
+      void* m_mapping;
+#endif
+    };
+
+    /**
+     * @brief Checks whether a file name refers to an array file, i.e. has the extension .npy
+     * or .raw, rather than an image format readable by ITK.
+     */
+    static bool isArrayFile(const std::string &fileName);
+
+    /**
+     * @brief Maps a .npy or raw voxel file into memory.
+     *
+     * The geometry is read from a JSON file as written by writeGeometry(). Its "spacing" and
+     * "origin" are required, "direction" defaults to the identity. Raw files additionally need
+     * "dtype", "shape" and optionally "dataOffset", either at the top level or in the item of
+     * "arrays" whose "fileName" matches the name of the array file. The voxels must be stored
+     * in C order and in the byte order of this machine.
+     *
+     * @param fileName Name of the .npy or raw file.
+     * @param geometryFileName Name of the geometry JSON file; if empty, the array file name with
+     *        the extension replaced by .json is used.
+     * @param array Receives the mapping.
+     * @return true if successful
+     */
+    static bool mapArray(const std::string &fileName, const std::string &geometryFileName, MappedArray &array);
+
+    /**
+     * @brief Wraps a mapped array into an image without copying the voxels. The pixel type of
+     * the image must match the dtype of the array.
+     */
+    template<typename TImage>
+    static typename TImage::Pointer importImage(const MappedArray &array) {
+      typedef itk::ImportImageFilter<typename TImage::PixelType, 3> ImportFilterType;
+      typename ImportFilterType::Pointer importFilter = ImportFilterType::New();
+
+      typename ImportFilterType::SizeType size;
+      typename ImportFilterType::IndexType start;
+      typename ImportFilterType::OriginType origin;
+      typename ImportFilterType::SpacingType spacing;
+      typename ImportFilterType::DirectionType direction;
+      for(int i=0;i<3;i++){
+        size[i] = array.shape[2-i];
+        start[i] = 0;
+        origin[i] = array.origin[i];
+        spacing[i] = array.spacing[i];
+        for(int j=0;j<3;j++)
+          direction[i][j] = array.direction[3*i+j];
+      }
+      typename ImportFilterType::RegionType region;
+      region.SetIndex(start);
+      region.SetSize(size);
+      importFilter->SetRegion(region);
+      importFilter->SetOrigin(origin);
+      importFilter->SetSpacing(spacing);
+      importFilter->SetDirection(direction);
+
+      // the converters only read their input, so the read-only mapping can be used directly
+      const size_t numberOfPixels = size_t(size[0]) * size[1] * size[2];
+      importFilter->SetImportPointer(static_cast<typename TImage::PixelType*>(const_cast<void*>(array.getData())),
+                                     numberOfPixels, false);
+      importFilter->Update();
+      return importFilter->GetOutput();
+    }
+
+    /**
+     * @brief Describes a mapped integer array as label buffer, without copying the voxels.
+     *
+     * @return false if the dtype is not supported as label type
+     */
+    static bool getLabelBuffer(const MappedArray &array, Itk2DicomConverter::LabelBuffer &labelBuffer);
+
+    /**
+     * @brief Writes label images as one array. A single image results in a 3D array, several
+     * images in a 4D array with the image index as first (channel) axis.
+     *
+     * @param images Images to write, all with the same size.
+     * @param fileName Name of the .npy file, or of the file in the archive.
+     * @param arrayInfo If not NULL, receives shape, dtype and data offset of the array.
+     * @param archive If not NULL, the file is added to this archive instead of the file system.
+     * @return true if successful
+     */
+    static bool writeArray(const std::vector<ShortImageType::Pointer> &images, const std::string &fileName,
+                           Json::Value* arrayInfo=NULL, TarWriter* archive=NULL);
+
+    /**
+     * @brief Writes a float image as 3D array.
+     */
+    static bool writeArray(const FloatImageType::Pointer &image, const std::string &fileName,
+                           Json::Value* arrayInfo=NULL, TarWriter* archive=NULL);
+
+    /**
+     * @brief Creates the JSON description of the geometry of an image: size, spacing and
+     * origin in image axis order (columns, rows, slices), the direction cosines row by row,
+     * and the matrix mapping (column, row, slice) indices to LPS coordinates.
+     */
+    static Json::Value getGeometry(const itk::ImageBase<3>* image);
+
+    /**
+     * @brief Writes a geometry JSON file as created by getGeometry(), together with the
+     * description of the arrays sharing this geometry.
+     *
+     * @param geometry Result of getGeometry().
+     * @param arrays Array descriptions returned by writeArray(), with their file names.
+     * @param fileName Name of the JSON file, or of the file in the archive.
+     * @param archive If not NULL, the file is added to this archive instead of the file system.
+     * @return true if successful
+     */
+    static bool writeGeometry(const Json::Value &geometry, const Json::Value &arrays, const std::string &fileName,
+                              TarWriter* archive=NULL);
+
+  protected:
+
+    /**
+     * @brief Creates the header of a .npy file (format version 1.0), padded to 64 bytes.
+     *
+     * @param dtype NumPy type string without byte order character, e.g. "i2".
+     * @param shape Extent of each axis, slowest varying first.
+     */
+    static std::string getHeader(const std::string &dtype, const std::vector<size_t> &shape);
+
+    /**
+     * @brief Writes header and voxel buffers of an array to a file or archive.
+     */
+    static bool write(const std::string &fileName, const std::string &dtype, const std::vector<size_t> &shape,
+                      const std::vector<std::pair<const char*, size_t> > &buffers, Json::Value* arrayInfo,
+                      TarWriter* archive);
+
+    /**
+     * @brief Prefixes the type string with the byte order of this machine.
+     */
+    static std::string getTypeString(const std::string &dtype);
+
+    /**
+     * @brief Gets the size in bytes of the supported array types, or 0 for other types.
+     */
+    static size_t getItemSize(const std::string &dtype);
+
+    /**
+     * @brief Parses the header of a mapped .npy file into dtype, shape and data offset.
+     */
+    static bool parseHeader(const char* data, size_t length, MappedArray &array);
+
+    /**
+     * @brief Strips and checks the byte order character of a NumPy type string.
+     */
+    static bool parseTypeString(const std::string &descr, std::string &dtype);
+  };
+
+}
+
+#endif //DCMQI_NUMPYIO_H
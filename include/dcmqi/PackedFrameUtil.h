@@ -0,0 +1,342 @@
+#ifndef DCMQI_PACKEDFRAMEUTIL_H
+#define DCMQI_PACKEDFRAMEUTIL_H
+
+#include "dcmtk/config/osconfig.h"
+#include "dcmtk/dcmdata/dcdatset.h"
+#include "dcmtk/ofstd/ofcond.h"
+#include "dcmtk/ofstd/oftypes.h"
+#include "dcmtk/ofstd/ofvector.h"
+#include <map>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/// error: the operation does not support LABELMAP segmentations
+extern const OFConditionConst SG_EC_LabelmapNotSupported;
+
+namespace dcmqi
+{
+
+/** Class that provides access to the frames of a BINARY or FRACTIONAL segmentation
+ *  dataset on the level of their encoded pixel data, i.e. without loading the dataset
+ *  into a DcmSegmentation object and without unpacking binary frames.
+ *  LABELMAP segmentations can be read if requested in setDataset(); their frames
+ *  are not assigned to a segment, and they cannot be used to build new datasets.
+ *  It provides the following main functionality:
+ *  - Access to the Segment Sequence items and the per-frame functional group items
+ *  - Segment number and position of every frame
+ *  - Extraction of the packed pixel data of a single frame
+ *  - Creation of a new segmentation dataset from segments and frames of one or
+ *    more existing datasets, copying their items and packed frames verbatim
+ *    (apart from the segment numbers).
+ */
+class PackedFrameUtil
+{
+public:
+    /// Image Position Patient tuple (x,y,z)
+    typedef OFVector<Float64> ImagePosition;
+
+    /// Segment of an existing dataset that should go into a new dataset
+    struct SegmentReference
+    {
+        /** Constructor
+         *  @param  src Source dataset of the segment
+         *  @param  num Segment number in the source dataset
+         *  @param  newNum Segment number in the new dataset
+         */
+        SegmentReference(const PackedFrameUtil* src, const Uint16 num, const Uint16 newNum)
+            : m_source(src)
+            , m_segmentNumber(num)
+            , m_newSegmentNumber(newNum)
+        {
+        }
+        /// Source dataset
+        const PackedFrameUtil* m_source;
+        /// Segment number in source dataset
+        Uint16 m_segmentNumber;
+        /// Segment number in new dataset
+        Uint16 m_newSegmentNumber;
+    };
+
+    /// Frame of an existing dataset that should go into a new dataset
+    struct FrameReference
+    {
+        /** Constructor
+         *  @param  src Source dataset of the frame
+         *  @param  num Frame number in the source dataset (first frame is 0)
+         *  @param  newSegNum Segment number the frame refers to in the new dataset
+         */
+        FrameReference(const PackedFrameUtil* src, const Uint32 num, const Uint16 newSegNum)
+            : m_source(src)
+            , m_frameNumber(num)
+            , m_newSegmentNumber(newSegNum)
+        {
+        }
+        /// Source dataset
+        const PackedFrameUtil* m_source;
+        /// Frame number in source dataset
+        Uint32 m_frameNumber;
+        /// Referenced segment number in new dataset
+        Uint16 m_newSegmentNumber;
+    };
+
+    // ------------------------------------------ Methods ------------------------------------------
+
+    /** Constructor. Use setDataset() to set the segmentation dataset to work with.
+     */
+    PackedFrameUtil();
+
+    /** Destructor */
+    ~PackedFrameUtil();
+
+    /** Set the segmentation dataset to work with and read its structure. Encapsulated
+     *  pixel data is decompressed (i.e. the dataset is modified), and the codecs
+     *  required have to be registered by the caller. The dataset must remain valid as
+     *  long as this object is used.
+     *  @param  dataset BINARY or FRACTIONAL segmentation dataset
+     *  @param  headerOnly If OFTrue, Pixel Data is neither required nor accessed (e.g. if
+     *          the dataset was loaded without it), and frame data is not available
+     *  @param  allowLabelmap If OFTrue, LABELMAP segmentations are accepted as well
+     *  @return EC_Normal if successful, SG_EC_LabelmapNotSupported for a LABELMAP
+     *          segmentation that is not allowed, other error otherwise
+     */
+    OFCondition setDataset(DcmDataset* dataset, const OFBool headerOnly = OFFalse, const OFBool allowLabelmap = OFFalse);
+
+    /** Clears all internal data */
+    void clear();
+
+    /** Get dataset
+     *  @return The segmentation dataset, or NULL if not set
+     */
+    DcmDataset* getDataset() const;
+
+    /** Check whether frame data is available, i.e. the dataset was not set header-only */
+    OFBool hasPixelData() const;
+
+    /** Get number of rows of each frame */
+    Uint16 getRows() const;
+
+    /** Get number of columns of each frame */
+    Uint16 getColumns() const;
+
+    /** Get bits allocated per pixel (1 for BINARY, 8 for FRACTIONAL, 8 or 16 for LABELMAP) */
+    Uint16 getBitsAllocated() const;
+
+    /** Check whether the dataset is a LABELMAP segmentation */
+    OFBool isLabelmap() const;
+
+    /** Get number of frames */
+    Uint32 getNumberOfFrames() const;
+
+    /** Get number of bits occupied by each frame in the pixel data */
+    size_t getFrameSizeInBits() const;
+
+    /** Get number of segments (i.e. number of Segment Sequence items) */
+    Uint16 getNumberOfSegments() const;
+
+    /** Get segment numbers found in the Segment Sequence, in ascending order */
+    OFVector<Uint16> getSegmentNumbers() const;
+
+    /** Get Segment Sequence item for the given segment
+     *  @param  segmentNumber The segment number
+     *  @return The item, or NULL if the segment does not exist
+     */
+    DcmItem* getSegmentItem(const Uint16 segmentNumber) const;
+
+    /** Get per-frame functional groups item for the given frame
+     *  @param  frameNo The frame number (first frame is 0)
+     *  @return The item, or NULL if not present
+     */
+    DcmItem* getPerFrameItem(const Uint32 frameNo) const;
+
+    /** Get segment number referenced by the given frame
+     *  @param  frameNo The frame number (first frame is 0)
+     *  @return The segment number, or 0 if not available (always for LABELMAP)
+     */
+    Uint16 getSegmentNumberOfFrame(const Uint32 frameNo) const;
+
+    /** Get frames for a specific segment by its segment number. For LABELMAP
+     *  segmentations, every frame may contain the segment, so all frames are returned.
+     *  @param  segmentNumber Segment number to get frames for (1..n)
+     *  @param  frames Resulting vector of frame numbers (first frame is frame 0)
+     *  @return EC_Normal if successful, error otherwise
+     */
+    OFCondition getFramesForSegment(const Uint16 segmentNumber, OFVector<Uint32>& frames) const;
+
+    /** Get Image Position Patient of the given frame
+     *  @param  frameNo The frame number (first frame is 0)
+     *  @param  position The resulting position
+     *  @return EC_Normal if successful, error otherwise
+     */
+    OFCondition getImagePosition(const Uint32 frameNo, ImagePosition& position) const;
+
+    /** Get Image Orientation Patient, which must be shared by all frames
+     *  @param  orientation The resulting orientation (6 values)
+     *  @return EC_Normal if successful, error otherwise
+     */
+    OFCondition getImageOrientation(OFVector<Float64>& orientation) const;
+
+    /** Get Pixel Spacing, which must be shared by all frames
+     *  @param  spacing The resulting spacing (row spacing, column spacing)
+     *  @return EC_Normal if successful, error otherwise
+     */
+    OFCondition getPixelSpacing(OFVector<Float64>& spacing) const;
+
+    /** Get the pixel data of a frame as stored in the dataset, i.e. packed for BINARY
+     *  segmentations. The first pixel of the frame always starts at bit 0 of the first
+     *  byte, even if the frame is not byte-aligned within the dataset. Unused bits of
+     *  the last byte are set to 0.
+     *  @param  frameNo The frame number (first frame is 0)
+     *  @param  frame Resulting frame data
+     *  @return EC_Normal if successful, error otherwise
+     */
+    OFCondition getPackedFrame(const Uint32 frameNo, OFVector<Uint8>& frame) const;
+
+    /** Get a frame as bit mask of its non-zero pixels, 64 pixels per word: pixel i is bit i % 64
+     *  of word i / 64. Bits following the last pixel are 0. Only accesses the pixel data, so it
+     *  is safe to call it concurrently.
+     *  @param  frameNo The frame number (first frame is 0)
+     *  @param  words Resulting bit mask, (rows * columns + 63) / 64 words
+     *  @param  label If not 0, only pixels with this value are set (for LABELMAP segmentations)
+     *  @return EC_Normal if successful, error otherwise
+     */
+    OFCondition getFrameMask(const Uint32 frameNo, OFVector<Uint64>& words, const Uint16 label = 0) const;
+
+    /** Get pointer to the pixel data of a frame without copying, which is only possible
+     *  if the frame starts at a byte boundary (always true for FRACTIONAL and LABELMAP
+     *  segmentations and if rows * columns is a multiple of 8 for BINARY segmentations).
+     *  16-bit LABELMAP frames are in local byte order.
+     *  @param  frameNo The frame number (first frame is 0)
+     *  @return Pointer to the frame data, or NULL if not byte-aligned or not available
+     */
+    const Uint8* getAlignedFrame(const Uint32 frameNo) const;
+
+    /** Create a new segmentation dataset from segments and frames of existing datasets.
+     *  All top-level attributes (except Segment Sequence, Per-frame Functional Groups
+     *  Sequence, Number of Frames and Pixel Data) are taken from the header template.
+     *  Segment Sequence items and per-frame functional group items are copied from the
+     *  respective source and only their segment numbers are changed. Packed frames are
+     *  concatenated in the order given. Referenced series and instances of all sources
+     *  are combined. New SOP Instance and Series Instance UIDs are generated. The segment
+     *  identification is always written per frame and removed from the shared functional
+     *  groups. LABELMAP sources are rejected.
+     *  @param  headerTemplate Source whose header is used for the new dataset
+     *  @param  segments Segments of the new dataset, in the order of their new numbers
+     *  @param  frames Frames of the new dataset in the order they should be written
+     *  @param  result The resulting dataset
+     *  @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition buildSegmentation(const PackedFrameUtil& headerTemplate,
+                                         const OFVector<SegmentReference>& segments,
+                                         const OFVector<FrameReference>& frames,
+                                         DcmDataset& result);
+
+    /** Append bits to a bit buffer, where the first bit is the least significant
+     *  bit of the first byte (i.e. the DICOM bit order for 1-bit pixel data)
+     *  @param  buffer The buffer to append to, grows as needed
+     *  @param  bitOffset Number of bits already in the buffer, updated on return
+     *  @param  data The bits to be appended, starting with bit 0 of the first byte
+     *  @param  numBits Number of bits to append
+     */
+    static void appendBits(OFVector<Uint8>& buffer, size_t& bitOffset, const Uint8* data, const size_t numBits);
+
+    /** Count the set bits of a word */
+    static inline unsigned countBits(const Uint64 value)
+    {
+#if defined(_MSC_VER)
+        return OFstatic_cast(unsigned, __popcnt64(value));
+#else
+        return OFstatic_cast(unsigned, __builtin_popcountll(value));
+#endif
+    }
+
+    /** Get the index of the lowest set bit of a word, which must not be 0 */
+    static inline unsigned lowestBit(const Uint64 value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return index;
+#else
+        return OFstatic_cast(unsigned, __builtin_ctzll(value));
+#endif
+    }
+
+    /** Get the index of the highest set bit of a word, which must not be 0 */
+    static inline unsigned highestBit(const Uint64 value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#else
+        return 63 - OFstatic_cast(unsigned, __builtin_clzll(value));
+#endif
+    }
+
+protected:
+    /** Find an item of a functional group sequence, either in the per-frame
+     *  functional groups of the given frame or in the shared functional groups
+     *  @param  frameNo The frame number (first frame is 0)
+     *  @param  fgSequence The tag of the functional group sequence
+     *  @return The first item of the functional group sequence, or NULL if not found
+     */
+    DcmItem* findFunctionalGroup(const Uint32 frameNo, const DcmTagKey& fgSequence) const;
+
+    /** Set the Referenced Segment Number of a per-frame functional group item, and update
+     *  the corresponding value of the Dimension Index Values if applicable
+     *  @param  perFrameItem The per-frame functional groups item to modify
+     *  @param  segmentNumber The new segment number
+     *  @param  segmentDimension Index of the segment number within the Dimension
+     *          Index Values, or -1 if the segment number is not a dimension
+     *  @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition setFrameSegmentNumber(DcmItem& perFrameItem, const Uint16 segmentNumber, const int segmentDimension);
+
+    /** Get index of the dimension indexing the segment number
+     *  @return The index within the Dimension Index Sequence, or -1 if not present
+     */
+    int getSegmentDimension() const;
+
+private:
+    /// Segmentation dataset, not owned by this class
+    DcmDataset* m_dataset;
+
+    /// Pixel data of the dataset (not owned)
+    const Uint8* m_pixelData;
+
+    /// Length of the pixel data in bytes
+    size_t m_pixelDataLength;
+
+    /// Rows
+    Uint16 m_rows;
+
+    /// Columns
+    Uint16 m_columns;
+
+    /// Bits Allocated
+    Uint16 m_bitsAllocated;
+
+    /// Number of frames
+    Uint32 m_numberOfFrames;
+
+    /// Whether the dataset is a LABELMAP segmentation
+    OFBool m_labelmap;
+
+    /// Segment Sequence items (not owned) by their segment number
+    std::map<Uint16, DcmItem*> m_segmentItems;
+
+    /// Per-frame functional group items (not owned), one per frame
+    OFVector<DcmItem*> m_perFrameItems;
+
+    /// Shared functional groups item (not owned)
+    DcmItem* m_sharedItem;
+
+    /// Referenced segment number of every frame
+    OFVector<Uint16> m_frameSegmentNumbers;
+};
+
+} // namespace dcmqi
+
+#endif // DCMQI_PACKEDFRAMEUTIL_H
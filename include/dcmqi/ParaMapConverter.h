@@ -21,9 +21,6 @@
 #include "dcmqi/ConverterBase.h"
 #include "dcmqi/JSONParametricMapMetaInformationHandler.h"
 
-typedef IODFloatingPointImagePixelModule::value_type FloatPixelType;
-typedef itk::Image<FloatPixelType, 3> FloatImageType;
-typedef itk::ImageFileReader<FloatImageType> FloatReaderType;
 typedef itk::MinimumMaximumImageCalculator<FloatImageType> MinMaxCalculatorType;
 
 using namespace std;
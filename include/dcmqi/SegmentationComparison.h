@@ -0,0 +1,221 @@
+#ifndef DCMQI_SEGMENTATIONCOMPARISON_H
+#define DCMQI_SEGMENTATIONCOMPARISON_H
+
+// DCMTK includes
+#include "dcmtk/config/osconfig.h"
+#include "dcmtk/dcmdata/dcdatset.h"
+#include "dcmtk/ofstd/ofcond.h"
+#include "dcmtk/ofstd/ofvector.h"
+
+// JSON includes
+#include <json/json.h>
+
+// DCMQI includes
+#include "dcmqi/ConverterBase.h"
+#include "dcmqi/PackedFrameUtil.h"
+
+#include <map>
+#include <utility>
+
+namespace dcmqi
+{
+
+/**
+ * @brief The SegmentationComparison class computes agreement metrics between the segments of a
+ * reference DICOM Segmentation object and those of a test segmentation, given either as DICOM
+ * Segmentation object or as label map image.
+ *
+ * Both objects are aligned by frame position, so they must be defined on the same in-plane pixel
+ * grid; slices present in only one of them are compared to an empty slice. Intersection and union
+ * are counted with popcount on the packed frames. Optionally, Hausdorff and mean surface distances
+ * are computed from the boundary voxels of both segments. Frame positions are processed in parallel.
+ */
+class SegmentationComparison
+{
+public:
+    /// Segment number in the reference and segment number (or label) in the test object
+    typedef std::pair<Uint16, Uint16> SegmentPair;
+
+    /// Agreement of a pair of segments
+    struct AgreementMetrics
+    {
+        AgreementMetrics();
+
+        /// Get the Dice similarity coefficient, or 1 if both segments are empty
+        Float64 getDice() const;
+
+        /// Get the Jaccard index, or 1 if both segments are empty
+        Float64 getJaccard() const;
+
+        /// Segment numbers in reference and test object
+        SegmentPair segments;
+        /// Number of voxels in the reference segment
+        Uint64 referenceCount;
+        /// Number of voxels in the test segment
+        Uint64 testCount;
+        /// Number of voxels in both segments
+        Uint64 intersection;
+        /// Volume of a voxel in cubic millimeters
+        Float64 voxelVolume;
+        /// Whether surface distances were computed, which requires both segments to be non-empty
+        bool hasSurfaceDistances;
+        /// Maximum distance of a boundary voxel to the boundary of the other segment (mm)
+        Float64 hausdorffDistance;
+        /// 95th percentile of the boundary distances, maximum of both directions (mm)
+        Float64 hausdorffDistance95;
+        /// Average distance of all boundary voxels to the boundary of the other segment (mm)
+        Float64 meanSurfaceDistance;
+    };
+
+    /**
+     * @brief Compares the segments of two segmentations.
+     *
+     * @param reference The reference segmentation (BINARY or FRACTIONAL, any non-zero pixel counts).
+     * @param test The test segmentation, on the same pixel grid as the reference.
+     * @param pairs The pairs of segments to compare. If empty, segments with the same number in
+     *        both segmentations are compared.
+     * @param surfaceDistances Whether Hausdorff and mean surface distances should be computed.
+     * @param metrics The resulting metrics, in the order of the pairs.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition compare(DcmDataset* reference,
+                               DcmDataset* test,
+                               const OFVector<SegmentPair>& pairs,
+                               const bool surfaceDistances,
+                               OFVector<AgreementMetrics>& metrics);
+
+    /**
+     * @brief Compares the segments of a segmentation with the labels of a label map image.
+     *
+     * @param reference The reference segmentation (BINARY or FRACTIONAL, any non-zero pixel counts).
+     * @param test The label map, on the same in-plane pixel grid as the reference.
+     * @param pairs The pairs of segment number and label to compare. If empty, every segment is
+     *        compared to the label equal to its segment number.
+     * @param surfaceDistances Whether Hausdorff and mean surface distances should be computed.
+     * @param metrics The resulting metrics, in the order of the pairs.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition compare(DcmDataset* reference,
+                               ShortImageType::Pointer test,
+                               const OFVector<SegmentPair>& pairs,
+                               const bool surfaceDistances,
+                               OFVector<AgreementMetrics>& metrics);
+
+    /**
+     * @brief Converts the metrics to JSON, one object per pair of segments.
+     */
+    static Json::Value getJSON(const OFVector<AgreementMetrics>& metrics);
+
+protected:
+    /// Pixel data of a segmentation or label map, mapped to the slice positions of the comparison
+    struct MaskSource
+    {
+        MaskSource();
+
+        /// Segmentation, if this is a DICOM Segmentation object
+        const PackedFrameUtil* seg;
+        /// Frames of every segment, for every slice position of the comparison
+        OFVector<std::map<Uint16, OFVector<Uint32> > > segmentFrames;
+        /// Label map, if this is a label map image
+        ShortImageType::Pointer labelmap;
+        /// Slice of the label map for every slice position of the comparison, or -1
+        OFVector<long> labelmapSlices;
+    };
+
+    /// Pixel grid shared by reference and test object
+    struct Grid
+    {
+        /// Rows and columns of each slice
+        Uint16 rows;
+        Uint16 columns;
+        /// Image Orientation Patient
+        OFVector<Float64> orientation;
+        /// Pixel Spacing (row spacing, column spacing)
+        OFVector<Float64> spacing;
+        /// Distance between slices
+        Float64 sliceSpacing;
+        /// Position of every slice, in ascending order along the slice normal
+        OFVector<PackedFrameUtil::ImagePosition> positions;
+        /// Distance of every slice along the slice normal
+        OFVector<Float64> distances;
+    };
+
+    /// Slice position given by its distance along the slice normal and its Image Position Patient
+    typedef std::pair<Float64, PackedFrameUtil::ImagePosition> SlicePosition;
+
+    /**
+     * @brief Sets up rows, columns, orientation and spacing of the grid from the reference.
+     */
+    static OFCondition initGrid(const PackedFrameUtil& reference, Grid& grid);
+
+    /**
+     * @brief Gets the slice positions of all frames of a segmentation.
+     */
+    static OFCondition getSlicePositions(const PackedFrameUtil& seg, OFVector<SlicePosition>& positions);
+
+    /**
+     * @brief Adds slice positions to the grid. Positions closer than 1 micrometer to an existing
+     * one are considered to be the same.
+     */
+    static void addSlicePositions(const OFVector<SlicePosition>& positions, Grid& grid);
+
+    /**
+     * @brief Finds the slice of the grid at the given distance along the normal.
+     * @return The index of the slice, or -1 if there is none
+     */
+    static long findSlice(const Grid& grid, const Float64 distance);
+
+    /**
+     * @brief Maps the frames of a segmentation to the slices of the grid.
+     */
+    static OFCondition mapSegmentation(const PackedFrameUtil& seg, const Grid& grid, MaskSource& source);
+
+    /**
+     * @brief Gets the mask of a segment (or label) at a slice position as bit mask of 64 pixels per
+     * word. Only accesses pixel data, so it is safe to call it concurrently.
+     */
+    static OFCondition getMask(const Grid& grid,
+                               const MaskSource& source,
+                               const size_t position,
+                               const Uint16 segment,
+                               OFVector<Uint64>& words);
+
+    /**
+     * @brief Computes the metrics for all pairs once reference and test are mapped to the grid.
+     */
+    static OFCondition compareSources(const Grid& grid,
+                                      const MaskSource& reference,
+                                      const MaskSource& test,
+                                      const OFVector<SegmentPair>& pairs,
+                                      const bool surfaceDistances,
+                                      OFVector<AgreementMetrics>& metrics);
+
+    /**
+     * @brief Appends the patient coordinates of the boundary voxels of a mask, i.e. of all voxels
+     * that have a 6-neighbor outside the mask, to the given point list (x,y,z triples).
+     *
+     * @param grid The grid.
+     * @param position Slice position of the mask.
+     * @param mask The mask.
+     * @param previous The mask at the previous slice position, or empty if there is none adjacent.
+     * @param next The mask at the next slice position, or empty if there is none adjacent.
+     * @param points The point list.
+     */
+    static void addBoundaryPoints(const Grid& grid,
+                                  const size_t position,
+                                  const OFVector<Uint64>& mask,
+                                  const OFVector<Uint64>& previous,
+                                  const OFVector<Uint64>& next,
+                                  OFVector<Float64>& points);
+
+    /**
+     * @brief Computes the surface distance metrics from the boundary points of both segments.
+     */
+    static void computeSurfaceDistances(const OFVector<Float64>& referencePoints,
+                                        const OFVector<Float64>& testPoints,
+                                        AgreementMetrics& metrics);
+};
+
+} // namespace dcmqi
+
+#endif // DCMQI_SEGMENTATIONCOMPARISON_H
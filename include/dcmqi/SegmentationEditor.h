@@ -0,0 +1,193 @@
+#ifndef DCMQI_SEGMENTATIONEDITOR_H
+#define DCMQI_SEGMENTATIONEDITOR_H
+
+// DCMTK includes
+#include "dcmtk/config/osconfig.h"
+#include "dcmtk/dcmdata/dcdatset.h"
+#include "dcmtk/ofstd/ofcond.h"
+#include "dcmtk/ofstd/ofvector.h"
+
+#include <string>
+#include <vector>
+
+// DCMQI includes
+#include "dcmqi/PackedFrameUtil.h"
+#include "dcmqi/SegmentationInfo.h"
+
+namespace dcmqi
+{
+
+/**
+ * @brief The SegmentationEditor class provides operations that modify the segments of
+ * existing DICOM Segmentation objects on the level of their packed frames, i.e. without
+ * unpacking pixel data and without re-encoding segments that are not changed.
+ */
+class SegmentationEditor
+{
+public:
+    /**
+     * @brief Removes or replaces segments of an existing segmentation.
+     *
+     * The segments to be removed are replaced by the segments of newSegments one by one,
+     * in ascending order of their segment numbers. Surplus new segments are appended after the
+     * existing segments, and surplus removed segments are dropped. The resulting segments are
+     * numbered consecutively. Frames and functional groups of all other segments are copied
+     * verbatim.
+     *
+     * @param original The existing segmentation.
+     * @param newSegments Segmentation with the newly encoded segments (e.g. created by
+     *        Itk2DicomConverter for the same source images), or NULL if segments are only removed.
+     * @param segmentNumbers Numbers of the segments of the existing segmentation to be removed or replaced.
+     * @param result The resulting segmentation, which is a new SOP Instance.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition editSegments(DcmDataset* original,
+                                    DcmDataset* newSegments,
+                                    const OFVector<Uint16>& segmentNumbers,
+                                    DcmDataset& result);
+
+    /**
+     * @brief Merges multiple segmentations of the same image into a single segmentation.
+     *
+     * All segmentations must share the Frame of Reference. Segments are numbered consecutively
+     * in the order of the input segmentations, and their packed frames and functional groups are
+     * copied verbatim. The header (patient, study, references etc.) is taken from the first input.
+     *
+     * If a segmentation is defined on a different pixel grid than the first one, it is an error,
+     * unless the source images are provided: then, the segmentation is decoded, resampled onto
+     * the grid of the first segmentation (extended along the slice direction as needed) using
+     * nearest neighbor interpolation, and encoded again before merging.
+     *
+     * @param inputs The segmentations to be merged.
+     * @param sourceDatasets Source images used for encoding resampled segmentations (may be empty).
+     * @param result The resulting segmentation, which is a new SOP Instance.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition mergeSegmentations(const OFVector<DcmDataset*>& inputs,
+                                          std::vector<DcmDataset*>& sourceDatasets,
+                                          DcmDataset& result);
+
+    /**
+     * @brief Splits a segmentation into one segmentation per segment.
+     *
+     * For every segment, its Segment Sequence item, per-frame functional groups and packed frames
+     * are copied verbatim into a new SOP Instance; only the segment number (including the respective
+     * Dimension Index Values) and the UIDs are changed. All resulting instances share one new series
+     * and are numbered in the order of the segments.
+     *
+     * @param input The segmentation to be split.
+     * @param results The resulting segmentations in ascending order of the original segment numbers.
+     *        The datasets are owned by the caller.
+     * @param segmentNumbers Original segment number of each result.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition splitSegmentation(DcmDataset* input,
+                                         OFVector<DcmDataset*>& results,
+                                         OFVector<Uint16>& segmentNumbers);
+
+    /**
+     * @brief Derives new segments from boolean expressions over the segments of a segmentation.
+     *
+     * Expressions combine segment numbers with the operators & (intersection), | (union),
+     * - (difference) and ^ (symmetric difference), and may use parentheses. & binds more strongly
+     * than the other operators, which are evaluated from left to right, e.g. "1 - 2 & 3" is
+     * "1 - (2 & 3)". Expressions are evaluated on the packed frames, 64 pixels at a time and in
+     * parallel across frame positions, without decoding the segmentation. Only BINARY
+     * segmentations are supported.
+     *
+     * Each derived segment is described by a copy of the Segment Sequence item of the first segment
+     * in its expression, with the given label and the expression as description. It has one frame
+     * per position where the result is not empty.
+     *
+     * @param input The segmentation.
+     * @param expressions One expression per derived segment, e.g. "1 - 3" or "1 | 2 | 3".
+     * @param labels Segment Label of each derived segment. Missing labels are replaced by the expression.
+     * @param keepInputSegments If true, the derived segments are appended after the segments of the
+     *        input, otherwise the result contains the derived segments only.
+     * @param result The resulting segmentation, which is a new SOP Instance.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition deriveSegments(DcmDataset* input,
+                                      const std::vector<std::string>& expressions,
+                                      const std::vector<std::string>& labels,
+                                      const bool keepInputSegments,
+                                      DcmDataset& result);
+
+    /**
+     * @brief Checks whether the frames of two segmentations are defined on the same pixel grid,
+     * i.e. have the same frame size, bit depth, Frame of Reference, orientation and pixel spacing.
+     *
+     * @param seg1 First segmentation.
+     * @param seg2 Second segmentation.
+     * @return EC_Normal if compatible, error otherwise
+     */
+    static OFCondition checkCompatibleGeometry(const PackedFrameUtil& seg1, const PackedFrameUtil& seg2);
+
+protected:
+    /// Element of a compiled segment expression in postfix order: an operator, or 0 for an operand
+    struct ExpressionToken
+    {
+        /// Operator (one of &|-^), or 0 if this is a segment number
+        char m_operator;
+        /// Segment number if this is an operand
+        Uint16 m_segmentNumber;
+    };
+
+    /**
+     * @brief Parses a segment expression (see deriveSegments()) into postfix order.
+     *
+     * @param expression The expression.
+     * @param tokens The resulting tokens.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition parseExpression(const std::string& expression, OFVector<ExpressionToken>& tokens);
+
+    /**
+     * @brief Evaluates a parsed expression and creates a segmentation holding the derived segment only.
+     *
+     * @param seg The input segmentation.
+     * @param framesByPosition Frames of the input grouped by position.
+     * @param tokens The parsed expression.
+     * @param label Segment Label of the derived segment.
+     * @param description Segment Description of the derived segment.
+     * @param result The resulting segmentation.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition deriveSegment(const PackedFrameUtil& seg,
+                                     const SegmentationInfo::FramesByPosition& framesByPosition,
+                                     const OFVector<ExpressionToken>& tokens,
+                                     const std::string& label,
+                                     const std::string& description,
+                                     DcmDataset& result);
+
+    /**
+     * @brief Decodes a segmentation, resamples it onto the pixel grid of a reference segmentation and
+     * encodes it again.
+     *
+     * @param reference The reference segmentation defining the grid.
+     * @param segmentation The segmentation to be resampled.
+     * @param sourceDatasets Source images used for encoding.
+     * @return The resampled segmentation, or NULL if conversion failed.
+     */
+    static DcmDataset* resampleToReference(DcmDataset* reference,
+                                           DcmDataset* segmentation,
+                                           std::vector<DcmDataset*>& sourceDatasets);
+
+    /**
+     * @brief Collects segment and frame references for the given segments, in the given order.
+     * The segments are numbered consecutively starting with 1, and the frames of each segment
+     * keep their original order.
+     *
+     * @param segments Pairs of source segmentation and segment number in that source.
+     * @param segmentRefs The resulting segment references.
+     * @param frameRefs The resulting frame references.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition collectReferences(const OFVector<std::pair<const PackedFrameUtil*, Uint16> >& segments,
+                                         OFVector<PackedFrameUtil::SegmentReference>& segmentRefs,
+                                         OFVector<PackedFrameUtil::FrameReference>& frameRefs);
+};
+
+} // namespace dcmqi
+
+#endif // DCMQI_SEGMENTATIONEDITOR_H
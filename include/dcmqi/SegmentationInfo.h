@@ -0,0 +1,82 @@
+#ifndef DCMQI_SEGMENTATIONINFO_H
+#define DCMQI_SEGMENTATIONINFO_H
+
+// DCMTK includes
+#include "dcmtk/config/osconfig.h"
+#include "dcmtk/dcmdata/dcdatset.h"
+#include "dcmtk/ofstd/ofcond.h"
+#include "dcmtk/ofstd/ofvector.h"
+
+// JSON includes
+#include <json/json.h>
+
+// DCMQI includes
+#include "dcmqi/PackedFrameUtil.h"
+
+namespace dcmqi
+{
+
+/**
+ * @brief The SegmentationInfo class summarizes the structure of a DICOM Segmentation object
+ * (segments, frames, geometry and overlap) as JSON, for triage without converting the object.
+ *
+ * Everything except the overlap check works on the header only, so the dataset can be
+ * loaded without Pixel Data. LABELMAP segmentations are supported; since their frames are
+ * not assigned to segments, no frame count is reported per segment, and their segments
+ * never overlap.
+ */
+class SegmentationInfo
+{
+public:
+    /// Frames at the same position along the slice normal, ordered by that position
+    typedef OFVector<std::pair<Float64, OFVector<Uint32> > > FramesByPosition;
+
+    /**
+     * @brief Creates the JSON summary of a segmentation.
+     *
+     * @param dataset The segmentation, may be loaded without Pixel Data unless checkOverlap is set.
+     * @param checkOverlap If true, check which segments actually overlap, comparing the packed
+     *        frames that share a position.
+     * @param info The resulting summary.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition getInfo(DcmDataset* dataset, bool checkOverlap, Json::Value& info);
+
+    /**
+     * @brief Groups the frames of a segmentation by their position along the slice normal.
+     *
+     * @param seg The segmentation.
+     * @param frames The resulting groups, in ascending order of the position.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition getFramesByPosition(const PackedFrameUtil& seg, FramesByPosition& frames);
+
+    /**
+     * @brief Converts the first item of a code sequence into the JSON representation used in the
+     * dcmqi meta information, i.e. CodeValue, CodingSchemeDesignator and CodeMeaning.
+     *
+     * @return The code, or a null value if the sequence is not present.
+     */
+    static Json::Value getCode(DcmItem* item, const DcmTagKey& sequence);
+
+protected:
+    /**
+     * @brief Computes the slice grid covered by the frames and checks whether the slices are
+     * evenly spaced.
+     */
+    static OFCondition getGeometryInfo(const PackedFrameUtil& seg, const FramesByPosition& frames, Json::Value& geometry);
+
+    /**
+     * @brief Finds the pairs of segments that have at least one pixel in common.
+     */
+    static OFCondition getOverlapInfo(const PackedFrameUtil& seg, const FramesByPosition& frames, Json::Value& overlap);
+
+    /**
+     * @brief Checks whether two frames of the same size have at least one non-zero pixel in common.
+     */
+    static OFCondition checkFramesOverlap(const PackedFrameUtil& seg, const Uint32 f1, const Uint32 f2, bool& overlap);
+};
+
+} // namespace dcmqi
+
+#endif // DCMQI_SEGMENTATIONINFO_H
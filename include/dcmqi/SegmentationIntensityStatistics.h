@@ -0,0 +1,208 @@
+#ifndef DCMQI_SEGMENTATIONINTENSITYSTATISTICS_H
+#define DCMQI_SEGMENTATIONINTENSITYSTATISTICS_H
+
+// DCMTK includes
+#include "dcmtk/config/osconfig.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/ofstd/ofcond.h"
+#include "dcmtk/ofstd/ofvector.h"
+
+// JSON includes
+#include <json/json.h>
+
+// DCMQI includes
+#include "dcmqi/PackedFrameUtil.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dcmqi
+{
+
+/**
+ * @brief The SegmentationIntensityStatistics class computes intensity statistics (mean, standard
+ * deviation, percentiles, histogram) of a source series or parametric map within every segment of
+ * a DICOM Segmentation object.
+ *
+ * Segmentation frames are mapped to source slices by their position, so the segmentation must be
+ * defined on the pixel grid of the source. Only the headers of the source are kept in memory; the
+ * slices covered by the segmentation are read one by one, in parallel, and the statistics are
+ * accumulated in a single pass. Percentiles are estimated from the histogram, whose range and
+ * number of bins have to be chosen up front.
+ */
+class SegmentationIntensityStatistics
+{
+public:
+    /// Intensity statistics of a single segment
+    struct IntensityStatistics
+    {
+        /** Constructor
+         *  @param  histogramMin Lower bound of the first histogram bin
+         *  @param  histogramMax Upper bound of the last histogram bin
+         *  @param  bins Number of histogram bins
+         */
+        IntensityStatistics(const Float64 histogramMin = -1024, const Float64 histogramMax = 3072, const Uint32 bins = 4096);
+
+        /// Add a single value
+        void add(const Float64 value);
+
+        /// Add all values accumulated by another object with the same histogram parameters
+        void merge(const IntensityStatistics& other);
+
+        /// Get the standard deviation of all values
+        Float64 getStandardDeviation() const;
+
+        /** Get a percentile, interpolated within the histogram bin it falls into
+         *  @param  percent The percentile (0..100)
+         *  @return The value, clamped to the minimum and maximum value
+         */
+        Float64 getPercentile(const Float64 percent) const;
+
+        /// Segment number
+        Uint16 segmentNumber;
+        /// Number of values
+        Uint64 count;
+        /// Mean of all values
+        Float64 mean;
+        /// Sum of squared differences from the mean
+        Float64 m2;
+        /// Minimum value
+        Float64 minimum;
+        /// Maximum value
+        Float64 maximum;
+        /// Lower bound of the first histogram bin
+        Float64 histogramMin;
+        /// Width of each histogram bin
+        Float64 binWidth;
+        /// Number of values per bin; values outside the range are counted in the first or last bin
+        OFVector<Uint64> histogram;
+    };
+
+    /** Constructor
+     *  @param  histogramMin Lower bound of the histogram range
+     *  @param  histogramMax Upper bound of the histogram range
+     *  @param  bins Number of histogram bins
+     */
+    SegmentationIntensityStatistics(const Float64 histogramMin = -1024,
+                                    const Float64 histogramMax = 3072,
+                                    const Uint32 bins          = 4096);
+
+    /** Use a series of single-frame images as source. Only the headers are read.
+     *  @param  fileNames The image files
+     *  @return EC_Normal if successful, error otherwise
+     */
+    OFCondition setSourceSeries(const std::vector<std::string>& fileNames);
+
+    /** Use a parametric map as source. Pixel data is read frame by frame as needed.
+     *  @param  fileName The parametric map file
+     *  @return EC_Normal if successful, error otherwise
+     */
+    OFCondition setParametricMap(const std::string& fileName);
+
+    /** Get the units of the source values, if known (Real World Value Mapping of a parametric map,
+     *  or Hounsfield units for a CT series)
+     *  @return The units in dcmqi JSON code representation, or a null value
+     */
+    Json::Value getUnits() const;
+
+    /** Get the quantity of the source values, if known (Quantity Definition of a parametric map,
+     *  or attenuation coefficient for a CT series)
+     *  @return The quantity in dcmqi JSON code representation, or a null value
+     */
+    Json::Value getQuantity() const;
+
+    /** Compute statistics for all segments
+     *  @param  segmentation BINARY or FRACTIONAL segmentation on the grid of the source. For
+     *          FRACTIONAL segmentations, every non-zero pixel is taken into account.
+     *  @param  statistics The resulting statistics in ascending order of segment numbers
+     *  @return EC_Normal if successful, error otherwise
+     */
+    OFCondition computeStatistics(DcmDataset* segmentation, OFVector<IntensityStatistics>& statistics);
+
+    /** Add Mean, Standard Deviation, Median, Minimum and Maximum as measurement items to the
+     *  TID1500 measurement groups (as created by SegmentationStatistics::getMeasurements()) of
+     *  the respective segments
+     *  @param  statistics The statistics
+     *  @param  quantity The measured quantity in dcmqi JSON code representation
+     *  @param  units The units in dcmqi JSON code representation
+     *  @param  measurements The measurement groups to be extended
+     */
+    static void addMeasurementItems(const OFVector<IntensityStatistics>& statistics,
+                                    const Json::Value& quantity,
+                                    const Json::Value& units,
+                                    Json::Value& measurements);
+
+    /** Add the statistics, including percentiles and histogram, to the per-segment objects
+     *  created by SegmentationStatistics::getStatisticsJSON()
+     *  @param  statistics The statistics
+     *  @param  segments The per-segment objects to be extended
+     */
+    static void addStatisticsJSON(const OFVector<IntensityStatistics>& statistics, Json::Value& segments);
+
+protected:
+    /// A slice of the source
+    struct SourceSlice
+    {
+        /// Position along the slice normal
+        Float64 distance;
+        /// Image Position Patient
+        PackedFrameUtil::ImagePosition position;
+        /// File the slice is stored in (source series only)
+        std::string fileName;
+        /// Frame number within the parametric map (parametric map only)
+        Uint32 frameNo;
+        /// Slope and intercept mapping stored to real values
+        Float64 slope;
+        Float64 intercept;
+    };
+
+    /** Check that a slice has the same pixel grid as the first one, and add it */
+    OFCondition addSlice(const SourceSlice& slice,
+                         const Uint16 rows,
+                         const Uint16 columns,
+                         const OFVector<Float64>& orientation,
+                         const OFVector<Float64>& spacing);
+
+    /** Read the real values of a slice. Safe to be called concurrently. */
+    OFCondition readSlice(const SourceSlice& slice, OFVector<Float64>& values);
+
+    /** Convert raw pixel data to real values */
+    void convertPixelData(const Uint8* data, const Float64 slope, const Float64 intercept, OFVector<Float64>& values) const;
+
+private:
+    /// Histogram parameters
+    Float64 m_histogramMin;
+    Float64 m_histogramMax;
+    Uint32 m_bins;
+
+    /// Source slices in ascending order of their position
+    OFVector<SourceSlice> m_slices;
+
+    /// Pixel grid of the source
+    Uint16 m_rows;
+    Uint16 m_columns;
+    OFVector<Float64> m_orientation;
+    OFVector<Float64> m_spacing;
+
+    /// Pixel data attributes of the source
+    DcmTagKey m_pixelDataTag;
+    Uint16 m_bitsAllocated;
+    Uint16 m_bitsStored;
+    Uint16 m_pixelRepresentation;
+
+    /// Parametric map, with pixel data left in the file
+    DcmFileFormat m_parametricMap;
+    bool m_isParametricMap;
+
+    /// Quantity and units of the parametric map
+    Json::Value m_quantity;
+    Json::Value m_units;
+
+    /// Serializes reading from the parametric map
+    std::mutex m_readMutex;
+};
+
+} // namespace dcmqi
+
+#endif // DCMQI_SEGMENTATIONINTENSITYSTATISTICS_H
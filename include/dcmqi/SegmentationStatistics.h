@@ -0,0 +1,118 @@
+#ifndef DCMQI_SEGMENTATIONSTATISTICS_H
+#define DCMQI_SEGMENTATIONSTATISTICS_H
+
+// DCMTK includes
+#include "dcmtk/config/osconfig.h"
+#include "dcmtk/dcmdata/dcdatset.h"
+#include "dcmtk/ofstd/ofcond.h"
+#include "dcmtk/ofstd/ofvector.h"
+
+// JSON includes
+#include <json/json.h>
+
+// DCMQI includes
+#include "dcmqi/PackedFrameUtil.h"
+
+namespace dcmqi
+{
+
+/**
+ * @brief The SegmentationStatistics class computes shape statistics of the segments of a DICOM
+ * Segmentation object directly from its packed frames, i.e. without creating a volume.
+ *
+ * Binary frames are scanned 64 bits at a time, counting pixels with popcount and finding the
+ * extent of each row with bit scans. Frames of a LABELMAP segmentation are scanned once for
+ * all segments. Frames are processed in parallel.
+ */
+class SegmentationStatistics
+{
+public:
+    /// Statistics of a single segment
+    struct SegmentStatistics
+    {
+        SegmentStatistics();
+
+        /// Segment number
+        Uint16 segmentNumber;
+        /// Number of non-zero pixels
+        Uint64 voxelCount;
+        /// Volume in cubic millimeters
+        Float64 volume;
+        /// First column, row and slice covered by the segment; slices are counted on the grid
+        /// defined by the smallest distance of frame positions, starting with the first position
+        Sint32 boundingBoxMin[3];
+        /// Last column, row and slice covered by the segment
+        Sint32 boundingBoxMax[3];
+        /// Center of mass in patient coordinates (mm)
+        Float64 centroid[3];
+    };
+
+    /**
+     * @brief Computes statistics for all segments of a segmentation.
+     *
+     * @param dataset BINARY, FRACTIONAL or LABELMAP segmentation. For FRACTIONAL segmentations,
+     *        every non-zero pixel is counted.
+     * @param statistics The resulting statistics in ascending order of segment numbers.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition computeStatistics(DcmDataset* dataset, OFVector<SegmentStatistics>& statistics);
+
+    /**
+     * @brief Creates one TID1500 measurement group per segment, in the format of the "Measurements"
+     * array read by tid1500writer. Each group reports the volume of the segment, and uses the
+     * segmented property type and anatomic region as finding and finding site.
+     *
+     * @param dataset The segmentation the statistics were computed for.
+     * @param statistics The statistics.
+     * @param measurements The resulting array.
+     * @return EC_Normal if successful, error otherwise
+     */
+    static OFCondition getMeasurements(DcmDataset* dataset,
+                                       const OFVector<SegmentStatistics>& statistics,
+                                       Json::Value& measurements);
+
+    /**
+     * @brief Converts the statistics to JSON, one object per segment.
+     */
+    static Json::Value getStatisticsJSON(const OFVector<SegmentStatistics>& statistics);
+
+    /**
+     * @brief Returns the distance between slices, computed from the frame positions or, if all
+     * frames share a position, taken from Spacing Between Slices or Slice Thickness.
+     */
+    static OFCondition getSliceSpacing(const PackedFrameUtil& seg, Float64& spacing);
+
+protected:
+    /// Statistics of a single frame, with coordinates in pixels
+    struct FrameStatistics
+    {
+        FrameStatistics();
+
+        Uint64 count;
+        Float64 sumColumns;
+        Float64 sumRows;
+        Sint32 minColumn, maxColumn, minRow, maxRow;
+    };
+
+    /**
+     * @brief Computes the statistics of a single frame. Only accesses the pixel data, so it is
+     * safe to call it concurrently for different frames.
+     */
+    static OFCondition scanFrame(const PackedFrameUtil& seg, const Uint32 frameNo, FrameStatistics& frameStats);
+
+    /**
+     * @brief Computes the statistics of all segments in a single LABELMAP frame, which is safe
+     * to call concurrently for different frames as well.
+     *
+     * @param segmentIndices Index of each segment number in frameStats, or -1 for unused values.
+     * @param frameStats The statistics of the frame, one per segment.
+     */
+    static OFCondition scanLabelmapFrame(const PackedFrameUtil& seg,
+                                         const Uint32 frameNo,
+                                         const OFVector<Sint32>& segmentIndices,
+                                         FrameStatistics* frameStats);
+};
+
+} // namespace dcmqi
+
+#endif // DCMQI_SEGMENTATIONSTATISTICS_H
@@ -0,0 +1,87 @@
+#ifndef DCMQI_SHAREDMEMORYIO_H
+#define DCMQI_SHAREDMEMORYIO_H
+
+// STD includes
+#include <stdint.h>
+#include <string>
+
+// ITK includes
+#include <itkImageBase.h>
+
+namespace dcmqi {
+
+  /**
+   * @brief The SharedMemoryIO class publishes decoded volumes as named POSIX shared memory
+   * objects, so that processes on the same host can map them without any disk I/O.
+   *
+   * Each object starts with a Header, followed by the voxels (C order, columns varying fastest,
+   * native byte order) and the JSON metadata of the volume. The voxels start at a multiple of
+   * 64 bytes. The objects are not removed by the publisher; the consumer owns them once they
+   * are announced and releases them with shm_unlink() (or unlink() of this class).
+   *
+   * Shared memory objects are only supported on POSIX systems.
+   */
+  class SharedMemoryIO {
+
+  public:
+
+    /// Type of the voxels of a shared volume
+    enum DataType { INT16 = 1, FLOAT32 = 2 };
+
+    /// Layout of the start of each shared memory object
+    struct Header {
+      /// "DCMQIVOL"
+      char magic[8];
+      /// Layout version, currently 1
+      uint32_t version;
+      /// Size of this structure
+      uint32_t headerSize;
+      /// DataType of the voxels
+      uint32_t dataType;
+      /// Bytes per voxel
+      uint32_t itemSize;
+      /// Number of columns, rows and slices
+      uint64_t size[3];
+      /// Voxel spacing (mm)
+      double spacing[3];
+      /// Position of the first voxel (mm), LPS
+      double origin[3];
+      /// Direction matrix, row by row; column i is the direction of image axis i
+      double direction[9];
+      /// Offset and length of the voxels
+      uint64_t dataOffset;
+      uint64_t dataSize;
+      /// Offset and length of the JSON metadata (UTF-8, not null-terminated)
+      uint64_t metadataOffset;
+      uint64_t metadataSize;
+    };
+
+    /**
+     * @brief Creates a shared memory object holding a volume.
+     *
+     * @param name Name of the object, starting with a slash, e.g. "/dcmqi-1234-1". Fails if an
+     *        object with this name exists already.
+     * @param image Image providing the geometry.
+     * @param voxels Voxel buffer of the image.
+     * @param dataType Type of the voxels.
+     * @param metadata JSON metadata stored along with the volume.
+     * @param objectSize If not NULL, receives the size of the object in bytes.
+     * @return true if successful
+     */
+    static bool publish(const std::string &name, const itk::ImageBase<3>* image, const void* voxels,
+                        DataType dataType, const std::string &metadata, size_t* objectSize=NULL);
+
+    /**
+     * @brief Removes a shared memory object created by publish().
+     */
+    static bool unlink(const std::string &name);
+
+    /**
+     * @brief Checks whether shared memory objects are supported on this platform.
+     */
+    static bool isSupported();
+  };
+
+}
+
+#endif //DCMQI_SHAREDMEMORYIO_H
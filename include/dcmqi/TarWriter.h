@@ -0,0 +1,54 @@
+#ifndef DCMQI_TARWRITER_H
+#define DCMQI_TARWRITER_H
+
+// STD includes
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dcmqi {
+
+  /**
+   * @brief The TarWriter class writes files as POSIX (ustar) tar archive to a stream, so that
+   * conversions with several output files can write them to a pipe instead of a directory.
+   *
+   * The content of each file is written as is, without intermediate copies. Files of 8 GiB
+   * and more use the base-256 size encoding understood by GNU and BSD tar.
+   */
+  class TarWriter {
+
+  public:
+
+    explicit TarWriter(std::ostream &stream);
+
+    /**
+     * @brief Adds a file with the given content.
+     *
+     * @param name Name of the file in the archive, at most 100 characters.
+     * @return true if successful
+     */
+    bool addFile(const std::string &name, const std::string &content);
+
+    /**
+     * @brief Adds a file whose content is the concatenation of several buffers.
+     */
+    bool addFile(const std::string &name, const std::vector<std::pair<const char*, size_t> > &buffers);
+
+    /**
+     * @brief Writes the end of the archive and flushes the stream.
+     */
+    bool finish();
+
+  protected:
+
+    bool writeHeader(const std::string &name, size_t size);
+
+  private:
+
+    std::ostream &m_stream;
+  };
+
+}
+
+#endif //DCMQI_TARWRITER_H
@@ -0,0 +1,182 @@
+#ifndef DCMQI_C_H
+#define DCMQI_C_H
+
+/*
+ * C interface of the dcmqi_c shared library.
+ *
+ * All conversions work on memory buffers: DICOM objects are passed as the bytes of a DICOM
+ * file (with or without the 128 byte preamble), images as voxel buffers with their geometry.
+ * Results are returned as opaque dcmqi_result objects, which also hold the messages of the
+ * conversion and must be released with dcmqi_result_free(). Input buffers are only read and
+ * need to stay valid for the duration of the call only.
+ *
+ * Functions may be called concurrently from several threads, as long as a result object is
+ * not used by several threads at the same time.
+ *
+ * The interface only uses C types. Structures start with their size in bytes, which the caller
+ * sets to sizeof() of the structure. They are only extended at their end together with an
+ * increment of DCMQI_C_API_VERSION, and the library uses the size given by the caller, also to
+ * step through arrays of structures. This way, callers built against an earlier version of
+ * this header keep working.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(DCMQI_C_EXPORTS)
+#    define DCMQI_C_API __declspec(dllexport)
+#  else
+#    define DCMQI_C_API __declspec(dllimport)
+#  endif
+#else
+#  define DCMQI_C_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Version of this interface */
+#define DCMQI_C_API_VERSION 1
+
+/** Status codes */
+#define DCMQI_OK 0
+/** An argument is NULL or inconsistent */
+#define DCMQI_ERROR_INVALID_ARGUMENT 1
+/** A DICOM buffer could not be parsed */
+#define DCMQI_ERROR_INVALID_DICOM 2
+/** The conversion failed, see dcmqi_result_errors() */
+#define DCMQI_ERROR_CONVERSION 3
+/** The requested item is not part of the result */
+#define DCMQI_ERROR_NOT_AVAILABLE 4
+
+/** Geometry of a 3D image in patient (LPS) coordinates */
+typedef struct dcmqi_geometry {
+  /** Size of this structure in bytes, to be set to sizeof(dcmqi_geometry) */
+  size_t struct_size;
+  /** Number of columns, rows and slices */
+  uint32_t size[3];
+  /** Position of the center of the first voxel (mm) */
+  double origin[3];
+  /** Distance between columns, rows and slices (mm) */
+  double spacing[3];
+  /** Direction cosines, row by row; column i is the direction of image axis i */
+  double direction[9];
+} dcmqi_geometry;
+
+/** Result of a conversion */
+typedef struct dcmqi_result dcmqi_result;
+
+/** Get DCMQI_C_API_VERSION of the library */
+DCMQI_C_API int dcmqi_api_version(void);
+
+/** Get the version of dcmqi, e.g. "1.3.0" */
+DCMQI_C_API const char* dcmqi_version(void);
+
+/**
+ * Convert a DICOM Segmentation object into label images.
+ *
+ * @param segData Bytes of the DICOM Segmentation file.
+ * @param segSize Number of bytes.
+ * @param mergeSegments Non-zero to store non-overlapping segments in the same label image.
+ * @param result Receives the result, also if the conversion fails.
+ * @return DCMQI_OK if successful, error code otherwise
+ */
+DCMQI_C_API int dcmqi_seg_to_labelmaps(const void* segData, size_t segSize, int mergeSegments,
+                                       dcmqi_result** result);
+
+/**
+ * Convert label images into a BINARY DICOM Segmentation object.
+ *
+ * @param sourceData Bytes of the DICOM files of the segmented image series.
+ * @param sourceSizes Number of bytes of each source file.
+ * @param sourceCount Number of source files.
+ * @param labels Voxels of each label image, columns varying fastest.
+ * @param geometries Geometry of each label image, all with the same struct_size.
+ * @param labelCount Number of label images.
+ * @param metadataJson Segment metadata as accepted by itkimage2segimage.
+ * @param skipEmptySlices Non-zero to skip slices without any label.
+ * @param result Receives the result, also if the conversion fails.
+ * @return DCMQI_OK if successful, error code otherwise
+ */
+DCMQI_C_API int dcmqi_labelmaps_to_seg(const void* const* sourceData, const size_t* sourceSizes,
+                                       size_t sourceCount,
+                                       const int16_t* const* labels, const dcmqi_geometry* geometries,
+                                       size_t labelCount,
+                                       const char* metadataJson, int skipEmptySlices,
+                                       dcmqi_result** result);
+
+/**
+ * Convert a DICOM Parametric Map object into a float image.
+ *
+ * @param pmapData Bytes of the DICOM Parametric Map file.
+ * @param pmapSize Number of bytes.
+ * @param result Receives the result, also if the conversion fails.
+ * @return DCMQI_OK if successful, error code otherwise
+ */
+DCMQI_C_API int dcmqi_paramap_to_image(const void* pmapData, size_t pmapSize, dcmqi_result** result);
+
+/**
+ * Convert a float image into a DICOM Parametric Map object.
+ *
+ * @param sourceData Bytes of the DICOM files of the source image series.
+ * @param sourceSizes Number of bytes of each source file.
+ * @param sourceCount Number of source files.
+ * @param voxels Voxels of the parametric map, columns varying fastest.
+ * @param geometry Geometry of the parametric map.
+ * @param metadataJson Metadata as accepted by itkimage2paramap.
+ * @param result Receives the result, also if the conversion fails.
+ * @return DCMQI_OK if successful, error code otherwise
+ */
+DCMQI_C_API int dcmqi_image_to_paramap(const void* const* sourceData, const size_t* sourceSizes,
+                                       size_t sourceCount,
+                                       const float* voxels, const dcmqi_geometry* geometry,
+                                       const char* metadataJson,
+                                       dcmqi_result** result);
+
+/** Get the number of images of a result */
+DCMQI_C_API size_t dcmqi_result_image_count(const dcmqi_result* result);
+
+/**
+ * Get a label image of a result. The voxels stay valid until the result is released.
+ * The struct_size of the geometry must be set by the caller.
+ *
+ * @return DCMQI_OK, or DCMQI_ERROR_NOT_AVAILABLE if there is no label image with this index
+ */
+DCMQI_C_API int dcmqi_result_label_image(const dcmqi_result* result, size_t index,
+                                         dcmqi_geometry* geometry, const int16_t** voxels);
+
+/**
+ * Get a float image of a result. The voxels stay valid until the result is released.
+ * The struct_size of the geometry must be set by the caller.
+ *
+ * @return DCMQI_OK, or DCMQI_ERROR_NOT_AVAILABLE if there is no float image with this index
+ */
+DCMQI_C_API int dcmqi_result_float_image(const dcmqi_result* result, size_t index,
+                                         dcmqi_geometry* geometry, const float** voxels);
+
+/**
+ * Get the DICOM file created by a conversion. The bytes stay valid until the result is released.
+ *
+ * @return DCMQI_OK, or DCMQI_ERROR_NOT_AVAILABLE if the conversion did not create a DICOM object
+ */
+DCMQI_C_API int dcmqi_result_dicom(const dcmqi_result* result, const void** data, size_t* size);
+
+/** Get the JSON metadata of a result, or an empty string */
+DCMQI_C_API const char* dcmqi_result_metadata(const dcmqi_result* result);
+
+/** Get the progress messages of a conversion */
+DCMQI_C_API const char* dcmqi_result_log(const dcmqi_result* result);
+
+/** Get the warnings and errors of a conversion */
+DCMQI_C_API const char* dcmqi_result_errors(const dcmqi_result* result);
+
+/** Release a result; NULL is ignored */
+DCMQI_C_API void dcmqi_result_free(dcmqi_result* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DCMQI_C_H */
@@ -0,0 +1,116 @@
+// DCMQI includes
+#include "dcmqi/AsyncConverter.h"
+#include "dcmqi/Dicom2ItkConverter.h"
+#include "dcmqi/Itk2DicomConverter.h"
+#include "dcmqi/ParaMapConverter.h"
+
+namespace dcmqi {
+
+  AsyncConverter::AsyncConverter(unsigned numberOfThreads)
+    : m_stopping(false) {
+    if(!numberOfThreads)
+      numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+    // Codecs must be registered before the first conversion, not concurrently by several ones
+    ConversionContext::initialize();
+    for(unsigned i=0;i<numberOfThreads;i++)
+      m_workers.push_back(std::thread(&AsyncConverter::work, this));
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  AsyncConverter::~AsyncConverter() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_condition.notify_all();
+    for(size_t i=0;i<m_workers.size();i++)
+      m_workers[i].join();
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  void AsyncConverter::enqueue(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.push_back(task);
+    }
+    m_condition.notify_one();
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  void AsyncConverter::work() {
+    while(true){
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this](){ return m_stopping || !m_tasks.empty(); });
+        // pending tasks are still processed when stopping
+        if(m_tasks.empty())
+          return;
+        task = m_tasks.front();
+        m_tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::future<AsyncConverter::DatasetResult> AsyncConverter::itkimage2dcmSegmentation(
+      const std::vector<DcmDataset*> &dcmDatasets,
+      const std::vector<ShortImageType::Pointer> &segmentations,
+      const std::string &metaData,
+      bool skipEmptySlices) {
+    return submit<DcmDataset*>([=](){
+      DcmDataset* dataset = Itk2DicomConverter::itkimage2dcmSegmentation(dcmDatasets, segmentations,
+                                                                         metaData, skipEmptySlices);
+      if(dataset == NULL)
+        throw -1;
+      return dataset;
+    });
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::future<AsyncConverter::SegmentationImagesResult> AsyncConverter::dcmSegmentation2itkimage(
+      DcmDataset* segDataset,
+      bool mergeSegments) {
+    return submit<SegmentationImages>([=](){
+      SegmentationImages result;
+      Dicom2ItkConverter converter;
+      OFCondition cond = converter.dcmSegmentation2itkimage(segDataset, result.metaInfo, mergeSegments);
+      if(cond.bad()){
+        ConversionContext::err() << "ERROR: Failed to convert DICOM SEG to ITK image: " << cond.text() << std::endl;
+        throw -1;
+      }
+      for(ShortImageType::Pointer image = converter.begin(); image; image = converter.next())
+        result.images.push_back(image);
+      return result;
+    });
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::future<AsyncConverter::DatasetResult> AsyncConverter::itkimage2paramap(
+      const FloatImageType::Pointer &parametricMapImage,
+      const std::vector<DcmDataset*> &dcmDatasets,
+      const std::string &metaData) {
+    return submit<DcmDataset*>([=](){
+      DcmDataset* dataset = ParaMapConverter::itkimage2paramap(parametricMapImage, dcmDatasets, metaData);
+      if(dataset == NULL)
+        throw -1;
+      return dataset;
+    });
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::future<AsyncConverter::ParametricMapResult> AsyncConverter::paramap2itkimage(DcmDataset* pmapDataset) {
+    return submit<std::pair<FloatImageType::Pointer, std::string> >([=](){
+      return ParaMapConverter::paramap2itkimage(pmapDataset);
+    });
+  }
+
+}
@@ -0,0 +1,58 @@
+// DCMQI includes
+#include "dcmqi/ConversionContext.h"
+
+// DCMTK includes
+#include <dcmtk/config/osconfig.h>
+#include <dcmtk/dcmdata/dcrledrg.h>
+#include <dcmtk/oflog/oflog.h>
+
+// STD includes
+#include <iostream>
+#include <mutex>
+
+namespace dcmqi {
+
+  namespace {
+    // Context of the conversion running on this thread, if any
+    thread_local ConversionContext* currentContext = NULL;
+
+    std::once_flag initializeFlag;
+  }
+
+  ConversionContext::ConversionContext(std::ostream &out, std::ostream &err)
+    : m_out(out), m_err(err), m_previous(currentContext) {
+    currentContext = this;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  ConversionContext::~ConversionContext() {
+    currentContext = m_previous;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::ostream& ConversionContext::out() {
+    return currentContext ? currentContext->m_out : std::cout;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::ostream& ConversionContext::err() {
+    return currentContext ? currentContext->m_err : std::cerr;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  void ConversionContext::initialize() {
+    std::call_once(initializeFlag, [](){
+      // Make sure RLE-compressed images can be decompressed
+      DcmRLEDecoderRegistration::registerCodecs();
+
+      // The parametric map IOD reports expected deviations as errors, which are not of interest
+      OFLogger dcemfinfLogger = OFLog::getLogger("qiicr.apps");
+      dcemfinfLogger.setLogLevel(dcmtk::log4cplus::OFF_LOG_LEVEL);
+    });
+  }
+
+}
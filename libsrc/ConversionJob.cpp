@@ -0,0 +1,505 @@
+// DCMQI includes
+#include "dcmqi/ConversionJob.h"
+#include "dcmqi/ContentHash.h"
+#include "dcmqi/Dicom2ItkConverter.h"
+#include "dcmqi/Helper.h"
+#include "dcmqi/Itk2DicomConverter.h"
+#include "dcmqi/NrrdIO.h"
+#include "dcmqi/NumpyIO.h"
+#include "dcmqi/ParaMapConverter.h"
+#include "dcmqi/QIICRConstants.h"
+
+// STD includes
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+
+namespace dcmqi {
+
+  namespace {
+    // Deletes the source datasets of a job also if it fails
+    struct DatasetList {
+      ~DatasetList() {
+        for(size_t i=0;i<datasets.size();i++)
+          delete datasets[i];
+      }
+      std::vector<DcmDataset*> datasets;
+    };
+  }
+
+  Json::Value ConversionJob::run(const Json::Value &job) {
+    const std::string type = job.get("type", "").asString();
+    if(type == "segimage2itkimage")
+      return runSegimage2itkimage(job);
+    if(type == "paramap2itkimage")
+      return runParamap2itkimage(job);
+    if(type == "itkimage2segimage")
+      return runItkimage2segimage(job);
+    if(type == "itkimage2paramap")
+      return runItkimage2paramap(job);
+    ConversionContext::err() << "ERROR: Unknown job type \"" << type << "\"" << std::endl;
+    throw -1;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  void ConversionJob::submit(AsyncConverter &converter, const Json::Value &job,
+                             std::function<void(const Json::Value&)> callback) {
+    converter.submit<Json::Value>([job](){ return run(job); },
+                                  [job, callback](AsyncConverter::Result<Json::Value> &result){
+                                    callback(getStatus(job, result));
+                                  });
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  Json::Value ConversionJob::getStatus(const Json::Value &job, const AsyncConverter::Result<Json::Value> &result) {
+    Json::Value status;
+    if(job.isMember("id"))
+      status["id"] = job["id"];
+    status["success"] = result.success;
+    status["outputs"] = result.success ? result.value : Json::Value(Json::arrayValue);
+    status["log"] = result.log;
+    status["errors"] = result.errors;
+    return status;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool ConversionJob::isValid(const Json::Value &job) {
+    if(!job.isObject())
+      return false;
+    const std::string type = job.get("type", "").asString();
+    return type == "segimage2itkimage" || type == "paramap2itkimage"
+           || type == "itkimage2segimage" || type == "itkimage2paramap";
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  size_t ConversionJob::runManifest(std::istream &manifest, const Json::Value &defaults, unsigned numberOfThreads,
+                                    std::ostream &status, const std::string &journalFileName,
+                                    size_t* numberOfJobs) {
+    std::mutex statusMutex;
+    size_t failures = 0, jobs = 0;
+    Json::StreamWriterBuilder writerBuilder;
+    writerBuilder["indentation"] = "";
+
+    // completed work by input hash; updated along with the journal under the status mutex
+    const bool journaling = !journalFileName.empty();
+    std::map<std::string, Json::Value> completed;
+    std::ofstream journal;
+    if(journaling){
+      completed = readJournal(journalFileName);
+      journal.open(journalFileName.c_str(), std::ios::out | std::ios::app);
+      if(!journal){
+        ConversionContext::err() << "ERROR: Failed to open journal " << journalFileName << std::endl;
+        throw -1;
+      }
+      ConversionContext::out() << "Journal " << journalFileName << " lists " << completed.size()
+                               << " completed conversions" << std::endl;
+    }
+
+    {
+      // waits for all jobs when going out of scope
+      AsyncConverter converter(numberOfThreads);
+
+      std::string line;
+      size_t lineNumber = 0;
+      while(std::getline(manifest, line)){
+        lineNumber++;
+        if(line.find_first_not_of(" \t\r") == std::string::npos)
+          continue;
+        jobs++;
+
+        Json::Value job;
+        Json::CharReaderBuilder readerBuilder;
+        std::unique_ptr<Json::CharReader> reader(readerBuilder.newCharReader());
+        std::string parseErrors;
+        if(reader->parse(line.data(), line.data() + line.size(), &job, &parseErrors) && job.isObject()){
+          const std::vector<std::string> keys = defaults.getMemberNames();
+          for(size_t i=0;i<keys.size();i++){
+            if(!job.isMember(keys[i]))
+              job[keys[i]] = defaults[keys[i]];
+          }
+          if(!job.isMember("id"))
+            job["id"] = Json::UInt64(lineNumber);
+        }
+
+        if(!isValid(job)){
+          Json::Value jobStatus;
+          jobStatus["id"] = Json::UInt64(lineNumber);
+          jobStatus["success"] = false;
+          jobStatus["outputs"] = Json::Value(Json::arrayValue);
+          jobStatus["log"] = "";
+          jobStatus["errors"] = "ERROR: Invalid job in line " + Helper::toString(unsigned(lineNumber)) + " " + parseErrors;
+          std::lock_guard<std::mutex> lock(statusMutex);
+          status << Json::writeString(writerBuilder, jobStatus) << std::endl;
+          failures++;
+          continue;
+        }
+
+        // input hash and skip decision of the job, set by the conversion
+        std::shared_ptr<std::pair<std::string, bool> > inputHash(new std::pair<std::string, bool>("", false));
+        converter.submit<Json::Value>(
+          [&, job, inputHash]() -> Json::Value {
+            if(journaling){
+              inputHash->first = getInputHash(job);
+              std::lock_guard<std::mutex> lock(statusMutex);
+              std::map<std::string, Json::Value>::const_iterator entry = completed.find(inputHash->first);
+              bool outputsExist = entry != completed.end();
+              for(Json::ArrayIndex i=0;outputsExist && i<entry->second.size();i++)
+                outputsExist = OFStandard::fileExists(entry->second[i].asString().c_str());
+              if(outputsExist){
+                ConversionContext::out() << "Inputs unchanged since the conversion listed in the journal, skipping" << std::endl;
+                inputHash->second = true;
+                return entry->second;
+              }
+            }
+            return run(job);
+          },
+          [&, job, inputHash](AsyncConverter::Result<Json::Value> &result){
+            Json::Value jobStatus = getStatus(job, result);
+            if(inputHash->second)
+              jobStatus["skipped"] = true;
+            std::lock_guard<std::mutex> lock(statusMutex);
+            status << Json::writeString(writerBuilder, jobStatus) << std::endl;
+            if(!result.success)
+              failures++;
+            else if(journaling && !inputHash->second){
+              Json::Value entry;
+              entry["id"] = job["id"];
+              entry["hash"] = inputHash->first;
+              entry["revision"] = QIICR_SOFTWARE_VERSIONS;
+              entry["outputs"] = result.value;
+              // flushed right away, so the entry survives if the process is killed
+              journal << Json::writeString(writerBuilder, entry) << std::endl;
+              completed[inputHash->first] = result.value;
+            }
+          });
+      }
+    }
+
+    if(numberOfJobs)
+      *numberOfJobs = jobs;
+    return failures;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::string ConversionJob::getInputHash(const Json::Value &job) {
+    const std::string type = job.get("type", "").asString();
+    ContentHash hash;
+    hash.update(std::string(QIICR_SOFTWARE_VERSIONS));
+
+    // options and output locations, but not where the inputs are stored
+    Json::Value options = job;
+    const char* inputMembers[] = { "id", "inputDICOM", "inputImage", "inputImageList", "inputMetadata",
+                                   "inputDICOMList", "inputDICOMDirectory" };
+    for(size_t i=0;i<sizeof(inputMembers)/sizeof(inputMembers[0]);i++)
+      options.removeMember(inputMembers[i]);
+    Json::StreamWriterBuilder writerBuilder;
+    writerBuilder["indentation"] = "";
+    hash.update(Json::writeString(writerBuilder, options));
+
+    std::vector<std::string> inputFiles;
+    if(type == "segimage2itkimage" || type == "paramap2itkimage")
+      inputFiles.push_back(getString(job, "inputDICOM"));
+    else {
+      if(type == "itkimage2segimage")
+        inputFiles = getStringList(job, "inputImageList");
+      else
+        inputFiles.push_back(getString(job, "inputImage"));
+      inputFiles.push_back(getString(job, "inputMetadata"));
+    }
+    for(size_t i=0;i<inputFiles.size();i++){
+      if(!hash.updateFromFile(inputFiles[i])){
+        ConversionContext::err() << "ERROR: Failed to read " << inputFiles[i] << std::endl;
+        throw -1;
+      }
+    }
+
+    if(type == "itkimage2segimage" || type == "itkimage2paramap"){
+      // the source images are identified by their UIDs, only the headers are read
+      const std::vector<std::string> sourceFiles = getSourceFiles(job);
+      std::vector<std::string> uids;
+      for(size_t i=0;i<sourceFiles.size();i++){
+        DcmFileFormat sourceFF;
+        OFString uid;
+        if(sourceFF.loadFile(sourceFiles[i].c_str(), EXS_Unknown, EGL_noChange, 4096).good()
+           && sourceFF.getDataset()->findAndGetOFString(DCM_SOPInstanceUID, uid).good())
+          uids.push_back(uid.c_str());
+      }
+      std::sort(uids.begin(), uids.end());
+      uids.erase(std::unique(uids.begin(), uids.end()), uids.end());
+      for(size_t i=0;i<uids.size();i++)
+        hash.update(uids[i]);
+    }
+    return hash.getHexDigest();
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  Json::Value ConversionJob::runSegimage2itkimage(const Json::Value &job) {
+    const std::string inputFileName = getString(job, "inputDICOM");
+    const std::string outputDirName = getString(job, "outputDirectory");
+    const std::string prefix = job.get("prefix", "").asString();
+    const std::string outputType = job.get("outputType", "nrrd").asString();
+    const bool segmentationOutput = outputType == "seg.nrrd";
+    const bool mergeSegments = job.get("mergeSegments", false).asBool() || segmentationOutput;
+    if(!Helper::pathExists(inputFileName) || !Helper::pathExists(outputDirName))
+      throw -1;
+    if(outputType == "npy4d" || outputType == "shm"){
+      ConversionContext::err() << "ERROR: Output type " << outputType << " is not supported for jobs" << std::endl;
+      throw -1;
+    }
+
+    DcmFileFormat segFF;
+    CHECK_COND(segFF.loadFile(inputFileName.c_str()));
+
+    Dicom2ItkConverter converter;
+    std::string metaInfo;
+    OFCondition cond = converter.dcmSegmentation2itkimage(segFF.getDataset(), metaInfo, mergeSegments);
+    CHECK_COND(cond);
+
+    const std::string outputPrefix = outputDirName + "/" + (prefix.empty() ? "" : prefix + "-");
+    const std::string fileExtension = Helper::getFileExtensionFromType(outputType);
+    Json::Value outputs(Json::arrayValue);
+    Json::Value geometry, arrays(Json::arrayValue);
+    if(segmentationOutput){
+      std::vector<Uint16> voxels;
+      size_t numberOfLayers = 0;
+      ShortImageType::Pointer layerGeometry;
+      CHECK_COND(converter.getLayers(voxels, numberOfLayers, layerGeometry));
+      Json::Value metaRoot;
+      std::istringstream metaInfoStream(metaInfo);
+      metaInfoStream >> metaRoot;
+      const std::string fileName = outputPrefix + "segmentation" + fileExtension;
+      if(!NrrdIO::writeSegmentation(layerGeometry, voxels, numberOfLayers, metaRoot["segmentAttributes"], fileName))
+        throw -1;
+      ConversionContext::out() << "Wrote " << fileName << std::endl;
+      outputs.append(fileName);
+    }
+    size_t fileIndex = 1;
+    for(ShortImageType::Pointer image = segmentationOutput ? ShortImageType::Pointer() : converter.begin(); image;
+        image = converter.next(), fileIndex++){
+      std::stringstream fileName;
+      fileName << outputPrefix << fileIndex << fileExtension;
+      if(outputType == "npy"){
+        Json::Value arrayInfo;
+        if(!NumpyIO::writeArray(std::vector<ShortImageType::Pointer>(1, image), fileName.str(), &arrayInfo))
+          throw -1;
+        arrayInfo["fileName"] = fileName.str().substr(outputDirName.size() + 1);
+        arrays.append(arrayInfo);
+        geometry = NumpyIO::getGeometry(image);
+      } else
+        writeImage<ShortImageType>(image, fileName.str());
+      ConversionContext::out() << "Wrote " << fileName.str() << std::endl;
+      outputs.append(fileName.str());
+    }
+    if(outputType == "npy" && !geometry.isNull()){
+      if(!NumpyIO::writeGeometry(geometry, arrays, outputPrefix + "geometry.json"))
+        throw -1;
+      outputs.append(outputPrefix + "geometry.json");
+    }
+
+    std::ofstream metaFile((outputPrefix + "meta.json").c_str());
+    metaFile << metaInfo;
+    outputs.append(outputPrefix + "meta.json");
+    return outputs;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  Json::Value ConversionJob::runParamap2itkimage(const Json::Value &job) {
+    const std::string inputFileName = getString(job, "inputDICOM");
+    const std::string outputDirName = getString(job, "outputDirectory");
+    const std::string prefix = job.get("prefix", "").asString();
+    const std::string outputType = job.get("outputType", "nrrd").asString();
+    if(!Helper::pathExists(inputFileName) || !Helper::pathExists(outputDirName))
+      throw -1;
+
+    DcmFileFormat pmapFF;
+    CHECK_COND(pmapFF.loadFile(inputFileName.c_str()));
+    std::pair<FloatImageType::Pointer, std::string> result = ParaMapConverter::paramap2itkimage(pmapFF.getDataset());
+
+    const std::string outputPrefix = outputDirName + "/" + (prefix.empty() ? "" : prefix + "-");
+    const std::string imageFileName = outputPrefix + "pmap" + Helper::getFileExtensionFromType(outputType);
+    Json::Value outputs(Json::arrayValue);
+    if(outputType == "npy"){
+      Json::Value arrayInfo, arrays(Json::arrayValue);
+      if(!NumpyIO::writeArray(result.first, imageFileName, &arrayInfo))
+        throw -1;
+      arrayInfo["fileName"] = imageFileName.substr(outputDirName.size() + 1);
+      arrays.append(arrayInfo);
+      if(!NumpyIO::writeGeometry(NumpyIO::getGeometry(result.first), arrays, outputPrefix + "geometry.json"))
+        throw -1;
+      outputs.append(outputPrefix + "geometry.json");
+    } else
+      writeImage<FloatImageType>(result.first, imageFileName);
+    ConversionContext::out() << "Wrote " << imageFileName << std::endl;
+
+    std::ofstream metaFile((outputPrefix + "meta.json").c_str());
+    metaFile << result.second;
+
+    outputs.append(imageFileName);
+    outputs.append(outputPrefix + "meta.json");
+    return outputs;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  Json::Value ConversionJob::runItkimage2segimage(const Json::Value &job) {
+    const std::vector<std::string> segImageFiles = getStringList(job, "inputImageList");
+    const std::string metaDataFileName = getString(job, "inputMetadata");
+    const std::string outputFileName = getString(job, "outputDICOM");
+    const std::string segmentationType = job.get("segmentationType", "BINARY").asString();
+    const bool skipEmptySlices = job.get("skip", true).asBool();
+    if(segImageFiles.empty() || !Helper::pathsExist(segImageFiles) || !Helper::pathExists(metaDataFileName))
+      throw -1;
+    if(segmentationType != "BINARY" && segmentationType != "LABELMAP"){
+      ConversionContext::err() << "ERROR: Unsupported segmentationType " << segmentationType << std::endl;
+      throw -1;
+    }
+
+    std::vector<ShortImageType::Pointer> segmentations;
+    for(size_t i=0;i<segImageFiles.size();i++){
+      ShortReaderType::Pointer reader = ShortReaderType::New();
+      reader->SetFileName(segImageFiles[i]);
+      reader->Update();
+      segmentations.push_back(reader->GetOutput());
+    }
+
+    DatasetList sources;
+    sources.datasets = loadSourceDatasets(job);
+    const std::string metadata = readFile(metaDataFileName);
+
+    DcmDataset* result = NULL;
+    if(segmentationType == "LABELMAP")
+      result = Itk2DicomConverter::itkimage2dcmLabelmapSegmentation(sources.datasets, segmentations, metadata, skipEmptySlices);
+    else
+      result = Itk2DicomConverter::itkimage2dcmSegmentation(sources.datasets, segmentations, metadata, skipEmptySlices);
+    if(result == NULL){
+      ConversionContext::err() << "ERROR: Conversion failed." << std::endl;
+      throw -1;
+    }
+    DcmFileFormat segFF(result);
+    delete result;
+    CHECK_COND(segFF.saveFile(outputFileName.c_str(), EXS_LittleEndianExplicit));
+    ConversionContext::out() << "Saved segmentation as " << outputFileName << std::endl;
+
+    Json::Value outputs(Json::arrayValue);
+    outputs.append(outputFileName);
+    return outputs;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  Json::Value ConversionJob::runItkimage2paramap(const Json::Value &job) {
+    const std::string inputFileName = getString(job, "inputImage");
+    const std::string metaDataFileName = getString(job, "inputMetadata");
+    const std::string outputFileName = getString(job, "outputDICOM");
+    if(!Helper::pathExists(inputFileName) || !Helper::pathExists(metaDataFileName))
+      throw -1;
+
+    FloatReaderType::Pointer reader = FloatReaderType::New();
+    reader->SetFileName(inputFileName);
+    reader->Update();
+
+    DatasetList sources;
+    sources.datasets = loadSourceDatasets(job);
+    const std::string metadata = readFile(metaDataFileName);
+
+    DcmDataset* result = ParaMapConverter::itkimage2paramap(reader->GetOutput(), sources.datasets, metadata);
+    if(result == NULL){
+      ConversionContext::err() << "ERROR: Conversion failed." << std::endl;
+      throw -1;
+    }
+    DcmFileFormat pmapFF(result);
+    delete result;
+    CHECK_COND(pmapFF.saveFile(outputFileName.c_str(), EXS_LittleEndianExplicit));
+    ConversionContext::out() << "Saved parametric map as " << outputFileName << std::endl;
+
+    Json::Value outputs(Json::arrayValue);
+    outputs.append(outputFileName);
+    return outputs;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::string ConversionJob::getString(const Json::Value &job, const std::string &key) {
+    if(!job[key].isString() || job[key].asString().empty()){
+      ConversionContext::err() << "ERROR: Job is missing \"" << key << "\"" << std::endl;
+      throw -1;
+    }
+    return job[key].asString();
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::vector<std::string> ConversionJob::getStringList(const Json::Value &job, const std::string &key) {
+    std::vector<std::string> list;
+    if(job[key].isString())
+      list.push_back(job[key].asString());
+    else if(job[key].isArray()){
+      for(Json::ArrayIndex i=0;i<job[key].size();i++)
+        list.push_back(job[key][i].asString());
+    }
+    return list;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::vector<std::string> ConversionJob::getSourceFiles(const Json::Value &job) {
+    std::vector<std::string> dicomImageFiles = getStringList(job, "inputDICOMList");
+    if(job.isMember("inputDICOMDirectory")){
+      const std::string dicomDirectory = job["inputDICOMDirectory"].asString();
+      if(!Helper::pathExists(dicomDirectory))
+        throw -1;
+      std::vector<std::string> dicomFileList = Helper::getFileListRecursively(dicomDirectory);
+      dicomImageFiles.insert(dicomImageFiles.end(), dicomFileList.begin(), dicomFileList.end());
+    }
+    if(!Helper::pathsExist(dicomImageFiles))
+      throw -1;
+    return dicomImageFiles;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::vector<DcmDataset*> ConversionJob::loadSourceDatasets(const Json::Value &job) {
+    std::vector<DcmDataset*> datasets = Helper::loadDatasets(getSourceFiles(job));
+    if(datasets.empty()){
+      ConversionContext::err() << "ERROR: no DICOM could be loaded from the specified list/directory" << std::endl;
+      throw -1;
+    }
+    return datasets;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::map<std::string, Json::Value> ConversionJob::readJournal(const std::string &journalFileName) {
+    std::map<std::string, Json::Value> completed;
+    std::ifstream journal(journalFileName.c_str());
+    std::string line;
+    Json::CharReaderBuilder readerBuilder;
+    std::unique_ptr<Json::CharReader> reader(readerBuilder.newCharReader());
+    while(std::getline(journal, line)){
+      // a line may be truncated if the process was killed while writing it
+      Json::Value entry;
+      if(!reader->parse(line.data(), line.data() + line.size(), &entry, NULL) || !entry.isObject())
+        continue;
+      if(entry.get("revision", "").asString() == QIICR_SOFTWARE_VERSIONS && entry["hash"].isString())
+        completed[entry["hash"].asString()] = entry["outputs"];
+    }
+    return completed;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::string ConversionJob::readFile(const std::string &fileName) {
+    std::ifstream stream(fileName.c_str(), std::ios_base::binary);
+    return std::string((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+  }
+
+}
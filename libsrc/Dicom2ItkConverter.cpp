@@ -5,7 +5,9 @@
 #include "dcmqi/OverlapUtil.h"
 
 // DCMTK includes
+#include <algorithm>
 #include <cstddef>
+#include <dcmtk/dcmdata/dcxfer.h>
 #include <dcmtk/dcmiod/cielabutil.h>
 #include <dcmtk/dcmsr/codes/dcm.h>
 #include <dcmtk/ofstd/ofmem.h>
@@ -27,7 +29,13 @@ Dicom2ItkConverter::Dicom2ItkConverter()
     , m_imageRegion()
     , m_metaInfo()
     , m_groupIterator()
-    , m_overlapUtil() {};
+    , m_overlapUtil()
+    , m_isLabelmap(false)
+    , m_labelmapPixelData8(NULL)
+    , m_labelmapPixelData16(NULL)
+    , m_labelmapRows(0)
+    , m_labelmapColumns(0)
+    , m_labelmapLUT() {};
 
 // -------------------------------------------------------------------------------------
 
@@ -37,13 +45,31 @@ Dicom2ItkConverter::dcmSegmentation2itkimage(DcmDataset* segDataset, std::string
     DcmSegmentation* segdoc = NULL;
 
     // Make sure RLE-compressed images can be decompressed
-    DcmRLEDecoderRegistration::registerCodecs();
-
-    // Load the DICOM segmentation dataset into DcmSegmentation member
-    OFCondition cond = DcmSegmentation::loadDataset(*segDataset, segdoc);
+    ConversionContext::initialize();
+
+    // Label Map Segmentations cannot be loaded by DcmSegmentation directly, so
+    // load a FRACTIONAL-compatible copy instead
+    OFCondition cond;
+    OFString segmentationType;
+    segDataset->findAndGetOFString(DCM_SegmentationType, segmentationType);
+    m_isLabelmap = (segmentationType == "LABELMAP");
+    if (m_isLabelmap)
+    {
+        DcmDataset loadableDataset;
+        cond = prepareLabelmapDataset(*segDataset, loadableDataset);
+        if (cond.good())
+        {
+            cond = DcmSegmentation::loadDataset(loadableDataset, segdoc);
+        }
+    }
+    else
+    {
+        // Load the DICOM segmentation dataset into DcmSegmentation member
+        cond = DcmSegmentation::loadDataset(*segDataset, segdoc);
+    }
     if (!segdoc)
     {
-        cerr << "ERROR: Failed to load segmentation dataset! " << cond.text() << endl;
+        ConversionContext::err() << "ERROR: Failed to load segmentation dataset! " << cond.text() << endl;
         throw -1;
     }
     m_segDoc.reset(segdoc);
@@ -63,19 +89,36 @@ Dicom2ItkConverter::dcmSegmentation2itkimage(DcmDataset* segDataset, std::string
 
 OFCondition Dicom2ItkConverter::dcmSegmentation2itkimage(const bool mergeSegments)
 {
-    // Setup logging (not used so far?)
-    OFLogger dcemfinfLogger = OFLog::getLogger("qiicr.apps");
-    dcemfinfLogger.setLogLevel(dcmtk::log4cplus::OFF_LOG_LEVEL);
-
     // Extract directions, origin, spacing and image region
     OFCondition result = extractBasicSegmentationInfo();
 
-    // Find groups of segments that can go into the same ITK image (i.e. that are non-overlapping)
-    m_overlapUtil.setSegmentationObject(m_segDoc.get());
-    result = getNonOverlappingSegmentGroups(mergeSegments, m_segmentGroups);
-    if (result.bad())
+    if (m_isLabelmap)
     {
-        return result;
+        // Segments of a label map never overlap, so all of them go into a single image
+        OFVector<Uint32> segs;
+        for (size_t i = 1; i <= m_segDoc->getNumberOfSegments(); ++i)
+        {
+            // Labels are stored in signed 16-bit ITK images
+            if (getLabelForSegment(i) > 32767)
+            {
+                ConversionContext::err() << "ERROR: Segment " << i << " would be stored with label " << getLabelForSegment(i)
+                                         << ", but labels above 32767 are not supported" << endl;
+                return EC_IllegalParameter;
+            }
+            segs.push_back(i);
+        }
+        m_segmentGroups.push_back(segs);
+        ConversionContext::out() << "Label map segmentation: Writing " << segs.size() << " segments into a single image" << endl;
+    }
+    else
+    {
+        // Find groups of segments that can go into the same ITK image (i.e. that are non-overlapping)
+        m_overlapUtil.setSegmentationObject(m_segDoc.get());
+        result = getNonOverlappingSegmentGroups(mergeSegments, m_segmentGroups);
+        if (result.bad())
+        {
+            return result;
+        }
     }
 
     // Create JSON meta info for all segments first since this is returned
@@ -111,6 +154,11 @@ itk::SmartPointer<ShortImageType> Dicom2ItkConverter::next()
 
 itk::SmartPointer<ShortImageType> Dicom2ItkConverter::nextResult()
 {
+    if (m_isLabelmap)
+    {
+        return nextLabelmapResult();
+    }
+
     OFCondition result;
     ShortImageType::Pointer itkImage = nullptr;
     if (m_groupIterator != m_segmentGroups.end())
@@ -134,16 +182,16 @@ itk::SmartPointer<ShortImageType> Dicom2ItkConverter::nextResult()
                 result = getITKImageOrigin(framesForSegment[frameIndex], frameOriginPoint);
                 if (result.bad())
                 {
-                    cerr << "ERROR: Failed to get origin for frame " << framesForSegment[frameIndex] << " of segment "
+                    ConversionContext::err() << "ERROR: Failed to get origin for frame " << framesForSegment[frameIndex] << " of segment "
                          << *segNum << endl;
                     m_groupIterator = m_segmentGroups.end();
                     return nullptr;
                 }
                 if (!itkImage->TransformPhysicalPointToIndex(frameOriginPoint, frameOriginIndex))
                 {
-                    cerr << "ERROR: Frame " << framesForSegment[frameIndex] << " origin " << frameOriginPoint
+                    ConversionContext::err() << "ERROR: Frame " << framesForSegment[frameIndex] << " origin " << frameOriginPoint
                          << " is outside image geometry!" << frameOriginIndex << endl;
-                    cerr << "Image size: " << itkImage->GetBufferedRegion().GetSize() << endl;
+                    ConversionContext::err() << "Image size: " << itkImage->GetBufferedRegion().GetSize() << endl;
                     m_groupIterator = m_segmentGroups.end();
                     return nullptr;
                 }
@@ -253,6 +301,297 @@ itk::SmartPointer<ShortImageType> Dicom2ItkConverter::nextResult()
 
 // -------------------------------------------------------------------------------------
 
+OFCondition Dicom2ItkConverter::getLayers(std::vector<Uint16>& voxels, size_t& numberOfLayers,
+                                          ShortImageType::Pointer& geometry)
+{
+    geometry = ShortImageType::New();
+    geometry->SetRegions(m_imageRegion);
+    geometry->SetOrigin(m_imageOrigin);
+    geometry->SetSpacing(m_imageSpacing);
+    geometry->SetDirection(m_direction);
+
+    const size_t frameSize      = m_imageSize[0] * m_imageSize[1];
+    const size_t numberOfVoxels = frameSize * m_imageSize[2];
+    voxels.clear();
+    numberOfLayers = 0;
+
+    if (m_isLabelmap)
+    {
+        // Label maps have a single group, and their frames are not packed
+        ShortImageType::Pointer itkImage = begin();
+        if (!itkImage)
+        {
+            return EC_IllegalCall;
+        }
+        numberOfLayers = 1;
+        const ShortImageType::PixelType* buffer = itkImage->GetBufferPointer();
+        voxels.assign(buffer, buffer + numberOfVoxels);
+        return EC_Normal;
+    }
+    if (m_segDoc->getSegmentationType() != DcmSegTypes::ST_BINARY)
+    {
+        ConversionContext::err() << "ERROR: Only BINARY and LABELMAP segmentations can be stored as layers" << endl;
+        return EC_IllegalParameter;
+    }
+
+    numberOfLayers = m_segmentGroups.size();
+    voxels.assign(numberOfVoxels * numberOfLayers, 0);
+    size_t layer = 0;
+    for (OverlapUtil::SegmentGroups::iterator group = m_segmentGroups.begin(); group != m_segmentGroups.end();
+         ++group, ++layer)
+    {
+        for (auto segNum = group->begin(); segNum != group->end(); ++segNum)
+        {
+            OverlapUtil::FramesForSegment::value_type framesForSegment;
+            m_overlapUtil.getFramesForSegment(*segNum, framesForSegment);
+            for (size_t frameIndex = 0; frameIndex < framesForSegment.size(); frameIndex++)
+            {
+                ShortImageType::PointType frameOriginPoint;
+                ShortImageType::IndexType frameOriginIndex;
+                if (getITKImageOrigin(framesForSegment[frameIndex], frameOriginPoint).bad())
+                {
+                    ConversionContext::err() << "ERROR: Failed to get origin for frame " << framesForSegment[frameIndex]
+                                             << " of segment " << *segNum << endl;
+                    return EC_IllegalCall;
+                }
+                if (!geometry->TransformPhysicalPointToIndex(frameOriginPoint, frameOriginIndex))
+                {
+                    ConversionContext::err() << "ERROR: Frame " << framesForSegment[frameIndex] << " origin "
+                                             << frameOriginPoint << " is outside image geometry!" << frameOriginIndex
+                                             << endl;
+                    return EC_IllegalCall;
+                }
+
+                const DcmIODTypes::Frame* rawFrame      = m_segDoc->getFrame(framesForSegment[frameIndex]);
+                const DcmIODTypes::Frame* unpackedFrame = DcmSegUtils::unpackBinaryFrame(rawFrame,
+                                                                                         m_imageSize[1],  // Rows
+                                                                                         m_imageSize[0]); // Cols
+                if (!unpackedFrame)
+                {
+                    ConversionContext::err() << "ERROR: Failed to unpack frame " << framesForSegment[frameIndex] << endl;
+                    return EC_IllegalCall;
+                }
+                Uint16* slice = &voxels[layer + numberOfLayers * frameSize * frameOriginIndex[2]];
+                for (size_t pixel = 0; pixel < frameSize; pixel++)
+                {
+                    if (unpackedFrame->pixData[pixel] != 0)
+                    {
+                        slice[numberOfLayers * pixel] = *segNum;
+                    }
+                }
+                delete unpackedFrame;
+            }
+        }
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+itk::SmartPointer<ShortImageType> Dicom2ItkConverter::nextLabelmapResult()
+{
+    if (m_groupIterator == m_segmentGroups.end())
+    {
+        return nullptr;
+    }
+    m_groupIterator++;
+
+    ShortImageType::Pointer itkImage = allocateITKImage();
+    ShortImageType::PixelType* buffer = itkImage->GetBufferPointer();
+    const size_t frameSize            = m_imageSize[0] * m_imageSize[1];
+    const size_t numFrames            = m_segDoc->getNumberOfFrames();
+    const Uint16 numSegments          = static_cast<Uint16>(m_segDoc->getNumberOfSegments());
+
+    for (size_t frameNo = 0; frameNo < numFrames; frameNo++)
+    {
+        ShortImageType::PointType frameOriginPoint;
+        ShortImageType::IndexType frameOriginIndex;
+        if (getITKImageOrigin(frameNo, frameOriginPoint).bad())
+        {
+            ConversionContext::err() << "ERROR: Failed to get origin for frame " << frameNo << endl;
+            return nullptr;
+        }
+        if (!itkImage->TransformPhysicalPointToIndex(frameOriginPoint, frameOriginIndex))
+        {
+            ConversionContext::err() << "ERROR: Frame " << frameNo << " origin " << frameOriginPoint
+                 << " is outside image geometry!" << frameOriginIndex << endl;
+            ConversionContext::err() << "Image size: " << itkImage->GetBufferedRegion().GetSize() << endl;
+            return nullptr;
+        }
+
+        // Frames cover a full slice in the same row-major order as the ITK buffer,
+        // so they can be copied without unpacking
+        ShortImageType::PixelType* slice = buffer + frameOriginIndex[2] * frameSize;
+        if (m_labelmapPixelData16)
+        {
+            const Uint16* frameData = m_labelmapPixelData16 + frameNo * frameSize;
+            // Other values could not be mapped to labels, and could exceed the range of the ITK image
+            if (*std::max_element(frameData, frameData + frameSize) > numSegments)
+            {
+                ConversionContext::err() << "ERROR: Frame " << frameNo << " holds values that are not segment numbers" << endl;
+                return nullptr;
+            }
+            if (m_labelmapLUT.empty())
+            {
+                std::copy(frameData, frameData + frameSize, slice);
+            }
+            else
+            {
+                std::transform(frameData, frameData + frameSize, slice,
+                               [this](const Uint16 v) { return getLabelForSegment(v); });
+            }
+        }
+        else
+        {
+            const Uint8* frameData = m_labelmapPixelData8 + frameNo * frameSize;
+            // Other values could not be mapped to labels
+            if (*std::max_element(frameData, frameData + frameSize) > numSegments)
+            {
+                ConversionContext::err() << "ERROR: Frame " << frameNo << " holds values that are not segment numbers" << endl;
+                return nullptr;
+            }
+            if (m_labelmapLUT.empty())
+            {
+                std::copy(frameData, frameData + frameSize, slice);
+            }
+            else
+            {
+                std::transform(frameData, frameData + frameSize, slice,
+                               [this](const Uint8 v) { return getLabelForSegment(v); });
+            }
+        }
+    }
+    return itk::SmartPointer<ShortImageType>(itkImage);
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition Dicom2ItkConverter::prepareLabelmapDataset(DcmDataset& segDataset, DcmDataset& loadableDataset)
+{
+    Uint16 bitsAllocated = 0;
+    Sint32 numFrames     = 0;
+    segDataset.findAndGetUint16(DCM_BitsAllocated, bitsAllocated);
+    segDataset.findAndGetUint16(DCM_Rows, m_labelmapRows);
+    segDataset.findAndGetUint16(DCM_Columns, m_labelmapColumns);
+    segDataset.findAndGetSint32(DCM_NumberOfFrames, numFrames);
+    if ((bitsAllocated != 8) && (bitsAllocated != 16))
+    {
+        ConversionContext::err() << "ERROR: Label map segmentation with " << bitsAllocated << " bits allocated is not supported" << endl;
+        return EC_IllegalParameter;
+    }
+    if (numFrames <= 0)
+    {
+        ConversionContext::err() << "ERROR: Label map segmentation without frames" << endl;
+        return EC_IllegalParameter;
+    }
+
+    // Frames are copied from the pixel data of the dataset itself, which must be uncompressed
+    OFCondition result;
+    if (DcmXfer(segDataset.getOriginalXfer()).isEncapsulated())
+    {
+        result = segDataset.chooseRepresentation(EXS_LittleEndianExplicit, NULL);
+        if (result.bad())
+        {
+            ConversionContext::err() << "ERROR: Failed to decompress label map segmentation: " << result.text() << endl;
+            return result;
+        }
+    }
+    const size_t numPixels = size_t(numFrames) * m_labelmapRows * m_labelmapColumns;
+    unsigned long count    = 0;
+    m_labelmapPixelData8   = NULL;
+    m_labelmapPixelData16  = NULL;
+    if (bitsAllocated == 16)
+    {
+        result = segDataset.findAndGetUint16Array(DCM_PixelData, m_labelmapPixelData16, &count);
+    }
+    else
+    {
+        result = segDataset.findAndGetUint8Array(DCM_PixelData, m_labelmapPixelData8, &count);
+    }
+    if (result.bad() || count < numPixels)
+    {
+        ConversionContext::err() << "ERROR: Failed to get " << bitsAllocated << "-bit pixel data of label map segmentation" << endl;
+        return EC_IllegalCall;
+    }
+
+    // Copy all attributes except the pixel data
+    for (unsigned long i = 0; i < segDataset.card(); i++)
+    {
+        DcmElement* element = segDataset.getElement(i);
+        if (element->getTag() != DCM_PixelData)
+        {
+            result = loadableDataset.insert(OFstatic_cast(DcmElement*, element->clone()), OFTrue /* replace */);
+            if (result.bad())
+                return result;
+        }
+    }
+
+    result = loadableDataset.putAndInsertString(DCM_SOPClassUID, UID_SegmentationStorage);
+    if (result.good())
+        result = loadableDataset.putAndInsertString(DCM_SegmentationType, "FRACTIONAL");
+    if (result.good())
+        result = loadableDataset.putAndInsertString(DCM_SegmentationFractionalType, "PROBABILITY");
+    if (result.good())
+        result = loadableDataset.putAndInsertUint16(DCM_MaximumFractionalValue, 255);
+    if (result.bad())
+        return result;
+
+    // Frames of a FRACTIONAL segmentation must reference a segment; the actual
+    // segment numbers are in the pixel data
+    DcmSequenceOfItems* perFrameSeq = NULL;
+    if (loadableDataset.findAndGetSequence(DCM_PerFrameFunctionalGroupsSequence, perFrameSeq).good() && perFrameSeq)
+    {
+        for (unsigned long i = 0; i < perFrameSeq->card(); i++)
+        {
+            DcmItem* frameItem = perFrameSeq->getItem(i);
+            if (!frameItem->tagExists(DCM_SegmentIdentificationSequence))
+            {
+                DcmItem* segIdItem = NULL;
+                result = frameItem->findOrCreateSequenceItem(DCM_SegmentIdentificationSequence, segIdItem);
+                if (result.good())
+                    result = segIdItem->putAndInsertUint16(DCM_ReferencedSegmentNumber, 1);
+                if (result.bad())
+                    return result;
+            }
+        }
+    }
+
+    // Single pixel 8-bit placeholder frames
+    OFVector<Uint8> placeholder(numFrames, 0);
+    result = loadableDataset.putAndInsertUint16(DCM_Rows, 1);
+    if (result.good())
+        result = loadableDataset.putAndInsertUint16(DCM_Columns, 1);
+    if (result.good())
+        result = loadableDataset.putAndInsertUint16(DCM_BitsAllocated, 8);
+    if (result.good())
+        result = loadableDataset.putAndInsertUint16(DCM_BitsStored, 8);
+    if (result.good())
+        result = loadableDataset.putAndInsertUint16(DCM_HighBit, 7);
+    if (result.good())
+        result = loadableDataset.putAndInsertUint8Array(DCM_PixelData, &placeholder[0], placeholder.size());
+    return result;
+}
+
+// -------------------------------------------------------------------------------------
+
+Uint16 Dicom2ItkConverter::getLabelForSegment(const Uint16 segmentNumber) const
+{
+    if (segmentNumber < m_labelmapLUT.size())
+    {
+        return m_labelmapLUT[segmentNumber];
+    }
+    return segmentNumber;
+}
+
+// -------------------------------------------------------------------------------------
+
+void Dicom2ItkConverter::setLabelmapLookupTable(const OFVector<Uint16>& lut)
+{
+    m_labelmapLUT = lut;
+}
+
+// -------------------------------------------------------------------------------------
+
 void Dicom2ItkConverter::populateMetaInformationFromDICOM(DcmDataset* segDataset)
 {
     OFString creatorName, sessionID, timePointID, seriesDescription, seriesNumber, instanceNumber, bodyPartExamined,
@@ -290,7 +629,7 @@ OFCondition Dicom2ItkConverter::extractBasicSegmentationInfo()
     FGInterface& fgInterface = m_segDoc->getFunctionalGroups();
     if (getImageDirections(fgInterface, m_direction))
     {
-        cerr << "ERROR: Failed to get image directions!" << endl;
+        ConversionContext::err() << "ERROR: Failed to get image directions!" << endl;
         throw -1;
     }
 
@@ -301,7 +640,7 @@ OFCondition Dicom2ItkConverter::extractBasicSegmentationInfo()
     if (computeVolumeExtent(
             fgInterface, m_sliceDirection, m_imageOrigin, m_computedSliceSpacing, m_computedVolumeExtent))
     {
-        cerr << "ERROR: Failed to compute origin and/or slice spacing!" << endl;
+        ConversionContext::err() << "ERROR: Failed to compute origin and/or slice spacing!" << endl;
         throw -1;
     }
 
@@ -309,13 +648,13 @@ OFCondition Dicom2ItkConverter::extractBasicSegmentationInfo()
     m_imageSpacing.Fill(0);
     if (getDeclaredImageSpacing(fgInterface, m_imageSpacing))
     {
-        cerr << "ERROR: Failed to get image spacing from DICOM!" << endl;
+        ConversionContext::err() << "ERROR: Failed to get image spacing from DICOM!" << endl;
         throw -1;
     }
 
     if (!m_imageSpacing[2])
     {
-        cerr << "ERROR: No sufficient information to derive slice spacing! Unable to interpret the data." << endl;
+        ConversionContext::err() << "ERROR: No sufficient information to derive slice spacing! Unable to interpret the data." << endl;
         throw -1;
     }
 
@@ -332,6 +671,12 @@ OFCondition Dicom2ItkConverter::extractBasicSegmentationInfo()
         {
             m_imageSize[0] = value;
         }
+        if (m_isLabelmap)
+        {
+            // the segmentation object only holds placeholder frames
+            m_imageSize[1] = m_labelmapRows;
+            m_imageSize[0] = m_labelmapColumns;
+        }
     }
     // Number of slices should be computed, since segmentation may have empty frames
     m_imageSize[2] = round(m_computedVolumeExtent / m_imageSpacing[2]) + 1;
@@ -353,10 +698,10 @@ OFCondition Dicom2ItkConverter::getNonOverlappingSegmentGroups(const bool mergeS
         result = m_overlapUtil.getNonOverlappingSegments(segmentGroups);
         if (result.bad())
         {
-            cout << "WARNING: Failed to compute non-overlapping segments (Error: " << result.text() << "), "
+            ConversionContext::out() << "WARNING: Failed to compute non-overlapping segments (Error: " << result.text() << "), "
                  << "falling back to one group per segment instead." << endl;
         }
-        cout << "Identified " << segmentGroups.size() << " groups of non-overlapping segments" << endl;
+        ConversionContext::out() << "Identified " << segmentGroups.size() << " groups of non-overlapping segments" << endl;
     }
     // Otherwise, use single group containing all segments (which might overlap)
     if (!mergeSegments || result.bad())
@@ -368,7 +713,7 @@ OFCondition Dicom2ItkConverter::getNonOverlappingSegmentGroups(const bool mergeS
             segs.push_back(i);
             segmentGroups.push_back(segs);
         }
-        cout << "Will not merge segments: Splitting segments into " << segmentGroups.size() << " groups" << endl;
+        ConversionContext::out() << "Will not merge segments: Splitting segments into " << segmentGroups.size() << " groups" << endl;
     }
     return result;
     ;
@@ -441,7 +786,7 @@ OFCondition Dicom2ItkConverter::createMetaInfo()
     }
     if (result.bad())
     {
-        cerr << "ERROR: Failed to create segment metadata: " << result.text() << endl;
+        ConversionContext::err() << "ERROR: Failed to create segment metadata: " << result.text() << endl;
     }
     return result;
 }
@@ -450,12 +795,13 @@ OFCondition Dicom2ItkConverter::createMetaInfo()
 
 OFCondition Dicom2ItkConverter::addSegmentMetadata(const size_t segmentGroup, const Uint16 segmentNumber)
 {
-    SegmentAttributes* segmentAttributes = m_metaInfo.createOrGetSegment(segmentGroup, segmentNumber);
+    const Uint16 labelID                 = m_isLabelmap ? getLabelForSegment(segmentNumber) : segmentNumber;
+    SegmentAttributes* segmentAttributes = m_metaInfo.createOrGetSegment(segmentGroup, labelID);
     // NOTE: Segment numbers in DICOM start with 1
     DcmSegment* segment = m_segDoc->getSegment(segmentNumber);
     if (segment == NULL)
     {
-        cerr << "Failed to get segment for segment ID " << segmentNumber << endl;
+        ConversionContext::err() << "Failed to get segment for segment ID " << segmentNumber << endl;
         return EC_IllegalParameter;
     }
 
@@ -469,7 +815,7 @@ OFCondition Dicom2ItkConverter::addSegmentMetadata(const size_t segmentGroup, co
         ciedcm[0] = 43803;
         ciedcm[1] = 26565;
         ciedcm[2] = 37722;
-        cerr << "Failed to get CIELab values - initializing to default " << ciedcm[0] << "," << ciedcm[1] << ","
+        ConversionContext::err() << "Failed to get CIELab values - initializing to default " << ciedcm[0] << "," << ciedcm[1] << ","
              << ciedcm[2] << endl;
     }
 
@@ -477,14 +823,14 @@ OFCondition Dicom2ItkConverter::addSegmentMetadata(const size_t segmentGroup, co
 
     if (segmentAttributes)
     {
-        segmentAttributes->setLabelID(segmentNumber);
+        segmentAttributes->setLabelID(labelID);
         DcmSegTypes::E_SegmentAlgoType algorithmType = segment->getSegmentAlgorithmType();
         string readableAlgorithmType                 = DcmSegTypes::algoType2OFString(algorithmType).c_str();
         segmentAttributes->setSegmentAlgorithmType(readableAlgorithmType);
 
         if (algorithmType == DcmSegTypes::SAT_UNKNOWN)
         {
-            cerr << "ERROR: AlgorithmType is not valid with value " << readableAlgorithmType << endl;
+            ConversionContext::err() << "ERROR: AlgorithmType is not valid with value " << readableAlgorithmType << endl;
             throw -1;
         }
         if (algorithmType != DcmSegTypes::SAT_MANUAL)
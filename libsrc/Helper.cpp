@@ -4,6 +4,16 @@
 
 // DCMTK includes
 #include <dcmtk/ofstd/oflist.h>
+#include <dcmtk/dcmdata/dcistrmb.h>
+#include <dcmtk/dcmdata/dcostrmb.h>
+
+// STD includes
+#include <cstdio>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 namespace dcmqi {
 
@@ -28,7 +38,7 @@ namespace dcmqi {
   bool Helper::pathExists(const string &path) {
     struct stat buffer;
     if (stat (path.c_str(), &buffer) != 0) {
-      cerr << "Error: " << path << " not found!" << endl;
+      ConversionContext::err() << "Error: " << path << " not found!" << endl;
       return false;
     } else {
       return true;
@@ -49,6 +59,10 @@ namespace dcmqi {
       extension = ".hdr";
     else if (type == "nrrd")
       extension = ".nrrd";
+    else if (type == "seg.nrrd")
+      extension = ".seg.nrrd";
+    else if (type == "npy" || type == "npy4d")
+      extension = ".npy";
     return extension;
   }
 
@@ -58,7 +72,7 @@ namespace dcmqi {
 #if _WIN32
     replace(directory.begin(), directory.end(), '/', PATH_SEPARATOR);
 #endif
-    cout << "Searching recursively " << directory << " for DICOM files" << endl;
+    ConversionContext::out() << "Searching recursively " << directory << " for DICOM files" << endl;
     if(OFStandard::searchDirectoryRecursively(directory.c_str(), fileList)) {
       for(OFListIterator(OFString) fileListIterator=fileList.begin(); fileListIterator!=fileList.end(); fileListIterator++) {
         dicomImageFiles.push_back((*fileListIterator).c_str());
@@ -75,7 +89,7 @@ namespace dcmqi {
       if(sliceFF->loadFile(dicomImageFiles[dcmFileNumber].c_str()).good()){
         DcmDataset* currentDataset = sliceFF->getAndRemoveDataset();
         if(!currentDataset->tagExistsWithValue(DCM_PixelData)){
-          std::cerr << "Source DICOM file does not contain PixelData, skipping: " << std::endl
+          ConversionContext::err() << "Source DICOM file does not contain PixelData, skipping: " << std::endl
              << "  >>>   " << dicomImageFiles[dcmFileNumber] << std::endl;
           continue;
         };
@@ -84,7 +98,7 @@ namespace dcmqi {
         for(size_t i=0;i<dcmDatasets.size();i++) {
           dcmDatasets[i]->findAndGetOFString(DCM_SOPInstanceUID, tmp);
           if (tmp == sopInstanceUID) {
-            cout << dicomImageFiles[dcmFileNumber].c_str() << " with SOPInstanceUID: " << sopInstanceUID
+            ConversionContext::out() << dicomImageFiles[dcmFileNumber].c_str() << " with SOPInstanceUID: " << sopInstanceUID
                  << " already exists" << endl;
             exists = true;
             break;
@@ -94,7 +108,7 @@ namespace dcmqi {
           dcmDatasets.push_back(currentDataset);
         }
       } else {
-        cerr << "Failed to read " << dicomImageFiles[dcmFileNumber] << ". Skipping it." << endl;
+        ConversionContext::err() << "Failed to read " << dicomImageFiles[dcmFileNumber] << ". Skipping it." << endl;
       }
     }
     delete sliceFF;
@@ -102,6 +116,78 @@ namespace dcmqi {
   }
 
 
+  DcmDataset* Helper::loadDatasetFromBuffer(const void* data, size_t size) {
+    DcmInputBufferStream stream;
+    stream.setBuffer(data, OFstatic_cast(offile_off_t, size));
+    stream.setEos();
+
+    DcmFileFormat fileFormat;
+    fileFormat.transferInit();
+    OFCondition cond = fileFormat.read(stream, EXS_Unknown, EGL_noChange, DCM_MaxReadLength);
+    fileFormat.transferEnd();
+    if(cond.bad()){
+      ConversionContext::err() << "Failed to parse DICOM data: " << cond.text() << endl;
+      return NULL;
+    }
+    return fileFormat.getAndRemoveDataset();
+  }
+
+
+  OFCondition Helper::saveDatasetToBuffer(DcmDataset* dataset, vector<char>& bytes) {
+    const E_TransferSyntax xfer = EXS_LittleEndianExplicit;
+    DcmFileFormat fileFormat(dataset);
+    OFCondition cond = fileFormat.validateMetaInfo(xfer);
+    if(cond.bad())
+      return cond;
+
+    // The stream hands out its buffer whenever it is full, until the whole file is written
+    char chunk[65536];
+    DcmOutputBufferStream stream(chunk, sizeof(chunk));
+    bytes.clear();
+    fileFormat.transferInit();
+    bool done = false;
+    while(!done){
+      cond = fileFormat.write(stream, xfer, EET_ExplicitLength, NULL);
+      if(cond.good()){
+        done = true;
+        stream.flush();
+      } else if(cond != EC_StreamNotifyClient) {
+        break;
+      }
+      void* buffer = NULL;
+      offile_off_t length = 0;
+      stream.getBuffer(buffer, length);
+      bytes.insert(bytes.end(), OFstatic_cast(char*, buffer), OFstatic_cast(char*, buffer) + length);
+    }
+    fileFormat.transferEnd();
+    return cond;
+  }
+
+
+  bool Helper::readStandardInput(vector<char>& bytes) {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    bytes.clear();
+    char chunk[65536];
+    size_t count;
+    while((count = fread(chunk, 1, sizeof(chunk), stdin)) > 0)
+      bytes.insert(bytes.end(), chunk, chunk + count);
+    if(ferror(stdin)){
+      ConversionContext::err() << "Failed to read from standard input" << endl;
+      return false;
+    }
+    return true;
+  }
+
+
+  void Helper::setBinaryStandardOutput() {
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+  }
+
+
   string Helper::floatToStr(float f) {
     ostringstream sstream;
     sstream.imbue(std::locale::classic());
@@ -118,7 +204,7 @@ namespace dcmqi {
     FGDerivationImage *derimgfg = OFstatic_cast(FGDerivationImage*, fgInterface.get(0, DcmFGTypes::EFG_DERIVATIONIMAGE,
                                                                                     isPerFrame));
     if(!derimgfg){
-      cout << "Debug: No derivation items present in the segmentation dataset" << endl;
+      ConversionContext::out() << "Debug: No derivation items present in the segmentation dataset" << endl;
     }
     assert(isPerFrame);
 
@@ -129,11 +215,11 @@ namespace dcmqi {
     if(srcitems.size()>0){
       CodeSequenceMacro &code = srcitems[0]->getPurposeOfReferenceCode();
       if (!code.getCodeValue(codeValue).good()) {
-        cout << "Failed to look up purpose of reference code" << endl;
+        ConversionContext::out() << "Failed to look up purpose of reference code" << endl;
         abort();
       }
     } else {
-      cout << "Warning: Source images are not initialized!" << endl;
+      ConversionContext::out() << "Warning: Source images are not initialized!" << endl;
     }
   }
 
@@ -5,8 +5,21 @@
 #include "dcmqi/JSONSegmentationMetaInformationHandler.h"
 
 // DCMTK includes
+#include <dcmtk/dcmdata/dcpixseq.h>
+#include <dcmtk/dcmdata/dcpxitem.h>
+#include <dcmtk/dcmdata/dcrleenc.h>
 #include <dcmtk/dcmsr/codes/dcm.h>
 
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DCMQI_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
 
 
 namespace dcmqi {
@@ -21,24 +34,88 @@ namespace dcmqi {
   DcmDataset* Itk2DicomConverter::itkimage2dcmSegmentation(vector<DcmDataset*> dcmDatasets,
                                                           vector<ShortImageType::Pointer> segmentations,
                                                           const string &metaData,
+                                                          bool skipEmptySlices,
+                                                          bool positionMajor) {
+    // The image buffers are read in place
+    vector<LabelBuffer> labelBuffers;
+    for(size_t segFileNumber=0; segFileNumber<segmentations.size(); segFileNumber++)
+      labelBuffers.push_back(LabelBuffer::fromImage(segmentations[segFileNumber]));
+    return itkimage2dcmSegmentation(dcmDatasets, labelBuffers, metaData, skipEmptySlices, positionMajor);
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  namespace {
+    // Label buffers held by the caller, all of which are valid during the conversion
+    class LabelBufferList : public Itk2DicomConverter::LabelSource {
+    public:
+      explicit LabelBufferList(const vector<Itk2DicomConverter::LabelBuffer> &labelBuffers)
+        : m_labelBuffers(labelBuffers), m_next(0) {}
+
+      size_t getNumberOfVolumes() const { return m_labelBuffers.size(); }
+
+      bool next(Itk2DicomConverter::LabelBuffer &buffer) {
+        buffer = m_labelBuffers[m_next++];
+        return true;
+      }
+
+    private:
+      const vector<Itk2DicomConverter::LabelBuffer> &m_labelBuffers;
+      size_t m_next;
+    };
+  }
+
+  DcmDataset* Itk2DicomConverter::itkimage2dcmSegmentation(vector<DcmDataset*> dcmDatasets,
+                                                          const vector<LabelBuffer> &labelBuffers,
+                                                          const string &metaData,
+                                                          bool skipEmptySlices,
+                                                          bool positionMajor) {
+    LabelBufferList labelSource(labelBuffers);
+    return encodeSegmentation(dcmDatasets, labelSource, metaData, skipEmptySlices, positionMajor);
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  DcmDataset* Itk2DicomConverter::itkimage2dcmSegmentation(vector<DcmDataset*> dcmDatasets,
+                                                          LabelSource &labelSource,
+                                                          const string &metaData,
                                                           bool skipEmptySlices) {
+    return encodeSegmentation(dcmDatasets, labelSource, metaData, skipEmptySlices, false);
+  }
 
-    ShortImageType::SizeType inputSize = segmentations[0]->GetBufferedRegion().GetSize();
+  // -------------------------------------------------------------------------------------
+
+  DcmDataset* Itk2DicomConverter::encodeSegmentation(vector<DcmDataset*> &dcmDatasets,
+                                                    LabelSource &labelSource,
+                                                    const string &metaData,
+                                                    bool skipEmptySlices,
+                                                    bool positionMajor) {
+
+    const size_t numberOfVolumes = labelSource.getNumberOfVolumes();
+    if(numberOfVolumes == 0){
+      ConversionContext::err() << "ERROR: No input segmentations!" << endl;
+      return NULL;
+    }
 
     JSONSegmentationMetaInformationHandler metaInfo(metaData.c_str());
     metaInfo.read();
 
-    if(metaInfo.segmentsAttributesMappingList.size() != segmentations.size()){
-      cerr << "Mismatch between the number of input segmentation files and the size of metainfo list!" << endl;
+    if(metaInfo.segmentsAttributesMappingList.size() != numberOfVolumes){
+      ConversionContext::err() << "Mismatch between the number of input segmentation files and the size of metainfo list!" << endl;
       return NULL;
     };
 
+    // The first volume defines the frame size; the others are checked when they are requested
+    LabelBuffer labelBuffer;
+    if(!labelSource.next(labelBuffer))
+      return NULL;
+    const size_t inputSize[3] = {labelBuffer.size[0], labelBuffer.size[1], labelBuffer.size[2]};
+
     IODGeneralEquipmentModule::EquipmentInfo eq = getEquipmentInfo();
     ContentIdentificationMacro ident = createContentIdentificationInformation(metaInfo);
     CHECK_COND(ident.setInstanceNumber(metaInfo.getInstanceNumber().c_str()));
 
     /* Create new segmentation document */
-    DcmDataset segdocDataset;
     DcmSegmentation *segdoc = NULL;
 
     DcmSegmentation::createBinarySegmentation(
@@ -55,55 +132,30 @@ namespace dcmqi {
     /* Initialize dimension module */
     char dimUID[128];
     dcmGenerateUniqueIdentifier(dimUID, QIICR_UID_ROOT);
+    // The dimension listed first is the one that varies slowest in the frame order
     IODMultiframeDimensionModule &mfdim = segdoc->getDimensions();
+    const unsigned segmentDimension = positionMajor ? 1 : 0;
+    const unsigned positionDimension = positionMajor ? 0 : 1;
+    if(positionMajor)
+      CHECK_COND(mfdim.addDimensionIndex(DCM_ImagePositionPatient, dimUID, DCM_PlanePositionSequence,
+                         DcmTag(DCM_ImagePositionPatient).getTagName()));
     CHECK_COND(mfdim.addDimensionIndex(DCM_ReferencedSegmentNumber, dimUID, DCM_SegmentIdentificationSequence,
                        DcmTag(DCM_ReferencedSegmentNumber).getTagName()));
-    CHECK_COND(mfdim.addDimensionIndex(DCM_ImagePositionPatient, dimUID, DCM_PlanePositionSequence,
-                       DcmTag(DCM_ImagePositionPatient).getTagName()));
+    if(!positionMajor)
+      CHECK_COND(mfdim.addDimensionIndex(DCM_ImagePositionPatient, dimUID, DCM_PlanePositionSequence,
+                         DcmTag(DCM_ImagePositionPatient).getTagName()));
 
     /* Initialize shared functional groups */
     const unsigned frameSize = inputSize[0] * inputSize[1];
 
-    // Shared FGs: PlaneOrientationPatientSequence
-    {
-      ShortImageType::DirectionType labelDirMatrix = segmentations[0]->GetDirection();
-
-      //cout << "Directions: " << labelDirMatrix << endl;
-
-      FGPlaneOrientationPatient *planor =
-          FGPlaneOrientationPatient::createMinimal(
-              Helper::floatToStr(labelDirMatrix[0][0]).c_str(),
-              Helper::floatToStr(labelDirMatrix[1][0]).c_str(),
-              Helper::floatToStr(labelDirMatrix[2][0]).c_str(),
-              Helper::floatToStr(labelDirMatrix[0][1]).c_str(),
-              Helper::floatToStr(labelDirMatrix[1][1]).c_str(),
-              Helper::floatToStr(labelDirMatrix[2][1]).c_str());
-
-      CHECK_COND(segdoc->addForAllFrames(*planor));
-    }
-
-    // Shared FGs: PixelMeasuresSequence
-    {
-      FGPixelMeasures *pixmsr = new FGPixelMeasures();
-
-      ShortImageType::SpacingType labelSpacing = segmentations[0]->GetSpacing();
-      ostringstream spacingSStream;
-      spacingSStream << scientific << labelSpacing[0] << "\\" << labelSpacing[1];
-      CHECK_COND(pixmsr->setPixelSpacing(spacingSStream.str().c_str()));
-
-      spacingSStream.clear(); spacingSStream.str("");
-      spacingSStream << scientific << labelSpacing[2];
-      CHECK_COND(pixmsr->setSpacingBetweenSlices(spacingSStream.str().c_str()));
-      CHECK_COND(pixmsr->setSliceThickness(spacingSStream.str().c_str()));
-      CHECK_COND(segdoc->addForAllFrames(*pixmsr));
-      delete pixmsr;
-    }
+    // Shared FGs: PlaneOrientationPatientSequence, PixelMeasuresSequence
+    addSharedFunctionalGroups(segdoc, getGeometryImage(labelBuffer));
 
 
     // Iterate over the files and labels available in each file, create a segment for each label,
     //  initialize segment frames and add to the document
 
-    OFString seriesInstanceUID, classUID;
+    OFString seriesInstanceUID;
     set<OFString> instanceUIDs;
 
     IODCommonInstanceReferenceModule &commref = segdoc->getCommonInstanceReference();
@@ -116,7 +168,6 @@ namespace dcmqi {
     CHECK_COND(dcmDatasets[0]->findAndGetOFString(DCM_SeriesInstanceUID, seriesInstanceUID));
     CHECK_COND(refseriesItem->setSeriesInstanceUID(seriesInstanceUID));
 
-    int uidfound = 0, uidnotfound = 0;
     Uint8 *frameData = new Uint8[frameSize];
 
     bool hasDerivationImages = false;
@@ -126,367 +177,1465 @@ namespace dcmqi {
     FGDerivationImage* fgder = new FGDerivationImage();
     OFVector<FGBase*> perFrameFGs;
 
-    for(size_t segFileNumber=0; segFileNumber<segmentations.size(); segFileNumber++){
+    // Segments are created first, and their frames are encoded afterwards in the requested order
+    struct FrameInfo {
+      size_t segFileNumber;
+      Uint32 label;
+      Uint16 segmentNumber;
+      unsigned sliceNumber;
+      unsigned firstSlice;
+      bool hasDerivationImages;
+      double position;
+      size_t positionIndex;
+    };
+    vector<FrameInfo> frames;
+    vector<vector<vector<int> > > slice2derimgs(numberOfVolumes);
+    vector<ShortImageType::Pointer> geometries(numberOfVolumes);
+    // With frames ordered by position, all volumes are encoded at the end
+    vector<LabelBuffer> labelBuffers(positionMajor ? numberOfVolumes : 0);
 
-      vector<vector<int> > slice2derimg = getSliceMapForSegmentation2DerivationImage(dcmDatasets, segmentations[segFileNumber]);
-      for(vector<vector<int> >::const_iterator vI=slice2derimg.begin();vI!=slice2derimg.end();++vI)
-        if((*vI).size()>0)
-          hasDerivationImages = true;
+    // Number of the distinct positions along the slice normal, only used with positionMajor
+    vector<double> positions;
+
+    // Adds the frame to the document
+    auto encodeFrame = [&](const FrameInfo& frame, const LabelBuffer& frameBuffer) {
+      const size_t segFileNumber = frame.segFileNumber;
+      const unsigned sliceNumber = frame.sliceNumber;
+      const vector<vector<int> >& slice2derimg = slice2derimgs[segFileNumber];
 
       perFrameFGs.clear();
       perFrameFGs.push_back(fgppp);
       perFrameFGs.push_back(fgfc);
-      if(hasDerivationImages)
+      if(frame.hasDerivationImages)
         perFrameFGs.push_back(fgder);
 
-      //cout << "Processing input label " << segmentations[segFileNumber] << endl;
+      // PerFrame FG: FrameContentSequence
+      //fracon->setStackID("1"); // all frames go into the same stack
+      CHECK_COND(fgfc->setDimensionIndexValues(frame.segmentNumber, segmentDimension));
+      if(positionMajor)
+        CHECK_COND(fgfc->setDimensionIndexValues(frame.positionIndex+1, positionDimension));
+      else
+        CHECK_COND(fgfc->setDimensionIndexValues(sliceNumber-frame.firstSlice+1, positionDimension));
+      //ostringstream inStackPosSStream; // StackID is not present/needed
+      //inStackPosSStream << s+1;
+      //fracon->setInStackPositionNumber(s+1);
 
-      LabelToLabelMapFilterType::Pointer l2lm = LabelToLabelMapFilterType::New();
-      l2lm->SetInput(segmentations[segFileNumber]);
-      l2lm->Update();
+      // PerFrame FG: PlanePositionSequence
+      setPlanePosition(fgppp, geometries[segFileNumber], sliceNumber);
 
-      typedef LabelToLabelMapFilterType::OutputImageType::LabelObjectType LabelType;
-      typedef itk::LabelStatisticsImageFilter<ShortImageType,ShortImageType> LabelStatisticsType;
+      /* Add frame that references this segment */
+      {
+        getLabelFrame(frameBuffer, sliceNumber, frame.label, frameData);
 
-      LabelStatisticsType::Pointer labelStats = LabelStatisticsType::New();
+        /*
+        if(sliceNumber>=dcmDatasets.size()){
+          ConversionContext::err() << "ERROR: trying to access missing DICOM Slice! And sorry, multi-frame not supported at the moment..." << endl;
+          return NULL;
+        }*/
 
-      cout << "Found " << l2lm->GetOutput()->GetNumberOfLabelObjects() << " label(s)" << endl;
-      labelStats->SetInput(segmentations[segFileNumber]);
-      labelStats->SetLabelInput(segmentations[segFileNumber]);
-      labelStats->Update();
+        OFVector<DcmDataset*> siVector;
+        for(size_t derImageInstanceNum=0;
+            derImageInstanceNum<slice2derimg[sliceNumber].size();
+            derImageInstanceNum++){
+          siVector.push_back(dcmDatasets[slice2derimg[sliceNumber][derImageInstanceNum]]);
+        }
+
+        if(siVector.size()>0){
+          addDerivationImageReferences(fgder, siVector, refinstances, instanceUIDs);
+        }
+
+        CHECK_COND(segdoc->addFrame(frameData, frame.segmentNumber, perFrameFGs));
 
-      bool cropSegmentsBBox = false;
-      if(cropSegmentsBBox){
-        cout << "WARNING: Crop operation enabled - WIP" << endl;
-        typedef itk::BinaryThresholdImageFilter<ShortImageType,ShortImageType> ThresholdType;
-        ThresholdType::Pointer thresh = ThresholdType::New();
-        thresh->SetInput(segmentations[segFileNumber]);
-        thresh->SetLowerThreshold(1);
-        thresh->SetLowerThreshold(100);
-        thresh->SetInsideValue(1);
-        thresh->Update();
+        // remove derivation image FG from the per-frame FGs, only if applicable!
+        if(siVector.size()>0){
+          // clean up for the next frame
+          fgder->clearData();
+        }
+      }
+    };
 
-        LabelStatisticsType::Pointer threshLabelStats = LabelStatisticsType::New();
+    for(size_t segFileNumber=0; segFileNumber<numberOfVolumes; segFileNumber++){
 
-        threshLabelStats->SetInput(thresh->GetOutput());
-        threshLabelStats->SetLabelInput(thresh->GetOutput());
-        threshLabelStats->Update();
+      if(segFileNumber > 0){
+        if(!labelSource.next(labelBuffer))
+          return NULL;
+        // All frames share the same number of rows and columns
+        if(labelBuffer.size[0] != inputSize[0] || labelBuffer.size[1] != inputSize[1]){
+          ConversionContext::err() << "ERROR: In-plane dimensions of segmentations are inconsistent!" << endl;
+          return NULL;
+        }
+      }
 
-        LabelStatisticsType::BoundingBoxType threshBbox = threshLabelStats->GetBoundingBox(1);
-        /*
-        cout << "OVerall bounding box: " << threshBbox[0] << ", " << threshBbox[1]
-               << threshBbox[2] << ", " << threshBbox[3]
-               << threshBbox[4] << ", " << threshBbox[5]
-               << endl;
-               */
+      geometries[segFileNumber] = getGeometryImage(labelBuffer);
+      vector<vector<int> >& slice2derimg = slice2derimgs[segFileNumber];
+      slice2derimg = getSliceMapForSegmentation2DerivationImage(dcmDatasets, geometries[segFileNumber]);
+      for(vector<vector<int> >::const_iterator vI=slice2derimg.begin();vI!=slice2derimg.end();++vI)
+        if((*vI).size()>0)
+          hasDerivationImages = true;
+
+      // Position of the slices along the slice normal
+      ShortImageType::DirectionType direction = geometries[segFileNumber]->GetDirection();
+      const double normal[3] = {direction[1][0]*direction[2][1]-direction[2][0]*direction[1][1],
+                                direction[2][0]*direction[0][1]-direction[0][0]*direction[2][1],
+                                direction[0][0]*direction[1][1]-direction[1][0]*direction[0][1]};
+
+      LabelExtents labelExtents;
+      if(!getLabelExtents(labelBuffer, labelExtents)){
+        ConversionContext::err() << "ERROR: Negative label values are not supported!" << endl;
         return NULL;
       }
 
-      for(unsigned segLabelNumber=0 ; segLabelNumber<l2lm->GetOutput()->GetNumberOfLabelObjects();segLabelNumber++){
-        LabelType* labelObject = l2lm->GetOutput()->GetNthLabelObject(segLabelNumber);
-        short label = labelObject->GetLabel();
+      ConversionContext::out() << "Found " << labelExtents.size() << " label(s)" << endl;
 
-        if(!label){
-          continue;
-        }
+      for(LabelExtents::const_iterator labelIt=labelExtents.begin(); labelIt!=labelExtents.end(); ++labelIt){
+        const Uint32 label = labelIt->first;
 
-        cout << "Processing label " << label << endl;
+        ConversionContext::out() << "Processing label " << label << endl;
 
-        LabelStatisticsType::BoundingBoxType bbox = labelStats->GetBoundingBox(label);
         unsigned firstSlice, lastSlice;
         //bool skipEmptySlices = true; // TODO: what to do with that line?
         //bool skipEmptySlices = false; // TODO: what to do with that line?
         if(skipEmptySlices){
-          firstSlice = bbox[4];
-          lastSlice = bbox[5]+1;
+          firstSlice = labelIt->second.first;
+          lastSlice = labelIt->second.second;
         } else {
           firstSlice = 0;
           lastSlice = inputSize[2];
         }
 
-        cout << "Total non-empty slices that will be encoded in SEG for label " <<
+        ConversionContext::out() << "Total non-empty slices that will be encoded in SEG for label " <<
         label << " is " << lastSlice-firstSlice << endl <<
         " (inclusive from " << firstSlice << " to " <<
         lastSlice << ")" << endl;
 
-        DcmSegment* segment = NULL;
         if(metaInfo.segmentsAttributesMappingList[segFileNumber].find(label) == metaInfo.segmentsAttributesMappingList[segFileNumber].end()){
-          cerr << "ERROR: Failed to match label from image to the segment metadata!" << endl;
+          ConversionContext::err() << "ERROR: Failed to match label from image to the segment metadata!" << endl;
           return NULL;
         }
 
         SegmentAttributes* segmentAttributes = metaInfo.segmentsAttributesMappingList[segFileNumber][label];
 
-        DcmSegTypes::E_SegmentAlgoType algoType = DcmSegTypes::SAT_UNKNOWN;
-        string algoName = "";
-        string algoTypeStr = segmentAttributes->getSegmentAlgorithmType();
-        if(algoTypeStr == "MANUAL"){
-          algoType = DcmSegTypes::SAT_MANUAL;
-        } else {
-          if(algoTypeStr == "AUTOMATIC")
-            algoType = DcmSegTypes::SAT_AUTOMATIC;
-          if(algoTypeStr == "SEMIAUTOMATIC")
-            algoType = DcmSegTypes::SAT_SEMIAUTOMATIC;
-
-          algoName = segmentAttributes->getSegmentAlgorithmName();
-          if(algoName == ""){
-            cerr << "ERROR: Algorithm name must be specified for non-manual algorithm types!" << endl;
-            return NULL;
-          }
-        }
-
-        CodeSequenceMacro* typeCode = segmentAttributes->getSegmentedPropertyTypeCodeSequence();
-        CodeSequenceMacro* categoryCode = segmentAttributes->getSegmentedPropertyCategoryCodeSequence();
-        assert(typeCode != NULL && categoryCode!= NULL);
-        OFString segmentLabel;
+        DcmSegment* segment = createSegment(segmentAttributes);
+        if(segment == NULL)
+          return NULL;
 
-        if(segmentAttributes->getSegmentLabel().length() > 0){
-          cout << "Populating segment label to " << segmentAttributes->getSegmentLabel() << endl;
-          segmentLabel = segmentAttributes->getSegmentLabel().c_str();
-        } else
-          CHECK_COND(typeCode->getCodeMeaning(segmentLabel));
+        Uint16 segmentNumber;
+        CHECK_COND(segdoc->addSegment(segment, segmentNumber /* returns logical segment number */));
 
-        CHECK_COND(DcmSegment::create(segment, segmentLabel, *categoryCode, *typeCode, algoType, algoName.c_str()));
+        for(unsigned sliceNumber=firstSlice;sliceNumber<lastSlice;sliceNumber++){
+          ShortImageType::IndexType sliceIndex;
+          sliceIndex[0] = 0;
+          sliceIndex[1] = 0;
+          sliceIndex[2] = sliceNumber;
+          ShortImageType::PointType slicePoint;
+          geometries[segFileNumber]->TransformIndexToPhysicalPoint(sliceIndex, slicePoint);
+          FrameInfo frame = {segFileNumber, label, segmentNumber, sliceNumber, firstSlice, hasDerivationImages,
+                             slicePoint[0]*normal[0]+slicePoint[1]*normal[1]+slicePoint[2]*normal[2], 0};
+          frames.push_back(frame);
+        }
+      }
 
-        if(segmentAttributes->getSegmentDescription().length() > 0)
-          segment->setSegmentDescription(segmentAttributes->getSegmentDescription().c_str());
+      if(positionMajor)
+        labelBuffers[segFileNumber] = labelBuffer;
+      else {
+        // Frames ordered by segment are complete for this volume, which is not needed anymore
+        for(size_t frameNumber=0;frameNumber<frames.size();frameNumber++)
+          encodeFrame(frames[frameNumber], labelBuffer);
+        frames.clear();
+      }
+    }
 
-        if(segmentAttributes->getTrackingIdentifier().length() > 0)
-          segment->setTrackingID(segmentAttributes->getTrackingIdentifier().c_str());
+    if(positionMajor){
+      // Number the distinct positions along the slice normal; positions closer than 1 micrometer are the same
+      for(size_t i=0;i<frames.size();i++)
+        positions.push_back(frames[i].position);
+      std::sort(positions.begin(), positions.end());
+      positions.erase(std::unique(positions.begin(), positions.end(),
+                                  [](double a, double b){ return b - a < 1e-3; }), positions.end());
+
+      for(size_t i=0;i<frames.size();i++)
+        frames[i].positionIndex = std::lower_bound(positions.begin(), positions.end(), frames[i].position - 1e-3)
+                                  - positions.begin();
+
+      // Co-located frames become contiguous, in the order of their segments
+      std::sort(frames.begin(), frames.end(), [](const FrameInfo& a, const FrameInfo& b){
+        if(a.positionIndex != b.positionIndex)
+          return a.positionIndex < b.positionIndex;
+        return a.segmentNumber < b.segmentNumber;
+      });
+
+      for(size_t frameNumber=0;frameNumber<frames.size();frameNumber++)
+        encodeFrame(frames[frameNumber], labelBuffers[frames[frameNumber].segFileNumber]);
+    }
 
-        if(segmentAttributes->getTrackingUniqueIdentifier().length() > 0)
-          segment->setTrackingUID(segmentAttributes->getTrackingUniqueIdentifier().c_str());
+    // add ReferencedSeriesItem only if it is not empty
+    if(refinstances.size())
+      refseries.push_back(refseriesItem);
 
-        CodeSequenceMacro* typeModifierCode = segmentAttributes->getSegmentedPropertyTypeModifierCodeSequence();
-        if (typeModifierCode != NULL) {
-          OFVector<CodeSequenceMacro*>& modifiersVector = segment->getSegmentedPropertyTypeModifierCode();
-          modifiersVector.push_back(typeModifierCode);
-        }
+    delete fgfc;
+    delete fgppp;
+    delete fgder;
+    delete[] frameData;
 
-        GeneralAnatomyMacro &anatomyMacro = segment->getGeneralAnatomyCode();
-        if (segmentAttributes->getAnatomicRegionSequence() != NULL){
-          OFVector<CodeSequenceMacro*>& anatomyMacroModifiersVector = anatomyMacro.getAnatomicRegionModifier();
-          CodeSequenceMacro& anatomicRegionSequence = anatomyMacro.getAnatomicRegion();
-          anatomicRegionSequence = *segmentAttributes->getAnatomicRegionSequence();
+    string segmentsOverlap;
+    if(numberOfVolumes == 1)
+      segmentsOverlap = "NO";
+    else
+      segmentsOverlap = "UNDEFINED";
 
-          if(segmentAttributes->getAnatomicRegionModifierSequence() != NULL){
-            CodeSequenceMacro* anatomicRegionModifierSequence = segmentAttributes->getAnatomicRegionModifierSequence();
-            anatomyMacroModifiersVector.push_back(anatomicRegionModifierSequence);
-          }
-        }
+    return writeSegmentationDataset(segdoc, metaInfo, dcmDatasets, segmentsOverlap);
+  }
 
-        unsigned* rgb = segmentAttributes->getRecommendedDisplayRGBValue();
-        int cielab[3];
+  // -------------------------------------------------------------------------------------
 
-        ColorUtilities::getIntegerScaledCIELabPCSFromSRGB(cielab[0], cielab[1], cielab[2], rgb[0], rgb[1], rgb[2]);
-        //IODCIELabUtil::rgb2DicomLab(cielab[0], cielab[1], cielab[2], rgb[0], rgb[1], rgb[2]);
+  Itk2DicomConverter::LabelBuffer::LabelBuffer()
+    : data(NULL), dataType(INT16) {
+    for(int i=0;i<3;i++){
+      size[i] = 0;
+      strides[i] = 0;
+      spacing[i] = 1.;
+      origin[i] = 0.;
+      for(int j=0;j<3;j++)
+        direction[3*i+j] = i == j ? 1. : 0.;
+    }
+  }
 
-        CHECK_COND(segment->setRecommendedDisplayCIELabValue(cielab[0],cielab[1],cielab[2]));
+  // -------------------------------------------------------------------------------------
 
-        Uint16 segmentNumber;
-        CHECK_COND(segdoc->addSegment(segment, segmentNumber /* returns logical segment number */));
+  Itk2DicomConverter::LabelBuffer Itk2DicomConverter::LabelBuffer::fromImage(const ShortImageType::Pointer &image) {
+    LabelBuffer buffer;
+    buffer.data = image->GetBufferPointer();
+    buffer.dataType = INT16;
+    ShortImageType::SizeType imageSize = image->GetBufferedRegion().GetSize();
+    ptrdiff_t stride = sizeof(ShortPixelType);
+    for(int i=0;i<3;i++){
+      buffer.size[i] = imageSize[i];
+      buffer.strides[i] = stride;
+      stride *= imageSize[i];
+      buffer.spacing[i] = image->GetSpacing()[i];
+      buffer.origin[i] = image->GetOrigin()[i];
+      for(int j=0;j<3;j++)
+        buffer.direction[3*i+j] = image->GetDirection()[i][j];
+    }
+    return buffer;
+  }
 
-        // TODO: make it possible to skip empty frames (optional)
-        // iterate over slices for an individual label and populate output frames
-        for(unsigned sliceNumber=firstSlice;sliceNumber<lastSlice;sliceNumber++){
+  // -------------------------------------------------------------------------------------
 
-          // PerFrame FG: FrameContentSequence
-          //fracon->setStackID("1"); // all frames go into the same stack
-          CHECK_COND(fgfc->setDimensionIndexValues(segmentNumber, 0));
-          CHECK_COND(fgfc->setDimensionIndexValues(sliceNumber-firstSlice+1, 1));
-          //ostringstream inStackPosSStream; // StackID is not present/needed
-          //inStackPosSStream << s+1;
-          //fracon->setInStackPositionNumber(s+1);
-
-          // PerFrame FG: PlanePositionSequence
-          {
-            ShortImageType::PointType sliceOriginPoint;
-            ShortImageType::IndexType sliceOriginIndex;
-            sliceOriginIndex.Fill(0);
-            sliceOriginIndex[2] = sliceNumber;
-            segmentations[segFileNumber]->TransformIndexToPhysicalPoint(sliceOriginIndex, sliceOriginPoint);
-            ostringstream pppSStream;
-            if(sliceNumber>0){
-              ShortImageType::PointType prevOrigin;
-              ShortImageType::IndexType prevIndex;
-              prevIndex.Fill(0);
-              prevIndex[2] = sliceNumber-1;
-              segmentations[segFileNumber]->TransformIndexToPhysicalPoint(prevIndex, prevOrigin);
-            }
-            fgppp->setImagePositionPatient(
-                Helper::floatToStr(sliceOriginPoint[0]).c_str(),
-                Helper::floatToStr(sliceOriginPoint[1]).c_str(),
-                Helper::floatToStr(sliceOriginPoint[2]).c_str());
-          }
+  ShortImageType::Pointer Itk2DicomConverter::getGeometryImage(const LabelBuffer &buffer) {
+    ShortImageType::Pointer image = ShortImageType::New();
+    ShortImageType::RegionType region;
+    ShortImageType::SizeType size;
+    ShortImageType::PointType origin;
+    ShortImageType::SpacingType spacing;
+    ShortImageType::DirectionType direction;
+    for(int i=0;i<3;i++){
+      size[i] = buffer.size[i];
+      origin[i] = buffer.origin[i];
+      spacing[i] = buffer.spacing[i];
+      for(int j=0;j<3;j++)
+        direction[i][j] = buffer.direction[3*i+j];
+    }
+    region.SetSize(size);
+    image->SetRegions(region);
+    image->SetOrigin(origin);
+    image->SetSpacing(spacing);
+    image->SetDirection(direction);
+    return image;
+  }
 
-          /* Add frame that references this segment */
-          {
-            ShortImageType::RegionType sliceRegion;
-            ShortImageType::IndexType sliceIndex;
-            ShortImageType::SizeType sliceSize;
-
-            sliceIndex[0] = 0;
-            sliceIndex[1] = 0;
-            sliceIndex[2] = sliceNumber;
-
-            sliceSize[0] = inputSize[0];
-            sliceSize[1] = inputSize[1];
-            sliceSize[2] = 1;
-
-            sliceRegion.SetIndex(sliceIndex);
-            sliceRegion.SetSize(sliceSize);
-
-            unsigned framePixelCnt = 0;
-            itk::ImageRegionConstIteratorWithIndex<ShortImageType> sliceIterator(segmentations[segFileNumber], sliceRegion);
-            for(sliceIterator.GoToBegin();!sliceIterator.IsAtEnd();++sliceIterator,++framePixelCnt){
-              if(sliceIterator.Get() == label){
-                frameData[framePixelCnt] = 1;
-                ShortImageType::IndexType idx = sliceIterator.GetIndex();
-                //cout << framePixelCnt << " " << idx[1] << "," << idx[0] << endl;
-              } else
-                frameData[framePixelCnt] = 0;
-            }
+  // -------------------------------------------------------------------------------------
 
-            /*
-            if(sliceNumber>=dcmDatasets.size()){
-              cerr << "ERROR: trying to access missing DICOM Slice! And sorry, multi-frame not supported at the moment..." << endl;
-              return NULL;
-            }*/
+  template<typename T>
+  bool Itk2DicomConverter::getLabelExtents(const LabelBuffer &buffer, LabelExtents &extents) {
+    const char* base = static_cast<const char*>(buffer.data);
+    for(size_t z=0;z<buffer.size[2];z++){
+      // Neighboring voxels mostly share their label, which saves most of the lookups
+      T previous = 0;
+      for(size_t y=0;y<buffer.size[1];y++){
+        const char* row = base + z*buffer.strides[2] + y*buffer.strides[1];
+        for(size_t x=0;x<buffer.size[0];x++){
+          T value;
+          memcpy(&value, row + x*buffer.strides[0], sizeof(T));
+          if(value == previous)
+            continue;
+          previous = value;
+          if(!value)
+            continue;
+          if(static_cast<long long>(value) < 0)
+            return false;
+          LabelExtents::iterator extent = extents.find(static_cast<Uint32>(value));
+          if(extent == extents.end())
+            extents[static_cast<Uint32>(value)] = make_pair(unsigned(z), unsigned(z+1));
+          else
+            extent->second.second = unsigned(z+1);
+        }
+      }
+    }
+    return true;
+  }
 
-            OFVector<DcmDataset*> siVector;
-            for(size_t derImageInstanceNum=0;
-                derImageInstanceNum<slice2derimg[sliceNumber].size();
-                derImageInstanceNum++){
-              siVector.push_back(dcmDatasets[slice2derimg[sliceNumber][derImageInstanceNum]]);
-            }
+  // -------------------------------------------------------------------------------------
 
-            if(siVector.size()>0){
-
-              DerivationImageItem *derimgItem;
-			  DSRBasicCodedEntry code_seg=CODE_DCM_Segmentation_113076;
-              CHECK_COND(fgder->addDerivationImageItem(CodeSequenceMacro(code_seg.CodeValue,code_seg.CodingSchemeDesignator,
-				  code_seg.CodeMeaning),"",derimgItem));
-
-              //cout << "Total of " << siVector.size() << " source image items will be added" << endl;
-			  DSRBasicCodedEntry code = CODE_DCM_SourceImageForImageProcessingOperation;
-              OFVector<SourceImageItem*> srcimgItems;
-              cout << "Added source image item" << endl;
-              CHECK_COND(derimgItem->addSourceImageItems(siVector,
-                                                       CodeSequenceMacro(code.CodeValue, code.CodingSchemeDesignator,
-														   code.CodeMeaning),
-                                                       srcimgItems));
-
-              if(1){
-                // initialize class UID and series instance UID
-                ImageSOPInstanceReferenceMacro &instRef = srcimgItems[0]->getImageSOPInstanceReference();
-                OFString instanceUID;
-                CHECK_COND(instRef.getReferencedSOPClassUID(classUID));
-                CHECK_COND(instRef.getReferencedSOPInstanceUID(instanceUID));
-
-                if(instanceUIDs.find(instanceUID) == instanceUIDs.end()){
-                  SOPInstanceReferenceMacro *refinstancesItem = new SOPInstanceReferenceMacro();
-                  CHECK_COND(refinstancesItem->setReferencedSOPClassUID(classUID));
-                  CHECK_COND(refinstancesItem->setReferencedSOPInstanceUID(instanceUID));
-                  refinstances.push_back(refinstancesItem);
-                  instanceUIDs.insert(instanceUID);
-                  uidnotfound++;
-                } else {
-                  uidfound++;
-                }
-              }
-            }
+  bool Itk2DicomConverter::getLabelExtents(const LabelBuffer &buffer, LabelExtents &extents) {
+    switch(buffer.dataType){
+      case LabelBuffer::UINT8: return getLabelExtents<Uint8>(buffer, extents);
+      case LabelBuffer::UINT16: return getLabelExtents<Uint16>(buffer, extents);
+      case LabelBuffer::INT16: return getLabelExtents<Sint16>(buffer, extents);
+      case LabelBuffer::UINT32: return getLabelExtents<Uint32>(buffer, extents);
+    }
+    return false;
+  }
 
-            CHECK_COND(segdoc->addFrame(frameData, segmentNumber, perFrameFGs));
+  // -------------------------------------------------------------------------------------
 
-            // remove derivation image FG from the per-frame FGs, only if applicable!
-            if(siVector.size()>0){
-              // clean up for the next frame
-              fgder->clearData();
-            }
-          }
-        }
+  template<typename T>
+  void Itk2DicomConverter::getLabelFrame(const LabelBuffer &buffer, unsigned sliceNumber, Uint32 label,
+                                         Uint8* frameData) {
+    const char* slice = static_cast<const char*>(buffer.data) + sliceNumber*buffer.strides[2];
+    const T labelValue = static_cast<T>(label);
+    for(size_t y=0;y<buffer.size[1];y++){
+      const char* row = slice + y*buffer.strides[1];
+      Uint8* frameRow = frameData + y*buffer.size[0];
+      for(size_t x=0;x<buffer.size[0];x++){
+        T value;
+        memcpy(&value, row + x*buffer.strides[0], sizeof(T));
+        frameRow[x] = value == labelValue ? 1 : 0;
       }
     }
+  }
 
-    // add ReferencedSeriesItem only if it is not empty
-    if(refinstances.size())
-      refseries.push_back(refseriesItem);
+  // -------------------------------------------------------------------------------------
 
-    delete fgfc;
-    delete fgppp;
-    delete fgder;
+  void Itk2DicomConverter::getLabelFrame(const LabelBuffer &buffer, unsigned sliceNumber, Uint32 label,
+                                         Uint8* frameData) {
+    switch(buffer.dataType){
+      case LabelBuffer::UINT8: getLabelFrame<Uint8>(buffer, sliceNumber, label, frameData); break;
+      case LabelBuffer::UINT16: getLabelFrame<Uint16>(buffer, sliceNumber, label, frameData); break;
+      case LabelBuffer::INT16: getLabelFrame<Sint16>(buffer, sliceNumber, label, frameData); break;
+      case LabelBuffer::UINT32: getLabelFrame<Uint32>(buffer, sliceNumber, label, frameData); break;
+    }
+  }
 
-    segdoc->getSeries().setSeriesNumber(metaInfo.getSeriesNumber().c_str());
+  // -------------------------------------------------------------------------------------
 
-    OFString frameOfRefUID;
-    if(!segdoc->getFrameOfReference().getFrameOfReferenceUID(frameOfRefUID).good()){
-      // TODO: add FoR UID to the metadata JSON and check that before generating one!
-      char frameOfRefUIDchar[128];
-      dcmGenerateUniqueIdentifier(frameOfRefUIDchar, QIICR_UID_ROOT);
-      CHECK_COND(segdoc->getFrameOfReference().setFrameOfReferenceUID(frameOfRefUIDchar));
-    }
+  DcmDataset* Itk2DicomConverter::itkimage2dcmLabelmapSegmentation(vector<DcmDataset*> dcmDatasets,
+                                                                  vector<ShortImageType::Pointer> segmentations,
+                                                                  const string &metaData,
+                                                                  bool skipEmptySlices) {
 
-    std::cout << "Writing DICOM segmentation dataset " << std::endl;
-    // Don't check functional groups since its very time consuming and we trust
-    // ourselves to put together valid datasets
-    segdoc->setCheckFGOnWrite(OFFalse);
-    OFCondition writeResult = segdoc->writeDataset(segdocDataset);
-    if(writeResult.bad()){
-      cerr << "FATAL ERROR: Writing of the SEG dataset failed!";
-      if (writeResult.text()){
-        cerr << " Error: " << writeResult.text() << ".";
-      }
-      cerr << " Please report the problem to the developers, ideally accompanied by a de-identified dataset allowing to reproduce the problem!" << endl;
+    ShortImageType::SizeType inputSize = segmentations[0]->GetBufferedRegion().GetSize();
+
+    JSONSegmentationMetaInformationHandler metaInfo(metaData.c_str());
+    metaInfo.read();
+
+    if(metaInfo.segmentsAttributesMappingList.size() != segmentations.size()){
+      ConversionContext::err() << "Mismatch between the number of input segmentation files and the size of metainfo list!" << endl;
       return NULL;
+    };
+
+    // All inputs are combined into a single label volume, so their geometry must be identical
+    for(size_t segFileNumber=1; segFileNumber<segmentations.size(); segFileNumber++){
+      if(segmentations[segFileNumber]->GetBufferedRegion() != segmentations[0]->GetBufferedRegion()
+         || segmentations[segFileNumber]->GetOrigin() != segmentations[0]->GetOrigin()
+         || segmentations[segFileNumber]->GetSpacing() != segmentations[0]->GetSpacing()
+         || segmentations[segFileNumber]->GetDirection() != segmentations[0]->GetDirection()){
+        ConversionContext::err() << "ERROR: Label map segmentation requires all input images to share the same geometry!" << endl;
+        return NULL;
+      }
     }
 
-    // Set reader/session/timepoint information
-    std::cout << "Patching in extra meta information into DICOM dataset" << std::endl;
-    CHECK_COND(segdocDataset.putAndInsertString(DCM_SeriesDescription, metaInfo.getSeriesDescription().c_str()));
-    CHECK_COND(segdocDataset.putAndInsertString(DCM_ContentCreatorName, metaInfo.getContentCreatorName().c_str()));
-    CHECK_COND(segdocDataset.putAndInsertString(DCM_ClinicalTrialSeriesID, metaInfo.getClinicalTrialSeriesID().c_str()));
-    CHECK_COND(segdocDataset.putAndInsertString(DCM_ClinicalTrialTimePointID, metaInfo.getClinicalTrialTimePointID().c_str()));
-    if (metaInfo.getClinicalTrialCoordinatingCenterName().size())
-      CHECK_COND(segdocDataset.putAndInsertString(DCM_ClinicalTrialCoordinatingCenterName, metaInfo.getClinicalTrialCoordinatingCenterName().c_str()));
+    IODGeneralEquipmentModule::EquipmentInfo eq = getEquipmentInfo();
+    ContentIdentificationMacro ident = createContentIdentificationInformation(metaInfo);
+    CHECK_COND(ident.setInstanceNumber(metaInfo.getInstanceNumber().c_str()));
 
-    // populate BodyPartExamined
-    {
-      OFString bodyPartStr;
-      string bodyPartAssigned = metaInfo.getBodyPartExamined();
+    // Label map frames are assembled as FRACTIONAL segmentation, which DCMTK can write, and
+    // the dataset is turned into a label map after writing. The frames added to DCMTK are
+    // single pixel placeholders; the label map pixel data is written directly into its own
+    // Pixel Data element, in 8 or 16 bits, which replaces them.
+    DcmSegmentation *segdoc = NULL;
+    CHECK_COND(DcmSegmentation::createFractionalSegmentation(
+        segdoc,   // resulting segmentation
+        1,    // rows of the placeholder frames
+        1,    // columns of the placeholder frames
+        DcmSegTypes::SFT_PROBABILITY,
+        255,    // maximum fractional value
+        eq,     // equipment
+        ident));   // content identification
+    std::unique_ptr<DcmSegmentation> segdocOwner(segdoc);
 
-      // inherit BodyPartExamined from the source image dataset, if available
-      if(dcmDatasets[0]->findAndGetOFString(DCM_BodyPartExamined, bodyPartStr).good())
-      if(string(bodyPartStr.c_str()).size())
-        bodyPartAssigned = bodyPartStr.c_str();
+    // import Patient, Study and Frame of Reference; do not import Series
+    // attributes
+    CHECK_COND(segdoc->importHierarchy(*dcmDatasets[0], OFTrue, OFTrue, OFTrue, OFFalse));
 
-      if(bodyPartAssigned.size())
-        CHECK_COND(segdocDataset.putAndInsertString(DCM_BodyPartExamined, bodyPartAssigned.c_str()));
-    }
+    /* Initialize dimension module: frames are only distinguished by their position */
+    char dimUID[128];
+    dcmGenerateUniqueIdentifier(dimUID, QIICR_UID_ROOT);
+    IODMultiframeDimensionModule &mfdim = segdoc->getDimensions();
+    CHECK_COND(mfdim.addDimensionIndex(DCM_ImagePositionPatient, dimUID, DCM_PlanePositionSequence,
+                       DcmTag(DCM_ImagePositionPatient).getTagName()));
 
-    // StudyDate/Time should be of the series segmented, not when segmentation was made - this is initialized by DCMTK
+    addSharedFunctionalGroups(segdoc, segmentations[0]);
 
-    // SeriesDate/Time should be of when segmentation was done; initialize to when it was saved
-    {
-      OFString contentDate, contentTime;
-      DcmDate::getCurrentDate(contentDate);
-      DcmTime::getCurrentTime(contentTime);
+    // Create segments for all labels of all input files. Segment numbers are assigned in the
+    // order of input files and ascending label values, same as for binary segmentations.
+    vector<map<short,Uint16> > label2segmentNumber(segmentations.size());
+    vector<unsigned> firstSlice(segmentations.size(), inputSize[2]), lastSlice(segmentations.size(), 0);
+    Uint16 maxSegmentNumber = 0;
 
-      CHECK_COND(segdocDataset.putAndInsertString(DCM_SeriesDate, contentDate.c_str()));
-      CHECK_COND(segdocDataset.putAndInsertString(DCM_SeriesTime, contentTime.c_str()));
-      segdoc->getGeneralImage().setContentDate(contentDate.c_str());
-      segdoc->getGeneralImage().setContentTime(contentTime.c_str());
-    }
+    for(size_t segFileNumber=0; segFileNumber<segmentations.size(); segFileNumber++){
+      LabelToLabelMapFilterType::Pointer l2lm = LabelToLabelMapFilterType::New();
+      l2lm->SetInput(segmentations[segFileNumber]);
+      l2lm->Update();
 
-    {
-      string segmentsOverlap;
-      if(segmentations.size() == 1)
-        segmentsOverlap = "NO";
-      else
-        segmentsOverlap = "UNDEFINED";
-      CHECK_COND(segdocDataset.putAndInsertString(DCM_SegmentsOverlap, segmentsOverlap.c_str()));
-    }
+      typedef LabelToLabelMapFilterType::OutputImageType::LabelObjectType LabelType;
+      typedef itk::LabelStatisticsImageFilter<ShortImageType,ShortImageType> LabelStatisticsType;
 
-    return new DcmDataset(segdocDataset);
+      LabelStatisticsType::Pointer labelStats = LabelStatisticsType::New();
+      labelStats->SetInput(segmentations[segFileNumber]);
+      labelStats->SetLabelInput(segmentations[segFileNumber]);
+      labelStats->Update();
+
+      ConversionContext::out() << "Found " << l2lm->GetOutput()->GetNumberOfLabelObjects() << " label(s)" << endl;
+
+      for(unsigned segLabelNumber=0 ; segLabelNumber<l2lm->GetOutput()->GetNumberOfLabelObjects();segLabelNumber++){
+        LabelType* labelObject = l2lm->GetOutput()->GetNthLabelObject(segLabelNumber);
+        short label = labelObject->GetLabel();
+
+        if(!label){
+          continue;
+        }
+
+        if(metaInfo.segmentsAttributesMappingList[segFileNumber].find(label) == metaInfo.segmentsAttributesMappingList[segFileNumber].end()){
+          ConversionContext::err() << "ERROR: Failed to match label from image to the segment metadata!" << endl;
+          return NULL;
+        }
+
+        DcmSegment* segment = createSegment(metaInfo.segmentsAttributesMappingList[segFileNumber][label]);
+        if(segment == NULL)
+          return NULL;
+
+        Uint16 segmentNumber;
+        CHECK_COND(segdoc->addSegment(segment, segmentNumber /* returns logical segment number */));
+        label2segmentNumber[segFileNumber][label] = segmentNumber;
+        maxSegmentNumber = max(maxSegmentNumber, segmentNumber);
+
+        LabelStatisticsType::BoundingBoxType bbox = labelStats->GetBoundingBox(label);
+        firstSlice[segFileNumber] = min(firstSlice[segFileNumber], (unsigned) bbox[4]);
+        lastSlice[segFileNumber] = max(lastSlice[segFileNumber], (unsigned) bbox[5]+1);
+
+        ConversionContext::out() << "Label " << label << " of input " << segFileNumber << " is encoded as segment " << segmentNumber << endl;
+      }
+    }
+
+    if(!maxSegmentNumber){
+      ConversionContext::err() << "ERROR: No non-zero labels found in the input images!" << endl;
+      return NULL;
+    }
+
+    const bool use16Bit = maxSegmentNumber > 255;
+    ConversionContext::out() << "Encoding label map segmentation with " << (use16Bit ? 16 : 8) << " bits per pixel" << endl;
+
+    unsigned volumeFirstSlice = 0, volumeLastSlice = inputSize[2];
+    if(skipEmptySlices){
+      volumeFirstSlice = *min_element(firstSlice.begin(), firstSlice.end());
+      volumeLastSlice = *max_element(lastSlice.begin(), lastSlice.end());
+    }
+
+    OFString seriesInstanceUID;
+    set<OFString> instanceUIDs;
+
+    IODCommonInstanceReferenceModule &commref = segdoc->getCommonInstanceReference();
+    OFVector<IODSeriesAndInstanceReferenceMacro::ReferencedSeriesItem*> &refseries = commref.getReferencedSeriesItems();
+    IODSeriesAndInstanceReferenceMacro::ReferencedSeriesItem* refseriesItem = new IODSeriesAndInstanceReferenceMacro::ReferencedSeriesItem;
+    OFVector<SOPInstanceReferenceMacro*> &refinstances = refseriesItem->getReferencedInstanceItems();
+
+    CHECK_COND(dcmDatasets[0]->findAndGetOFString(DCM_SeriesInstanceUID, seriesInstanceUID));
+    CHECK_COND(refseriesItem->setSeriesInstanceUID(seriesInstanceUID));
+
+    vector<vector<int> > slice2derimg = getSliceMapForSegmentation2DerivationImage(dcmDatasets, segmentations[0]);
+    bool hasDerivationImages = false;
+    for(vector<vector<int> >::const_iterator vI=slice2derimg.begin();vI!=slice2derimg.end();++vI)
+      if((*vI).size()>0)
+        hasDerivationImages = true;
+
+    FGPlanePosPatient* fgppp = FGPlanePosPatient::createMinimal("1","1","1");
+    FGFrameContent* fgfc = new FGFrameContent();
+    FGDerivationImage* fgder = new FGDerivationImage();
+    OFVector<FGBase*> perFrameFGs;
+    perFrameFGs.push_back(fgppp);
+    perFrameFGs.push_back(fgfc);
+    if(hasDerivationImages)
+      perFrameFGs.push_back(fgder);
+
+    const size_t frameSize = size_t(inputSize[0]) * inputSize[1];
+    OFVector<Uint16> labelFrame(frameSize);
+    Uint8 placeholderFrame = 0;
+
+    // Find the slices to encode first, so that the pixel data can be allocated at its final size
+    vector<bool> encodeSlice(inputSize[2], false);
+    size_t numberOfFrames = 0;
+    for(unsigned sliceNumber=volumeFirstSlice;sliceNumber<volumeLastSlice;sliceNumber++){
+      for(size_t segFileNumber=0; !encodeSlice[sliceNumber] && segFileNumber<segmentations.size(); segFileNumber++){
+        if(!skipEmptySlices){
+          encodeSlice[sliceNumber] = true;
+          break;
+        }
+        if(sliceNumber < firstSlice[segFileNumber] || sliceNumber >= lastSlice[segFileNumber])
+          continue;
+        const ShortImageType::PixelType* slice = segmentations[segFileNumber]->GetBufferPointer() + sliceNumber*frameSize;
+        encodeSlice[sliceNumber] = find_if(slice, slice + frameSize,
+                                           [](ShortImageType::PixelType label){ return label != 0; }) != slice + frameSize;
+      }
+      if(encodeSlice[sliceNumber])
+        numberOfFrames++;
+    }
+
+    std::unique_ptr<DcmPixelData> pixelData(new DcmPixelData(DCM_PixelData));
+    Uint8* pixelData8 = NULL;
+    Uint16* pixelData16 = NULL;
+    if(use16Bit)
+      CHECK_COND(pixelData->createUint16Array(Uint32(numberOfFrames*frameSize), pixelData16));
+    else
+      CHECK_COND(pixelData->createUint8Array(Uint32(numberOfFrames*frameSize), pixelData8));
+
+    unsigned frameNumber = 0;
+    for(unsigned sliceNumber=volumeFirstSlice;sliceNumber<volumeLastSlice;sliceNumber++){
+      if(!encodeSlice[sliceNumber])
+        continue;
+
+      ShortImageType::RegionType sliceRegion;
+      ShortImageType::IndexType sliceIndex;
+      ShortImageType::SizeType sliceSize;
+
+      sliceIndex[0] = 0;
+      sliceIndex[1] = 0;
+      sliceIndex[2] = sliceNumber;
+
+      sliceSize[0] = inputSize[0];
+      sliceSize[1] = inputSize[1];
+      sliceSize[2] = 1;
+
+      sliceRegion.SetIndex(sliceIndex);
+      sliceRegion.SetSize(sliceSize);
+
+      // Combine labels of all inputs into segment numbers, failing on overlapping voxels
+      fill(labelFrame.begin(), labelFrame.end(), 0);
+      for(size_t segFileNumber=0; segFileNumber<segmentations.size(); segFileNumber++){
+        if(sliceNumber < firstSlice[segFileNumber] || sliceNumber >= lastSlice[segFileNumber])
+          continue;
+        const map<short,Uint16> &segmentNumbers = label2segmentNumber[segFileNumber];
+        unsigned framePixelCnt = 0;
+        itk::ImageRegionConstIterator<ShortImageType> sliceIterator(segmentations[segFileNumber], sliceRegion);
+        for(sliceIterator.GoToBegin();!sliceIterator.IsAtEnd();++sliceIterator,++framePixelCnt){
+          short label = sliceIterator.Get();
+          if(!label)
+            continue;
+          if(labelFrame[framePixelCnt]){
+            ConversionContext::err() << "ERROR: Input segments overlap at slice " << sliceNumber
+                 << ", label map segmentation cannot be created!" << endl;
+            delete fgfc;
+            delete fgppp;
+            delete fgder;
+            delete refseriesItem;
+            return NULL;
+          }
+          labelFrame[framePixelCnt] = segmentNumbers.find(label)->second;
+        }
+      }
+
+      if(use16Bit)
+        copy(labelFrame.begin(), labelFrame.end(), pixelData16 + frameNumber*frameSize);
+      else
+        copy(labelFrame.begin(), labelFrame.end(), pixelData8 + frameNumber*frameSize);
+
+      frameNumber++;
+      CHECK_COND(fgfc->setDimensionIndexValues(sliceNumber-volumeFirstSlice+1, 0));
+      setPlanePosition(fgppp, segmentations[0], sliceNumber);
+
+      OFVector<DcmDataset*> siVector;
+      for(size_t derImageInstanceNum=0;
+          derImageInstanceNum<slice2derimg[sliceNumber].size();
+          derImageInstanceNum++){
+        siVector.push_back(dcmDatasets[slice2derimg[sliceNumber][derImageInstanceNum]]);
+      }
+      if(siVector.size()>0){
+        addDerivationImageReferences(fgder, siVector, refinstances, instanceUIDs);
+      }
+
+      // The segment number passed here is only used for the Segment Identification
+      // functional group, which is removed again when converting to a label map
+      CHECK_COND(segdoc->addFrame(&placeholderFrame, 1, perFrameFGs));
+
+      if(siVector.size()>0){
+        fgder->clearData();
+      }
+    }
+
+    ConversionContext::out() << "Encoded " << frameNumber << " label map frame(s)" << endl;
+
+    if(refinstances.size())
+      refseries.push_back(refseriesItem);
+    else
+      delete refseriesItem;
+
+    delete fgfc;
+    delete fgppp;
+    delete fgder;
+
+    DcmDataset* result = writeSegmentationDataset(segdoc, metaInfo, dcmDatasets, "NO");
+    if(result == NULL)
+      return NULL;
+
+    OFCondition cond = convertToLabelmapDataset(*result, pixelData.release(), inputSize[1], inputSize[0], use16Bit);
+    if(cond.bad()){
+      ConversionContext::err() << "ERROR: Failed to convert dataset to label map segmentation: " << cond.text() << endl;
+      delete result;
+      return NULL;
+    }
+    return result;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  DcmDataset* Itk2DicomConverter::itkimage2dcmFractionalSegmentation(vector<DcmDataset*> dcmDatasets,
+                                                                    vector<FloatImageType::Pointer> probabilityMaps,
+                                                                    const string &metaData,
+                                                                    Uint16 maxFractionalValue,
+                                                                    bool skipEmptySlices) {
+
+    if(maxFractionalValue < 1 || maxFractionalValue > 255){
+      ConversionContext::err() << "ERROR: Maximum fractional value must be between 1 and 255!" << endl;
+      return NULL;
+    }
+
+    FloatImageType::SizeType inputSize = probabilityMaps[0]->GetBufferedRegion().GetSize();
+
+    JSONSegmentationMetaInformationHandler metaInfo(metaData.c_str());
+    metaInfo.read();
+
+    if(metaInfo.segmentsAttributesMappingList.size() != probabilityMaps.size()){
+      ConversionContext::err() << "Mismatch between the number of input segmentation files and the size of metainfo list!" << endl;
+      return NULL;
+    };
+
+    // Frames of all segments share the plane positions of the first input
+    for(size_t segFileNumber=1; segFileNumber<probabilityMaps.size(); segFileNumber++){
+      if(probabilityMaps[segFileNumber]->GetBufferedRegion() != probabilityMaps[0]->GetBufferedRegion()
+         || probabilityMaps[segFileNumber]->GetOrigin() != probabilityMaps[0]->GetOrigin()
+         || probabilityMaps[segFileNumber]->GetSpacing() != probabilityMaps[0]->GetSpacing()
+         || probabilityMaps[segFileNumber]->GetDirection() != probabilityMaps[0]->GetDirection()){
+        ConversionContext::err() << "ERROR: Fractional segmentation requires all input images to share the same geometry!" << endl;
+        return NULL;
+      }
+    }
+
+    // The geometry helpers work on label images; an image without buffer is sufficient for them
+    ShortImageType::Pointer geometry = ShortImageType::New();
+    geometry->SetRegions(probabilityMaps[0]->GetLargestPossibleRegion());
+    geometry->SetOrigin(probabilityMaps[0]->GetOrigin());
+    geometry->SetSpacing(probabilityMaps[0]->GetSpacing());
+    geometry->SetDirection(probabilityMaps[0]->GetDirection());
+
+    IODGeneralEquipmentModule::EquipmentInfo eq = getEquipmentInfo();
+    ContentIdentificationMacro ident = createContentIdentificationInformation(metaInfo);
+    CHECK_COND(ident.setInstanceNumber(metaInfo.getInstanceNumber().c_str()));
+
+    DcmSegmentation *segdoc = NULL;
+    CHECK_COND(DcmSegmentation::createFractionalSegmentation(
+        segdoc,   // resulting segmentation
+        inputSize[1],    // rows
+        inputSize[0],    // columns
+        DcmSegTypes::SFT_PROBABILITY,
+        maxFractionalValue,
+        eq,     // equipment
+        ident));   // content identification
+
+    // import Patient, Study and Frame of Reference; do not import Series
+    // attributes
+    CHECK_COND(segdoc->importHierarchy(*dcmDatasets[0], OFTrue, OFTrue, OFTrue, OFFalse));
+
+    /* Initialize dimension module */
+    char dimUID[128];
+    dcmGenerateUniqueIdentifier(dimUID, QIICR_UID_ROOT);
+    IODMultiframeDimensionModule &mfdim = segdoc->getDimensions();
+    CHECK_COND(mfdim.addDimensionIndex(DCM_ReferencedSegmentNumber, dimUID, DCM_SegmentIdentificationSequence,
+                       DcmTag(DCM_ReferencedSegmentNumber).getTagName()));
+    CHECK_COND(mfdim.addDimensionIndex(DCM_ImagePositionPatient, dimUID, DCM_PlanePositionSequence,
+                       DcmTag(DCM_ImagePositionPatient).getTagName()));
+
+    addSharedFunctionalGroups(segdoc, geometry);
+
+    OFString seriesInstanceUID;
+    set<OFString> instanceUIDs;
+
+    IODCommonInstanceReferenceModule &commref = segdoc->getCommonInstanceReference();
+    OFVector<IODSeriesAndInstanceReferenceMacro::ReferencedSeriesItem*> &refseries = commref.getReferencedSeriesItems();
+    IODSeriesAndInstanceReferenceMacro::ReferencedSeriesItem* refseriesItem = new IODSeriesAndInstanceReferenceMacro::ReferencedSeriesItem;
+    OFVector<SOPInstanceReferenceMacro*> &refinstances = refseriesItem->getReferencedInstanceItems();
+
+    CHECK_COND(dcmDatasets[0]->findAndGetOFString(DCM_SeriesInstanceUID, seriesInstanceUID));
+    CHECK_COND(refseriesItem->setSeriesInstanceUID(seriesInstanceUID));
+
+    vector<vector<int> > slice2derimg = getSliceMapForSegmentation2DerivationImage(dcmDatasets, geometry);
+    bool hasDerivationImages = false;
+    for(vector<vector<int> >::const_iterator vI=slice2derimg.begin();vI!=slice2derimg.end();++vI)
+      if((*vI).size()>0)
+        hasDerivationImages = true;
+
+    FGPlanePosPatient* fgppp = FGPlanePosPatient::createMinimal("1","1","1");
+    FGFrameContent* fgfc = new FGFrameContent();
+    FGDerivationImage* fgder = new FGDerivationImage();
+    OFVector<FGBase*> perFrameFGs;
+    perFrameFGs.push_back(fgppp);
+    perFrameFGs.push_back(fgfc);
+    if(hasDerivationImages)
+      perFrameFGs.push_back(fgder);
+
+    const size_t frameSize = inputSize[0] * inputSize[1];
+    OFVector<Uint8> frameData(frameSize);
+
+    unsigned frameNumber = 0;
+    for(size_t segFileNumber=0; segFileNumber<probabilityMaps.size(); segFileNumber++){
+
+      // A probability map describes exactly one segment
+      if(metaInfo.segmentsAttributesMappingList[segFileNumber].size() != 1){
+        ConversionContext::err() << "ERROR: Exactly one segment must be described for each probability map!" << endl;
+        delete fgfc;
+        delete fgppp;
+        delete fgder;
+        delete refseriesItem;
+        delete segdoc;
+        return NULL;
+      }
+
+      DcmSegment* segment = createSegment(metaInfo.segmentsAttributesMappingList[segFileNumber].begin()->second);
+      if(segment == NULL){
+        delete fgfc;
+        delete fgppp;
+        delete fgder;
+        delete refseriesItem;
+        delete segdoc;
+        return NULL;
+      }
+
+      Uint16 segmentNumber;
+      CHECK_COND(segdoc->addSegment(segment, segmentNumber /* returns logical segment number */));
+
+      // Slices are contiguous in the image buffer, so they can be quantized in place
+      const FloatPixelType* probabilities = probabilityMaps[segFileNumber]->GetBufferPointer();
+      unsigned segmentFrames = 0;
+      for(unsigned sliceNumber=0;sliceNumber<inputSize[2];sliceNumber++){
+        const bool nonEmpty = quantizeProbabilities(probabilities + sliceNumber*frameSize, frameSize,
+                                                    maxFractionalValue, &frameData[0]);
+        if(skipEmptySlices && !nonEmpty)
+          continue;
+
+        CHECK_COND(fgfc->setDimensionIndexValues(segmentNumber, 0));
+        CHECK_COND(fgfc->setDimensionIndexValues(sliceNumber+1, 1));
+        setPlanePosition(fgppp, geometry, sliceNumber);
+
+        OFVector<DcmDataset*> siVector;
+        for(size_t derImageInstanceNum=0;
+            derImageInstanceNum<slice2derimg[sliceNumber].size();
+            derImageInstanceNum++){
+          siVector.push_back(dcmDatasets[slice2derimg[sliceNumber][derImageInstanceNum]]);
+        }
+        if(siVector.size()>0){
+          addDerivationImageReferences(fgder, siVector, refinstances, instanceUIDs);
+        }
+
+        CHECK_COND(segdoc->addFrame(&frameData[0], segmentNumber, perFrameFGs));
+        segmentFrames++;
+
+        if(siVector.size()>0){
+          fgder->clearData();
+        }
+      }
+
+      ConversionContext::out() << "Encoded " << segmentFrames << " fractional frame(s) for segment " << segmentNumber << endl;
+      frameNumber += segmentFrames;
+    }
+
+    if(refinstances.size())
+      refseries.push_back(refseriesItem);
+    else
+      delete refseriesItem;
+
+    delete fgfc;
+    delete fgppp;
+    delete fgder;
+
+    if(!frameNumber){
+      ConversionContext::err() << "ERROR: All probabilities are zero, no frames to encode!" << endl;
+      delete segdoc;
+      return NULL;
+    }
+
+    // Probabilities of different segments may well be non-zero at the same pixel
+    return writeSegmentationDataset(segdoc, metaInfo, dcmDatasets, probabilityMaps.size() == 1 ? "NO" : "UNDEFINED");
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool Itk2DicomConverter::quantizeProbabilities(const FloatPixelType* probabilities, size_t count,
+                                                 Uint16 maxFractionalValue, Uint8* fractions) {
+    const float scale = static_cast<float>(maxFractionalValue);
+    size_t i = 0;
+    Uint8 any = 0;
+#ifdef DCMQI_HAVE_SSE2
+    // 16 probabilities per iteration: clamp, scale, round and saturate down to bytes.
+    // max(p,0) yields 0 for NaN, since SSE returns the second operand for unordered inputs.
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 scaleVec = _mm_set1_ps(scale);
+    const __m128 half = _mm_set1_ps(.5f);
+    __m128i anyVec = _mm_setzero_si128();
+    for(; i+16<=count; i+=16){
+      __m128i q[4];
+      for(int j=0;j<4;j++){
+        __m128 p = _mm_loadu_ps(probabilities + i + 4*j);
+        p = _mm_min_ps(_mm_max_ps(p, zero), one);
+        q[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(p, scaleVec), half));
+      }
+      const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]), _mm_packs_epi32(q[2], q[3]));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(fractions + i), bytes);
+      anyVec = _mm_or_si128(anyVec, bytes);
+    }
+    any = _mm_movemask_epi8(_mm_cmpeq_epi8(anyVec, _mm_setzero_si128())) != 0xFFFF;
+#endif
+    for(; i<count; i++){
+      const float p = probabilities[i];
+      // written so that NaN ends up as 0
+      const float clamped = p > 0.f ? (p < 1.f ? p : 1.f) : 0.f;
+      fractions[i] = static_cast<Uint8>(clamped*scale + .5f);
+      any |= fractions[i];
+    }
+    return any != 0;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  OFCondition Itk2DicomConverter::addRLEFrame(DcmPixelSequence &pixelSequence, const Uint16* frame,
+                                              Uint16 rows, Uint16 columns, bool use16Bit) {
+    // RLE Lossless (DICOM PS3.5 Annex G): one segment per byte of a pixel, most significant byte
+    // first, each preceded by a header holding the number of segments and their offsets
+    const Uint32 numberOfSegments = use16Bit ? 2 : 1;
+    OFVector<Uint8> fragment(64, 0);
+    Uint32 header[16] = {numberOfSegments};
+    for(Uint32 segment=0; segment<numberOfSegments; segment++){
+      const unsigned shift = 8 * (numberOfSegments - 1 - segment);
+      // padding is added below, since it must not be inserted between rows
+      DcmRLEEncoder encoder(0);
+      for(size_t row=0; row<rows; row++){
+        const Uint16* rowData = frame + row * columns;
+        for(size_t col=0; col<columns; col++)
+          encoder.add(static_cast<unsigned char>(rowData[col] >> shift));
+        // rows are encoded separately
+        encoder.flush();
+      }
+      if(encoder.fail())
+        return EC_MemoryExhausted;
+      // a fragment is limited to 32-bit length
+      const size_t offset = fragment.size();
+      const size_t segmentSize = encoder.size() + encoder.size() % 2;
+      if(offset + segmentSize > 0xFFFFFFFE)
+        return EC_ElemLengthExceeds32BitField;
+      header[1 + segment] = Uint32(offset);
+      // segments are padded with zero to even length
+      fragment.resize(offset + segmentSize, 0);
+      encoder.write(&fragment[offset]);
+    }
+    // the header is stored in little endian byte order
+    for(size_t i=0; i<16; i++){
+      for(size_t byte=0; byte<4; byte++)
+        fragment[4*i + byte] = Uint8(header[i] >> (8 * byte));
+    }
+
+    DcmPixelItem* item = new DcmPixelItem(DcmTag(DCM_Item, EVR_OB));
+    OFCondition cond = item->putUint8Array(&fragment[0], Uint32(fragment.size()));
+    if(cond.good())
+      cond = pixelSequence.insert(item);
+    if(cond.bad())
+      delete item;
+    return cond;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  DcmDataset* Itk2DicomConverter::itkimage2dcmTiledSegmentation(DcmDataset* sourceDataset,
+                                                               const string &segImageFileName,
+                                                               const string &metaData,
+                                                               unsigned tileSize,
+                                                               bool skipEmptyTiles) {
+
+    if(tileSize == 0 || tileSize > 65535){
+      ConversionContext::err() << "ERROR: Invalid tile size " << tileSize << endl;
+      return NULL;
+    }
+
+    // Only read the image information here; pixel data is streamed in strips below
+    UShortReader2DType::Pointer reader = UShortReader2DType::New();
+    reader->SetFileName(segImageFileName);
+    reader->UpdateOutputInformation();
+    UShortImage2DType::Pointer labelImage = reader->GetOutput();
+    // Image IOs that cannot stream would read the whole image for every strip, so it is read once
+    const bool streamStrips = reader->GetImageIO()->CanStreamRead();
+    if(!streamStrips){
+      ConversionContext::err() << "WARNING: " << reader->GetImageIO()->GetNameOfClass() << " cannot read " << segImageFileName
+           << " in strips, so the complete image is loaded into memory. Use an uncompressed MetaImage (.mha/.mhd) file"
+           << " to stream large label images." << endl;
+      reader->Update();
+    }
+    UShortImage2DType::SizeType imageSize = labelImage->GetLargestPossibleRegion().GetSize();
+
+    JSONSegmentationMetaInformationHandler metaInfo(metaData.c_str());
+    metaInfo.read();
+
+    if(metaInfo.segmentsAttributesMappingList.size() != 1){
+      ConversionContext::err() << "ERROR: Tiled segmentation requires a single input label image and a single segmentAttributes item!" << endl;
+      return NULL;
+    };
+
+    IODGeneralEquipmentModule::EquipmentInfo eq = getEquipmentInfo();
+    ContentIdentificationMacro ident = createContentIdentificationInformation(metaInfo);
+    CHECK_COND(ident.setInstanceNumber(metaInfo.getInstanceNumber().c_str()));
+
+    // Tiles are written as label map frames with placeholders, see itkimage2dcmLabelmapSegmentation()
+    DcmSegmentation *segdoc = NULL;
+    CHECK_COND(DcmSegmentation::createFractionalSegmentation(
+        segdoc,   // resulting segmentation
+        1,    // rows of the placeholder frames
+        1,    // columns of the placeholder frames
+        DcmSegTypes::SFT_PROBABILITY,
+        255,    // maximum fractional value
+        eq,     // equipment
+        ident));   // content identification
+    std::unique_ptr<DcmSegmentation> segdocOwner(segdoc);
+
+    // import Patient, Study and Frame of Reference; do not import Series
+    // attributes
+    CHECK_COND(segdoc->importHierarchy(*sourceDataset, OFTrue, OFTrue, OFTrue, OFFalse));
+
+    /* Initialize dimension module: frames are distinguished by their position in the total pixel matrix */
+    char dimUID[128];
+    dcmGenerateUniqueIdentifier(dimUID, QIICR_UID_ROOT);
+    IODMultiframeDimensionModule &mfdim = segdoc->getDimensions();
+    CHECK_COND(mfdim.addDimensionIndex(DCM_ColumnPositionInTotalImagePixelMatrix, dimUID, DCM_PlanePositionSlideSequence,
+                       DcmTag(DCM_ColumnPositionInTotalImagePixelMatrix).getTagName()));
+    CHECK_COND(mfdim.addDimensionIndex(DCM_RowPositionInTotalImagePixelMatrix, dimUID, DCM_PlanePositionSlideSequence,
+                       DcmTag(DCM_RowPositionInTotalImagePixelMatrix).getTagName()));
+
+    // Shared FGs: PixelMeasuresSequence
+    {
+      FGPixelMeasures *pixmsr = new FGPixelMeasures();
+      UShortImage2DType::SpacingType labelSpacing = labelImage->GetSpacing();
+      ostringstream spacingSStream;
+      // DICOM Pixel Spacing is row spacing (y) followed by column spacing (x)
+      spacingSStream << scientific << labelSpacing[1] << "\\" << labelSpacing[0];
+      CHECK_COND(pixmsr->setPixelSpacing(spacingSStream.str().c_str()));
+      CHECK_COND(segdoc->addForAllFrames(*pixmsr));
+      delete pixmsr;
+    }
+
+    // Shared FGs: DerivationImageSequence, all tiles are derived from the same source image
+    OFString seriesInstanceUID;
+    set<OFString> instanceUIDs;
+
+    IODCommonInstanceReferenceModule &commref = segdoc->getCommonInstanceReference();
+    OFVector<IODSeriesAndInstanceReferenceMacro::ReferencedSeriesItem*> &refseries = commref.getReferencedSeriesItems();
+    IODSeriesAndInstanceReferenceMacro::ReferencedSeriesItem* refseriesItem = new IODSeriesAndInstanceReferenceMacro::ReferencedSeriesItem;
+    OFVector<SOPInstanceReferenceMacro*> &refinstances = refseriesItem->getReferencedInstanceItems();
+
+    CHECK_COND(sourceDataset->findAndGetOFString(DCM_SeriesInstanceUID, seriesInstanceUID));
+    CHECK_COND(refseriesItem->setSeriesInstanceUID(seriesInstanceUID));
+    {
+      FGDerivationImage* fgder = new FGDerivationImage();
+      OFVector<DcmDataset*> siVector;
+      siVector.push_back(sourceDataset);
+      addDerivationImageReferences(fgder, siVector, refinstances, instanceUIDs);
+      CHECK_COND(segdoc->addForAllFrames(*fgder));
+      delete fgder;
+    }
+    refseries.push_back(refseriesItem);
+
+    // Create segments in ascending label order and set up the label to segment number lookup table
+    map<unsigned, SegmentAttributes*> &labelAttributes = metaInfo.segmentsAttributesMappingList[0];
+    if(labelAttributes.empty() || labelAttributes.rbegin()->first > 65535){
+      ConversionContext::err() << "ERROR: No valid segment labels found in the metadata!" << endl;
+      return NULL;
+    }
+    vector<Uint16> label2segmentNumber(labelAttributes.rbegin()->first + 1, 0);
+    Uint16 maxSegmentNumber = 0;
+    for(map<unsigned, SegmentAttributes*>::const_iterator lI=labelAttributes.begin(); lI!=labelAttributes.end(); ++lI){
+      if(!lI->first)
+        continue;
+      DcmSegment* segment = createSegment(lI->second);
+      if(segment == NULL)
+        return NULL;
+      Uint16 segmentNumber;
+      CHECK_COND(segdoc->addSegment(segment, segmentNumber /* returns logical segment number */));
+      label2segmentNumber[lI->first] = segmentNumber;
+      maxSegmentNumber = max(maxSegmentNumber, segmentNumber);
+    }
+
+    const bool use16Bit = maxSegmentNumber > 255;
+    const unsigned tileColumns = (imageSize[0] + tileSize - 1) / tileSize;
+    const unsigned tileRows = (imageSize[1] + tileSize - 1) / tileSize;
+    ConversionContext::out() << "Encoding " << imageSize[0] << "x" << imageSize[1] << " label image as up to "
+         << tileColumns * tileRows << " tiles of " << tileSize << "x" << tileSize << " pixels, "
+         << (use16Bit ? 16 : 8) << " bits per pixel" << endl;
+
+    FGFrameContent* fgfc = new FGFrameContent();
+    OFVector<FGBase*> perFrameFGs;
+    perFrameFGs.push_back(fgfc);
+
+    const size_t frameSize = size_t(tileSize) * tileSize;
+    OFVector<Uint16> labelTile(frameSize);
+    Uint8 placeholderFrame = 0;
+    // Tiles are RLE compressed as soon as they are complete, so that only the compressed
+    // frames are held in memory. This also lifts the 4 GB limit of native pixel data.
+    DcmPixelSequence* pixelSequence = new DcmPixelSequence(DcmTag(DCM_PixelData, EVR_OB));
+    std::unique_ptr<DcmPixelSequence> pixelSequenceOwner(pixelSequence);
+    // empty basic offset table
+    OFCondition offsetTableCond = pixelSequence->insert(new DcmPixelItem(DcmTag(DCM_Item, EVR_OB)));
+    CHECK_COND(offsetTableCond);
+    OFVector<std::pair<Uint32, Uint32> > tilePositions;
+
+    for(unsigned tileRow=0; tileRow<tileRows; tileRow++){
+
+      // Read one strip of tiles covering the full image width
+      UShortImage2DType::IndexType stripIndex;
+      UShortImage2DType::SizeType stripSize;
+      stripIndex[0] = 0;
+      stripIndex[1] = tileRow * tileSize;
+      stripSize[0] = imageSize[0];
+      stripSize[1] = min<size_t>(tileSize, imageSize[1] - stripIndex[1]);
+      UShortImage2DType::RegionType stripRegion(stripIndex, stripSize);
+
+      if(streamStrips){
+        labelImage->SetRequestedRegion(stripRegion);
+        reader->Update();
+      }
+      const UShortImage2DType::PixelType* buffer = labelImage->GetBufferPointer();
+
+      for(unsigned tileColumn=0; tileColumn<tileColumns; tileColumn++){
+        const size_t firstColumn = tileColumn * tileSize;
+        const size_t columns = min<size_t>(tileSize, imageSize[0] - firstColumn);
+
+        // Tiles at the right and bottom border are padded with background
+        fill(labelTile.begin(), labelTile.end(), 0);
+        bool tileIsEmpty = true;
+        for(size_t row=0; row<stripSize[1]; row++){
+          UShortImage2DType::IndexType rowStart;
+          rowStart[0] = firstColumn;
+          rowStart[1] = stripIndex[1] + row;
+          const UShortImage2DType::PixelType* rowData = buffer + labelImage->ComputeOffset(rowStart);
+          Uint16* tileRowData = &labelTile[row * tileSize];
+          for(size_t col=0; col<columns; col++){
+            const UShortPixelType label = rowData[col];
+            if(!label)
+              continue;
+            if((size_t) label >= label2segmentNumber.size() || !label2segmentNumber[label]){
+              ConversionContext::err() << "ERROR: Label " << label << " found in the image is not described in the segment metadata!" << endl;
+              delete fgfc;
+              return NULL;
+            }
+            tileRowData[col] = label2segmentNumber[label];
+            tileIsEmpty = false;
+          }
+        }
+
+        if(skipEmptyTiles && tileIsEmpty)
+          continue;
+
+        CHECK_COND(fgfc->setDimensionIndexValues(tileColumn+1, 0));
+        CHECK_COND(fgfc->setDimensionIndexValues(tileRow+1, 1));
+        tilePositions.push_back(std::make_pair(Uint32(firstColumn+1), Uint32(stripIndex[1]+1)));
+
+        OFCondition cond = addRLEFrame(*pixelSequence, &labelTile[0], tileSize, tileSize, use16Bit);
+        if(cond.bad()){
+          ConversionContext::err() << "ERROR: Failed to compress tile " << tilePositions.size() << ": " << cond.text() << endl;
+          delete fgfc;
+          return NULL;
+        }
+        CHECK_COND(segdoc->addFrame(&placeholderFrame, 1, perFrameFGs));
+      }
+    }
+    delete fgfc;
+
+    const bool tiledFull = tilePositions.size() == size_t(tileColumns) * tileRows;
+    ConversionContext::out() << "Encoded " << tilePositions.size() << " tile(s), dimension organization "
+         << (tiledFull ? "TILED_FULL" : "TILED_SPARSE") << endl;
+
+    vector<DcmDataset*> dcmDatasets(1, sourceDataset);
+    DcmDataset* result = writeSegmentationDataset(segdoc, metaInfo, dcmDatasets, "NO");
+    if(result == NULL)
+      return NULL;
+
+    // the pixel data takes over the compressed frames; it has no uncompressed representation
+    DcmPixelData* pixelData = new DcmPixelData(DCM_PixelData);
+    pixelData->putOriginalRepresentation(EXS_RLELossless, NULL, pixelSequenceOwner.release());
+    OFCondition cond = convertToLabelmapDataset(*result, pixelData, tileSize, tileSize, use16Bit);
+    if(cond.good())
+      cond = addTiledImageAttributes(*result, labelImage, tilePositions, tiledFull);
+    if(cond.bad()){
+      ConversionContext::err() << "ERROR: Failed to convert dataset to tiled label map segmentation: " << cond.text() << endl;
+      delete result;
+      return NULL;
+    }
+    return result;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  DcmSegment* Itk2DicomConverter::createSegment(SegmentAttributes* segmentAttributes) {
+    DcmSegment* segment = NULL;
+
+    DcmSegTypes::E_SegmentAlgoType algoType = DcmSegTypes::SAT_UNKNOWN;
+    string algoName = "";
+    string algoTypeStr = segmentAttributes->getSegmentAlgorithmType();
+    if(algoTypeStr == "MANUAL"){
+      algoType = DcmSegTypes::SAT_MANUAL;
+    } else {
+      if(algoTypeStr == "AUTOMATIC")
+        algoType = DcmSegTypes::SAT_AUTOMATIC;
+      if(algoTypeStr == "SEMIAUTOMATIC")
+        algoType = DcmSegTypes::SAT_SEMIAUTOMATIC;
+
+      algoName = segmentAttributes->getSegmentAlgorithmName();
+      if(algoName == ""){
+        ConversionContext::err() << "ERROR: Algorithm name must be specified for non-manual algorithm types!" << endl;
+        return NULL;
+      }
+    }
+
+    CodeSequenceMacro* typeCode = segmentAttributes->getSegmentedPropertyTypeCodeSequence();
+    CodeSequenceMacro* categoryCode = segmentAttributes->getSegmentedPropertyCategoryCodeSequence();
+    assert(typeCode != NULL && categoryCode!= NULL);
+    OFString segmentLabel;
+
+    if(segmentAttributes->getSegmentLabel().length() > 0){
+      ConversionContext::out() << "Populating segment label to " << segmentAttributes->getSegmentLabel() << endl;
+      segmentLabel = segmentAttributes->getSegmentLabel().c_str();
+    } else
+      CHECK_COND(typeCode->getCodeMeaning(segmentLabel));
+
+    CHECK_COND(DcmSegment::create(segment, segmentLabel, *categoryCode, *typeCode, algoType, algoName.c_str()));
+
+    if(segmentAttributes->getSegmentDescription().length() > 0)
+      segment->setSegmentDescription(segmentAttributes->getSegmentDescription().c_str());
+
+    if(segmentAttributes->getTrackingIdentifier().length() > 0)
+      segment->setTrackingID(segmentAttributes->getTrackingIdentifier().c_str());
+
+    if(segmentAttributes->getTrackingUniqueIdentifier().length() > 0)
+      segment->setTrackingUID(segmentAttributes->getTrackingUniqueIdentifier().c_str());
+
+    CodeSequenceMacro* typeModifierCode = segmentAttributes->getSegmentedPropertyTypeModifierCodeSequence();
+    if (typeModifierCode != NULL) {
+      OFVector<CodeSequenceMacro*>& modifiersVector = segment->getSegmentedPropertyTypeModifierCode();
+      modifiersVector.push_back(typeModifierCode);
+    }
+
+    GeneralAnatomyMacro &anatomyMacro = segment->getGeneralAnatomyCode();
+    if (segmentAttributes->getAnatomicRegionSequence() != NULL){
+      OFVector<CodeSequenceMacro*>& anatomyMacroModifiersVector = anatomyMacro.getAnatomicRegionModifier();
+      CodeSequenceMacro& anatomicRegionSequence = anatomyMacro.getAnatomicRegion();
+      anatomicRegionSequence = *segmentAttributes->getAnatomicRegionSequence();
+
+      if(segmentAttributes->getAnatomicRegionModifierSequence() != NULL){
+        CodeSequenceMacro* anatomicRegionModifierSequence = segmentAttributes->getAnatomicRegionModifierSequence();
+        anatomyMacroModifiersVector.push_back(anatomicRegionModifierSequence);
+      }
+    }
+
+    unsigned* rgb = segmentAttributes->getRecommendedDisplayRGBValue();
+    int cielab[3];
+
+    ColorUtilities::getIntegerScaledCIELabPCSFromSRGB(cielab[0], cielab[1], cielab[2], rgb[0], rgb[1], rgb[2]);
+    //IODCIELabUtil::rgb2DicomLab(cielab[0], cielab[1], cielab[2], rgb[0], rgb[1], rgb[2]);
+
+    CHECK_COND(segment->setRecommendedDisplayCIELabValue(cielab[0],cielab[1],cielab[2]));
+
+    return segment;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  void Itk2DicomConverter::addSharedFunctionalGroups(DcmSegmentation* segdoc, const ShortImageType::Pointer &referenceImage) {
+    // Shared FGs: PlaneOrientationPatientSequence
+    {
+      ShortImageType::DirectionType labelDirMatrix = referenceImage->GetDirection();
+
+      //cout << "Directions: " << labelDirMatrix << endl;
+
+      FGPlaneOrientationPatient *planor =
+          FGPlaneOrientationPatient::createMinimal(
+              Helper::floatToStr(labelDirMatrix[0][0]).c_str(),
+              Helper::floatToStr(labelDirMatrix[1][0]).c_str(),
+              Helper::floatToStr(labelDirMatrix[2][0]).c_str(),
+              Helper::floatToStr(labelDirMatrix[0][1]).c_str(),
+              Helper::floatToStr(labelDirMatrix[1][1]).c_str(),
+              Helper::floatToStr(labelDirMatrix[2][1]).c_str());
+
+      CHECK_COND(segdoc->addForAllFrames(*planor));
+      delete planor;
+    }
+
+    // Shared FGs: PixelMeasuresSequence
+    {
+      FGPixelMeasures *pixmsr = new FGPixelMeasures();
+
+      ShortImageType::SpacingType labelSpacing = referenceImage->GetSpacing();
+      ostringstream spacingSStream;
+      spacingSStream << scientific << labelSpacing[0] << "\\" << labelSpacing[1];
+      CHECK_COND(pixmsr->setPixelSpacing(spacingSStream.str().c_str()));
+
+      spacingSStream.clear(); spacingSStream.str("");
+      spacingSStream << scientific << labelSpacing[2];
+      CHECK_COND(pixmsr->setSpacingBetweenSlices(spacingSStream.str().c_str()));
+      CHECK_COND(pixmsr->setSliceThickness(spacingSStream.str().c_str()));
+      CHECK_COND(segdoc->addForAllFrames(*pixmsr));
+      delete pixmsr;
+    }
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  void Itk2DicomConverter::setPlanePosition(FGPlanePosPatient* fgppp, const ShortImageType::Pointer &image,
+                                            unsigned sliceNumber) {
+    ShortImageType::PointType sliceOriginPoint;
+    ShortImageType::IndexType sliceOriginIndex;
+    sliceOriginIndex.Fill(0);
+    sliceOriginIndex[2] = sliceNumber;
+    image->TransformIndexToPhysicalPoint(sliceOriginIndex, sliceOriginPoint);
+    fgppp->setImagePositionPatient(
+        Helper::floatToStr(sliceOriginPoint[0]).c_str(),
+        Helper::floatToStr(sliceOriginPoint[1]).c_str(),
+        Helper::floatToStr(sliceOriginPoint[2]).c_str());
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  void Itk2DicomConverter::addDerivationImageReferences(FGDerivationImage* fgder, OFVector<DcmDataset*> &siVector,
+                                                        OFVector<SOPInstanceReferenceMacro*> &refinstances,
+                                                        set<OFString> &instanceUIDs) {
+    DerivationImageItem *derimgItem;
+    DSRBasicCodedEntry code_seg=CODE_DCM_Segmentation_113076;
+    CHECK_COND(fgder->addDerivationImageItem(CodeSequenceMacro(code_seg.CodeValue,code_seg.CodingSchemeDesignator,
+                                                               code_seg.CodeMeaning),"",derimgItem));
+
+    //cout << "Total of " << siVector.size() << " source image items will be added" << endl;
+    DSRBasicCodedEntry code = CODE_DCM_SourceImageForImageProcessingOperation;
+    OFVector<SourceImageItem*> srcimgItems;
+    ConversionContext::out() << "Added source image item" << endl;
+    CHECK_COND(derimgItem->addSourceImageItems(siVector,
+                                               CodeSequenceMacro(code.CodeValue, code.CodingSchemeDesignator,
+                                                                 code.CodeMeaning),
+                                               srcimgItems));
+
+    // initialize class UID and series instance UID
+    ImageSOPInstanceReferenceMacro &instRef = srcimgItems[0]->getImageSOPInstanceReference();
+    OFString instanceUID, classUID;
+    CHECK_COND(instRef.getReferencedSOPClassUID(classUID));
+    CHECK_COND(instRef.getReferencedSOPInstanceUID(instanceUID));
+
+    if(instanceUIDs.find(instanceUID) == instanceUIDs.end()){
+      SOPInstanceReferenceMacro *refinstancesItem = new SOPInstanceReferenceMacro();
+      CHECK_COND(refinstancesItem->setReferencedSOPClassUID(classUID));
+      CHECK_COND(refinstancesItem->setReferencedSOPInstanceUID(instanceUID));
+      refinstances.push_back(refinstancesItem);
+      instanceUIDs.insert(instanceUID);
+    }
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  DcmDataset* Itk2DicomConverter::writeSegmentationDataset(DcmSegmentation* segdoc,
+                                                          JSONSegmentationMetaInformationHandler &metaInfo,
+                                                          vector<DcmDataset*> &dcmDatasets,
+                                                          const string &segmentsOverlap) {
+    DcmDataset segdocDataset;
+
+    segdoc->getSeries().setSeriesNumber(metaInfo.getSeriesNumber().c_str());
+
+    OFString frameOfRefUID;
+    if(!segdoc->getFrameOfReference().getFrameOfReferenceUID(frameOfRefUID).good()){
+      // TODO: add FoR UID to the metadata JSON and check that before generating one!
+      char frameOfRefUIDchar[128];
+      dcmGenerateUniqueIdentifier(frameOfRefUIDchar, QIICR_UID_ROOT);
+      CHECK_COND(segdoc->getFrameOfReference().setFrameOfReferenceUID(frameOfRefUIDchar));
+    }
+
+    ConversionContext::out() << "Writing DICOM segmentation dataset " << std::endl;
+    // Don't check functional groups since its very time consuming and we trust
+    // ourselves to put together valid datasets
+    segdoc->setCheckFGOnWrite(OFFalse);
+    OFCondition writeResult = segdoc->writeDataset(segdocDataset);
+    if(writeResult.bad()){
+      ConversionContext::err() << "FATAL ERROR: Writing of the SEG dataset failed!";
+      if (writeResult.text()){
+        ConversionContext::err() << " Error: " << writeResult.text() << ".";
+      }
+      ConversionContext::err() << " Please report the problem to the developers, ideally accompanied by a de-identified dataset allowing to reproduce the problem!" << endl;
+      return NULL;
+    }
+
+    // Set reader/session/timepoint information
+    ConversionContext::out() << "Patching in extra meta information into DICOM dataset" << std::endl;
+    CHECK_COND(segdocDataset.putAndInsertString(DCM_SeriesDescription, metaInfo.getSeriesDescription().c_str()));
+    CHECK_COND(segdocDataset.putAndInsertString(DCM_ContentCreatorName, metaInfo.getContentCreatorName().c_str()));
+    CHECK_COND(segdocDataset.putAndInsertString(DCM_ClinicalTrialSeriesID, metaInfo.getClinicalTrialSeriesID().c_str()));
+    CHECK_COND(segdocDataset.putAndInsertString(DCM_ClinicalTrialTimePointID, metaInfo.getClinicalTrialTimePointID().c_str()));
+    if (metaInfo.getClinicalTrialCoordinatingCenterName().size())
+      CHECK_COND(segdocDataset.putAndInsertString(DCM_ClinicalTrialCoordinatingCenterName, metaInfo.getClinicalTrialCoordinatingCenterName().c_str()));
+
+    // populate BodyPartExamined
+    {
+      OFString bodyPartStr;
+      string bodyPartAssigned = metaInfo.getBodyPartExamined();
+
+      // inherit BodyPartExamined from the source image dataset, if available
+      if(dcmDatasets[0]->findAndGetOFString(DCM_BodyPartExamined, bodyPartStr).good())
+      if(string(bodyPartStr.c_str()).size())
+        bodyPartAssigned = bodyPartStr.c_str();
+
+      if(bodyPartAssigned.size())
+        CHECK_COND(segdocDataset.putAndInsertString(DCM_BodyPartExamined, bodyPartAssigned.c_str()));
+    }
+
+    // StudyDate/Time should be of the series segmented, not when segmentation was made - this is initialized by DCMTK
+
+    // SeriesDate/Time should be of when segmentation was done; initialize to when it was saved
+    {
+      OFString contentDate, contentTime;
+      DcmDate::getCurrentDate(contentDate);
+      DcmTime::getCurrentTime(contentTime);
+
+      CHECK_COND(segdocDataset.putAndInsertString(DCM_SeriesDate, contentDate.c_str()));
+      CHECK_COND(segdocDataset.putAndInsertString(DCM_SeriesTime, contentTime.c_str()));
+      segdoc->getGeneralImage().setContentDate(contentDate.c_str());
+      segdoc->getGeneralImage().setContentTime(contentTime.c_str());
+    }
+
+    CHECK_COND(segdocDataset.putAndInsertString(DCM_SegmentsOverlap, segmentsOverlap.c_str()));
+
+    return new DcmDataset(segdocDataset);
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  OFCondition Itk2DicomConverter::convertToLabelmapDataset(DcmDataset &dataset, DcmPixelData* pixelData,
+                                                          Uint16 rows, Uint16 columns, bool use16Bit) {
+    // the dataset holds the placeholder frames until the pixel data is inserted
+    OFCondition cond = dataset.insert(pixelData, OFTrue /* replace */);
+    if(cond.bad()){
+      delete pixelData;
+      return cond;
+    }
+    cond = dataset.putAndInsertString(DCM_SOPClassUID, UID_LabelMapSegmentationStorage);
+    if(cond.good())
+      cond = dataset.putAndInsertString(DCM_SegmentationType, "LABELMAP");
+    if(cond.bad())
+      return cond;
+
+    // Fractional segmentation attributes do not apply to label maps
+    dataset.findAndDeleteElement(DCM_SegmentationFractionalType);
+    dataset.findAndDeleteElement(DCM_MaximumFractionalValue);
+
+    // Frames do not reference an individual segment; the pixel values do
+    DcmSequenceOfItems* perFrameSeq = NULL;
+    if(dataset.findAndGetSequence(DCM_PerFrameFunctionalGroupsSequence, perFrameSeq).good() && perFrameSeq){
+      for(unsigned long i=0; i<perFrameSeq->card(); i++){
+        perFrameSeq->getItem(i)->findAndDeleteElement(DCM_SegmentIdentificationSequence);
+      }
+    }
+
+    cond = dataset.putAndInsertUint16(DCM_Rows, rows);
+    if(cond.good())
+      cond = dataset.putAndInsertUint16(DCM_Columns, columns);
+    if(cond.good())
+      cond = dataset.putAndInsertUint16(DCM_BitsAllocated, use16Bit ? 16 : 8);
+    if(cond.good())
+      cond = dataset.putAndInsertUint16(DCM_BitsStored, use16Bit ? 16 : 8);
+    if(cond.good())
+      cond = dataset.putAndInsertUint16(DCM_HighBit, use16Bit ? 15 : 7);
+    return cond;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  OFCondition Itk2DicomConverter::addTiledImageAttributes(DcmDataset &dataset, const UShortImage2DType::Pointer &image,
+                                                          const OFVector<std::pair<Uint32, Uint32> > &tilePositions,
+                                                          bool tiledFull) {
+    UShortImage2DType::SizeType imageSize = image->GetLargestPossibleRegion().GetSize();
+    UShortImage2DType::DirectionType direction = image->GetDirection();
+
+    OFCondition cond = dataset.putAndInsertString(DCM_DimensionOrganizationType, tiledFull ? "TILED_FULL" : "TILED_SPARSE");
+    if(cond.good())
+      cond = dataset.putAndInsertUint32(DCM_TotalPixelMatrixColumns, imageSize[0]);
+    if(cond.good())
+      cond = dataset.putAndInsertUint32(DCM_TotalPixelMatrixRows, imageSize[1]);
+    if(cond.good())
+      cond = dataset.putAndInsertUint32(DCM_TotalPixelMatrixFocalPlanes, 1);
+    if(cond.bad())
+      return cond;
+
+    // Orientation and origin of the total pixel matrix in the slide coordinate system
+    {
+      ostringstream orientationSStream;
+      orientationSStream << Helper::floatToStr(direction[0][0]) << "\\" << Helper::floatToStr(direction[1][0]) << "\\0\\"
+                         << Helper::floatToStr(direction[0][1]) << "\\" << Helper::floatToStr(direction[1][1]) << "\\0";
+      cond = dataset.putAndInsertOFStringArray(DCM_ImageOrientationSlide, orientationSStream.str().c_str());
+      if(cond.bad())
+        return cond;
+
+      UShortImage2DType::PointType origin = image->GetOrigin();
+      DcmItem* originItem = NULL;
+      cond = dataset.findOrCreateSequenceItem(DCM_TotalPixelMatrixOriginSequence, originItem);
+      if(cond.good())
+        cond = originItem->putAndInsertString(DCM_XOffsetInSlideCoordinateSystem, Helper::floatToStr(origin[0]).c_str());
+      if(cond.good())
+        cond = originItem->putAndInsertString(DCM_YOffsetInSlideCoordinateSystem, Helper::floatToStr(origin[1]).c_str());
+      if(cond.bad())
+        return cond;
+    }
+
+    // With TILED_FULL, frame positions are implied by the frame order
+    if(tiledFull){
+      delete dataset.remove(DCM_PerFrameFunctionalGroupsSequence);
+      return EC_Normal;
+    }
+
+    DcmSequenceOfItems* perFrameSeq = NULL;
+    cond = dataset.findAndGetSequence(DCM_PerFrameFunctionalGroupsSequence, perFrameSeq);
+    if(cond.bad())
+      return cond;
+    if(!perFrameSeq || perFrameSeq->card() != tilePositions.size())
+      return EC_IllegalCall;
+
+    for(unsigned long i=0; cond.good() && i<perFrameSeq->card(); i++){
+      UShortImage2DType::IndexType tileIndex;
+      tileIndex[0] = tilePositions[i].first - 1;
+      tileIndex[1] = tilePositions[i].second - 1;
+      UShortImage2DType::PointType tileOrigin;
+      image->TransformIndexToPhysicalPoint(tileIndex, tileOrigin);
+
+      DcmItem* positionItem = NULL;
+      cond = perFrameSeq->getItem(i)->findOrCreateSequenceItem(DCM_PlanePositionSlideSequence, positionItem);
+      if(cond.good())
+        cond = positionItem->putAndInsertSint32(DCM_ColumnPositionInTotalImagePixelMatrix, tilePositions[i].first);
+      if(cond.good())
+        cond = positionItem->putAndInsertSint32(DCM_RowPositionInTotalImagePixelMatrix, tilePositions[i].second);
+      if(cond.good())
+        cond = positionItem->putAndInsertString(DCM_XOffsetInSlideCoordinateSystem, Helper::floatToStr(tileOrigin[0]).c_str());
+      if(cond.good())
+        cond = positionItem->putAndInsertString(DCM_YOffsetInSlideCoordinateSystem, Helper::floatToStr(tileOrigin[1]).c_str());
+      if(cond.good())
+        cond = positionItem->putAndInsertString(DCM_ZOffsetInSlideCoordinateSystem, "0");
+    }
+    return cond;
   }
 
 }
@@ -159,9 +159,9 @@ namespace dcmqi {
       }
 
     } catch (exception& e) {
-      cerr << "ERROR: JSON parameter file could not be parsed!" << std::endl;
-      cerr << "You can validate the JSON file here: http://qiicr.org/dcmqi/#/validators" << std::endl;
-      cerr << "Exception details (probably not very useful): " << e.what() << endl;
+      ConversionContext::err() << "ERROR: JSON parameter file could not be parsed!" << std::endl;
+      ConversionContext::err() << "You can validate the JSON file here: http://qiicr.org/dcmqi/#/validators" << std::endl;
+      ConversionContext::err() << "Exception details (probably not very useful): " << e.what() << endl;
       throw JSONReadErrorException();
     }
   }
@@ -53,9 +53,9 @@ namespace dcmqi {
 
       this->readSegmentAttributes();
     } catch (exception& e) {
-      cerr << "ERROR: JSON parameter file could not be parsed!" << std::endl;
-      cerr << "You can validate the JSON file here: http://qiicr.org/dcmqi/#/validators" << std::endl;
-      cerr << "Exception details (probably not very useful): " << e.what() << endl;
+      ConversionContext::err() << "ERROR: JSON parameter file could not be parsed!" << std::endl;
+      ConversionContext::err() << "You can validate the JSON file here: http://qiicr.org/dcmqi/#/validators" << std::endl;
+      ConversionContext::err() << "Exception details (probably not very useful): " << e.what() << endl;
       throw JSONReadErrorException();
     }
   }
@@ -154,7 +154,7 @@ namespace dcmqi {
   SegmentAttributes *JSONSegmentationMetaInformationHandler::createOrGetSegment(const unsigned int segGroupNumber, const unsigned labelID) {
     if (segGroupNumber < 1)
     {
-      std::cerr << "ERROR: Segment group number must be >= 1" << std::endl;
+      ConversionContext::err() << "ERROR: Segment group number must be >= 1" << std::endl;
       return NULL;
     }
 
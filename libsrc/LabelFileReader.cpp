@@ -0,0 +1,72 @@
+// DCMQI includes
+#include "dcmqi/LabelFileReader.h"
+#include "dcmqi/ConversionContext.h"
+
+// STD includes
+#include <algorithm>
+
+namespace dcmqi {
+
+  LabelFileReader::LabelFileReader(const std::vector<std::string> &fileNames, unsigned readAhead)
+    : m_fileNames(fileNames), m_readAhead(std::max(readAhead, 1u)), m_nextRead(0), m_nextVolume(0) {
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  LabelFileReader::~LabelFileReader() {
+    for(size_t i=0;i<m_pendingReads.size();i++)
+      m_pendingReads[i].wait();
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  size_t LabelFileReader::getNumberOfVolumes() const {
+    return m_fileNames.size();
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool LabelFileReader::next(Itk2DicomConverter::LabelBuffer &buffer) {
+    if(m_nextVolume >= m_fileNames.size()){
+      ConversionContext::err() << "ERROR: No more label images to read" << std::endl;
+      return false;
+    }
+
+    // the previous image is released before further reads start, which bounds the memory use
+    m_current = NULL;
+    while(m_nextRead < m_fileNames.size() && m_pendingReads.size() <= m_readAhead){
+      m_pendingReads.push_back(std::async(std::launch::async, &LabelFileReader::read, m_fileNames[m_nextRead]));
+      m_nextRead++;
+    }
+
+    ReadResult result = m_pendingReads.front().get();
+    m_pendingReads.pop_front();
+    const std::string &fileName = m_fileNames[m_nextVolume++];
+    if(!result.image){
+      ConversionContext::err() << "ERROR: Failed to read " << fileName << ": " << result.error << std::endl;
+      return false;
+    }
+    ConversionContext::out() << "Loaded segmentation from " << fileName << std::endl;
+
+    m_current = result.image;
+    buffer = Itk2DicomConverter::LabelBuffer::fromImage(m_current);
+    return true;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  LabelFileReader::ReadResult LabelFileReader::read(const std::string &fileName) {
+    // runs on a background thread, so errors are passed to the caller instead of reported
+    ReadResult result;
+    try {
+      ShortReaderType::Pointer reader = ShortReaderType::New();
+      reader->SetFileName(fileName);
+      reader->Update();
+      result.image = reader->GetOutput();
+    } catch (itk::ExceptionObject &error) {
+      result.error = error.GetDescription();
+    }
+    return result;
+  }
+
+}
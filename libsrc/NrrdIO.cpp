@@ -0,0 +1,240 @@
+// DCMQI includes
+#include "dcmqi/NrrdIO.h"
+#include "dcmqi/ConversionContext.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcxfer.h>
+
+// ITK includes
+#include <itk_zlib.h>
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+
+namespace dcmqi {
+
+  bool NrrdIO::writeImage(const ShortImageType::Pointer &image, const std::string &fileName, TarWriter* archive) {
+    return write(fileName, archive, getHeader(image, "short"), image->GetBufferPointer(),
+                 image->GetPixelContainer()->Size()*sizeof(ShortImageType::PixelType));
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NrrdIO::writeImage(const FloatImageType::Pointer &image, const std::string &fileName, TarWriter* archive) {
+    return write(fileName, archive, getHeader(image, "float"), image->GetBufferPointer(),
+                 image->GetPixelContainer()->Size()*sizeof(FloatPixelType));
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NrrdIO::writeSegmentation(const itk::ImageBase<3>* geometry, const std::vector<Uint16> &voxels,
+                                 size_t numberOfLayers, const Json::Value &segmentAttributes,
+                                 const std::string &fileName, TarWriter* archive) {
+    const bool singleByte = voxels.empty() || *std::max_element(voxels.begin(), voxels.end()) <= 255;
+    std::string compressed;
+    if(!compress(voxels, singleByte, compressed)){
+      ConversionContext::err() << "ERROR: Failed to compress " << fileName << std::endl;
+      return false;
+    }
+    const std::string header = getHeader(geometry, singleByte ? "unsigned char" : "unsigned short", numberOfLayers,
+                                          "gzip", getSegmentFields(geometry, voxels, numberOfLayers, segmentAttributes));
+    return write(fileName, archive, header, compressed.data(), compressed.size());
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::string NrrdIO::getSegmentFields(const itk::ImageBase<3>* geometry, const std::vector<Uint16> &voxels,
+                                       size_t numberOfLayers, const Json::Value &segmentAttributes) {
+    itk::ImageBase<3>::SizeType size = geometry->GetLargestPossibleRegion().GetSize();
+
+    // extent of each label value as minimum and maximum index per axis, found in one pass
+    std::map<Uint16, std::vector<long> > extents;
+    size_t position = 0;
+    for(long k=0;k<long(size[2]);k++){
+      for(long j=0;j<long(size[1]);j++){
+        for(long i=0;i<long(size[0]);i++){
+          for(size_t layer=0;layer<numberOfLayers;layer++,position++){
+            const Uint16 label = voxels[position];
+            if(!label)
+              continue;
+            std::vector<long> &extent = extents[label];
+            if(extent.empty()){
+              const long initial[6] = {i, i, j, j, k, k};
+              extent.assign(initial, initial + 6);
+              continue;
+            }
+            extent[0] = std::min(extent[0], i); extent[1] = std::max(extent[1], i);
+            extent[2] = std::min(extent[2], j); extent[3] = std::max(extent[3], j);
+            extent[4] = std::min(extent[4], k); extent[5] = std::max(extent[5], k);
+          }
+        }
+      }
+    }
+
+    // Slicer tags codes as "scheme^value^meaning", with empty fields for missing codes
+    auto code = [](const Json::Value &item) -> std::string {
+      return item.get("CodingSchemeDesignator", "").asString() + "^" + item.get("CodeValue", "").asString() + "^" +
+             item.get("CodeMeaning", "").asString();
+    };
+
+    std::stringstream fields;
+    fields << "Segmentation_MasterRepresentation:=Binary labelmap" << std::endl
+           << "Segmentation_ContainedRepresentationNames:=Binary labelmap|" << std::endl
+           << "Segmentation_ReferenceImageExtentOffset:=0 0 0" << std::endl;
+    unsigned segment = 0;
+    for(Json::Value::ArrayIndex layer=0;layer<segmentAttributes.size();layer++){
+      const Json::Value &group = segmentAttributes[layer];
+      for(Json::Value::ArrayIndex i=0;i<group.size();i++,segment++){
+        const Json::Value &attributes = group[i];
+        const unsigned labelID = attributes.get("labelID", 0).asUInt();
+        std::string name = attributes.get("SegmentLabel", "").asString();
+        if(name.empty())
+          name = attributes.get("SegmentDescription", "").asString();
+        if(name.empty())
+          name = "Segment_" + std::to_string(labelID);
+
+        std::stringstream prefix;
+        prefix << "Segment" << segment << "_";
+        fields << prefix.str() << "ID:=Segment_" << labelID << std::endl
+               << prefix.str() << "Name:=" << name << std::endl
+               << prefix.str() << "NameAutoGenerated:=0" << std::endl;
+
+        fields << prefix.str() << "Color:=";
+        const Json::Value &color = attributes["recommendedDisplayRGBValue"];
+        for(Json::Value::ArrayIndex c=0;c<3;c++)
+          fields << (c ? " " : "") << (color.size() == 3 ? color[c].asDouble()/255. : 0.5);
+        fields << std::endl
+               << prefix.str() << "ColorAutoGenerated:=0" << std::endl;
+
+        fields << prefix.str() << "Extent:=";
+        std::map<Uint16, std::vector<long> >::const_iterator extent = extents.find(Uint16(labelID));
+        if(extent == extents.end())
+          fields << "0 -1 0 -1 0 -1";
+        else
+          for(size_t e=0;e<6;e++)
+            fields << (e ? " " : "") << extent->second[e];
+        fields << std::endl
+               << prefix.str() << "LabelValue:=" << labelID << std::endl
+               << prefix.str() << "Layer:=" << (numberOfLayers > 1 ? layer : 0) << std::endl;
+
+        fields << prefix.str() << "Tags:=TerminologyEntry:Segmentation category and type - DICOM master list~"
+               << code(attributes["SegmentedPropertyCategoryCodeSequence"]) << "~"
+               << code(attributes["SegmentedPropertyTypeCodeSequence"]) << "~"
+               << code(attributes["SegmentedPropertyTypeModifierCodeSequence"]) << "~"
+               << "Anatomic codes - DICOM master list~"
+               << code(attributes["AnatomicRegionSequence"]) << "~"
+               << code(attributes["AnatomicRegionModifierSequence"]) << "|" << std::endl;
+      }
+    }
+    return fields.str();
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NrrdIO::compress(const std::vector<Uint16> &voxels, bool singleByte, std::string &compressed) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // window bits above 15 select the gzip format
+    if(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      return false;
+
+    const size_t chunkLength = 1 << 20;
+    std::vector<unsigned char> input(singleByte ? chunkLength : 0);
+    std::vector<char> output(chunkLength);
+    compressed.clear();
+    int status = Z_OK;
+    for(size_t first=0;;first+=chunkLength){
+      const size_t count = first < voxels.size() ? std::min(chunkLength, voxels.size() - first) : 0;
+      if(singleByte){
+        std::copy(voxels.begin() + first, voxels.begin() + first + count, input.begin());
+        stream.next_in = &input[0];
+        stream.avail_in = uInt(count);
+      } else {
+        stream.next_in = count ? (Bytef*)(&voxels[first]) : Z_NULL;
+        stream.avail_in = uInt(count*sizeof(Uint16));
+      }
+      const int flush = first + count >= voxels.size() ? Z_FINISH : Z_NO_FLUSH;
+      do {
+        stream.next_out = (Bytef*)(&output[0]);
+        stream.avail_out = uInt(output.size());
+        status = deflate(&stream, flush);
+        if(status == Z_STREAM_ERROR){
+          deflateEnd(&stream);
+          return false;
+        }
+        compressed.append(&output[0], output.size() - stream.avail_out);
+      } while(stream.avail_out == 0);
+      if(flush == Z_FINISH)
+        break;
+    }
+    deflateEnd(&stream);
+    return status == Z_STREAM_END;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::string NrrdIO::getHeader(const itk::ImageBase<3>* image, const std::string &type, size_t numberOfLayers,
+                                const std::string &encoding, const std::string &keyValuePairs) {
+    itk::ImageBase<3>::SizeType size = image->GetLargestPossibleRegion().GetSize();
+    itk::ImageBase<3>::SpacingType spacing = image->GetSpacing();
+    itk::ImageBase<3>::PointType origin = image->GetOrigin();
+    itk::ImageBase<3>::DirectionType direction = image->GetDirection();
+
+    std::stringstream header;
+    header.precision(std::numeric_limits<double>::digits10 + 2);
+    header << "NRRD0004" << std::endl
+           << "# Complete NRRD file format specification at:" << std::endl
+           << "# http://teem.sourceforge.net/nrrd/format.html" << std::endl
+           << "type: " << type << std::endl
+           << "dimension: " << (numberOfLayers > 1 ? 4 : 3) << std::endl
+           << "space: left-posterior-superior" << std::endl
+           << "sizes: ";
+    if(numberOfLayers > 1)
+      header << numberOfLayers << " ";
+    header << size[0] << " " << size[1] << " " << size[2] << std::endl;
+    // each axis is given by its direction scaled by its spacing; the layers are no spatial axis
+    header << "space directions:" << (numberOfLayers > 1 ? " none" : "");
+    for(unsigned axis=0;axis<3;axis++){
+      header << " (";
+      for(unsigned i=0;i<3;i++)
+        header << (i ? "," : "") << direction[i][axis]*spacing[axis];
+      header << ")";
+    }
+    header << std::endl
+           << "kinds: " << (numberOfLayers > 1 ? "list " : "") << "domain domain domain" << std::endl
+           << "endian: " << (gLocalByteOrder == EBO_BigEndian ? "big" : "little") << std::endl
+           << "encoding: " << encoding << std::endl
+           << "space origin: (" << origin[0] << "," << origin[1] << "," << origin[2] << ")" << std::endl
+           << keyValuePairs
+           << std::endl;
+    return header.str();
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NrrdIO::write(const std::string &fileName, TarWriter* archive, const std::string &header,
+                     const void* voxels, size_t length) {
+    if(archive){
+      std::vector<std::pair<const char*, size_t> > buffers;
+      buffers.push_back(std::make_pair(header.data(), header.size()));
+      buffers.push_back(std::make_pair(static_cast<const char*>(voxels), length));
+      return archive->addFile(fileName, buffers);
+    }
+
+    std::ofstream outputFile(fileName.c_str(), std::ios::out | std::ios::binary);
+    outputFile.write(header.data(), std::streamsize(header.size()));
+    outputFile.write(static_cast<const char*>(voxels), std::streamsize(length));
+    outputFile.close();
+    if(!outputFile){
+      ConversionContext::err() << "ERROR: Failed to write " << fileName << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+}
@@ -0,0 +1,540 @@
+// DCMQI includes
+#include "dcmqi/NumpyIO.h"
+#include "dcmqi/ConversionContext.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcxfer.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dcmqi {
+
+  NumpyIO::MappedArray::MappedArray()
+    : dataOffset(0), m_base(NULL), m_length(0)
+#ifdef _WIN32
+    , m_file(NULL), m_mapping(NULL)
+#endif
+  {
+    for(int i=0;i<3;i++){
+      spacing[i] = 1.;
+      origin[i] = 0.;
+    }
+    for(int i=0;i<9;i++)
+      direction[i] = i%4 == 0 ? 1. : 0.;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  NumpyIO::MappedArray::~MappedArray() {
+    unmap();
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NumpyIO::MappedArray::map(const std::string &fileName) {
+    unmap();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+      return false;
+    LARGE_INTEGER length;
+    if(!GetFileSizeEx(file, &length) || length.QuadPart == 0){
+      CloseHandle(file);
+      return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mapping == NULL){
+      CloseHandle(file);
+      return false;
+    }
+    const void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(base == NULL){
+      CloseHandle(mapping);
+      CloseHandle(file);
+      return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_base = static_cast<const char*>(base);
+    m_length = size_t(length.QuadPart);
+#else
+    int file = open(fileName.c_str(), O_RDONLY);
+    if(file < 0)
+      return false;
+    struct stat status;
+    if(fstat(file, &status) != 0 || status.st_size == 0){
+      close(file);
+      return false;
+    }
+    void* base = mmap(NULL, size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    // the mapping stays valid after closing the descriptor
+    close(file);
+    if(base == MAP_FAILED)
+      return false;
+    m_base = static_cast<const char*>(base);
+    m_length = size_t(status.st_size);
+#endif
+    return true;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  void NumpyIO::MappedArray::unmap() {
+    if(m_base == NULL)
+      return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_base);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+    m_mapping = NULL;
+    m_file = NULL;
+#else
+    munmap(const_cast<char*>(m_base), m_length);
+#endif
+    m_base = NULL;
+    m_length = 0;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NumpyIO::isArrayFile(const std::string &fileName) {
+    const size_t dot = fileName.rfind('.');
+    if(dot == std::string::npos)
+      return false;
+    std::string extension = fileName.substr(dot);
+    for(size_t i=0;i<extension.size();i++)
+      extension[i] = char(tolower(extension[i]));
+    return extension == ".npy" || extension == ".raw";
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NumpyIO::mapArray(const std::string &fileName, const std::string &geometryFileName, MappedArray &array) {
+    std::string geometryFile = geometryFileName;
+    const size_t separator = fileName.find_last_of("/\\");
+    const std::string baseName = separator == std::string::npos ? fileName : fileName.substr(separator+1);
+    if(geometryFile.empty())
+      geometryFile = fileName.substr(0, fileName.rfind('.')) + ".json";
+
+    Json::Value geometry;
+    std::ifstream geometryStream(geometryFile.c_str());
+    Json::CharReaderBuilder readerBuilder;
+    std::string parseErrors;
+    if(!geometryStream || !Json::parseFromStream(readerBuilder, geometryStream, &geometry, &parseErrors)
+       || !geometry.isObject()){
+      ConversionContext::err() << "ERROR: Failed to read the geometry of " << fileName << " from "
+                               << geometryFile << " " << parseErrors << std::endl;
+      return false;
+    }
+
+    // the description of this particular file, if several arrays share the geometry
+    Json::Value arrayInfo = geometry;
+    if(geometry.isMember("arrays")){
+      for(Json::ArrayIndex i=0;i<geometry["arrays"].size();i++){
+        if(geometry["arrays"][i].get("fileName", "").asString() == baseName)
+          arrayInfo = geometry["arrays"][i];
+      }
+    }
+
+    if(!geometry["spacing"].isArray() || geometry["spacing"].size() != 3
+       || !geometry["origin"].isArray() || geometry["origin"].size() != 3){
+      ConversionContext::err() << "ERROR: " << geometryFile << " must specify spacing and origin" << std::endl;
+      return false;
+    }
+    for(Json::ArrayIndex i=0;i<3;i++){
+      array.spacing[i] = geometry["spacing"][i].asDouble();
+      array.origin[i] = geometry["origin"][i].asDouble();
+    }
+    if(geometry.isMember("direction")){
+      // either row by row, or as flat list
+      const Json::Value &direction = geometry["direction"];
+      for(Json::ArrayIndex i=0;i<9;i++){
+        if(direction.size() == 3 && direction[i/3].isArray() && direction[i/3].size() == 3)
+          array.direction[i] = direction[i/3][i%3].asDouble();
+        else if(direction.size() == 9)
+          array.direction[i] = direction[i].asDouble();
+        else {
+          ConversionContext::err() << "ERROR: Invalid direction in " << geometryFile << std::endl;
+          return false;
+        }
+      }
+    }
+
+    if(!array.map(fileName)){
+      ConversionContext::err() << "ERROR: Failed to map " << fileName << " into memory" << std::endl;
+      return false;
+    }
+
+    // .npy files are recognized by their magic string, anything else is raw
+    if(std::string(array.m_base, std::min<size_t>(array.m_length, 6)) == "\x93NUMPY"){
+      if(!parseHeader(array.m_base, array.m_length, array))
+        return false;
+    } else {
+      if(!arrayInfo.isMember("dtype") || !arrayInfo["shape"].isArray()){
+        ConversionContext::err() << "ERROR: " << geometryFile << " must specify dtype and shape of " << fileName << std::endl;
+        return false;
+      }
+      if(!parseTypeString(arrayInfo["dtype"].asString(), array.dtype))
+        return false;
+      array.shape.clear();
+      for(Json::ArrayIndex i=0;i<arrayInfo["shape"].size();i++)
+        array.shape.push_back(size_t(arrayInfo["shape"][i].asUInt64()));
+      array.dataOffset = size_t(arrayInfo.get("dataOffset", 0).asUInt64());
+    }
+
+    // a single channel 4D array is accepted as well
+    if(array.shape.size() == 4 && array.shape[0] == 1)
+      array.shape.erase(array.shape.begin());
+    if(array.shape.size() != 3){
+      ConversionContext::err() << "ERROR: " << fileName << " is not a 3D array" << std::endl;
+      return false;
+    }
+    if(geometry["size"].isArray() && geometry["size"].size() == 3){
+      for(Json::ArrayIndex i=0;i<3;i++){
+        if(size_t(geometry["size"][i].asUInt64()) != array.shape[2-i]){
+          ConversionContext::err() << "ERROR: Shape of " << fileName << " does not match the size in "
+                                   << geometryFile << std::endl;
+          return false;
+        }
+      }
+    }
+
+    const size_t itemSize = getItemSize(array.dtype);
+    if(itemSize == 0){
+      ConversionContext::err() << "ERROR: Unsupported array type " << array.dtype << " of " << fileName << std::endl;
+      return false;
+    }
+    if(array.dataOffset % itemSize != 0){
+      ConversionContext::err() << "ERROR: Voxels of " << fileName << " are not aligned" << std::endl;
+      return false;
+    }
+    // the shape is read from the file, so its product may not fit into size_t
+    size_t dataSize = itemSize;
+    for(int i=0;i<3;i++){
+      if(array.shape[i] && dataSize > std::numeric_limits<size_t>::max() / array.shape[i]){
+        ConversionContext::err() << "ERROR: Shape of " << fileName << " is too large" << std::endl;
+        return false;
+      }
+      dataSize *= array.shape[i];
+    }
+    if(array.dataOffset > array.m_length || array.m_length - array.dataOffset < dataSize){
+      ConversionContext::err() << "ERROR: " << fileName << " is smaller than its shape requires" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NumpyIO::getLabelBuffer(const MappedArray &array, Itk2DicomConverter::LabelBuffer &labelBuffer) {
+    if(array.dtype == "u1")
+      labelBuffer.dataType = Itk2DicomConverter::LabelBuffer::UINT8;
+    else if(array.dtype == "u2")
+      labelBuffer.dataType = Itk2DicomConverter::LabelBuffer::UINT16;
+    else if(array.dtype == "i2")
+      labelBuffer.dataType = Itk2DicomConverter::LabelBuffer::INT16;
+    else if(array.dtype == "u4")
+      labelBuffer.dataType = Itk2DicomConverter::LabelBuffer::UINT32;
+    else
+      return false;
+
+    const ptrdiff_t itemSize = ptrdiff_t(getItemSize(array.dtype));
+    labelBuffer.data = array.getData();
+    for(int i=0;i<3;i++){
+      labelBuffer.size[i] = array.shape[2-i];
+      labelBuffer.spacing[i] = array.spacing[i];
+      labelBuffer.origin[i] = array.origin[i];
+    }
+    labelBuffer.strides[0] = itemSize;
+    labelBuffer.strides[1] = itemSize*ptrdiff_t(array.shape[2]);
+    labelBuffer.strides[2] = labelBuffer.strides[1]*ptrdiff_t(array.shape[1]);
+    for(int i=0;i<9;i++)
+      labelBuffer.direction[i] = array.direction[i];
+    return true;
+  }
+
+  bool NumpyIO::writeArray(const std::vector<ShortImageType::Pointer> &images, const std::string &fileName,
+                           Json::Value* arrayInfo, TarWriter* archive) {
+    if(images.empty()){
+      ConversionContext::err() << "ERROR: No images to write to " << fileName << std::endl;
+      return false;
+    }
+
+    ShortImageType::SizeType size = images[0]->GetLargestPossibleRegion().GetSize();
+    std::vector<std::pair<const char*, size_t> > buffers;
+    for(size_t i=0;i<images.size();i++){
+      if(images[i]->GetLargestPossibleRegion().GetSize() != size){
+        ConversionContext::err() << "ERROR: Images of different size cannot be stored in one array" << std::endl;
+        return false;
+      }
+      buffers.push_back(std::make_pair(reinterpret_cast<const char*>(images[i]->GetBufferPointer()),
+                                       images[i]->GetPixelContainer()->Size()*sizeof(ShortImageType::PixelType)));
+    }
+
+    std::vector<size_t> shape;
+    if(images.size() > 1)
+      shape.push_back(images.size());
+    shape.push_back(size[2]);
+    shape.push_back(size[1]);
+    shape.push_back(size[0]);
+
+    return write(fileName, "i2", shape, buffers, arrayInfo, archive);
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NumpyIO::writeArray(const FloatImageType::Pointer &image, const std::string &fileName,
+                           Json::Value* arrayInfo, TarWriter* archive) {
+    FloatImageType::SizeType size = image->GetLargestPossibleRegion().GetSize();
+    std::vector<size_t> shape;
+    shape.push_back(size[2]);
+    shape.push_back(size[1]);
+    shape.push_back(size[0]);
+
+    std::vector<std::pair<const char*, size_t> > buffers;
+    buffers.push_back(std::make_pair(reinterpret_cast<const char*>(image->GetBufferPointer()),
+                                     image->GetPixelContainer()->Size()*sizeof(FloatPixelType)));
+
+    return write(fileName, "f4", shape, buffers, arrayInfo, archive);
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  Json::Value NumpyIO::getGeometry(const itk::ImageBase<3>* image) {
+    itk::ImageBase<3>::SizeType size = image->GetLargestPossibleRegion().GetSize();
+    itk::ImageBase<3>::SpacingType spacing = image->GetSpacing();
+    itk::ImageBase<3>::PointType origin = image->GetOrigin();
+    itk::ImageBase<3>::DirectionType direction = image->GetDirection();
+
+    Json::Value geometry;
+    geometry["coordinateSystem"] = "LPS";
+    geometry["axes"] = Json::Value(Json::arrayValue);
+    geometry["axes"].append("column");
+    geometry["axes"].append("row");
+    geometry["axes"].append("slice");
+    for(unsigned i=0;i<3;i++){
+      geometry["size"].append(Json::UInt64(size[i]));
+      geometry["spacing"].append(spacing[i]);
+      geometry["origin"].append(origin[i]);
+    }
+
+    // the index of each image axis is scaled by its spacing along its direction
+    Json::Value ijkToLPS(Json::arrayValue);
+    for(unsigned row=0;row<4;row++){
+      Json::Value matrixRow(Json::arrayValue);
+      for(unsigned column=0;column<4;column++){
+        if(row == 3)
+          matrixRow.append(column == 3 ? 1. : 0.);
+        else if(column == 3)
+          matrixRow.append(origin[row]);
+        else
+          matrixRow.append(direction[row][column]*spacing[column]);
+      }
+      ijkToLPS.append(matrixRow);
+      if(row < 3){
+        Json::Value directionRow(Json::arrayValue);
+        for(unsigned column=0;column<3;column++)
+          directionRow.append(direction[row][column]);
+        geometry["direction"].append(directionRow);
+      }
+    }
+    geometry["ijkToLPS"] = ijkToLPS;
+    return geometry;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NumpyIO::writeGeometry(const Json::Value &geometry, const Json::Value &arrays, const std::string &fileName,
+                              TarWriter* archive) {
+    Json::Value root = geometry;
+    root["arrays"] = arrays;
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "  ";
+    if(archive)
+      return archive->addFile(fileName, Json::writeString(builder, root) + "\n");
+
+    std::ofstream outputFile(fileName.c_str());
+    std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
+    writer->write(root, &outputFile);
+    outputFile << std::endl;
+    if(!outputFile){
+      ConversionContext::err() << "ERROR: Failed to write " << fileName << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::string NumpyIO::getHeader(const std::string &dtype, const std::vector<size_t> &shape) {
+    std::stringstream dict;
+    dict << "{'descr': '" << getTypeString(dtype) << "', 'fortran_order': False, 'shape': (";
+    for(size_t i=0;i<shape.size();i++)
+      dict << shape[i] << ", ";
+    dict << "), }";
+
+    // magic string, version and header length take 10 bytes, the header ends with a newline
+    std::string header = dict.str();
+    size_t length = 10 + header.size() + 1;
+    header.append((64 - length % 64) % 64, ' ');
+    header.append(1, '\n');
+
+    const Uint16 headerLength = Uint16(header.size());
+    std::string preamble("\x93NUMPY\x01\x00", 8);
+    preamble.append(1, char(headerLength & 0xff));
+    preamble.append(1, char(headerLength >> 8));
+    return preamble + header;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NumpyIO::write(const std::string &fileName, const std::string &dtype, const std::vector<size_t> &shape,
+                      const std::vector<std::pair<const char*, size_t> > &buffers, Json::Value* arrayInfo,
+                      TarWriter* archive) {
+    const std::string header = getHeader(dtype, shape);
+
+    if(archive){
+      std::vector<std::pair<const char*, size_t> > content(1, std::make_pair(header.data(), header.size()));
+      content.insert(content.end(), buffers.begin(), buffers.end());
+      if(!archive->addFile(fileName, content))
+        return false;
+    } else {
+      std::ofstream outputFile(fileName.c_str(), std::ios::out | std::ios::binary);
+      outputFile.write(header.data(), header.size());
+      for(size_t i=0;i<buffers.size();i++)
+        outputFile.write(buffers[i].first, buffers[i].second);
+      outputFile.close();
+      if(!outputFile){
+        ConversionContext::err() << "ERROR: Failed to write " << fileName << std::endl;
+        return false;
+      }
+    }
+
+    if(arrayInfo){
+      (*arrayInfo)["dtype"] = getTypeString(dtype);
+      (*arrayInfo)["shape"] = Json::Value(Json::arrayValue);
+      for(size_t i=0;i<shape.size();i++)
+        (*arrayInfo)["shape"].append(Json::UInt64(shape[i]));
+      (*arrayInfo)["dataOffset"] = Json::UInt64(header.size());
+    }
+    return true;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  std::string NumpyIO::getTypeString(const std::string &dtype) {
+    return (gLocalByteOrder == EBO_BigEndian ? ">" : "<") + dtype;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  size_t NumpyIO::getItemSize(const std::string &dtype) {
+    if(dtype == "u1" || dtype == "i1")
+      return 1;
+    if(dtype == "u2" || dtype == "i2")
+      return 2;
+    if(dtype == "u4" || dtype == "i4" || dtype == "f4")
+      return 4;
+    if(dtype == "f8")
+      return 8;
+    return 0;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NumpyIO::parseHeader(const char* data, size_t length, MappedArray &array) {
+    // version 1.0 uses a 2 byte header length, later versions 4 bytes
+    if(length < 10){
+      ConversionContext::err() << "ERROR: Truncated .npy header" << std::endl;
+      return false;
+    }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t headerStart = 10, headerLength = bytes[8] | (bytes[9] << 8);
+    if(bytes[6] > 1){
+      if(length < 12){
+        ConversionContext::err() << "ERROR: Truncated .npy header" << std::endl;
+        return false;
+      }
+      headerStart = 12;
+      headerLength = size_t(bytes[8]) | (size_t(bytes[9]) << 8) | (size_t(bytes[10]) << 16) | (size_t(bytes[11]) << 24);
+    }
+    if(headerStart + headerLength > length){
+      ConversionContext::err() << "ERROR: Truncated .npy header" << std::endl;
+      return false;
+    }
+    const std::string header(data + headerStart, headerLength);
+    array.dataOffset = headerStart + headerLength;
+
+    // the header is a Python dict literal with the keys descr, fortran_order and shape
+    size_t pos = header.find("'descr'");
+    size_t begin = pos == std::string::npos ? pos : header.find('\'', pos + 7);
+    size_t end = begin == std::string::npos ? begin : header.find('\'', begin + 1);
+    if(end == std::string::npos){
+      ConversionContext::err() << "ERROR: .npy header without descr" << std::endl;
+      return false;
+    }
+    if(!parseTypeString(header.substr(begin + 1, end - begin - 1), array.dtype))
+      return false;
+
+    pos = header.find("'fortran_order'");
+    const size_t value = pos == std::string::npos ? pos : header.find_first_not_of(": ", pos + 15);
+    if(value == std::string::npos || header.compare(value, 5, "False") != 0){
+      ConversionContext::err() << "ERROR: Only C-ordered .npy arrays are supported" << std::endl;
+      return false;
+    }
+
+    pos = header.find("'shape'");
+    begin = pos == std::string::npos ? pos : header.find('(', pos);
+    end = begin == std::string::npos ? begin : header.find(')', begin);
+    if(end == std::string::npos){
+      ConversionContext::err() << "ERROR: .npy header without shape" << std::endl;
+      return false;
+    }
+    array.shape.clear();
+    std::stringstream shape(header.substr(begin + 1, end - begin - 1));
+    std::string item;
+    while(std::getline(shape, item, ',')){
+      if(item.find_first_not_of(" ") == std::string::npos)
+        continue;
+      array.shape.push_back(size_t(strtoull(item.c_str(), NULL, 10)));
+    }
+    return true;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool NumpyIO::parseTypeString(const std::string &descr, std::string &dtype) {
+    if(descr.size() < 2){
+      ConversionContext::err() << "ERROR: Invalid array type " << descr << std::endl;
+      return false;
+    }
+    // single byte types have no byte order ('|'), '=' is the native one
+    const char byteOrder = descr[0];
+    const char nativeByteOrder = gLocalByteOrder == EBO_BigEndian ? '>' : '<';
+    if(byteOrder != '|' && byteOrder != '=' && byteOrder != nativeByteOrder){
+      ConversionContext::err() << "ERROR: Array type " << descr << " does not use the byte order of this machine" << std::endl;
+      return false;
+    }
+    dtype = descr.substr(1);
+    return true;
+  }
+
+}
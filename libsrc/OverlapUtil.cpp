@@ -19,6 +19,7 @@
  *
  */
 
+#include "dcmqi/ConversionContext.h"
 #include "dcmqi/OverlapUtil.h"
 #include "dcmtk/dcmdata/dcerror.h"
 #include "dcmtk/dcmfg/fginterface.h"
@@ -169,7 +170,7 @@ OFCondition OverlapUtil::ensureFramesAreParallel()
                                                    m_imageOrientation[3],
                                                    m_imageOrientation[4],
                                                    m_imageOrientation[5]);
-            std::cout << "Image Orientation Patient set to : " << m_imageOrientation[0] << ", " << m_imageOrientation[1]
+            ConversionContext::out() << "Image Orientation Patient set to : " << m_imageOrientation[0] << ", " << m_imageOrientation[1]
                       << ", " << m_imageOrientation[2] << ", " << m_imageOrientation[3] << ", " << m_imageOrientation[4]
                       << ", " << m_imageOrientation[5] << std::endl;
             return cond;
@@ -780,7 +781,7 @@ OFCondition OverlapUtil::groupFramesByLogicalPosition()
             }
             else
             {
-                std::cerr
+                ConversionContext::err()
                     << "groupFramesByPosition(): Cannot identify coordinate relevant for sorting frames by position"
                     << std::endl;
                 cond = EC_InvalidValue;
@@ -788,14 +789,14 @@ OFCondition OverlapUtil::groupFramesByLogicalPosition()
         }
         else
         {
-            std::cerr << "groupFramesByPosition(): Slice Thickness not found, cannot sort frames by position"
+            ConversionContext::err() << "groupFramesByPosition(): Slice Thickness not found, cannot sort frames by position"
                       << std::endl;
             cond = EC_TagNotFound;
         }
     }
     else
     {
-        std::cerr << "groupFramesByPosition(): Pixel Measures FG not found, cannot sort frames by position"
+        ConversionContext::err() << "groupFramesByPosition(): Pixel Measures FG not found, cannot sort frames by position"
                   << std::endl;
         cond = EC_TagNotFound;
     }
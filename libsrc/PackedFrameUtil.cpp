@@ -0,0 +1,761 @@
+
+// DCMQI includes
+#include "dcmqi/PackedFrameUtil.h"
+#include "dcmqi/QIICRUIDs.h"
+
+// DCMTK includes
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcpixel.h"
+#include "dcmtk/dcmdata/dcswap.h"
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/dcmdata/dcvrat.h"
+#include "dcmtk/dcmdata/dcvrda.h"
+#include "dcmtk/dcmdata/dcvrtm.h"
+#include "dcmtk/dcmseg/segtypes.h"
+
+#include <cstring>
+#include <set>
+#include <string>
+
+makeOFConditionConst(SG_EC_LabelmapNotSupported, OFM_dcmseg, 8, OF_error,
+                     "LABELMAP segmentations are not supported by this operation");
+
+namespace dcmqi
+{
+
+PackedFrameUtil::PackedFrameUtil()
+    : m_dataset(NULL)
+    , m_pixelData(NULL)
+    , m_pixelDataLength(0)
+    , m_rows(0)
+    , m_columns(0)
+    , m_bitsAllocated(0)
+    , m_numberOfFrames(0)
+    , m_labelmap(OFFalse)
+    , m_segmentItems()
+    , m_perFrameItems()
+    , m_sharedItem(NULL)
+    , m_frameSegmentNumbers()
+{
+}
+
+PackedFrameUtil::~PackedFrameUtil()
+{
+    // nothing to do, all items are owned by the dataset
+}
+
+// -------------------------------------------------------------------------------------
+
+void PackedFrameUtil::clear()
+{
+    m_dataset         = NULL;
+    m_pixelData       = NULL;
+    m_pixelDataLength = 0;
+    m_rows            = 0;
+    m_columns         = 0;
+    m_bitsAllocated   = 0;
+    m_numberOfFrames  = 0;
+    m_labelmap        = OFFalse;
+    m_segmentItems.clear();
+    m_perFrameItems.clear();
+    m_sharedItem = NULL;
+    m_frameSegmentNumbers.clear();
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition PackedFrameUtil::setDataset(DcmDataset* dataset, const OFBool headerOnly, const OFBool allowLabelmap)
+{
+    clear();
+    if (!dataset)
+    {
+        return EC_IllegalParameter;
+    }
+
+    OFString sopClass, segmentationType;
+    dataset->findAndGetOFString(DCM_SOPClassUID, sopClass);
+    dataset->findAndGetOFString(DCM_SegmentationType, segmentationType);
+    if ((sopClass == UID_LabelMapSegmentationStorage) && (segmentationType == "LABELMAP"))
+    {
+        if (!allowLabelmap)
+        {
+            DCMSEG_ERROR("setDataset(): LABELMAP segmentations are not supported by this operation");
+            return SG_EC_LabelmapNotSupported;
+        }
+        m_labelmap = OFTrue;
+    }
+    else if ((sopClass != UID_SegmentationStorage)
+             || ((segmentationType != "BINARY") && (segmentationType != "FRACTIONAL")))
+    {
+        DCMSEG_ERROR("setDataset(): Only BINARY, FRACTIONAL and LABELMAP segmentations are supported (Segmentation Type is "
+                     << segmentationType << ")");
+        return EC_IllegalParameter;
+    }
+
+    Sint32 numberOfFrames = 0;
+    dataset->findAndGetUint16(DCM_Rows, m_rows);
+    dataset->findAndGetUint16(DCM_Columns, m_columns);
+    dataset->findAndGetUint16(DCM_BitsAllocated, m_bitsAllocated);
+    dataset->findAndGetSint32(DCM_NumberOfFrames, numberOfFrames);
+    const OFBool validBits = m_labelmap ? ((m_bitsAllocated == 8) || (m_bitsAllocated == 16))
+                                        : ((m_bitsAllocated == 1) || (m_bitsAllocated == 8));
+    if (!m_rows || !m_columns || (numberOfFrames <= 0) || !validBits)
+    {
+        DCMSEG_ERROR("setDataset(): Invalid image pixel attributes");
+        clear();
+        return EC_IllegalParameter;
+    }
+    m_numberOfFrames = OFstatic_cast(Uint32, numberOfFrames);
+
+    // Make sure pixel data is available uncompressed, unless only the header is of interest
+    if (!headerOnly)
+    {
+        OFCondition result = dataset->chooseRepresentation(EXS_LittleEndianExplicit, NULL);
+        if (result.bad())
+        {
+            DCMSEG_ERROR("setDataset(): Cannot decompress pixel data: " << result.text());
+            return result;
+        }
+        DcmElement* pixelData = NULL;
+        Uint8* pixelValues    = NULL;
+        result                = dataset->findAndGetElement(DCM_PixelData, pixelData);
+        if (result.good() && (m_bitsAllocated == 16))
+        {
+            // OW, in local byte order
+            Uint16* wordValues = NULL;
+            result             = pixelData->getUint16Array(wordValues);
+            pixelValues        = OFreinterpret_cast(Uint8*, wordValues);
+        }
+        else if (result.good())
+        {
+            result = pixelData->getUint8Array(pixelValues);
+        }
+        if (result.bad() || !pixelValues)
+        {
+            DCMSEG_ERROR("setDataset(): Pixel Data not present");
+            clear();
+            return EC_IllegalParameter;
+        }
+        m_pixelData       = pixelValues;
+        m_pixelDataLength = pixelData->getLength();
+        if (m_pixelDataLength * 8 < getFrameSizeInBits() * m_numberOfFrames)
+        {
+            DCMSEG_ERROR("setDataset(): Pixel Data is too short for " << m_numberOfFrames << " frames");
+            clear();
+            return EC_IllegalParameter;
+        }
+    }
+
+    // Segments
+    DcmSequenceOfItems* segmentSeq = NULL;
+    if (dataset->findAndGetSequence(DCM_SegmentSequence, segmentSeq).good() && segmentSeq)
+    {
+        for (unsigned long i = 0; i < segmentSeq->card(); i++)
+        {
+            Uint16 segmentNumber = 0;
+            DcmItem* item        = segmentSeq->getItem(i);
+            if (item->findAndGetUint16(DCM_SegmentNumber, segmentNumber).bad() || !segmentNumber)
+            {
+                DCMSEG_ERROR("setDataset(): Segment Sequence item #" << i << " has no valid Segment Number");
+                return EC_IllegalParameter;
+            }
+            m_segmentItems[segmentNumber] = item;
+        }
+    }
+
+    // Functional groups
+    dataset->findAndGetSequenceItem(DCM_SharedFunctionalGroupsSequence, m_sharedItem, 0);
+    DcmSequenceOfItems* perFrameSeq = NULL;
+    dataset->findAndGetSequence(DCM_PerFrameFunctionalGroupsSequence, perFrameSeq);
+    if (perFrameSeq && (perFrameSeq->card() != m_numberOfFrames))
+    {
+        DCMSEG_ERROR("setDataset(): Number of per-frame functional group items (" << perFrameSeq->card()
+                                                                                  << ") does not match number of frames ("
+                                                                                  << m_numberOfFrames << ")");
+        return EC_IllegalParameter;
+    }
+    m_perFrameItems.resize(m_numberOfFrames, NULL);
+    for (Uint32 f = 0; perFrameSeq && (f < m_numberOfFrames); f++)
+    {
+        m_perFrameItems[f] = perFrameSeq->getItem(f);
+    }
+
+    m_dataset = dataset;
+
+    // Frames of a label map hold all segments, their pixel values are the segment numbers
+    m_frameSegmentNumbers.resize(m_numberOfFrames, 0);
+    for (Uint32 f = 0; !m_labelmap && (f < m_numberOfFrames); f++)
+    {
+        DcmItem* segIdItem = findFunctionalGroup(f, DCM_SegmentIdentificationSequence);
+        if (!segIdItem || segIdItem->findAndGetUint16(DCM_ReferencedSegmentNumber, m_frameSegmentNumbers[f]).bad()
+            || (m_segmentItems.find(m_frameSegmentNumbers[f]) == m_segmentItems.end()))
+        {
+            DCMSEG_ERROR("setDataset(): Frame #" << f << " does not reference a valid segment");
+            clear();
+            return EC_IllegalParameter;
+        }
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+DcmDataset* PackedFrameUtil::getDataset() const
+{
+    return m_dataset;
+}
+
+OFBool PackedFrameUtil::hasPixelData() const
+{
+    return m_pixelData != NULL;
+}
+
+Uint16 PackedFrameUtil::getRows() const
+{
+    return m_rows;
+}
+
+Uint16 PackedFrameUtil::getColumns() const
+{
+    return m_columns;
+}
+
+Uint16 PackedFrameUtil::getBitsAllocated() const
+{
+    return m_bitsAllocated;
+}
+
+OFBool PackedFrameUtil::isLabelmap() const
+{
+    return m_labelmap;
+}
+
+Uint32 PackedFrameUtil::getNumberOfFrames() const
+{
+    return m_numberOfFrames;
+}
+
+size_t PackedFrameUtil::getFrameSizeInBits() const
+{
+    return OFstatic_cast(size_t, m_rows) * m_columns * m_bitsAllocated;
+}
+
+Uint16 PackedFrameUtil::getNumberOfSegments() const
+{
+    return OFstatic_cast(Uint16, m_segmentItems.size());
+}
+
+// -------------------------------------------------------------------------------------
+
+OFVector<Uint16> PackedFrameUtil::getSegmentNumbers() const
+{
+    OFVector<Uint16> result;
+    for (std::map<Uint16, DcmItem*>::const_iterator it = m_segmentItems.begin(); it != m_segmentItems.end(); ++it)
+    {
+        result.push_back(it->first);
+    }
+    return result;
+}
+
+// -------------------------------------------------------------------------------------
+
+DcmItem* PackedFrameUtil::getSegmentItem(const Uint16 segmentNumber) const
+{
+    std::map<Uint16, DcmItem*>::const_iterator it = m_segmentItems.find(segmentNumber);
+    return (it != m_segmentItems.end()) ? it->second : NULL;
+}
+
+// -------------------------------------------------------------------------------------
+
+DcmItem* PackedFrameUtil::getPerFrameItem(const Uint32 frameNo) const
+{
+    return (frameNo < m_perFrameItems.size()) ? m_perFrameItems[frameNo] : NULL;
+}
+
+// -------------------------------------------------------------------------------------
+
+Uint16 PackedFrameUtil::getSegmentNumberOfFrame(const Uint32 frameNo) const
+{
+    return (frameNo < m_frameSegmentNumbers.size()) ? m_frameSegmentNumbers[frameNo] : 0;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition PackedFrameUtil::getFramesForSegment(const Uint16 segmentNumber, OFVector<Uint32>& frames) const
+{
+    if (!getSegmentItem(segmentNumber))
+    {
+        DCMSEG_ERROR("getFramesForSegment(): Segment number " << segmentNumber << " does not exist");
+        return EC_IllegalParameter;
+    }
+    frames.clear();
+    for (Uint32 f = 0; f < m_numberOfFrames; f++)
+    {
+        if (m_labelmap || (m_frameSegmentNumbers[f] == segmentNumber))
+        {
+            frames.push_back(f);
+        }
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition PackedFrameUtil::getImagePosition(const Uint32 frameNo, ImagePosition& position) const
+{
+    DcmItem* item = findFunctionalGroup(frameNo, DCM_PlanePositionSequence);
+    position.resize(3);
+    for (unsigned long i = 0; item && (i < 3); i++)
+    {
+        if (item->findAndGetFloat64(DCM_ImagePositionPatient, position[i], i).bad())
+        {
+            item = NULL;
+        }
+    }
+    if (!item)
+    {
+        DCMSEG_ERROR("getImagePosition(): Image Position Patient not found for frame #" << frameNo);
+        return EC_TagNotFound;
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition PackedFrameUtil::getImageOrientation(OFVector<Float64>& orientation) const
+{
+    DcmItem* item = NULL;
+    if (m_sharedItem)
+    {
+        m_sharedItem->findAndGetSequenceItem(DCM_PlaneOrientationSequence, item, 0);
+    }
+    orientation.resize(6);
+    for (unsigned long i = 0; item && (i < 6); i++)
+    {
+        if (item->findAndGetFloat64(DCM_ImageOrientationPatient, orientation[i], i).bad())
+        {
+            item = NULL;
+        }
+    }
+    if (!item)
+    {
+        DCMSEG_ERROR("getImageOrientation(): Image Orientation Patient is not shared by all frames");
+        return EC_TagNotFound;
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition PackedFrameUtil::getPixelSpacing(OFVector<Float64>& spacing) const
+{
+    DcmItem* item = NULL;
+    if (m_sharedItem)
+    {
+        m_sharedItem->findAndGetSequenceItem(DCM_PixelMeasuresSequence, item, 0);
+    }
+    spacing.resize(2);
+    for (unsigned long i = 0; item && (i < 2); i++)
+    {
+        if (item->findAndGetFloat64(DCM_PixelSpacing, spacing[i], i).bad())
+        {
+            item = NULL;
+        }
+    }
+    if (!item)
+    {
+        DCMSEG_ERROR("getPixelSpacing(): Pixel Spacing is not shared by all frames");
+        return EC_TagNotFound;
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition PackedFrameUtil::getPackedFrame(const Uint32 frameNo, OFVector<Uint8>& frame) const
+{
+    if ((frameNo >= m_numberOfFrames) || !m_pixelData)
+    {
+        return EC_IllegalParameter;
+    }
+    const size_t numBits  = getFrameSizeInBits();
+    const size_t numBytes = (numBits + 7) / 8;
+    const size_t startBit = numBits * frameNo;
+    const size_t shift    = startBit % 8;
+    const Uint8* src      = m_pixelData + startBit / 8;
+    const Uint8* end      = m_pixelData + m_pixelDataLength;
+
+    frame.resize(numBytes);
+    if (shift == 0)
+    {
+        memcpy(&frame[0], src, numBytes);
+    }
+    else
+    {
+        // Frame starts within a byte: shift bits of two source bytes into each target byte
+        for (size_t i = 0; i < numBytes; i++)
+        {
+            Uint8 value = OFstatic_cast(Uint8, src[i] >> shift);
+            if (src + i + 1 < end)
+            {
+                value |= OFstatic_cast(Uint8, src[i + 1] << (8 - shift));
+            }
+            frame[i] = value;
+        }
+    }
+    // Clear bits belonging to the next frame
+    if (numBits % 8)
+    {
+        frame[numBytes - 1] &= OFstatic_cast(Uint8, (1 << (numBits % 8)) - 1);
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition PackedFrameUtil::getFrameMask(const Uint32 frameNo, OFVector<Uint64>& words, const Uint16 label) const
+{
+    const size_t numPixels = OFstatic_cast(size_t, m_rows) * m_columns;
+    words.assign((numPixels + 63) / 64, 0);
+    OFVector<Uint8> buffer;
+    const Uint8* frame = getAlignedFrame(frameNo);
+    if (!frame)
+    {
+        OFCondition cond = getPackedFrame(frameNo, buffer);
+        if (cond.bad())
+        {
+            return cond;
+        }
+        frame = &buffer[0];
+    }
+
+    if (m_bitsAllocated == 1)
+    {
+        // An aligned frame may share its last byte with the next frame
+        const size_t numBytes = (numPixels + 7) / 8;
+        Uint8* bytes          = OFreinterpret_cast(Uint8*, &words[0]);
+        memcpy(bytes, frame, numBytes);
+        if (numPixels % 8)
+            bytes[numBytes - 1] &= OFstatic_cast(Uint8, (1 << (numPixels % 8)) - 1);
+        if (gLocalByteOrder == EBO_BigEndian)
+            swapBytes(bytes, OFstatic_cast(Uint32, words.size() * sizeof(Uint64)), sizeof(Uint64));
+    }
+    else if (m_bitsAllocated == 16)
+    {
+        const Uint16* values = OFreinterpret_cast(const Uint16*, frame);
+        for (size_t p = 0; p < numPixels; p++)
+        {
+            if (label ? (values[p] == label) : (values[p] != 0))
+                words[p / 64] |= OFstatic_cast(Uint64, 1) << (p % 64);
+        }
+    }
+    else
+    {
+        for (size_t p = 0; p < numPixels; p++)
+        {
+            if (label ? (frame[p] == label) : (frame[p] != 0))
+                words[p / 64] |= OFstatic_cast(Uint64, 1) << (p % 64);
+        }
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+const Uint8* PackedFrameUtil::getAlignedFrame(const Uint32 frameNo) const
+{
+    const size_t startBit = getFrameSizeInBits() * frameNo;
+    if ((frameNo >= m_numberOfFrames) || (startBit % 8) || !m_pixelData)
+    {
+        return NULL;
+    }
+    return m_pixelData + startBit / 8;
+}
+
+// -------------------------------------------------------------------------------------
+
+void PackedFrameUtil::appendBits(OFVector<Uint8>& buffer, size_t& bitOffset, const Uint8* data, const size_t numBits)
+{
+    const size_t newBitOffset = bitOffset + numBits;
+    const size_t numBytes     = (numBits + 7) / 8;
+    const size_t shift        = bitOffset % 8;
+    const size_t firstByte    = bitOffset / 8;
+    buffer.resize((newBitOffset + 7) / 8, 0);
+
+    if (shift == 0)
+    {
+        memcpy(&buffer[firstByte], data, numBytes);
+    }
+    else
+    {
+        // Target byte is partially filled: split each source byte over two target bytes
+        for (size_t i = 0; i < numBytes; i++)
+        {
+            buffer[firstByte + i] |= OFstatic_cast(Uint8, data[i] << shift);
+            if (firstByte + i + 1 < buffer.size())
+            {
+                buffer[firstByte + i + 1] |= OFstatic_cast(Uint8, data[i] >> (8 - shift));
+            }
+        }
+    }
+    // Bits beyond the end must be 0, since next append ORs into them
+    if (newBitOffset % 8)
+    {
+        buffer.back() &= OFstatic_cast(Uint8, (1 << (newBitOffset % 8)) - 1);
+    }
+    bitOffset = newBitOffset;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition PackedFrameUtil::buildSegmentation(const PackedFrameUtil& headerTemplate,
+                                               const OFVector<SegmentReference>& segments,
+                                               const OFVector<FrameReference>& frames,
+                                               DcmDataset& result)
+{
+    DcmDataset* templateDataset = headerTemplate.getDataset();
+    if (!templateDataset || segments.empty() || frames.empty())
+    {
+        return EC_IllegalParameter;
+    }
+    if (headerTemplate.isLabelmap())
+    {
+        return SG_EC_LabelmapNotSupported;
+    }
+    const int segmentDimension = headerTemplate.getSegmentDimension();
+    const size_t frameBits     = headerTemplate.getFrameSizeInBits();
+
+    // Copy header, leaving out everything that is rebuilt below
+    result.clear();
+    OFCondition cond;
+    for (unsigned long i = 0; cond.good() && (i < templateDataset->card()); i++)
+    {
+        DcmElement* elem    = templateDataset->getElement(i);
+        const DcmTagKey tag = elem->getTag();
+        if ((tag == DCM_SegmentSequence) || (tag == DCM_PerFrameFunctionalGroupsSequence)
+            || (tag == DCM_NumberOfFrames) || (tag == DCM_PixelData) || (tag == DCM_ReferencedSeriesSequence))
+        {
+            continue;
+        }
+        cond = result.insert(OFstatic_cast(DcmElement*, elem->clone()));
+    }
+
+    // Segment identification is written per frame, so it must not be shared as well
+    DcmItem* sharedItem = NULL;
+    if (cond.good() && result.findAndGetSequenceItem(DCM_SharedFunctionalGroupsSequence, sharedItem, 0).good())
+    {
+        sharedItem->findAndDeleteElement(DCM_SegmentIdentificationSequence);
+    }
+
+    // Segment Sequence
+    DcmSequenceOfItems* segmentSeq = new DcmSequenceOfItems(DCM_SegmentSequence);
+    for (size_t s = 0; cond.good() && (s < segments.size()); s++)
+    {
+        DcmItem* item = segments[s].m_source->getSegmentItem(segments[s].m_segmentNumber);
+        if (!item)
+        {
+            DCMSEG_ERROR("buildSegmentation(): Segment " << segments[s].m_segmentNumber << " not found");
+            cond = EC_IllegalParameter;
+            break;
+        }
+        DcmItem* newItem = OFstatic_cast(DcmItem*, item->clone());
+        cond             = newItem->putAndInsertUint16(DCM_SegmentNumber, segments[s].m_newSegmentNumber);
+        if (cond.good())
+            cond = segmentSeq->append(newItem);
+        else
+            delete newItem;
+    }
+    if (cond.good())
+        cond = result.insert(segmentSeq);
+    else
+        delete segmentSeq;
+
+    // Per-frame functional groups and pixel data
+    DcmSequenceOfItems* perFrameSeq = new DcmSequenceOfItems(DCM_PerFrameFunctionalGroupsSequence);
+    OFVector<Uint8> pixelData;
+    pixelData.reserve((frameBits * frames.size() + 7) / 8 + 1);
+    size_t bitOffset = 0;
+    OFVector<Uint8> packedFrame;
+    for (size_t f = 0; cond.good() && (f < frames.size()); f++)
+    {
+        const PackedFrameUtil* source = frames[f].m_source;
+        if ((source->getFrameSizeInBits() != frameBits) || (source->getSegmentDimension() != segmentDimension)
+            || source->isLabelmap())
+        {
+            DCMSEG_ERROR("buildSegmentation(): Frame #" << frames[f].m_frameNumber
+                                                        << " is incompatible with the header template");
+            cond = EC_IllegalParameter;
+            break;
+        }
+        DcmItem* item    = source->getPerFrameItem(frames[f].m_frameNumber);
+        DcmItem* newItem = item ? OFstatic_cast(DcmItem*, item->clone()) : new DcmItem();
+        cond             = setFrameSegmentNumber(*newItem, frames[f].m_newSegmentNumber, segmentDimension);
+        if (cond.good())
+            cond = perFrameSeq->append(newItem);
+        else
+            delete newItem;
+
+        const Uint8* aligned = source->getAlignedFrame(frames[f].m_frameNumber);
+        if (!aligned && cond.good())
+        {
+            cond    = source->getPackedFrame(frames[f].m_frameNumber, packedFrame);
+            aligned = &packedFrame[0];
+        }
+        if (cond.good())
+            appendBits(pixelData, bitOffset, aligned, frameBits);
+    }
+    if (cond.good())
+        cond = result.insert(perFrameSeq);
+    else
+        delete perFrameSeq;
+
+    if (cond.good())
+    {
+        // Pixel Data must have even length
+        if (pixelData.size() % 2)
+            pixelData.push_back(0);
+        cond = result.putAndInsertOFStringArray(DCM_NumberOfFrames, std::to_string(frames.size()).c_str());
+        if (cond.good())
+            cond = result.putAndInsertUint8Array(DCM_PixelData, &pixelData[0], pixelData.size());
+    }
+
+    // Combine referenced series and instances of all sources, keeping the order
+    if (cond.good())
+    {
+        std::set<const PackedFrameUtil*> visited;
+        OFVector<const PackedFrameUtil*> sources;
+        sources.push_back(&headerTemplate);
+        for (size_t s = 0; s < segments.size(); s++)
+        {
+            sources.push_back(segments[s].m_source);
+        }
+
+        DcmSequenceOfItems* refSeriesSeq = new DcmSequenceOfItems(DCM_ReferencedSeriesSequence);
+        std::map<OFString, DcmItem*> seriesItems;
+        std::set<OFString> instanceUIDs;
+        for (size_t s = 0; s < sources.size(); s++)
+        {
+            if (!visited.insert(sources[s]).second)
+                continue;
+            DcmSequenceOfItems* srcSeriesSeq = NULL;
+            if (sources[s]->getDataset()->findAndGetSequence(DCM_ReferencedSeriesSequence, srcSeriesSeq).bad()
+                || !srcSeriesSeq)
+                continue;
+            for (unsigned long i = 0; i < srcSeriesSeq->card(); i++)
+            {
+                DcmItem* srcSeries = srcSeriesSeq->getItem(i);
+                OFString seriesUID;
+                srcSeries->findAndGetOFString(DCM_SeriesInstanceUID, seriesUID);
+                DcmItem* targetSeries = seriesItems[seriesUID];
+                if (!targetSeries)
+                {
+                    targetSeries = new DcmItem();
+                    targetSeries->putAndInsertString(DCM_SeriesInstanceUID, seriesUID.c_str());
+                    refSeriesSeq->append(targetSeries);
+                    seriesItems[seriesUID] = targetSeries;
+                }
+                DcmSequenceOfItems* srcInstanceSeq = NULL;
+                if (srcSeries->findAndGetSequence(DCM_ReferencedInstanceSequence, srcInstanceSeq).bad()
+                    || !srcInstanceSeq)
+                    continue;
+                for (unsigned long j = 0; j < srcInstanceSeq->card(); j++)
+                {
+                    OFString instanceUID;
+                    srcInstanceSeq->getItem(j)->findAndGetOFString(DCM_ReferencedSOPInstanceUID, instanceUID);
+                    if (instanceUIDs.insert(instanceUID).second)
+                    {
+                        targetSeries->insertSequenceItem(DCM_ReferencedInstanceSequence,
+                                                         OFstatic_cast(DcmItem*, srcInstanceSeq->getItem(j)->clone()));
+                    }
+                }
+            }
+        }
+        if (refSeriesSeq->card() > 0)
+            cond = result.insert(refSeriesSeq);
+        else
+            delete refSeriesSeq;
+    }
+
+    // New instance in a new series
+    if (cond.good())
+    {
+        char uid[100];
+        OFString date, time;
+        DcmDate::getCurrentDate(date);
+        DcmTime::getCurrentTime(time);
+        cond = result.putAndInsertString(DCM_SOPInstanceUID, dcmGenerateUniqueIdentifier(uid, QIICR_UID_ROOT));
+        if (cond.good())
+            cond = result.putAndInsertString(DCM_SeriesInstanceUID, dcmGenerateUniqueIdentifier(uid, QIICR_UID_ROOT));
+        if (cond.good())
+            cond = result.putAndInsertString(DCM_InstanceCreationDate, date.c_str());
+        if (cond.good())
+            cond = result.putAndInsertString(DCM_InstanceCreationTime, time.c_str());
+        if (cond.good())
+            cond = result.putAndInsertString(DCM_ContentDate, date.c_str());
+        if (cond.good())
+            cond = result.putAndInsertString(DCM_ContentTime, time.c_str());
+    }
+    return cond;
+}
+
+// -------------------------------------------------------------------------------------
+
+DcmItem* PackedFrameUtil::findFunctionalGroup(const Uint32 frameNo, const DcmTagKey& fgSequence) const
+{
+    DcmItem* item     = NULL;
+    DcmItem* perFrame = getPerFrameItem(frameNo);
+    if (perFrame && perFrame->findAndGetSequenceItem(fgSequence, item, 0).good() && item)
+    {
+        return item;
+    }
+    if (m_sharedItem && m_sharedItem->findAndGetSequenceItem(fgSequence, item, 0).good())
+    {
+        return item;
+    }
+    return NULL;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition PackedFrameUtil::setFrameSegmentNumber(DcmItem& perFrameItem, const Uint16 segmentNumber, const int segmentDimension)
+{
+    DcmItem* segIdItem = NULL;
+    OFCondition cond   = perFrameItem.findOrCreateSequenceItem(DCM_SegmentIdentificationSequence, segIdItem, 0);
+    if (cond.good())
+        cond = segIdItem->putAndInsertUint16(DCM_ReferencedSegmentNumber, segmentNumber);
+
+    DcmItem* frameContentItem = NULL;
+    DcmElement* indexValues   = NULL;
+    if (cond.good() && (segmentDimension >= 0)
+        && perFrameItem.findAndGetSequenceItem(DCM_FrameContentSequence, frameContentItem, 0).good()
+        && frameContentItem->findAndGetElement(DCM_DimensionIndexValues, indexValues).good())
+    {
+        cond = indexValues->putUint32(segmentNumber, OFstatic_cast(unsigned long, segmentDimension));
+    }
+    return cond;
+}
+
+// -------------------------------------------------------------------------------------
+
+int PackedFrameUtil::getSegmentDimension() const
+{
+    DcmSequenceOfItems* dimSeq = NULL;
+    if (!m_dataset || m_dataset->findAndGetSequence(DCM_DimensionIndexSequence, dimSeq).bad() || !dimSeq)
+    {
+        return -1;
+    }
+    for (unsigned long i = 0; i < dimSeq->card(); i++)
+    {
+        DcmElement* pointer = NULL;
+        DcmTagKey key;
+        if (dimSeq->getItem(i)->findAndGetElement(DCM_DimensionIndexPointer, pointer).good()
+            && OFstatic_cast(DcmAttributeTag*, pointer)->getTagVal(key, 0).good()
+            && (key == DCM_ReferencedSegmentNumber))
+        {
+            return OFstatic_cast(int, i);
+        }
+    }
+    return -1;
+}
+
+} // namespace dcmqi
@@ -43,7 +43,7 @@ namespace dcmqi {
     OFString modality = "MR";
 
     FloatImageType::SizeType inputSize = parametricMapImage->GetBufferedRegion().GetSize();
-    cout << "Input image size: " << inputSize << endl;
+    ConversionContext::out() << "Input image size: " << inputSize << endl;
 
     OFvariant<OFCondition,DPMParametricMapIOD> obj =
         DPMParametricMapIOD::create<IODFloatingPointImagePixelModule>(modality, metaInfo.getSeriesNumber().c_str(),
@@ -94,7 +94,7 @@ namespace dcmqi {
 
       FloatImageType::DirectionType labelDirMatrix = parametricMapImage->GetDirection();
 
-      cout << "Directions: " << labelDirMatrix << endl;
+      ConversionContext::out() << "Directions: " << labelDirMatrix << endl;
 
       FGPlaneOrientationPatient *planor =
           FGPlaneOrientationPatient::createMinimal(
@@ -229,9 +229,9 @@ namespace dcmqi {
         bval->getEntireConceptNameCodeSequence().push_back(qCodeName);
         bval->getEntireMeasurementUnitsCodeSequence().push_back(bvalUnits);
         if(bval->setNumericValue(metaInfo.metaInfoRoot["SourceImageDiffusionBValues"][static_cast<int>(bvalId)].asCString()).bad())
-          cout << "ERROR: Failed to insert the value!" << endl;;
+          ConversionContext::out() << "ERROR: Failed to insert the value!" << endl;;
         realWorldValueMappingItem->getEntireQuantityDefinitionSequence().push_back(bval);
-        cout << bval->toString() << endl;
+        ConversionContext::out() << bval->toString() << endl;
       }
     }
 
@@ -249,14 +249,14 @@ namespace dcmqi {
       cast->SetInput(parametricMapImage);
       cast->Update();
       slice2derimg = getSliceMapForSegmentation2DerivationImage(dcmDatasets, cast->GetOutput());
-      cout << "Mapping from the ITK image slices to the DICOM instances in the input list" << endl;
+      ConversionContext::out() << "Mapping from the ITK image slices to the DICOM instances in the input list" << endl;
       for(size_t i=0;i<slice2derimg.size();i++){
-        cout << "  Slice " << i << ": ";
+        ConversionContext::out() << "  Slice " << i << ": ";
         for(size_t j=0;j<slice2derimg[i].size();j++){
-          cout << slice2derimg[i][j] << " ";
+          ConversionContext::out() << slice2derimg[i][j] << " ";
           hasDerivationImages = true;
         }
-        cout << endl;
+        ConversionContext::out() << endl;
       }
     }
 
@@ -312,7 +312,7 @@ namespace dcmqi {
                                                    metaInfo.getDerivationDescription().c_str(),
                                                    derimgItem));
         } else {
-          cerr << "ERROR: DerivationCode must be specified in the input metadata!" << endl;
+          ConversionContext::err() << "ERROR: DerivationCode must be specified in the input metadata!" << endl;
           throw -1;
         }
 
@@ -398,7 +398,7 @@ namespace dcmqi {
         DPMParametricMapIOD::FramesType frames = pMapDoc->getFrames();
         result = OFget<DPMParametricMapIOD::Frames<FloatPixelType> >(&frames)->addFrame(&*data.begin(), frameSize, perFrameFGs);
 
-        cout << "Frame " << sliceNumber << " added" << endl;
+        ConversionContext::out() << "Frame " << sliceNumber << " added" << endl;
       }
 
       // remove derivation image FG from the per-frame FGs, only if applicable!
@@ -454,10 +454,7 @@ namespace dcmqi {
 
   pair <FloatImageType::Pointer, string> ParaMapConverter::paramap2itkimage(DcmDataset *pmapDataset) {
 
-    DcmRLEDecoderRegistration::registerCodecs();
-
-    OFLogger dcemfinfLogger = OFLog::getLogger("qiicr.apps");
-    dcemfinfLogger.setLogLevel(dcmtk::log4cplus::OFF_LOG_LEVEL);
+    ConversionContext::initialize();
 
     OFvariant<OFCondition,DPMParametricMapIOD*> result = DPMParametricMapIOD::loadDataset(*pmapDataset);
     if (OFget<OFCondition>(&result)) {
@@ -470,7 +467,7 @@ namespace dcmqi {
     FGInterface &fgInterface = pMapDoc->getFunctionalGroups();
     FloatImageType::DirectionType direction;
     if(getImageDirections(fgInterface, direction)){
-      cerr << "ERROR: Failed to get image directions" << endl;
+      ConversionContext::err() << "ERROR: Failed to get image directions" << endl;
       throw -1;
     }
 
@@ -483,14 +480,14 @@ namespace dcmqi {
 
     FloatImageType::PointType imageOrigin;
     if(computeVolumeExtent(fgInterface, sliceDirection, imageOrigin, computedSliceSpacing, computedVolumeExtent)){
-      cerr << "ERROR: Failed to compute origin and/or slice spacing!" << endl;
+      ConversionContext::err() << "ERROR: Failed to compute origin and/or slice spacing!" << endl;
       throw -1;
     }
 
     FloatImageType::SpacingType imageSpacing;
     imageSpacing.Fill(0);
     if(getDeclaredImageSpacing(fgInterface, imageSpacing)){
-      cerr << "ERROR: Failed to get image spacing from DICOM!" << endl;
+      ConversionContext::err() << "ERROR: Failed to get image spacing from DICOM!" << endl;
       throw -1;
     }
 
@@ -498,7 +495,7 @@ namespace dcmqi {
     if(!imageSpacing[2]){
       imageSpacing[2] = computedSliceSpacing;
     } else if(fabs(imageSpacing[2]-computedSliceSpacing)>tolerance){
-      cerr << "WARNING: Declared slice spacing is significantly different from the one declared in DICOM!" <<
+      ConversionContext::err() << "WARNING: Declared slice spacing is significantly different from the one declared in DICOM!" <<
            " Declared = " << imageSpacing[2] << " Computed = " << computedSliceSpacing << endl;
     }
 
@@ -633,7 +630,7 @@ namespace dcmqi {
 
     OFvariant<OFCondition,DPMParametricMapIOD*> result = DPMParametricMapIOD::loadDataset(*pmapDataset);
     if (OFCondition* pCondition = OFget<OFCondition>(&result)) {
-      cerr << "ERROR: Failed to load parametric map! " << pCondition->text() << endl;
+      ConversionContext::err() << "ERROR: Failed to load parametric map! " << pCondition->text() << endl;
       throw -1;
     }
     DPMParametricMapIOD* pMapDoc = *OFget<DPMParametricMapIOD*>(&result);
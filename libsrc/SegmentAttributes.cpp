@@ -123,11 +123,11 @@ namespace dcmqi {
   }
 
   void SegmentAttributes::PrintSelf() {
-    cout << "labelID: " << this->labelID << endl;
+    ConversionContext::out() << "labelID: " << this->labelID << endl;
 //    for (map<string, string>::const_iterator mIt = attributesDictionary.begin();
 //       mIt != attributesDictionary.end(); ++mIt) {
 //      cout << (*mIt).first << " : " << (*mIt).second << endl;
 //    }
-    cout << endl;
+    ConversionContext::out() << endl;
   }
 }
@@ -0,0 +1,600 @@
+// DCMQI includes
+#include "dcmqi/SegmentationComparison.h"
+#include "dcmqi/SegmentationEditor.h"
+#include "dcmqi/SegmentationInfo.h"
+#include "dcmqi/SegmentationStatistics.h"
+
+// DCMTK includes
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmseg/segtypes.h"
+
+// ITK includes
+#include <itkKdTreeGenerator.h>
+#include <itkListSample.h>
+#include <itkMultiThreaderBase.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace dcmqi
+{
+
+namespace
+{
+
+// 95th percentile of unsorted values, nearest rank
+Float64 percentile95(OFVector<Float64> values)
+{
+    const size_t rank = OFstatic_cast(size_t, ceil(0.95 * values.size()));
+    std::nth_element(values.begin(), values.begin() + (rank - 1), values.end());
+    return values[rank - 1];
+}
+
+} // namespace
+
+// -------------------------------------------------------------------------------------
+
+SegmentationComparison::AgreementMetrics::AgreementMetrics()
+    : segments(0, 0)
+    , referenceCount(0)
+    , testCount(0)
+    , intersection(0)
+    , voxelVolume(0)
+    , hasSurfaceDistances(false)
+    , hausdorffDistance(0)
+    , hausdorffDistance95(0)
+    , meanSurfaceDistance(0)
+{
+}
+
+Float64 SegmentationComparison::AgreementMetrics::getDice() const
+{
+    const Uint64 sum = referenceCount + testCount;
+    return sum ? 2.0 * intersection / sum : 1.0;
+}
+
+Float64 SegmentationComparison::AgreementMetrics::getJaccard() const
+{
+    const Uint64 unionCount = referenceCount + testCount - intersection;
+    return unionCount ? OFstatic_cast(Float64, intersection) / unionCount : 1.0;
+}
+
+SegmentationComparison::MaskSource::MaskSource()
+    : seg(NULL)
+    , segmentFrames()
+    , labelmap()
+    , labelmapSlices()
+{
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationComparison::compare(DcmDataset* reference,
+                                            DcmDataset* test,
+                                            const OFVector<SegmentPair>& pairs,
+                                            const bool surfaceDistances,
+                                            OFVector<AgreementMetrics>& metrics)
+{
+    metrics.clear();
+    PackedFrameUtil referenceSeg, testSeg;
+    OFCondition cond = referenceSeg.setDataset(reference);
+    if (cond.good())
+        cond = testSeg.setDataset(test);
+    if (cond.good())
+        cond = SegmentationEditor::checkCompatibleGeometry(referenceSeg, testSeg);
+    Grid grid;
+    if (cond.good())
+        cond = initGrid(referenceSeg, grid);
+    OFVector<SlicePosition> referencePositions, testPositions;
+    if (cond.good())
+        cond = getSlicePositions(referenceSeg, referencePositions);
+    if (cond.good())
+        cond = getSlicePositions(testSeg, testPositions);
+    if (cond.bad())
+    {
+        return cond;
+    }
+    addSlicePositions(referencePositions, grid);
+    addSlicePositions(testPositions, grid);
+
+    MaskSource referenceSource, testSource;
+    cond = mapSegmentation(referenceSeg, grid, referenceSource);
+    if (cond.good())
+        cond = mapSegmentation(testSeg, grid, testSource);
+    if (cond.bad())
+    {
+        return cond;
+    }
+
+    OFVector<SegmentPair> segmentPairs = pairs;
+    if (segmentPairs.empty())
+    {
+        const OFVector<Uint16> segmentNumbers = referenceSeg.getSegmentNumbers();
+        for (size_t s = 0; s < segmentNumbers.size(); s++)
+        {
+            if (testSeg.getSegmentItem(segmentNumbers[s]))
+                segmentPairs.push_back(SegmentPair(segmentNumbers[s], segmentNumbers[s]));
+        }
+    }
+    for (size_t i = 0; i < segmentPairs.size(); i++)
+    {
+        if (!referenceSeg.getSegmentItem(segmentPairs[i].first) || !testSeg.getSegmentItem(segmentPairs[i].second))
+        {
+            DCMSEG_ERROR("compare(): Segment pair " << segmentPairs[i].first << ":" << segmentPairs[i].second
+                                                    << " does not exist");
+            return EC_IllegalParameter;
+        }
+    }
+    return compareSources(grid, referenceSource, testSource, segmentPairs, surfaceDistances, metrics);
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationComparison::compare(DcmDataset* reference,
+                                            ShortImageType::Pointer test,
+                                            const OFVector<SegmentPair>& pairs,
+                                            const bool surfaceDistances,
+                                            OFVector<AgreementMetrics>& metrics)
+{
+    metrics.clear();
+    PackedFrameUtil referenceSeg;
+    Grid grid;
+    OFVector<SlicePosition> referencePositions;
+    OFCondition cond = referenceSeg.setDataset(reference);
+    if (cond.good())
+        cond = initGrid(referenceSeg, grid);
+    if (cond.good())
+        cond = getSlicePositions(referenceSeg, referencePositions);
+    if (cond.good() && (!test || referencePositions.empty()))
+        cond = EC_IllegalParameter;
+    if (cond.bad())
+    {
+        return cond;
+    }
+
+    // The label map must share the in-plane grid, i.e. size, spacing, orientation and alignment
+    const ShortImageType::SizeType size           = test->GetLargestPossibleRegion().GetSize();
+    const ShortImageType::SpacingType spacing     = test->GetSpacing();
+    const ShortImageType::DirectionType direction = test->GetDirection();
+    bool sameGrid = (size[0] == grid.columns) && (size[1] == grid.rows)
+                    && (fabs(spacing[0] - grid.spacing[1]) <= 1e-4 * grid.spacing[1])
+                    && (fabs(spacing[1] - grid.spacing[0]) <= 1e-4 * grid.spacing[0]);
+    for (unsigned i = 0; sameGrid && (i < 3); i++)
+    {
+        sameGrid = (fabs(direction[i][0] - grid.orientation[i]) <= 1e-4)
+                   && (fabs(direction[i][1] - grid.orientation[3 + i]) <= 1e-4);
+    }
+    const Float64 normal[3] = { grid.orientation[1] * grid.orientation[5] - grid.orientation[2] * grid.orientation[4],
+                                grid.orientation[2] * grid.orientation[3] - grid.orientation[0] * grid.orientation[5],
+                                grid.orientation[0] * grid.orientation[4] - grid.orientation[1] * grid.orientation[3] };
+    OFVector<SlicePosition> testPositions;
+    for (itk::SizeValueType k = 0; sameGrid && (k < size[2]); k++)
+    {
+        ShortImageType::IndexType index;
+        index[0] = 0;
+        index[1] = 0;
+        index[2] = OFstatic_cast(itk::IndexValueType, k);
+        ShortImageType::PointType point;
+        test->TransformIndexToPhysicalPoint(index, point);
+        SlicePosition position(0, PackedFrameUtil::ImagePosition(3));
+        for (unsigned i = 0; i < 3; i++)
+        {
+            position.second[i] = point[i];
+            position.first += point[i] * normal[i];
+        }
+        // Slices must not be shifted in-plane against the reference
+        for (size_t axis = 0; sameGrid && (axis < 2); axis++)
+        {
+            Float64 offset = 0;
+            for (size_t i = 0; i < 3; i++)
+            {
+                offset += (position.second[i] - referencePositions[0].second[i]) * grid.orientation[axis * 3 + i];
+            }
+            sameGrid = fabs(offset) <= 0.01 * grid.spacing[1 - axis];
+        }
+        testPositions.push_back(position);
+    }
+    if (!sameGrid)
+    {
+        DCMSEG_ERROR("compare(): Label map is not defined on the pixel grid of the segmentation");
+        return EC_IllegalParameter;
+    }
+    addSlicePositions(referencePositions, grid);
+    addSlicePositions(testPositions, grid);
+
+    MaskSource referenceSource, testSource;
+    cond = mapSegmentation(referenceSeg, grid, referenceSource);
+    if (cond.bad())
+    {
+        return cond;
+    }
+    testSource.labelmap = test;
+    testSource.labelmapSlices.assign(grid.distances.size(), -1);
+    for (size_t k = 0; k < testPositions.size(); k++)
+    {
+        testSource.labelmapSlices[findSlice(grid, testPositions[k].first)] = OFstatic_cast(long, k);
+    }
+
+    OFVector<SegmentPair> segmentPairs = pairs;
+    const OFVector<Uint16> segmentNumbers = referenceSeg.getSegmentNumbers();
+    for (size_t s = 0; pairs.empty() && (s < segmentNumbers.size()); s++)
+    {
+        segmentPairs.push_back(SegmentPair(segmentNumbers[s], segmentNumbers[s]));
+    }
+    for (size_t i = 0; i < segmentPairs.size(); i++)
+    {
+        if (!referenceSeg.getSegmentItem(segmentPairs[i].first))
+        {
+            DCMSEG_ERROR("compare(): Segment " << segmentPairs[i].first << " does not exist");
+            return EC_IllegalParameter;
+        }
+    }
+    return compareSources(grid, referenceSource, testSource, segmentPairs, surfaceDistances, metrics);
+}
+
+// -------------------------------------------------------------------------------------
+
+Json::Value SegmentationComparison::getJSON(const OFVector<AgreementMetrics>& metrics)
+{
+    Json::Value result(Json::arrayValue);
+    for (size_t i = 0; i < metrics.size(); i++)
+    {
+        const AgreementMetrics& m = metrics[i];
+        Json::Value pair;
+        pair["referenceSegment"]       = m.segments.first;
+        pair["testSegment"]            = m.segments.second;
+        pair["referenceVoxelCount"]    = Json::UInt64(m.referenceCount);
+        pair["testVoxelCount"]         = Json::UInt64(m.testCount);
+        pair["intersectionVoxelCount"] = Json::UInt64(m.intersection);
+        pair["referenceVolume"]        = m.referenceCount * m.voxelVolume;
+        pair["testVolume"]             = m.testCount * m.voxelVolume;
+        pair["volumeDifference"]
+            = (OFstatic_cast(Float64, m.testCount) - OFstatic_cast(Float64, m.referenceCount)) * m.voxelVolume;
+        pair["dice"]    = m.getDice();
+        pair["jaccard"] = m.getJaccard();
+        if (m.hasSurfaceDistances)
+        {
+            pair["hausdorffDistance"]   = m.hausdorffDistance;
+            pair["hausdorffDistance95"] = m.hausdorffDistance95;
+            pair["meanSurfaceDistance"] = m.meanSurfaceDistance;
+        }
+        result.append(pair);
+    }
+    return result;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationComparison::initGrid(const PackedFrameUtil& reference, Grid& grid)
+{
+    grid.rows    = reference.getRows();
+    grid.columns = reference.getColumns();
+    grid.positions.clear();
+    grid.distances.clear();
+    OFCondition cond = reference.getImageOrientation(grid.orientation);
+    if (cond.good())
+        cond = reference.getPixelSpacing(grid.spacing);
+    if (cond.good())
+        cond = SegmentationStatistics::getSliceSpacing(reference, grid.sliceSpacing);
+    return cond;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationComparison::getSlicePositions(const PackedFrameUtil& seg, OFVector<SlicePosition>& positions)
+{
+    positions.clear();
+    SegmentationInfo::FramesByPosition framesByPosition;
+    OFCondition cond = SegmentationInfo::getFramesByPosition(seg, framesByPosition);
+    for (size_t p = 0; cond.good() && (p < framesByPosition.size()); p++)
+    {
+        PackedFrameUtil::ImagePosition position;
+        cond = seg.getImagePosition(framesByPosition[p].second[0], position);
+        positions.push_back(SlicePosition(framesByPosition[p].first, position));
+    }
+    return cond;
+}
+
+// -------------------------------------------------------------------------------------
+
+void SegmentationComparison::addSlicePositions(const OFVector<SlicePosition>& positions, Grid& grid)
+{
+    for (size_t p = 0; p < positions.size(); p++)
+    {
+        if (findSlice(grid, positions[p].first) >= 0)
+            continue;
+        const size_t index = std::lower_bound(grid.distances.begin(), grid.distances.end(), positions[p].first)
+                             - grid.distances.begin();
+        grid.distances.insert(grid.distances.begin() + index, positions[p].first);
+        grid.positions.insert(grid.positions.begin() + index, positions[p].second);
+    }
+}
+
+// -------------------------------------------------------------------------------------
+
+long SegmentationComparison::findSlice(const Grid& grid, const Float64 distance)
+{
+    const size_t index
+        = std::lower_bound(grid.distances.begin(), grid.distances.end(), distance - 1e-3) - grid.distances.begin();
+    if ((index < grid.distances.size()) && (grid.distances[index] <= distance + 1e-3))
+    {
+        return OFstatic_cast(long, index);
+    }
+    return -1;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationComparison::mapSegmentation(const PackedFrameUtil& seg, const Grid& grid, MaskSource& source)
+{
+    SegmentationInfo::FramesByPosition framesByPosition;
+    OFCondition cond = SegmentationInfo::getFramesByPosition(seg, framesByPosition);
+    if (cond.bad())
+    {
+        return cond;
+    }
+    source.seg = &seg;
+    source.segmentFrames.assign(grid.distances.size(), std::map<Uint16, OFVector<Uint32> >());
+    for (size_t p = 0; p < framesByPosition.size(); p++)
+    {
+        const long slice = findSlice(grid, framesByPosition[p].first);
+        for (size_t i = 0; (slice >= 0) && (i < framesByPosition[p].second.size()); i++)
+        {
+            const Uint32 f = framesByPosition[p].second[i];
+            source.segmentFrames[slice][seg.getSegmentNumberOfFrame(f)].push_back(f);
+        }
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationComparison::getMask(const Grid& grid,
+                                            const MaskSource& source,
+                                            const size_t position,
+                                            const Uint16 segment,
+                                            OFVector<Uint64>& words)
+{
+    const size_t numPixels = OFstatic_cast(size_t, grid.rows) * grid.columns;
+    words.assign((numPixels + 63) / 64, 0);
+    if (source.seg)
+    {
+        std::map<Uint16, OFVector<Uint32> >::const_iterator it = source.segmentFrames[position].find(segment);
+        OFVector<Uint64> frame;
+        for (size_t i = 0; (it != source.segmentFrames[position].end()) && (i < it->second.size()); i++)
+        {
+            OFCondition cond = source.seg->getFrameMask(it->second[i], frame);
+            if (cond.bad())
+            {
+                return cond;
+            }
+            for (size_t w = 0; w < words.size(); w++)
+                words[w] |= frame[w];
+        }
+        return EC_Normal;
+    }
+
+    const long slice = source.labelmapSlices[position];
+    if (slice >= 0)
+    {
+        const ShortPixelType* pixels = source.labelmap->GetBufferPointer() + slice * numPixels;
+        for (size_t p = 0; p < numPixels; p++)
+        {
+            if (pixels[p] == OFstatic_cast(ShortPixelType, segment))
+                words[p / 64] |= OFstatic_cast(Uint64, 1) << (p % 64);
+        }
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationComparison::compareSources(const Grid& grid,
+                                                   const MaskSource& reference,
+                                                   const MaskSource& test,
+                                                   const OFVector<SegmentPair>& pairs,
+                                                   const bool surfaceDistances,
+                                                   OFVector<AgreementMetrics>& metrics)
+{
+    const size_t numSlices = grid.distances.size();
+    const size_t numPairs  = pairs.size();
+
+    // Counts and boundary points per slice and pair, reduced after the parallel pass
+    OFVector<AgreementMetrics> sliceMetrics(numSlices * numPairs);
+    OFVector<OFVector<Float64> > referencePoints(surfaceDistances ? numSlices * numPairs : 0);
+    OFVector<OFVector<Float64> > testPoints(surfaceDistances ? numSlices * numPairs : 0);
+    OFVector<OFCondition> results(numSlices);
+    itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+    threader->ParallelizeArray(
+        0,
+        numSlices,
+        [&](itk::SizeValueType p) {
+            // Adjacent slices are needed to tell boundary voxels
+            const bool hasPrevious = (p > 0) && (grid.distances[p] - grid.distances[p - 1] < 1.01 * grid.sliceSpacing);
+            const bool hasNext
+                = (p + 1 < numSlices) && (grid.distances[p + 1] - grid.distances[p] < 1.01 * grid.sliceSpacing);
+            OFVector<Uint64> referenceMask, testMask, previous, next;
+            for (size_t i = 0; i < numPairs; i++)
+            {
+                results[p] = getMask(grid, reference, p, pairs[i].first, referenceMask);
+                if (results[p].good())
+                    results[p] = getMask(grid, test, p, pairs[i].second, testMask);
+                if (results[p].bad())
+                    return;
+
+                AgreementMetrics& m = sliceMetrics[p * numPairs + i];
+                for (size_t w = 0; w < referenceMask.size(); w++)
+                {
+                    m.referenceCount += PackedFrameUtil::countBits(referenceMask[w]);
+                    m.testCount += PackedFrameUtil::countBits(testMask[w]);
+                    m.intersection += PackedFrameUtil::countBits(referenceMask[w] & testMask[w]);
+                }
+                if (!surfaceDistances)
+                    continue;
+
+                const MaskSource* sources[2]            = { &reference, &test };
+                const Uint16 segments[2]                = { pairs[i].first, pairs[i].second };
+                const Uint64 counts[2]                  = { m.referenceCount, m.testCount };
+                const OFVector<Uint64>* masks[2]        = { &referenceMask, &testMask };
+                OFVector<OFVector<Float64> >* points[2] = { &referencePoints, &testPoints };
+                for (size_t s = 0; s < 2; s++)
+                {
+                    if (!counts[s])
+                        continue;
+                    previous.clear();
+                    next.clear();
+                    if (hasPrevious)
+                        results[p] = getMask(grid, *sources[s], p - 1, segments[s], previous);
+                    if (hasNext && results[p].good())
+                        results[p] = getMask(grid, *sources[s], p + 1, segments[s], next);
+                    if (results[p].bad())
+                        return;
+                    addBoundaryPoints(grid, p, *masks[s], previous, next, (*points[s])[p * numPairs + i]);
+                }
+            }
+        },
+        nullptr);
+    for (size_t p = 0; p < numSlices; p++)
+    {
+        if (results[p].bad())
+        {
+            return results[p];
+        }
+    }
+
+    const Float64 voxelVolume = grid.spacing[0] * grid.spacing[1] * grid.sliceSpacing;
+    for (size_t i = 0; i < numPairs; i++)
+    {
+        AgreementMetrics m;
+        m.segments    = pairs[i];
+        m.voxelVolume = voxelVolume;
+        OFVector<Float64> pairReferencePoints, pairTestPoints;
+        for (size_t p = 0; p < numSlices; p++)
+        {
+            const size_t index = p * numPairs + i;
+            m.referenceCount += sliceMetrics[index].referenceCount;
+            m.testCount += sliceMetrics[index].testCount;
+            m.intersection += sliceMetrics[index].intersection;
+            if (surfaceDistances)
+            {
+                pairReferencePoints.insert(
+                    pairReferencePoints.end(), referencePoints[index].begin(), referencePoints[index].end());
+                pairTestPoints.insert(pairTestPoints.end(), testPoints[index].begin(), testPoints[index].end());
+            }
+        }
+        if (surfaceDistances && !pairReferencePoints.empty() && !pairTestPoints.empty())
+        {
+            computeSurfaceDistances(pairReferencePoints, pairTestPoints, m);
+        }
+        metrics.push_back(m);
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+void SegmentationComparison::addBoundaryPoints(const Grid& grid,
+                                               const size_t position,
+                                               const OFVector<Uint64>& mask,
+                                               const OFVector<Uint64>& previous,
+                                               const OFVector<Uint64>& next,
+                                               OFVector<Float64>& points)
+{
+    const size_t rows    = grid.rows;
+    const size_t columns = grid.columns;
+    // Voxels outside the grid and on missing slices are background
+    const bool hasPrevious = !previous.empty();
+    const bool hasNext     = !next.empty();
+    for (size_t w = 0; w < mask.size(); w++)
+    {
+        for (Uint64 bits = mask[w]; bits; bits &= bits - 1)
+        {
+            const size_t i = w * 64 + PackedFrameUtil::lowestBit(bits);
+            const size_t r = i / columns;
+            const size_t c = i % columns;
+            bool interior  = (r > 0) && (r + 1 < rows) && (c > 0) && (c + 1 < columns) && hasPrevious && hasNext;
+            const size_t neighbors[6] = { i - 1, i + 1, i - columns, i + columns, i, i };
+            for (size_t n = 0; interior && (n < 6); n++)
+            {
+                const OFVector<Uint64>& neighborMask = (n < 4) ? mask : ((n == 4) ? previous : next);
+                interior = (neighborMask[neighbors[n] / 64] >> (neighbors[n] % 64)) & 1;
+            }
+            if (interior)
+                continue;
+            for (size_t d = 0; d < 3; d++)
+            {
+                // Columns advance along the row direction, rows along the column direction
+                points.push_back(grid.positions[position][d] + c * grid.spacing[1] * grid.orientation[d]
+                                 + r * grid.spacing[0] * grid.orientation[3 + d]);
+            }
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------
+
+void SegmentationComparison::computeSurfaceDistances(const OFVector<Float64>& referencePoints,
+                                                     const OFVector<Float64>& testPoints,
+                                                     AgreementMetrics& metrics)
+{
+    typedef itk::Vector<Float64, 3> MeasurementVectorType;
+    typedef itk::Statistics::ListSample<MeasurementVectorType> SampleType;
+    typedef itk::Statistics::KdTreeGenerator<SampleType> TreeGeneratorType;
+    typedef TreeGeneratorType::KdTreeType TreeType;
+
+    const OFVector<Float64>* points[2] = { &referencePoints, &testPoints };
+    OFVector<Float64> distances[2];
+    for (size_t s = 0; s < 2; s++)
+    {
+        // Distances of the points of one segment to the boundary of the other one
+        const OFVector<Float64>& from = *points[s];
+        const OFVector<Float64>& to   = *points[1 - s];
+        SampleType::Pointer sample    = SampleType::New();
+        sample->SetMeasurementVectorSize(3);
+        for (size_t i = 0; i < to.size(); i += 3)
+        {
+            MeasurementVectorType v;
+            v[0] = to[i];
+            v[1] = to[i + 1];
+            v[2] = to[i + 2];
+            sample->PushBack(v);
+        }
+        TreeGeneratorType::Pointer generator = TreeGeneratorType::New();
+        generator->SetSample(sample);
+        generator->SetBucketSize(16);
+        generator->Update();
+        const TreeType* tree = generator->GetOutput();
+
+        distances[s].resize(from.size() / 3);
+        itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+        threader->ParallelizeArray(
+            0,
+            distances[s].size(),
+            [&](itk::SizeValueType i) {
+                MeasurementVectorType query;
+                query[0] = from[3 * i];
+                query[1] = from[3 * i + 1];
+                query[2] = from[3 * i + 2];
+                TreeType::InstanceIdentifierVectorType neighbors;
+                tree->Search(query, 1, neighbors);
+                distances[s][i] = (query - tree->GetMeasurementVector(neighbors[0])).GetNorm();
+            },
+            nullptr);
+    }
+
+    Float64 sum = 0;
+    metrics.hausdorffDistance = 0;
+    for (size_t s = 0; s < 2; s++)
+    {
+        for (size_t i = 0; i < distances[s].size(); i++)
+        {
+            sum += distances[s][i];
+            metrics.hausdorffDistance = std::max(metrics.hausdorffDistance, distances[s][i]);
+        }
+    }
+    metrics.hausdorffDistance95 = std::max(percentile95(distances[0]), percentile95(distances[1]));
+    metrics.meanSurfaceDistance = sum / (distances[0].size() + distances[1].size());
+    metrics.hasSurfaceDistances = true;
+}
+
+} // namespace dcmqi
@@ -0,0 +1,757 @@
+
+// DCMQI includes
+#include "dcmqi/SegmentationEditor.h"
+#include "dcmqi/Dicom2ItkConverter.h"
+#include "dcmqi/Itk2DicomConverter.h"
+#include "dcmqi/QIICRUIDs.h"
+
+// DCMTK includes
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcswap.h"
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/dcmseg/segtypes.h"
+
+// ITK includes
+#include <itkMultiThreaderBase.h>
+#include <itkNearestNeighborInterpolateImageFunction.h>
+#include <itkResampleImageFilter.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace dcmqi
+{
+
+OFCondition SegmentationEditor::editSegments(DcmDataset* original,
+                                             DcmDataset* newSegments,
+                                             const OFVector<Uint16>& segmentNumbers,
+                                             DcmDataset& result)
+{
+    PackedFrameUtil originalSeg, newSeg;
+    OFCondition cond = originalSeg.setDataset(original);
+    if (cond.good() && newSegments)
+    {
+        cond = newSeg.setDataset(newSegments);
+        if (cond.good())
+            cond = checkCompatibleGeometry(originalSeg, newSeg);
+    }
+    if (cond.bad())
+    {
+        return cond;
+    }
+
+    for (size_t i = 0; i < segmentNumbers.size(); i++)
+    {
+        if (!originalSeg.getSegmentItem(segmentNumbers[i]))
+        {
+            DCMSEG_ERROR("editSegments(): Segment " << segmentNumbers[i] << " does not exist");
+            return EC_IllegalParameter;
+        }
+    }
+
+    // Replace removed segments one by one by the new segments, append the rest
+    OFVector<Uint16> newSegmentNumbers;
+    if (newSegments)
+    {
+        newSegmentNumbers = newSeg.getSegmentNumbers();
+    }
+    size_t nextNewSegment = 0;
+    OFVector<std::pair<const PackedFrameUtil*, Uint16> > segments;
+    OFVector<Uint16> originalSegmentNumbers = originalSeg.getSegmentNumbers();
+    for (size_t i = 0; i < originalSegmentNumbers.size(); i++)
+    {
+        if (std::find(segmentNumbers.begin(), segmentNumbers.end(), originalSegmentNumbers[i]) == segmentNumbers.end())
+        {
+            segments.push_back(std::make_pair(&originalSeg, originalSegmentNumbers[i]));
+        }
+        else if (nextNewSegment < newSegmentNumbers.size())
+        {
+            segments.push_back(std::make_pair(&newSeg, newSegmentNumbers[nextNewSegment++]));
+        }
+    }
+    for (; nextNewSegment < newSegmentNumbers.size(); nextNewSegment++)
+    {
+        segments.push_back(std::make_pair(&newSeg, newSegmentNumbers[nextNewSegment]));
+    }
+    if (segments.empty())
+    {
+        DCMSEG_ERROR("editSegments(): Resulting segmentation would not contain any segment");
+        return EC_IllegalParameter;
+    }
+
+    OFVector<PackedFrameUtil::SegmentReference> segmentRefs;
+    OFVector<PackedFrameUtil::FrameReference> frameRefs;
+    cond = collectReferences(segments, segmentRefs, frameRefs);
+    if (cond.good())
+    {
+        cond = PackedFrameUtil::buildSegmentation(originalSeg, segmentRefs, frameRefs, result);
+    }
+    // Segments encoded separately may overlap with the existing ones
+    if (cond.good() && newSegments && (segments.size() > 1))
+    {
+        cond = result.putAndInsertString(DCM_SegmentsOverlap, "UNDEFINED");
+    }
+    return cond;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationEditor::mergeSegmentations(const OFVector<DcmDataset*>& inputs,
+                                                   std::vector<DcmDataset*>& sourceDatasets,
+                                                   DcmDataset& result)
+{
+    if (inputs.size() < 2)
+    {
+        DCMSEG_ERROR("mergeSegmentations(): At least two segmentations are required");
+        return EC_IllegalParameter;
+    }
+
+    OFString frameOfRef, otherFrameOfRef;
+    inputs[0]->findAndGetOFString(DCM_FrameOfReferenceUID, frameOfRef);
+
+    // Resampled segmentations are owned here
+    std::vector<std::unique_ptr<DcmDataset> > resampled;
+    OFVector<PackedFrameUtil> segs(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        inputs[i]->findAndGetOFString(DCM_FrameOfReferenceUID, otherFrameOfRef);
+        if (otherFrameOfRef != frameOfRef)
+        {
+            DCMSEG_ERROR("mergeSegmentations(): Segmentation #" << i + 1 << " has a different Frame of Reference ("
+                                                                << otherFrameOfRef << " vs " << frameOfRef << ")");
+            return EC_IllegalParameter;
+        }
+        OFCondition cond = segs[i].setDataset(inputs[i]);
+        if (cond.good() && (i > 0))
+        {
+            cond = checkCompatibleGeometry(segs[0], segs[i]);
+            if (cond.bad() && !sourceDatasets.empty())
+            {
+                ConversionContext::out() << "Segmentation #" << i + 1 << " is defined on a different grid, resampling it" << endl;
+                DcmDataset* resampledSeg = resampleToReference(inputs[0], inputs[i], sourceDatasets);
+                if (!resampledSeg)
+                {
+                    return EC_IllegalCall;
+                }
+                resampled.push_back(std::unique_ptr<DcmDataset>(resampledSeg));
+                cond = segs[i].setDataset(resampledSeg);
+                if (cond.good())
+                    cond = checkCompatibleGeometry(segs[0], segs[i]);
+            }
+        }
+        if (cond.bad())
+        {
+            DCMSEG_ERROR("mergeSegmentations(): Segmentation #" << i + 1 << " cannot be merged: " << cond.text());
+            return cond;
+        }
+    }
+
+    OFVector<std::pair<const PackedFrameUtil*, Uint16> > segments;
+    for (size_t i = 0; i < segs.size(); i++)
+    {
+        OFVector<Uint16> segmentNumbers = segs[i].getSegmentNumbers();
+        for (size_t s = 0; s < segmentNumbers.size(); s++)
+        {
+            segments.push_back(std::make_pair(&segs[i], segmentNumbers[s]));
+        }
+    }
+    if (segments.size() > 65535)
+    {
+        DCMSEG_ERROR("mergeSegmentations(): Too many segments (" << segments.size() << ")");
+        return EC_IllegalParameter;
+    }
+
+    OFVector<PackedFrameUtil::SegmentReference> segmentRefs;
+    OFVector<PackedFrameUtil::FrameReference> frameRefs;
+    OFCondition cond = collectReferences(segments, segmentRefs, frameRefs);
+    if (cond.good())
+    {
+        cond = PackedFrameUtil::buildSegmentation(segs[0], segmentRefs, frameRefs, result);
+    }
+    // Segments of different segmentations may overlap
+    if (cond.good())
+    {
+        cond = result.putAndInsertString(DCM_SegmentsOverlap, "UNDEFINED");
+    }
+    return cond;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationEditor::splitSegmentation(DcmDataset* input,
+                                                  OFVector<DcmDataset*>& results,
+                                                  OFVector<Uint16>& segmentNumbers)
+{
+    results.clear();
+    PackedFrameUtil seg;
+    OFCondition cond = seg.setDataset(input);
+    if (cond.bad())
+    {
+        return cond;
+    }
+    const OFVector<Uint16> allSegmentNumbers = seg.getSegmentNumbers();
+    segmentNumbers.clear();
+
+    char uid[100];
+    OFString seriesUID(dcmGenerateUniqueIdentifier(uid, QIICR_UID_ROOT));
+    for (size_t s = 0; cond.good() && (s < allSegmentNumbers.size()); s++)
+    {
+        OFVector<std::pair<const PackedFrameUtil*, Uint16> > segments;
+        segments.push_back(std::make_pair(&seg, allSegmentNumbers[s]));
+        OFVector<PackedFrameUtil::SegmentReference> segmentRefs;
+        OFVector<PackedFrameUtil::FrameReference> frameRefs;
+        cond = collectReferences(segments, segmentRefs, frameRefs);
+        if (cond.good() && frameRefs.empty())
+        {
+            DCMSEG_WARN("splitSegmentation(): Segment " << allSegmentNumbers[s] << " has no frames, skipping");
+            continue;
+        }
+
+        DcmDataset* result = new DcmDataset();
+        if (cond.good())
+            cond = PackedFrameUtil::buildSegmentation(seg, segmentRefs, frameRefs, *result);
+        if (cond.good())
+            cond = result->putAndInsertOFStringArray(DCM_SeriesInstanceUID, seriesUID);
+        if (cond.good())
+            cond = result->putAndInsertOFStringArray(DCM_InstanceNumber, std::to_string(results.size() + 1).c_str());
+        if (cond.good())
+            cond = result->putAndInsertString(DCM_SegmentsOverlap, "NO");
+        if (cond.good())
+        {
+            results.push_back(result);
+            segmentNumbers.push_back(allSegmentNumbers[s]);
+        }
+        else
+            delete result;
+    }
+
+    if (cond.bad())
+    {
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            delete results[i];
+        }
+        results.clear();
+        segmentNumbers.clear();
+    }
+    return cond;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationEditor::deriveSegments(DcmDataset* input,
+                                               const std::vector<std::string>& expressions,
+                                               const std::vector<std::string>& labels,
+                                               const bool keepInputSegments,
+                                               DcmDataset& result)
+{
+    if (expressions.empty())
+    {
+        DCMSEG_ERROR("deriveSegments(): No expression given");
+        return EC_IllegalParameter;
+    }
+    PackedFrameUtil seg;
+    OFCondition cond = seg.setDataset(input);
+    if (cond.good() && (seg.getBitsAllocated() != 1))
+    {
+        DCMSEG_ERROR("deriveSegments(): Only BINARY segmentations are supported");
+        cond = EC_IllegalParameter;
+    }
+    SegmentationInfo::FramesByPosition framesByPosition;
+    if (cond.good())
+        cond = SegmentationInfo::getFramesByPosition(seg, framesByPosition);
+    if (cond.bad())
+    {
+        return cond;
+    }
+
+    // Every derived segment is built as a segmentation of its own first, owned here
+    std::vector<std::unique_ptr<DcmDataset> > derived;
+    OFVector<PackedFrameUtil> derivedSegs(expressions.size());
+    for (size_t e = 0; e < expressions.size(); e++)
+    {
+        OFVector<ExpressionToken> tokens;
+        cond = parseExpression(expressions[e], tokens);
+        for (size_t t = 0; cond.good() && (t < tokens.size()); t++)
+        {
+            if (!tokens[t].m_operator && !seg.getSegmentItem(tokens[t].m_segmentNumber))
+            {
+                DCMSEG_ERROR("deriveSegments(): Segment " << tokens[t].m_segmentNumber << " does not exist");
+                cond = EC_IllegalParameter;
+            }
+        }
+        const std::string label = ((e < labels.size()) && !labels[e].empty()) ? labels[e] : expressions[e];
+        derived.push_back(std::unique_ptr<DcmDataset>(new DcmDataset()));
+        if (cond.good())
+            cond = deriveSegment(seg, framesByPosition, tokens, label, expressions[e], *derived.back());
+        if (cond.good())
+            cond = derivedSegs[e].setDataset(derived.back().get());
+        if (cond.bad())
+        {
+            DCMSEG_ERROR("deriveSegments(): Cannot evaluate \"" << expressions[e] << "\": " << cond.text());
+            return cond;
+        }
+    }
+
+    OFVector<std::pair<const PackedFrameUtil*, Uint16> > segments;
+    if (keepInputSegments)
+    {
+        OFVector<Uint16> segmentNumbers = seg.getSegmentNumbers();
+        for (size_t s = 0; s < segmentNumbers.size(); s++)
+        {
+            segments.push_back(std::make_pair(&seg, segmentNumbers[s]));
+        }
+    }
+    for (size_t e = 0; e < derivedSegs.size(); e++)
+    {
+        segments.push_back(std::make_pair(&derivedSegs[e], Uint16(1)));
+    }
+    if (segments.size() > 65535)
+    {
+        DCMSEG_ERROR("deriveSegments(): Too many segments (" << segments.size() << ")");
+        return EC_IllegalParameter;
+    }
+
+    OFVector<PackedFrameUtil::SegmentReference> segmentRefs;
+    OFVector<PackedFrameUtil::FrameReference> frameRefs;
+    cond = collectReferences(segments, segmentRefs, frameRefs);
+    if (cond.good())
+    {
+        cond = PackedFrameUtil::buildSegmentation(seg, segmentRefs, frameRefs, result);
+    }
+    // Derived segments overlap with their operands, and usually with each other
+    if (cond.good())
+    {
+        cond = result.putAndInsertString(DCM_SegmentsOverlap, (segments.size() > 1) ? "UNDEFINED" : "NO");
+    }
+    return cond;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationEditor::parseExpression(const std::string& expression, OFVector<ExpressionToken>& tokens)
+{
+    // Shunting-yard algorithm, & takes precedence over the other (left-associative) operators
+    tokens.clear();
+    OFVector<char> operators;
+    bool expectOperand = true;
+    size_t pos         = 0;
+    while (pos < expression.size())
+    {
+        const char c = expression[pos];
+        if (isspace(OFstatic_cast(unsigned char, c)))
+        {
+            pos++;
+        }
+        else if (isdigit(OFstatic_cast(unsigned char, c)) && expectOperand)
+        {
+            unsigned long number = 0;
+            while ((pos < expression.size()) && isdigit(OFstatic_cast(unsigned char, expression[pos]))
+                   && (number <= 65535))
+            {
+                number = number * 10 + (expression[pos++] - '0');
+            }
+            if ((number == 0) || (number > 65535))
+            {
+                DCMSEG_ERROR("parseExpression(): Invalid segment number in \"" << expression << "\"");
+                return EC_IllegalParameter;
+            }
+            ExpressionToken token = { 0, OFstatic_cast(Uint16, number) };
+            tokens.push_back(token);
+            expectOperand = false;
+        }
+        else if ((c == '(') && expectOperand)
+        {
+            operators.push_back(c);
+            pos++;
+        }
+        else if ((c == ')') && !expectOperand)
+        {
+            while (!operators.empty() && (operators.back() != '('))
+            {
+                ExpressionToken token = { operators.back(), 0 };
+                tokens.push_back(token);
+                operators.pop_back();
+            }
+            if (operators.empty())
+            {
+                DCMSEG_ERROR("parseExpression(): Unbalanced parentheses in \"" << expression << "\"");
+                return EC_IllegalParameter;
+            }
+            operators.pop_back();
+            pos++;
+        }
+        else if (c && strchr("&|-^", c) && !expectOperand)
+        {
+            while (!operators.empty() && (operators.back() != '(') && ((operators.back() == '&') || (c != '&')))
+            {
+                ExpressionToken token = { operators.back(), 0 };
+                tokens.push_back(token);
+                operators.pop_back();
+            }
+            operators.push_back(c);
+            expectOperand = true;
+            pos++;
+        }
+        else
+        {
+            DCMSEG_ERROR("parseExpression(): Unexpected character at position " << pos + 1 << " of \"" << expression
+                                                                                << "\"");
+            return EC_IllegalParameter;
+        }
+    }
+    if (expectOperand)
+    {
+        DCMSEG_ERROR("parseExpression(): Incomplete expression \"" << expression << "\"");
+        return EC_IllegalParameter;
+    }
+    while (!operators.empty())
+    {
+        if (operators.back() == '(')
+        {
+            DCMSEG_ERROR("parseExpression(): Unbalanced parentheses in \"" << expression << "\"");
+            return EC_IllegalParameter;
+        }
+        ExpressionToken token = { operators.back(), 0 };
+        tokens.push_back(token);
+        operators.pop_back();
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationEditor::deriveSegment(const PackedFrameUtil& seg,
+                                              const SegmentationInfo::FramesByPosition& framesByPosition,
+                                              const OFVector<ExpressionToken>& tokens,
+                                              const std::string& label,
+                                              const std::string& description,
+                                              DcmDataset& result)
+{
+    const size_t frameBits  = seg.getFrameSizeInBits();
+    const size_t frameWords = (frameBits + 63) / 64;
+
+    // Frames of every segment at every position, collected up front since the worker threads
+    // must not access the dataset
+    OFVector<std::map<Uint16, OFVector<Uint32> > > segmentFrames(framesByPosition.size());
+    for (size_t p = 0; p < framesByPosition.size(); p++)
+    {
+        for (size_t i = 0; i < framesByPosition[p].second.size(); i++)
+        {
+            const Uint32 f = framesByPosition[p].second[i];
+            segmentFrames[p][seg.getSegmentNumberOfFrame(f)].push_back(f);
+        }
+    }
+
+    // Evaluate the expression at every position with a stack of packed frames
+    OFVector<OFVector<Uint64> > resultFrames(framesByPosition.size());
+    OFVector<OFCondition> results(framesByPosition.size());
+    itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+    threader->ParallelizeArray(
+        0,
+        framesByPosition.size(),
+        [&](itk::SizeValueType p) {
+            OFVector<OFVector<Uint64> > stack;
+            OFVector<Uint64> words;
+            for (size_t t = 0; t < tokens.size(); t++)
+            {
+                if (!tokens[t].m_operator)
+                {
+                    // Union of all frames of the segment at this position; zero if there are none
+                    stack.push_back(OFVector<Uint64>(frameWords, 0));
+                    Uint64* operand = &stack.back()[0];
+                    std::map<Uint16, OFVector<Uint32> >::const_iterator it
+                        = segmentFrames[p].find(tokens[t].m_segmentNumber);
+                    for (size_t i = 0; (it != segmentFrames[p].end()) && (i < it->second.size()); i++)
+                    {
+                        results[p] = seg.getFrameMask(it->second[i], words);
+                        if (results[p].bad())
+                            return;
+                        for (size_t w = 0; w < frameWords; w++)
+                            operand[w] |= words[w];
+                    }
+                    continue;
+                }
+                OFVector<Uint64> right;
+                right.swap(stack.back());
+                stack.pop_back();
+                Uint64* left    = &stack.back()[0];
+                const Uint64* r = &right[0];
+                switch (tokens[t].m_operator)
+                {
+                    case '&':
+                        for (size_t w = 0; w < frameWords; w++)
+                            left[w] &= r[w];
+                        break;
+                    case '|':
+                        for (size_t w = 0; w < frameWords; w++)
+                            left[w] |= r[w];
+                        break;
+                    case '-':
+                        for (size_t w = 0; w < frameWords; w++)
+                            left[w] &= ~r[w];
+                        break;
+                    case '^':
+                        for (size_t w = 0; w < frameWords; w++)
+                            left[w] ^= r[w];
+                        break;
+                }
+            }
+            // Padding bits are zero in all operands, and remain so
+            OFVector<Uint64>& frame = stack.back();
+            for (size_t w = 0; w < frameWords; w++)
+            {
+                if (frame[w])
+                {
+                    resultFrames[p].swap(frame);
+                    break;
+                }
+            }
+        },
+        nullptr);
+    for (size_t p = 0; p < results.size(); p++)
+    {
+        if (results[p].bad())
+        {
+            return results[p];
+        }
+    }
+
+    // Header and per-frame functional groups are taken from the first segment of the expression
+    // and from any frame at the respective position
+    Uint16 firstSegment = 0;
+    for (size_t t = 0; !firstSegment && (t < tokens.size()); t++)
+    {
+        firstSegment = tokens[t].m_segmentNumber;
+    }
+    OFVector<PackedFrameUtil::SegmentReference> segmentRefs;
+    segmentRefs.push_back(PackedFrameUtil::SegmentReference(&seg, firstSegment, 1));
+    OFVector<PackedFrameUtil::FrameReference> frameRefs;
+    OFVector<Uint8> pixelData;
+    size_t bitOffset = 0;
+    for (size_t p = 0; p < resultFrames.size(); p++)
+    {
+        if (resultFrames[p].empty())
+            continue;
+        frameRefs.push_back(PackedFrameUtil::FrameReference(&seg, framesByPosition[p].second[0], 1));
+        // Bit masks are in local byte order
+        if (gLocalByteOrder == EBO_BigEndian)
+            swapBytes(&resultFrames[p][0], OFstatic_cast(Uint32, frameWords * sizeof(Uint64)), sizeof(Uint64));
+        PackedFrameUtil::appendBits(pixelData, bitOffset, OFreinterpret_cast(const Uint8*, &resultFrames[p][0]), frameBits);
+    }
+    if (frameRefs.empty())
+    {
+        DCMSEG_ERROR("deriveSegment(): Derived segment \"" << label << "\" is empty");
+        return EC_IllegalParameter;
+    }
+
+    OFCondition cond = PackedFrameUtil::buildSegmentation(seg, segmentRefs, frameRefs, result);
+    if (cond.good())
+    {
+        if (pixelData.size() % 2)
+            pixelData.push_back(0);
+        cond = result.putAndInsertUint8Array(DCM_PixelData, &pixelData[0], pixelData.size());
+    }
+    DcmItem* segmentItem = NULL;
+    if (cond.good())
+        cond = result.findAndGetSequenceItem(DCM_SegmentSequence, segmentItem, 0);
+    if (cond.good())
+        cond = segmentItem->putAndInsertString(DCM_SegmentLabel, label.c_str());
+    if (cond.good())
+        cond = segmentItem->putAndInsertString(DCM_SegmentDescription, description.c_str());
+    // The derived segment is not the entity tracked by the copied segment
+    if (cond.good())
+    {
+        segmentItem->findAndDeleteElement(DCM_TrackingID);
+        segmentItem->findAndDeleteElement(DCM_TrackingUID);
+    }
+    return cond;
+}
+
+// -------------------------------------------------------------------------------------
+
+DcmDataset* SegmentationEditor::resampleToReference(DcmDataset* reference,
+                                                    DcmDataset* segmentation,
+                                                    std::vector<DcmDataset*>& sourceDatasets)
+{
+    // Reference grid, as decoded from the reference segmentation
+    Dicom2ItkConverter referenceConverter;
+    std::string referenceMetaInfo;
+    if (referenceConverter.dcmSegmentation2itkimage(reference, referenceMetaInfo).bad())
+    {
+        return NULL;
+    }
+    ShortImageType::Pointer referenceImage = referenceConverter.begin();
+
+    Dicom2ItkConverter converter;
+    std::string metaInfo;
+    if (!referenceImage || converter.dcmSegmentation2itkimage(segmentation, metaInfo).bad())
+    {
+        return NULL;
+    }
+    std::vector<ShortImageType::Pointer> images;
+    for (ShortImageType::Pointer image = converter.begin(); image; image = converter.next())
+    {
+        images.push_back(image);
+    }
+
+    std::vector<ShortImageType::Pointer> resampledImages;
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        // Extend the reference grid along the slice direction to cover this image
+        ShortImageType::SizeType referenceSize = referenceImage->GetLargestPossibleRegion().GetSize();
+        ShortImageType::SizeType imageSize     = images[i]->GetLargestPossibleRegion().GetSize();
+        double minSlice = 0, maxSlice = referenceSize[2] - 1;
+        for (unsigned corner = 0; corner < 8; corner++)
+        {
+            ShortImageType::IndexType cornerIndex;
+            for (unsigned d = 0; d < 3; d++)
+            {
+                cornerIndex[d] = (corner & (1 << d)) ? imageSize[d] - 1 : 0;
+            }
+            ShortImageType::PointType cornerPoint;
+            images[i]->TransformIndexToPhysicalPoint(cornerIndex, cornerPoint);
+            itk::ContinuousIndex<double, 3> referenceIndex;
+            referenceImage->TransformPhysicalPointToContinuousIndex(cornerPoint, referenceIndex);
+            minSlice = std::min(minSlice, floor(referenceIndex[2] + 0.5));
+            maxSlice = std::max(maxSlice, floor(referenceIndex[2] + 0.5));
+        }
+        ShortImageType::IndexType firstSliceIndex;
+        firstSliceIndex.Fill(0);
+        firstSliceIndex[2] = OFstatic_cast(itk::IndexValueType, minSlice);
+        ShortImageType::PointType outputOrigin;
+        referenceImage->TransformIndexToPhysicalPoint(firstSliceIndex, outputOrigin);
+        ShortImageType::SizeType outputSize = referenceSize;
+        outputSize[2]                       = OFstatic_cast(itk::SizeValueType, maxSlice - minSlice + 1);
+
+        typedef itk::ResampleImageFilter<ShortImageType, ShortImageType> ResampleFilterType;
+        typedef itk::NearestNeighborInterpolateImageFunction<ShortImageType, double> InterpolatorType;
+        ResampleFilterType::Pointer resampler = ResampleFilterType::New();
+        resampler->SetInput(images[i]);
+        resampler->SetInterpolator(InterpolatorType::New());
+        resampler->SetOutputSpacing(referenceImage->GetSpacing());
+        resampler->SetOutputDirection(referenceImage->GetDirection());
+        resampler->SetOutputOrigin(outputOrigin);
+        resampler->SetSize(outputSize);
+        resampler->SetDefaultPixelValue(0);
+        resampler->Update();
+        resampledImages.push_back(resampler->GetOutput());
+    }
+
+    return Itk2DicomConverter::itkimage2dcmSegmentation(sourceDatasets, resampledImages, metaInfo, true);
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationEditor::checkCompatibleGeometry(const PackedFrameUtil& seg1, const PackedFrameUtil& seg2)
+{
+    if ((seg1.getRows() != seg2.getRows()) || (seg1.getColumns() != seg2.getColumns())
+        || (seg1.getBitsAllocated() != seg2.getBitsAllocated()))
+    {
+        DCMSEG_ERROR("checkCompatibleGeometry(): Segmentations differ in frame size or bits allocated");
+        return EC_IllegalParameter;
+    }
+
+    OFString frameOfRef1, frameOfRef2;
+    seg1.getDataset()->findAndGetOFString(DCM_FrameOfReferenceUID, frameOfRef1);
+    seg2.getDataset()->findAndGetOFString(DCM_FrameOfReferenceUID, frameOfRef2);
+    if (frameOfRef1 != frameOfRef2)
+    {
+        DCMSEG_ERROR("checkCompatibleGeometry(): Segmentations differ in Frame of Reference ("
+                     << frameOfRef1 << " vs " << frameOfRef2 << ")");
+        return EC_IllegalParameter;
+    }
+
+    OFVector<Float64> orientation1, orientation2, spacing1, spacing2;
+    OFCondition cond = seg1.getImageOrientation(orientation1);
+    if (cond.good())
+        cond = seg2.getImageOrientation(orientation2);
+    if (cond.good())
+        cond = seg1.getPixelSpacing(spacing1);
+    if (cond.good())
+        cond = seg2.getPixelSpacing(spacing2);
+    if (cond.bad())
+    {
+        return cond;
+    }
+    for (size_t i = 0; i < 6; i++)
+    {
+        if (fabs(orientation1[i] - orientation2[i]) > 1e-4)
+        {
+            DCMSEG_ERROR("checkCompatibleGeometry(): Segmentations differ in Image Orientation Patient");
+            return EC_IllegalParameter;
+        }
+    }
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (fabs(spacing1[i] - spacing2[i]) > 1e-4 * spacing1[i])
+        {
+            DCMSEG_ERROR("checkCompatibleGeometry(): Segmentations differ in Pixel Spacing");
+            return EC_IllegalParameter;
+        }
+    }
+
+    // Frames must be aligned in-plane, i.e. positions may only differ along the slice normal
+    if (seg1.getNumberOfFrames() && seg2.getNumberOfFrames())
+    {
+        PackedFrameUtil::ImagePosition pos1, pos2;
+        cond = seg1.getImagePosition(0, pos1);
+        if (cond.good())
+            cond = seg2.getImagePosition(0, pos2);
+        if (cond.bad())
+        {
+            return cond;
+        }
+        for (size_t axis = 0; axis < 2; axis++)
+        {
+            Float64 offset = 0;
+            for (size_t i = 0; i < 3; i++)
+            {
+                offset += (pos2[i] - pos1[i]) * orientation1[axis * 3 + i];
+            }
+            // row direction vector goes along columns, i.e. is scaled by column spacing
+            const Float64 spacing = spacing1[1 - axis];
+            if (fabs(offset) > 0.01 * spacing)
+            {
+                DCMSEG_ERROR("checkCompatibleGeometry(): Frames of the segmentations are not aligned in-plane");
+                return EC_IllegalParameter;
+            }
+        }
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationEditor::collectReferences(const OFVector<std::pair<const PackedFrameUtil*, Uint16> >& segments,
+                                                  OFVector<PackedFrameUtil::SegmentReference>& segmentRefs,
+                                                  OFVector<PackedFrameUtil::FrameReference>& frameRefs)
+{
+    segmentRefs.clear();
+    frameRefs.clear();
+    for (size_t s = 0; s < segments.size(); s++)
+    {
+        const Uint16 newSegmentNumber = OFstatic_cast(Uint16, s + 1);
+        segmentRefs.push_back(
+            PackedFrameUtil::SegmentReference(segments[s].first, segments[s].second, newSegmentNumber));
+
+        OFVector<Uint32> frames;
+        OFCondition cond = segments[s].first->getFramesForSegment(segments[s].second, frames);
+        if (cond.bad())
+        {
+            return cond;
+        }
+        for (size_t f = 0; f < frames.size(); f++)
+        {
+            frameRefs.push_back(PackedFrameUtil::FrameReference(segments[s].first, frames[f], newSegmentNumber));
+        }
+    }
+    return EC_Normal;
+}
+
+} // namespace dcmqi
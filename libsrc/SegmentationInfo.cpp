@@ -0,0 +1,323 @@
+
+// DCMQI includes
+#include "dcmqi/SegmentationInfo.h"
+
+// DCMTK includes
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmseg/segtypes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+namespace dcmqi
+{
+
+OFCondition SegmentationInfo::getInfo(DcmDataset* dataset, bool checkOverlap, Json::Value& info)
+{
+    PackedFrameUtil seg;
+    OFCondition cond = seg.setDataset(dataset, !checkOverlap, OFTrue);
+    if (cond.bad())
+    {
+        return cond;
+    }
+
+    info = Json::Value(Json::objectValue);
+    const DcmTagKey topLevelTags[] = { DCM_SOPInstanceUID,       DCM_SeriesInstanceUID,    DCM_SeriesDescription,
+                                       DCM_FrameOfReferenceUID,  DCM_SegmentationType,     DCM_SegmentationFractionalType,
+                                       DCM_MaximumFractionalValue };
+    for (size_t i = 0; i < sizeof(topLevelTags) / sizeof(topLevelTags[0]); i++)
+    {
+        OFString value;
+        if (dataset->findAndGetOFString(topLevelTags[i], value).good() && !value.empty())
+        {
+            info[DcmTag(topLevelTags[i]).getTagName()] = value.c_str();
+        }
+    }
+    OFString segmentsOverlap;
+    dataset->findAndGetOFString(DCM_SegmentsOverlap, segmentsOverlap);
+    info["SegmentsOverlap"]  = segmentsOverlap.empty() ? "UNDEFINED" : segmentsOverlap.c_str();
+    info["NumberOfFrames"]   = seg.getNumberOfFrames();
+    info["NumberOfSegments"] = seg.getNumberOfSegments();
+
+    // Segments
+    info["segments"]                = Json::Value(Json::arrayValue);
+    OFVector<Uint16> segmentNumbers = seg.getSegmentNumbers();
+    for (size_t s = 0; s < segmentNumbers.size(); s++)
+    {
+        DcmItem* item = seg.getSegmentItem(segmentNumbers[s]);
+        Json::Value segment;
+        segment["labelID"] = segmentNumbers[s];
+        const DcmTagKey segmentTags[] = { DCM_SegmentLabel, DCM_SegmentDescription, DCM_SegmentAlgorithmType,
+                                          DCM_SegmentAlgorithmName };
+        for (size_t i = 0; i < sizeof(segmentTags) / sizeof(segmentTags[0]); i++)
+        {
+            OFString value;
+            if (item->findAndGetOFString(segmentTags[i], value).good() && !value.empty())
+            {
+                segment[DcmTag(segmentTags[i]).getTagName()] = value.c_str();
+            }
+        }
+        segment["SegmentedPropertyCategoryCodeSequence"] = getCode(item, DCM_SegmentedPropertyCategoryCodeSequence);
+        segment["SegmentedPropertyTypeCodeSequence"]     = getCode(item, DCM_SegmentedPropertyTypeCodeSequence);
+        DcmItem* typeItem                                = NULL;
+        if (item->findAndGetSequenceItem(DCM_SegmentedPropertyTypeCodeSequence, typeItem, 0).good())
+        {
+            Json::Value modifier = getCode(typeItem, DCM_SegmentedPropertyTypeModifierCodeSequence);
+            if (!modifier.isNull())
+                segment["SegmentedPropertyTypeModifierCodeSequence"] = modifier;
+        }
+        Json::Value region = getCode(item, DCM_AnatomicRegionSequence);
+        if (!region.isNull())
+            segment["AnatomicRegionSequence"] = region;
+
+        // Frames of a label map are not assigned to segments
+        if (!seg.isLabelmap())
+        {
+            OFVector<Uint32> frames;
+            seg.getFramesForSegment(segmentNumbers[s], frames);
+            segment["numberOfFrames"] = OFstatic_cast(Json::UInt, frames.size());
+        }
+        info["segments"].append(segment);
+    }
+
+    // Geometry and overlap, both need the frame positions
+    FramesByPosition framesByPosition;
+    cond = getFramesByPosition(seg, framesByPosition);
+    if (cond.good())
+    {
+        cond = getGeometryInfo(seg, framesByPosition, info["geometry"]);
+    }
+    if (cond.good() && checkOverlap)
+    {
+        cond = getOverlapInfo(seg, framesByPosition, info["overlap"]);
+    }
+    return cond;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationInfo::getFramesByPosition(const PackedFrameUtil& seg, FramesByPosition& frames)
+{
+    frames.clear();
+    OFVector<Float64> orientation;
+    OFCondition cond = seg.getImageOrientation(orientation);
+    if (cond.bad())
+    {
+        return cond;
+    }
+    // Slice normal is the cross product of row and column direction
+    const Float64 normal[3] = { orientation[1] * orientation[5] - orientation[2] * orientation[4],
+                                orientation[2] * orientation[3] - orientation[0] * orientation[5],
+                                orientation[0] * orientation[4] - orientation[1] * orientation[3] };
+
+    OFVector<std::pair<Float64, Uint32> > distances;
+    for (Uint32 f = 0; f < seg.getNumberOfFrames(); f++)
+    {
+        PackedFrameUtil::ImagePosition position;
+        cond = seg.getImagePosition(f, position);
+        if (cond.bad())
+        {
+            return cond;
+        }
+        distances.push_back(
+            std::make_pair(position[0] * normal[0] + position[1] * normal[1] + position[2] * normal[2], f));
+    }
+    std::sort(distances.begin(), distances.end());
+
+    // Frames closer than 1 micrometer are considered to be at the same position
+    for (size_t i = 0; i < distances.size(); i++)
+    {
+        if (frames.empty() || (fabs(distances[i].first - frames.back().first) > 1e-3))
+        {
+            frames.push_back(std::make_pair(distances[i].first, OFVector<Uint32>()));
+        }
+        frames.back().second.push_back(distances[i].second);
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationInfo::getGeometryInfo(const PackedFrameUtil& seg,
+                                              const FramesByPosition& frames,
+                                              Json::Value& geometry)
+{
+    OFVector<Float64> orientation, spacing;
+    OFCondition cond = seg.getImageOrientation(orientation);
+    if (cond.good())
+        cond = seg.getPixelSpacing(spacing);
+    if (cond.bad() || frames.empty())
+    {
+        return cond;
+    }
+
+    geometry["Rows"]    = seg.getRows();
+    geometry["Columns"] = seg.getColumns();
+    for (size_t i = 0; i < orientation.size(); i++)
+        geometry["ImageOrientationPatient"].append(orientation[i]);
+    for (size_t i = 0; i < spacing.size(); i++)
+        geometry["PixelSpacing"].append(spacing[i]);
+
+    // Slice thickness and spacing as declared
+    DcmItem* sharedItem = NULL;
+    DcmItem* measures   = NULL;
+    Float64 value       = 0;
+    if (seg.getDataset()->findAndGetSequenceItem(DCM_SharedFunctionalGroupsSequence, sharedItem, 0).good()
+        && sharedItem->findAndGetSequenceItem(DCM_PixelMeasuresSequence, measures, 0).good())
+    {
+        if (measures->findAndGetFloat64(DCM_SliceThickness, value).good())
+            geometry["SliceThickness"] = value;
+        if (measures->findAndGetFloat64(DCM_SpacingBetweenSlices, value).good())
+            geometry["SpacingBetweenSlices"] = value;
+    }
+
+    // Grid as computed from the frame positions
+    PackedFrameUtil::ImagePosition first, last;
+    seg.getImagePosition(frames.front().second[0], first);
+    seg.getImagePosition(frames.back().second[0], last);
+    for (size_t i = 0; i < 3; i++)
+    {
+        geometry["firstFramePosition"].append(first[i]);
+        geometry["lastFramePosition"].append(last[i]);
+    }
+    geometry["numberOfPositions"] = OFstatic_cast(Json::UInt, frames.size());
+
+    if (frames.size() > 1)
+    {
+        Float64 minSpacing = frames[1].first - frames[0].first, maxSpacing = minSpacing;
+        for (size_t i = 2; i < frames.size(); i++)
+        {
+            minSpacing = std::min(minSpacing, frames[i].first - frames[i - 1].first);
+            maxSpacing = std::max(maxSpacing, frames[i].first - frames[i - 1].first);
+        }
+        // Slices not covered by any frame if the smallest spacing defines the grid
+        const Float64 extent    = frames.back().first - frames.front().first;
+        const Json::UInt slices = OFstatic_cast(Json::UInt, floor(extent / minSpacing + 0.5)) + 1;
+        geometry["sliceSpacing"]     = minSpacing;
+        geometry["maxSliceSpacing"]  = maxSpacing;
+        geometry["numberOfSlices"]   = slices;
+        geometry["missingSlices"]    = slices - OFstatic_cast(Json::UInt, frames.size());
+        geometry["irregularSpacing"] = (maxSpacing - minSpacing) > std::max(1e-3, 1e-2 * minSpacing);
+    }
+    else
+    {
+        geometry["numberOfSlices"]   = 1;
+        geometry["irregularSpacing"] = false;
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationInfo::getOverlapInfo(const PackedFrameUtil& seg,
+                                             const FramesByPosition& frames,
+                                             Json::Value& overlap)
+{
+    std::set<std::pair<Uint16, Uint16> > overlapping;
+    for (size_t p = 0; p < frames.size(); p++)
+    {
+        const OFVector<Uint32>& framesAtPosition = frames[p].second;
+        for (size_t i = 0; i < framesAtPosition.size(); i++)
+        {
+            for (size_t j = i + 1; j < framesAtPosition.size(); j++)
+            {
+                Uint16 seg1 = seg.getSegmentNumberOfFrame(framesAtPosition[i]);
+                Uint16 seg2 = seg.getSegmentNumberOfFrame(framesAtPosition[j]);
+                if (seg1 > seg2)
+                    std::swap(seg1, seg2);
+                if ((seg1 == seg2) || overlapping.count(std::make_pair(seg1, seg2)))
+                    continue;
+                bool frameOverlap = false;
+                OFCondition cond  = checkFramesOverlap(seg, framesAtPosition[i], framesAtPosition[j], frameOverlap);
+                if (cond.bad())
+                {
+                    return cond;
+                }
+                if (frameOverlap)
+                {
+                    overlapping.insert(std::make_pair(seg1, seg2));
+                }
+            }
+        }
+    }
+
+    overlap["SegmentsOverlap"]     = overlapping.empty() ? "NO" : "YES";
+    overlap["overlappingSegments"] = Json::Value(Json::arrayValue);
+    for (std::set<std::pair<Uint16, Uint16> >::const_iterator it = overlapping.begin(); it != overlapping.end(); ++it)
+    {
+        Json::Value pair(Json::arrayValue);
+        pair.append(it->first);
+        pair.append(it->second);
+        overlap["overlappingSegments"].append(pair);
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationInfo::checkFramesOverlap(const PackedFrameUtil& seg,
+                                                 const Uint32 f1,
+                                                 const Uint32 f2,
+                                                 bool& overlap)
+{
+    OFVector<Uint8> buffer1, buffer2;
+    const Uint8* frame1 = seg.getAlignedFrame(f1);
+    const Uint8* frame2 = seg.getAlignedFrame(f2);
+    OFCondition cond;
+    if (!frame1 && (cond = seg.getPackedFrame(f1, buffer1)).good())
+        frame1 = &buffer1[0];
+    if (!frame2 && cond.good() && (cond = seg.getPackedFrame(f2, buffer2)).good())
+        frame2 = &buffer2[0];
+    if (cond.bad())
+    {
+        return cond;
+    }
+
+    overlap               = false;
+    const size_t numBits  = seg.getFrameSizeInBits();
+    const size_t numBytes = numBits / 8;
+    if (seg.getBitsAllocated() == 1)
+    {
+        // Aligned frames may share their last byte with the next frame
+        for (size_t i = 0; !overlap && (i < numBytes); i++)
+        {
+            overlap = (frame1[i] & frame2[i]) != 0;
+        }
+        if (!overlap && (numBits % 8))
+        {
+            const Uint8 mask = OFstatic_cast(Uint8, (1 << (numBits % 8)) - 1);
+            overlap          = (frame1[numBytes] & frame2[numBytes] & mask) != 0;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; !overlap && (i < numBytes); i++)
+        {
+            overlap = frame1[i] && frame2[i];
+        }
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+Json::Value SegmentationInfo::getCode(DcmItem* item, const DcmTagKey& sequence)
+{
+    DcmItem* codeItem = NULL;
+    if (!item || item->findAndGetSequenceItem(sequence, codeItem, 0).bad() || !codeItem)
+    {
+        return Json::Value();
+    }
+    OFString codeValue, codingSchemeDesignator, codeMeaning;
+    codeItem->findAndGetOFString(DCM_CodeValue, codeValue);
+    codeItem->findAndGetOFString(DCM_CodingSchemeDesignator, codingSchemeDesignator);
+    codeItem->findAndGetOFString(DCM_CodeMeaning, codeMeaning);
+    Json::Value code;
+    code["CodeValue"]              = codeValue.c_str();
+    code["CodingSchemeDesignator"] = codingSchemeDesignator.c_str();
+    code["CodeMeaning"]            = codeMeaning.c_str();
+    return code;
+}
+
+} // namespace dcmqi
@@ -0,0 +1,738 @@
+
+// DCMQI includes
+#include "dcmqi/SegmentationIntensityStatistics.h"
+#include "dcmqi/Helper.h"
+#include "dcmqi/SegmentationInfo.h"
+
+// DCMTK includes
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcfcache.h"
+#include "dcmtk/dcmseg/segtypes.h"
+
+// ITK includes
+#include <itkMultiThreaderBase.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+namespace dcmqi
+{
+
+namespace
+{
+
+// First item of a functional group sequence, either per-frame or shared
+DcmItem* findFunctionalGroup(DcmItem* perFrameItem, DcmItem* sharedItem, const DcmTagKey& fgSequence)
+{
+    DcmItem* item = NULL;
+    if (perFrameItem && perFrameItem->findAndGetSequenceItem(fgSequence, item, 0).good() && item)
+        return item;
+    if (sharedItem && sharedItem->findAndGetSequenceItem(fgSequence, item, 0).good())
+        return item;
+    return NULL;
+}
+
+OFCondition getFloat64Values(DcmItem* item, const DcmTagKey& tag, const size_t count, OFVector<Float64>& values)
+{
+    values.resize(count);
+    for (unsigned long i = 0; i < count; i++)
+    {
+        if (!item || item->findAndGetFloat64(tag, values[i], i).bad())
+        {
+            return EC_TagNotFound;
+        }
+    }
+    return EC_Normal;
+}
+
+Json::Value makeCode(const char* value, const char* designator, const char* meaning)
+{
+    Json::Value code;
+    code["CodeValue"]              = value;
+    code["CodingSchemeDesignator"] = designator;
+    code["CodeMeaning"]            = meaning;
+    return code;
+}
+
+} // namespace
+
+// -------------------------------------------------------------------------------------
+
+SegmentationIntensityStatistics::IntensityStatistics::IntensityStatistics(const Float64 histogramMin,
+                                                                          const Float64 histogramMax,
+                                                                          const Uint32 bins)
+    : segmentNumber(0)
+    , count(0)
+    , mean(0)
+    , m2(0)
+    , minimum(0)
+    , maximum(0)
+    , histogramMin(histogramMin)
+    , binWidth((histogramMax - histogramMin) / (bins ? bins : 1))
+    , histogram(bins ? bins : 1, 0)
+{
+}
+
+void SegmentationIntensityStatistics::IntensityStatistics::add(const Float64 value)
+{
+    if (!count || (value < minimum))
+        minimum = value;
+    if (!count || (value > maximum))
+        maximum = value;
+    count++;
+    const Float64 delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+
+    const Float64 bin = floor((value - histogramMin) / binWidth);
+    histogram[OFstatic_cast(size_t, std::min(std::max(bin, 0.0), OFstatic_cast(Float64, histogram.size() - 1)))]++;
+}
+
+void SegmentationIntensityStatistics::IntensityStatistics::merge(const IntensityStatistics& other)
+{
+    if (!other.count)
+        return;
+    if (!count)
+    {
+        minimum = other.minimum;
+        maximum = other.maximum;
+    }
+    else
+    {
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+    }
+    // Parallel variant of Welford's algorithm
+    const Uint64 total  = count + other.count;
+    const Float64 delta = other.mean - mean;
+    mean += delta * other.count / total;
+    m2 += other.m2 + delta * delta * (OFstatic_cast(Float64, count) * other.count / total);
+    count = total;
+    for (size_t b = 0; b < histogram.size(); b++)
+    {
+        histogram[b] += other.histogram[b];
+    }
+}
+
+Float64 SegmentationIntensityStatistics::IntensityStatistics::getStandardDeviation() const
+{
+    return (count > 1) ? sqrt(m2 / (count - 1)) : 0;
+}
+
+Float64 SegmentationIntensityStatistics::IntensityStatistics::getPercentile(const Float64 percent) const
+{
+    const Float64 target = percent / 100 * count;
+    Uint64 cumulative    = 0;
+    for (size_t b = 0; b < histogram.size(); b++)
+    {
+        if (histogram[b] && (cumulative + histogram[b] >= target))
+        {
+            const Float64 fraction = (target - cumulative) / histogram[b];
+            const Float64 value    = histogramMin + (b + fraction) * binWidth;
+            return std::min(std::max(value, minimum), maximum);
+        }
+        cumulative += histogram[b];
+    }
+    return maximum;
+}
+
+// -------------------------------------------------------------------------------------
+
+SegmentationIntensityStatistics::SegmentationIntensityStatistics(const Float64 histogramMin,
+                                                                 const Float64 histogramMax,
+                                                                 const Uint32 bins)
+    : m_histogramMin(histogramMin)
+    , m_histogramMax(histogramMax)
+    , m_bins(bins)
+    , m_slices()
+    , m_rows(0)
+    , m_columns(0)
+    , m_orientation()
+    , m_spacing()
+    , m_pixelDataTag(DCM_PixelData)
+    , m_bitsAllocated(0)
+    , m_bitsStored(0)
+    , m_pixelRepresentation(0)
+    , m_parametricMap()
+    , m_isParametricMap(false)
+    , m_quantity()
+    , m_units()
+    , m_readMutex()
+{
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationIntensityStatistics::setSourceSeries(const std::vector<std::string>& fileNames)
+{
+    m_slices.clear();
+    m_isParametricMap = false;
+    m_pixelDataTag    = DCM_PixelData;
+    m_quantity        = Json::Value();
+    m_units           = Json::Value();
+    for (size_t i = 0; i < fileNames.size(); i++)
+    {
+        // Pixel data is read later, slice by slice
+        DcmFileFormat ff;
+        OFCondition cond = ff.loadFileUntilTag(
+            fileNames[i].c_str(), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData);
+        if (cond.bad())
+        {
+            DCMSEG_ERROR("setSourceSeries(): Cannot read " << fileNames[i] << ": " << cond.text());
+            return cond;
+        }
+        DcmDataset* dataset = ff.getDataset();
+
+        SourceSlice slice;
+        OFVector<Float64> orientation, spacing;
+        Uint16 rows = 0, columns = 0, bitsAllocated = 0, bitsStored = 0, pixelRepresentation = 0;
+        dataset->findAndGetUint16(DCM_Rows, rows);
+        dataset->findAndGetUint16(DCM_Columns, columns);
+        dataset->findAndGetUint16(DCM_BitsAllocated, bitsAllocated);
+        dataset->findAndGetUint16(DCM_BitsStored, bitsStored);
+        dataset->findAndGetUint16(DCM_PixelRepresentation, pixelRepresentation);
+        if (getFloat64Values(dataset, DCM_ImagePositionPatient, 3, slice.position).bad()
+            || getFloat64Values(dataset, DCM_ImageOrientationPatient, 6, orientation).bad()
+            || getFloat64Values(dataset, DCM_PixelSpacing, 2, spacing).bad())
+        {
+            DCMSEG_WARN("setSourceSeries(): Skipping " << fileNames[i] << ", no image plane information");
+            continue;
+        }
+        if (m_slices.empty())
+        {
+            m_bitsAllocated       = bitsAllocated;
+            m_bitsStored          = bitsStored;
+            m_pixelRepresentation = pixelRepresentation;
+            // Rescaled CT values are known to be Hounsfield units
+            OFString modality;
+            dataset->findAndGetOFString(DCM_Modality, modality);
+            if (modality == "CT")
+            {
+                m_quantity = makeCode("112031", "DCM", "Attenuation Coefficient");
+                m_units    = makeCode("[hnsf'U]", "UCUM", "Hounsfield unit");
+            }
+        }
+        else if ((bitsAllocated != m_bitsAllocated) || (bitsStored != m_bitsStored)
+                 || (pixelRepresentation != m_pixelRepresentation))
+        {
+            DCMSEG_ERROR("setSourceSeries(): " << fileNames[i] << " differs in pixel data attributes");
+            return EC_IllegalParameter;
+        }
+        slice.fileName = fileNames[i];
+        slice.frameNo  = 0;
+        if (dataset->findAndGetFloat64(DCM_RescaleSlope, slice.slope).bad())
+            slice.slope = 1;
+        if (dataset->findAndGetFloat64(DCM_RescaleIntercept, slice.intercept).bad())
+            slice.intercept = 0;
+        cond = addSlice(slice, rows, columns, orientation, spacing);
+        if (cond.bad())
+        {
+            DCMSEG_ERROR("setSourceSeries(): " << fileNames[i] << " is not on the grid of the other images");
+            return cond;
+        }
+    }
+    if ((m_bitsAllocated != 8) && (m_bitsAllocated != 16) && (m_bitsAllocated != 32))
+    {
+        DCMSEG_ERROR("setSourceSeries(): No images found, or unsupported Bits Allocated " << m_bitsAllocated);
+        m_slices.clear();
+        return EC_IllegalParameter;
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationIntensityStatistics::setParametricMap(const std::string& fileName)
+{
+    m_slices.clear();
+    m_isParametricMap = true;
+    m_quantity        = Json::Value();
+    m_units           = Json::Value();
+
+    // Large elements (i.e. pixel data) remain in the file until accessed
+    OFCondition cond = m_parametricMap.loadFile(fileName.c_str(), EXS_Unknown, EGL_noChange, DCM_MaxReadLength);
+    if (cond.bad())
+    {
+        DCMSEG_ERROR("setParametricMap(): Cannot read " << fileName << ": " << cond.text());
+        return cond;
+    }
+    DcmDataset* dataset = m_parametricMap.getDataset();
+
+    m_pixelRepresentation = 0;
+    dataset->findAndGetUint16(DCM_BitsAllocated, m_bitsAllocated);
+    dataset->findAndGetUint16(DCM_BitsStored, m_bitsStored);
+    dataset->findAndGetUint16(DCM_PixelRepresentation, m_pixelRepresentation);
+    if (dataset->tagExists(DCM_FloatPixelData))
+        m_pixelDataTag = DCM_FloatPixelData;
+    else if (dataset->tagExists(DCM_DoubleFloatPixelData))
+        m_pixelDataTag = DCM_DoubleFloatPixelData;
+    else
+        m_pixelDataTag = DCM_PixelData;
+
+    Uint16 rows = 0, columns = 0;
+    Sint32 numberOfFrames = 0;
+    dataset->findAndGetUint16(DCM_Rows, rows);
+    dataset->findAndGetUint16(DCM_Columns, columns);
+    dataset->findAndGetSint32(DCM_NumberOfFrames, numberOfFrames);
+    DcmItem* sharedItem = NULL;
+    dataset->findAndGetSequenceItem(DCM_SharedFunctionalGroupsSequence, sharedItem, 0);
+    DcmSequenceOfItems* perFrameSeq = NULL;
+    dataset->findAndGetSequence(DCM_PerFrameFunctionalGroupsSequence, perFrameSeq);
+
+    for (Sint32 f = 0; f < numberOfFrames; f++)
+    {
+        DcmItem* perFrameItem = perFrameSeq ? perFrameSeq->getItem(OFstatic_cast(unsigned long, f)) : NULL;
+        SourceSlice slice;
+        OFVector<Float64> orientation, spacing;
+        cond = getFloat64Values(
+            findFunctionalGroup(perFrameItem, sharedItem, DCM_PlanePositionSequence), DCM_ImagePositionPatient, 3, slice.position);
+        if (cond.good())
+            cond = getFloat64Values(findFunctionalGroup(perFrameItem, sharedItem, DCM_PlaneOrientationSequence),
+                                    DCM_ImageOrientationPatient,
+                                    6,
+                                    orientation);
+        if (cond.good())
+            cond = getFloat64Values(
+                findFunctionalGroup(perFrameItem, sharedItem, DCM_PixelMeasuresSequence), DCM_PixelSpacing, 2, spacing);
+        if (cond.bad())
+        {
+            DCMSEG_ERROR("setParametricMap(): Missing image plane information for frame #" << f);
+            return cond;
+        }
+
+        // Real World Value Mapping of the frame, also provides quantity and units
+        slice.frameNo      = OFstatic_cast(Uint32, f);
+        slice.slope        = 1;
+        slice.intercept    = 0;
+        DcmItem* rwvmItem  = findFunctionalGroup(perFrameItem, sharedItem, DCM_RealWorldValueMappingSequence);
+        if (rwvmItem)
+        {
+            rwvmItem->findAndGetFloat64(DCM_RealWorldValueSlope, slice.slope);
+            rwvmItem->findAndGetFloat64(DCM_RealWorldValueIntercept, slice.intercept);
+            if (m_units.isNull())
+                m_units = SegmentationInfo::getCode(rwvmItem, DCM_MeasurementUnitsCodeSequence);
+            DcmSequenceOfItems* quantitySeq = NULL;
+            if (m_quantity.isNull() && rwvmItem->findAndGetSequence(DCM_QuantityDefinitionSequence, quantitySeq).good())
+            {
+                for (unsigned long i = 0; quantitySeq && (i < quantitySeq->card()); i++)
+                {
+                    Json::Value concept = SegmentationInfo::getCode(quantitySeq->getItem(i), DCM_ConceptNameCodeSequence);
+                    if (!concept.isNull() && (concept["CodeValue"].asString() == "246205007"))
+                        m_quantity = SegmentationInfo::getCode(quantitySeq->getItem(i), DCM_ConceptCodeSequence);
+                }
+            }
+        }
+        cond = addSlice(slice, rows, columns, orientation, spacing);
+        if (cond.bad())
+        {
+            DCMSEG_ERROR("setParametricMap(): Frame #" << f << " is not on the grid of the other frames");
+            return cond;
+        }
+    }
+    if (m_slices.empty() || ((m_pixelDataTag == DCM_PixelData) && (m_bitsAllocated != 8) && (m_bitsAllocated != 16)))
+    {
+        DCMSEG_ERROR("setParametricMap(): No frames found, or unsupported Bits Allocated " << m_bitsAllocated);
+        m_slices.clear();
+        return EC_IllegalParameter;
+    }
+    if (m_pixelDataTag == DCM_FloatPixelData)
+        m_bitsAllocated = 32;
+    else if (m_pixelDataTag == DCM_DoubleFloatPixelData)
+        m_bitsAllocated = 64;
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+Json::Value SegmentationIntensityStatistics::getUnits() const
+{
+    return m_units;
+}
+
+Json::Value SegmentationIntensityStatistics::getQuantity() const
+{
+    return m_quantity;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationIntensityStatistics::addSlice(const SourceSlice& slice,
+                                                      const Uint16 rows,
+                                                      const Uint16 columns,
+                                                      const OFVector<Float64>& orientation,
+                                                      const OFVector<Float64>& spacing)
+{
+    if (m_slices.empty())
+    {
+        m_rows        = rows;
+        m_columns     = columns;
+        m_orientation = orientation;
+        m_spacing     = spacing;
+    }
+    else
+    {
+        if ((rows != m_rows) || (columns != m_columns))
+            return EC_IllegalParameter;
+        for (size_t i = 0; i < 6; i++)
+        {
+            if (fabs(orientation[i] - m_orientation[i]) > 1e-4)
+                return EC_IllegalParameter;
+        }
+        for (size_t i = 0; i < 2; i++)
+        {
+            if (fabs(spacing[i] - m_spacing[i]) > 1e-4 * m_spacing[i])
+                return EC_IllegalParameter;
+        }
+    }
+
+    // Keep slices ordered by their position along the normal
+    SourceSlice newSlice = slice;
+    newSlice.distance    = slice.position[0] * (m_orientation[1] * m_orientation[5] - m_orientation[2] * m_orientation[4])
+                        + slice.position[1] * (m_orientation[2] * m_orientation[3] - m_orientation[0] * m_orientation[5])
+                        + slice.position[2] * (m_orientation[0] * m_orientation[4] - m_orientation[1] * m_orientation[3]);
+    OFVector<SourceSlice>::iterator it = m_slices.begin();
+    while ((it != m_slices.end()) && (it->distance < newSlice.distance))
+        ++it;
+    m_slices.insert(it, newSlice);
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationIntensityStatistics::computeStatistics(DcmDataset* segmentation,
+                                                               OFVector<IntensityStatistics>& statistics)
+{
+    statistics.clear();
+    if (m_slices.empty())
+    {
+        DCMSEG_ERROR("computeStatistics(): No source set");
+        return EC_IllegalCall;
+    }
+
+    PackedFrameUtil seg;
+    OFVector<Float64> orientation, spacing;
+    OFCondition cond = seg.setDataset(segmentation);
+    if (cond.good())
+        cond = seg.getImageOrientation(orientation);
+    if (cond.good())
+        cond = seg.getPixelSpacing(spacing);
+    if (cond.bad())
+    {
+        return cond;
+    }
+    bool sameGrid = (seg.getRows() == m_rows) && (seg.getColumns() == m_columns);
+    for (size_t i = 0; sameGrid && (i < 6); i++)
+        sameGrid = fabs(orientation[i] - m_orientation[i]) <= 1e-4;
+    for (size_t i = 0; sameGrid && (i < 2); i++)
+        sameGrid = fabs(spacing[i] - m_spacing[i]) <= 1e-4 * m_spacing[i];
+    if (!sameGrid)
+    {
+        DCMSEG_ERROR("computeStatistics(): Segmentation is not defined on the pixel grid of the source");
+        return EC_IllegalParameter;
+    }
+
+    // Map every frame to the source slice at the same position. Segment numbers are read from
+    // the dataset here, since it must not be accessed concurrently.
+    const Float64 tolerance = 0.01 * std::min(m_spacing[0], m_spacing[1]);
+    OFVector<OFVector<Uint32> > framesPerSlice(m_slices.size());
+    OFVector<Uint16> frameSegments(seg.getNumberOfFrames(), 0);
+    for (Uint32 f = 0; f < seg.getNumberOfFrames(); f++)
+    {
+        frameSegments[f] = seg.getSegmentNumberOfFrame(f);
+        PackedFrameUtil::ImagePosition position;
+        cond = seg.getImagePosition(f, position);
+        if (cond.bad())
+        {
+            return cond;
+        }
+        size_t nearest   = 0;
+        Float64 minError = -1;
+        for (size_t s = 0; s < m_slices.size(); s++)
+        {
+            Float64 error = 0;
+            for (size_t i = 0; i < 3; i++)
+            {
+                error += (position[i] - m_slices[s].position[i]) * (position[i] - m_slices[s].position[i]);
+            }
+            if ((minError < 0) || (error < minError))
+            {
+                minError = error;
+                nearest  = s;
+            }
+        }
+        if (sqrt(minError) > tolerance)
+        {
+            DCMSEG_ERROR("computeStatistics(): No source slice found for frame #" << f);
+            return EC_IllegalParameter;
+        }
+        framesPerSlice[nearest].push_back(f);
+    }
+    OFVector<size_t> coveredSlices;
+    for (size_t s = 0; s < m_slices.size(); s++)
+    {
+        if (!framesPerSlice[s].empty())
+            coveredSlices.push_back(s);
+    }
+
+    // Read covered slices in parallel, reducing per-slice statistics into the result
+    std::map<Uint16, IntensityStatistics> result;
+    const OFVector<Uint16> segmentNumbers = seg.getSegmentNumbers();
+    for (size_t s = 0; s < segmentNumbers.size(); s++)
+    {
+        result[segmentNumbers[s]]               = IntensityStatistics(m_histogramMin, m_histogramMax, m_bins);
+        result[segmentNumbers[s]].segmentNumber = segmentNumbers[s];
+    }
+    std::mutex resultMutex;
+    OFCondition readResult;
+    const size_t numPixels                   = OFstatic_cast(size_t, m_rows) * m_columns;
+    itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+    threader->ParallelizeArray(
+        0,
+        coveredSlices.size(),
+        [&](itk::SizeValueType i) {
+            const size_t s = coveredSlices[i];
+            OFVector<Float64> values;
+            OFCondition sliceResult = readSlice(m_slices[s], values);
+            std::map<Uint16, IntensityStatistics> sliceStatistics;
+            OFVector<Uint8> buffer;
+            for (size_t j = 0; sliceResult.good() && (j < framesPerSlice[s].size()); j++)
+            {
+                const Uint32 f       = framesPerSlice[s][j];
+                const Uint16 segment = frameSegments[f];
+                const Uint8* frame   = seg.getAlignedFrame(f);
+                if (!frame && (sliceResult = seg.getPackedFrame(f, buffer)).good())
+                    frame = &buffer[0];
+                if (sliceResult.bad())
+                    break;
+                IntensityStatistics& stats = sliceStatistics.insert(
+                    std::make_pair(segment, IntensityStatistics(m_histogramMin, m_histogramMax, m_bins))).first->second;
+                if (seg.getBitsAllocated() == 1)
+                {
+                    // Skip empty bytes of the packed frame
+                    for (size_t byte = 0; byte < (numPixels + 7) / 8; byte++)
+                    {
+                        for (size_t bit = 0; frame[byte] && (bit < 8) && (byte * 8 + bit < numPixels); bit++)
+                        {
+                            if (frame[byte] & (1 << bit))
+                                stats.add(values[byte * 8 + bit]);
+                        }
+                    }
+                }
+                else
+                {
+                    for (size_t p = 0; p < numPixels; p++)
+                    {
+                        if (frame[p])
+                            stats.add(values[p]);
+                    }
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(resultMutex);
+            if (sliceResult.bad())
+            {
+                readResult = sliceResult;
+                return;
+            }
+            for (std::map<Uint16, IntensityStatistics>::const_iterator it = sliceStatistics.begin();
+                 it != sliceStatistics.end();
+                 ++it)
+            {
+                result[it->first].merge(it->second);
+            }
+        },
+        nullptr);
+    if (readResult.bad())
+    {
+        return readResult;
+    }
+
+    for (std::map<Uint16, IntensityStatistics>::const_iterator it = result.begin(); it != result.end(); ++it)
+    {
+        statistics.push_back(it->second);
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationIntensityStatistics::readSlice(const SourceSlice& slice, OFVector<Float64>& values)
+{
+    const size_t frameBytes = OFstatic_cast(size_t, m_rows) * m_columns * (m_bitsAllocated / 8);
+    if (m_isParametricMap)
+    {
+        OFVector<Uint8> buffer(frameBytes);
+        {
+            std::lock_guard<std::mutex> lock(m_readMutex);
+            DcmElement* pixelData = NULL;
+            DcmFileCache cache;
+            OFCondition cond = m_parametricMap.getDataset()->findAndGetElement(m_pixelDataTag, pixelData);
+            if (cond.good())
+                cond = pixelData->getPartialValue(
+                    &buffer[0], OFstatic_cast(Uint32, slice.frameNo * frameBytes), OFstatic_cast(Uint32, frameBytes), &cache);
+            if (cond.bad())
+            {
+                DCMSEG_ERROR("readSlice(): Cannot read frame #" << slice.frameNo << ": " << cond.text());
+                return cond;
+            }
+        }
+        convertPixelData(&buffer[0], slice.slope, slice.intercept, values);
+        return EC_Normal;
+    }
+
+    DcmFileFormat ff;
+    OFCondition cond = ff.loadFile(slice.fileName.c_str());
+    if (cond.good())
+        cond = ff.getDataset()->chooseRepresentation(EXS_LittleEndianExplicit, NULL);
+    DcmElement* pixelData = NULL;
+    Uint8* data           = NULL;
+    if (cond.good())
+        cond = ff.getDataset()->findAndGetElement(DCM_PixelData, pixelData);
+    if (cond.good())
+        cond = pixelData->getUint8Array(data);
+    if (cond.good() && (!data || (pixelData->getLength() < frameBytes)))
+        cond = EC_IllegalParameter;
+    if (cond.bad())
+    {
+        DCMSEG_ERROR("readSlice(): Cannot read pixel data of " << slice.fileName << ": " << cond.text());
+        return cond;
+    }
+    convertPixelData(data, slice.slope, slice.intercept, values);
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+void SegmentationIntensityStatistics::convertPixelData(const Uint8* data,
+                                                       const Float64 slope,
+                                                       const Float64 intercept,
+                                                       OFVector<Float64>& values) const
+{
+    const size_t numPixels = OFstatic_cast(size_t, m_rows) * m_columns;
+    values.resize(numPixels);
+    if (m_pixelDataTag == DCM_FloatPixelData)
+    {
+        for (size_t p = 0; p < numPixels; p++)
+        {
+            Float32 value;
+            memcpy(&value, data + p * sizeof(Float32), sizeof(Float32));
+            values[p] = value * slope + intercept;
+        }
+        return;
+    }
+    if (m_pixelDataTag == DCM_DoubleFloatPixelData)
+    {
+        for (size_t p = 0; p < numPixels; p++)
+        {
+            Float64 value;
+            memcpy(&value, data + p * sizeof(Float64), sizeof(Float64));
+            values[p] = value * slope + intercept;
+        }
+        return;
+    }
+
+    // Integer pixel data, in local byte order, with Bits Stored starting at bit 0
+    const Uint16 bitsStored = (m_bitsStored && (m_bitsStored < m_bitsAllocated)) ? m_bitsStored : m_bitsAllocated;
+    const Uint64 mask       = (OFstatic_cast(Uint64, 1) << bitsStored) - 1;
+    for (size_t p = 0; p < numPixels; p++)
+    {
+        Uint64 raw = 0;
+        if (m_bitsAllocated == 8)
+            raw = data[p];
+        else if (m_bitsAllocated == 16)
+        {
+            Uint16 value;
+            memcpy(&value, data + p * 2, 2);
+            raw = value;
+        }
+        else
+        {
+            Uint32 value;
+            memcpy(&value, data + p * 4, 4);
+            raw = value;
+        }
+        raw &= mask;
+        Float64 value = OFstatic_cast(Float64, raw);
+        if (m_pixelRepresentation && (raw >> (bitsStored - 1)))
+            value -= OFstatic_cast(Float64, mask) + 1;
+        values[p] = value * slope + intercept;
+    }
+}
+
+// -------------------------------------------------------------------------------------
+
+void SegmentationIntensityStatistics::addMeasurementItems(const OFVector<IntensityStatistics>& statistics,
+                                                          const Json::Value& quantity,
+                                                          const Json::Value& units,
+                                                          Json::Value& measurements)
+{
+    for (Json::ArrayIndex g = 0; g < measurements.size(); g++)
+    {
+        Json::Value& group = measurements[g];
+        for (size_t s = 0; s < statistics.size(); s++)
+        {
+            const IntensityStatistics& stats = statistics[s];
+            if ((stats.segmentNumber != group["ReferencedSegment"].asUInt()) || !stats.count)
+                continue;
+            const Float64 values[]         = { stats.mean, stats.getStandardDeviation(), stats.getPercentile(50),
+                                               stats.minimum, stats.maximum };
+            const Json::Value modifiers[] = { makeCode("373098007", "SCT", "Mean"),
+                                              makeCode("386136009", "SCT", "Standard Deviation"),
+                                              makeCode("260528009", "SCT", "Median"),
+                                              makeCode("255605001", "SCT", "Minimum"),
+                                              makeCode("56851009", "SCT", "Maximum") };
+            for (size_t i = 0; i < 5; i++)
+            {
+                Json::Value item;
+                item["value"]              = Helper::floatToStr(OFstatic_cast(float, values[i]));
+                item["quantity"]           = quantity;
+                item["units"]              = units;
+                item["derivationModifier"] = modifiers[i];
+                group["measurementItems"].append(item);
+            }
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------
+
+void SegmentationIntensityStatistics::addStatisticsJSON(const OFVector<IntensityStatistics>& statistics,
+                                                        Json::Value& segments)
+{
+    const Float64 percentiles[] = { 5, 25, 50, 75, 95 };
+    for (Json::ArrayIndex i = 0; i < segments.size(); i++)
+    {
+        for (size_t s = 0; s < statistics.size(); s++)
+        {
+            const IntensityStatistics& stats = statistics[s];
+            if (stats.segmentNumber != segments[i]["labelID"].asUInt())
+                continue;
+            Json::Value intensity;
+            intensity["count"] = Json::UInt64(stats.count);
+            if (stats.count)
+            {
+                intensity["mean"]              = stats.mean;
+                intensity["standardDeviation"] = stats.getStandardDeviation();
+                intensity["minimum"]           = stats.minimum;
+                intensity["maximum"]           = stats.maximum;
+                for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); p++)
+                {
+                    intensity["percentiles"][Helper::toString(OFstatic_cast(unsigned, percentiles[p]))]
+                        = stats.getPercentile(percentiles[p]);
+                }
+            }
+            intensity["histogram"]["min"]      = stats.histogramMin;
+            intensity["histogram"]["binWidth"] = stats.binWidth;
+            intensity["histogram"]["counts"]   = Json::Value(Json::arrayValue);
+            for (size_t b = 0; b < stats.histogram.size(); b++)
+            {
+                intensity["histogram"]["counts"].append(Json::UInt64(stats.histogram[b]));
+            }
+            segments[i]["intensity"] = intensity;
+        }
+    }
+}
+
+} // namespace dcmqi
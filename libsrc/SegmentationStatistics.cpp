@@ -0,0 +1,415 @@
+
+// DCMQI includes
+#include "dcmqi/SegmentationStatistics.h"
+#include "dcmqi/Helper.h"
+#include "dcmqi/SegmentationInfo.h"
+
+// DCMTK includes
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmseg/segtypes.h"
+#include "dcmtk/ofstd/oflimits.h"
+
+// ITK includes
+#include <itkMultiThreaderBase.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace dcmqi
+{
+
+namespace
+{
+
+// Up to 64 bits starting at an arbitrary bit offset, first bit is the least significant one
+inline Uint64 loadBits(const Uint8* data, const size_t bitOffset, const size_t numBits)
+{
+    const Uint8* src    = data + bitOffset / 8;
+    const size_t shift  = bitOffset % 8;
+    const size_t nBytes = (shift + numBits + 7) / 8;
+    Uint64 value        = 0;
+    for (size_t i = 0; i < nBytes; i++)
+    {
+        const Uint64 byte = src[i];
+        value |= (i * 8 >= shift) ? (byte << (i * 8 - shift)) : (byte >> (shift - i * 8));
+    }
+    return (numBits < 64) ? (value & ((OFstatic_cast(Uint64, 1) << numBits) - 1)) : value;
+}
+
+// Sum of the indices of all set bits: bit k of the index is set for the bits selected by mask k
+inline Uint64 sumOfBitIndices(const Uint64 value)
+{
+    static const Uint64 masks[6] = { 0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+                                     0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL };
+    Uint64 sum = 0;
+    for (unsigned k = 0; k < 6; k++)
+    {
+        sum += OFstatic_cast(Uint64, PackedFrameUtil::countBits(value & masks[k])) << k;
+    }
+    return sum;
+}
+
+Json::Value makeCode(const char* value, const char* designator, const char* meaning)
+{
+    Json::Value code;
+    code["CodeValue"]              = value;
+    code["CodingSchemeDesignator"] = designator;
+    code["CodeMeaning"]            = meaning;
+    return code;
+}
+
+} // namespace
+
+// -------------------------------------------------------------------------------------
+
+SegmentationStatistics::SegmentStatistics::SegmentStatistics()
+    : segmentNumber(0)
+    , voxelCount(0)
+    , volume(0)
+{
+    for (size_t i = 0; i < 3; i++)
+    {
+        boundingBoxMin[i] = 0;
+        boundingBoxMax[i] = -1;
+        centroid[i]       = 0;
+    }
+}
+
+SegmentationStatistics::FrameStatistics::FrameStatistics()
+    : count(0)
+    , sumColumns(0)
+    , sumRows(0)
+    , minColumn(OFnumeric_limits<Sint32>::max())
+    , maxColumn(-1)
+    , minRow(OFnumeric_limits<Sint32>::max())
+    , maxRow(-1)
+{
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationStatistics::computeStatistics(DcmDataset* dataset, OFVector<SegmentStatistics>& statistics)
+{
+    statistics.clear();
+    PackedFrameUtil seg;
+    OFCondition cond = seg.setDataset(dataset, OFFalse, OFTrue);
+    OFVector<Float64> orientation, spacing;
+    Float64 sliceSpacing = 0;
+    if (cond.good())
+        cond = seg.getImageOrientation(orientation);
+    if (cond.good())
+        cond = seg.getPixelSpacing(spacing);
+    if (cond.good())
+        cond = getSliceSpacing(seg, sliceSpacing);
+    if (cond.bad())
+    {
+        return cond;
+    }
+    const Uint32 numberOfFrames = seg.getNumberOfFrames();
+
+    // Frame positions are read from the dataset, which must not be accessed concurrently
+    SegmentationInfo::FramesByPosition framesByPosition;
+    cond = SegmentationInfo::getFramesByPosition(seg, framesByPosition);
+    if (cond.bad())
+    {
+        return cond;
+    }
+    OFVector<Sint32> frameSlices(numberOfFrames, 0);
+    OFVector<PackedFrameUtil::ImagePosition> framePositions(numberOfFrames);
+    for (size_t p = 0; p < framesByPosition.size(); p++)
+    {
+        const Float64 offset = framesByPosition[p].first - framesByPosition[0].first;
+        for (size_t i = 0; i < framesByPosition[p].second.size(); i++)
+        {
+            const Uint32 f = framesByPosition[p].second[i];
+            frameSlices[f] = OFstatic_cast(Sint32, floor(offset / sliceSpacing + 0.5));
+            seg.getImagePosition(f, framePositions[f]);
+        }
+    }
+
+    // Frames of a label map hold all segments, so they have statistics for each segment
+    const OFVector<Uint16> segmentNumbers = seg.getSegmentNumbers();
+    const size_t statisticsPerFrame       = seg.isLabelmap() ? segmentNumbers.size() : 1;
+    OFVector<Sint32> segmentIndices;
+    if (seg.isLabelmap() && !segmentNumbers.empty())
+    {
+        segmentIndices.resize(OFstatic_cast(size_t, segmentNumbers.back()) + 1, -1);
+        for (size_t s = 0; s < segmentNumbers.size(); s++)
+            segmentIndices[segmentNumbers[s]] = OFstatic_cast(Sint32, s);
+    }
+
+    OFVector<FrameStatistics> frameStats(numberOfFrames * statisticsPerFrame);
+    OFVector<OFCondition> frameResults(numberOfFrames);
+    itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+    threader->ParallelizeArray(
+        0,
+        numberOfFrames,
+        [&](itk::SizeValueType f) {
+            const Uint32 frameNo = OFstatic_cast(Uint32, f);
+            frameResults[f]      = seg.isLabelmap()
+                                       ? scanLabelmapFrame(seg, frameNo, segmentIndices, &frameStats[f * statisticsPerFrame])
+                                       : scanFrame(seg, frameNo, frameStats[f]);
+        },
+        nullptr);
+    for (Uint32 f = 0; f < numberOfFrames; f++)
+    {
+        if (frameResults[f].bad())
+        {
+            return frameResults[f];
+        }
+    }
+
+    const Float64 voxelVolume = spacing[0] * spacing[1] * sliceSpacing;
+    for (size_t s = 0; s < segmentNumbers.size(); s++)
+    {
+        SegmentStatistics segmentStats;
+        segmentStats.segmentNumber = segmentNumbers[s];
+        OFVector<Uint32> frames;
+        seg.getFramesForSegment(segmentNumbers[s], frames);
+        Float64 sum[3] = { 0, 0, 0 };
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            const FrameStatistics& fs = frameStats[frames[i] * statisticsPerFrame + (seg.isLabelmap() ? s : 0)];
+            if (!fs.count)
+                continue;
+            const Sint32 frameMin[3] = { fs.minColumn, fs.minRow, frameSlices[frames[i]] };
+            const Sint32 frameMax[3] = { fs.maxColumn, fs.maxRow, frameSlices[frames[i]] };
+            for (size_t d = 0; d < 3; d++)
+            {
+                const bool first = (segmentStats.voxelCount == 0);
+                segmentStats.boundingBoxMin[d] = first ? frameMin[d] : std::min(segmentStats.boundingBoxMin[d], frameMin[d]);
+                segmentStats.boundingBoxMax[d] = first ? frameMax[d] : std::max(segmentStats.boundingBoxMax[d], frameMax[d]);
+                // Columns advance along the row direction, rows along the column direction
+                sum[d] += fs.count * framePositions[frames[i]][d] + fs.sumColumns * spacing[1] * orientation[d]
+                          + fs.sumRows * spacing[0] * orientation[3 + d];
+            }
+            segmentStats.voxelCount += fs.count;
+        }
+        segmentStats.volume = segmentStats.voxelCount * voxelVolume;
+        for (size_t d = 0; segmentStats.voxelCount && (d < 3); d++)
+        {
+            segmentStats.centroid[d] = sum[d] / segmentStats.voxelCount;
+        }
+        statistics.push_back(segmentStats);
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationStatistics::getMeasurements(DcmDataset* dataset,
+                                                    const OFVector<SegmentStatistics>& statistics,
+                                                    Json::Value& measurements)
+{
+    PackedFrameUtil seg;
+    OFCondition cond = seg.setDataset(dataset, OFTrue, OFTrue);
+    if (cond.bad())
+    {
+        return cond;
+    }
+    OFString sopInstanceUID, sourceSeriesUID;
+    dataset->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID);
+    DcmItem* seriesItem = NULL;
+    if (dataset->findAndGetSequenceItem(DCM_ReferencedSeriesSequence, seriesItem, 0).good())
+    {
+        seriesItem->findAndGetOFString(DCM_SeriesInstanceUID, sourceSeriesUID);
+    }
+
+    measurements = Json::Value(Json::arrayValue);
+    for (size_t s = 0; s < statistics.size(); s++)
+    {
+        DcmItem* segmentItem = seg.getSegmentItem(statistics[s].segmentNumber);
+        if (!segmentItem)
+        {
+            DCMSEG_ERROR("getMeasurements(): Segment " << statistics[s].segmentNumber << " does not exist");
+            return EC_IllegalParameter;
+        }
+        OFString label;
+        segmentItem->findAndGetOFString(DCM_SegmentLabel, label);
+        if (label.empty())
+        {
+            label = ("Segment " + Helper::toString(statistics[s].segmentNumber)).c_str();
+        }
+
+        Json::Value group;
+        group["TrackingIdentifier"]               = label.c_str();
+        group["ReferencedSegment"]                = statistics[s].segmentNumber;
+        group["SourceSeriesForImageSegmentation"] = sourceSeriesUID.c_str();
+        group["segmentationSOPInstanceUID"]       = sopInstanceUID.c_str();
+        group["Finding"] = SegmentationInfo::getCode(segmentItem, DCM_SegmentedPropertyTypeCodeSequence);
+        Json::Value findingSite = SegmentationInfo::getCode(segmentItem, DCM_AnatomicRegionSequence);
+        if (!findingSite.isNull())
+            group["FindingSite"] = findingSite;
+
+        Json::Value volume;
+        volume["value"]    = Helper::floatToStr(OFstatic_cast(float, statistics[s].volume));
+        volume["quantity"] = makeCode("118565006", "SCT", "Volume");
+        volume["units"]    = makeCode("mm3", "UCUM", "cubic millimeter");
+        group["measurementItems"].append(volume);
+        measurements.append(group);
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+Json::Value SegmentationStatistics::getStatisticsJSON(const OFVector<SegmentStatistics>& statistics)
+{
+    Json::Value result(Json::arrayValue);
+    for (size_t s = 0; s < statistics.size(); s++)
+    {
+        Json::Value segment;
+        segment["labelID"]    = statistics[s].segmentNumber;
+        segment["voxelCount"] = Json::UInt64(statistics[s].voxelCount);
+        segment["volume"]     = statistics[s].volume;
+        if (statistics[s].voxelCount)
+        {
+            for (size_t d = 0; d < 3; d++)
+            {
+                segment["boundingBoxMin"].append(statistics[s].boundingBoxMin[d]);
+                segment["boundingBoxMax"].append(statistics[s].boundingBoxMax[d]);
+                segment["centroid"].append(statistics[s].centroid[d]);
+            }
+        }
+        result.append(segment);
+    }
+    return result;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationStatistics::scanFrame(const PackedFrameUtil& seg, const Uint32 frameNo, FrameStatistics& frameStats)
+{
+    const size_t rows    = seg.getRows();
+    const size_t columns = seg.getColumns();
+    OFVector<Uint8> buffer;
+    const Uint8* frame = seg.getAlignedFrame(frameNo);
+    if (!frame)
+    {
+        OFCondition cond = seg.getPackedFrame(frameNo, buffer);
+        if (cond.bad())
+        {
+            return cond;
+        }
+        frame = &buffer[0];
+    }
+
+    for (size_t r = 0; r < rows; r++)
+    {
+        Uint64 rowCount = 0;
+        if (seg.getBitsAllocated() == 1)
+        {
+            for (size_t c = 0; c < columns; c += 64)
+            {
+                const Uint64 word = loadBits(frame, r * columns + c, std::min<size_t>(64, columns - c));
+                if (!word)
+                    continue;
+                const Uint64 count = PackedFrameUtil::countBits(word);
+                rowCount += count;
+                frameStats.sumColumns += OFstatic_cast(Float64, count * c + sumOfBitIndices(word));
+                frameStats.minColumn
+                    = std::min(frameStats.minColumn, OFstatic_cast(Sint32, c + PackedFrameUtil::lowestBit(word)));
+                frameStats.maxColumn
+                    = std::max(frameStats.maxColumn, OFstatic_cast(Sint32, c + PackedFrameUtil::highestBit(word)));
+            }
+        }
+        else
+        {
+            const Uint8* row = frame + r * columns;
+            for (size_t c = 0; c < columns; c++)
+            {
+                if (!row[c])
+                    continue;
+                rowCount++;
+                frameStats.sumColumns += OFstatic_cast(Float64, c);
+                frameStats.minColumn = std::min(frameStats.minColumn, OFstatic_cast(Sint32, c));
+                frameStats.maxColumn = std::max(frameStats.maxColumn, OFstatic_cast(Sint32, c));
+            }
+        }
+        if (rowCount)
+        {
+            frameStats.count += rowCount;
+            frameStats.sumRows += OFstatic_cast(Float64, rowCount * r);
+            frameStats.minRow = std::min(frameStats.minRow, OFstatic_cast(Sint32, r));
+            frameStats.maxRow = OFstatic_cast(Sint32, r);
+        }
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationStatistics::scanLabelmapFrame(const PackedFrameUtil& seg,
+                                                      const Uint32 frameNo,
+                                                      const OFVector<Sint32>& segmentIndices,
+                                                      FrameStatistics* frameStats)
+{
+    const size_t rows    = seg.getRows();
+    const size_t columns = seg.getColumns();
+    const Uint8* frame   = seg.getAlignedFrame(frameNo);
+    if (!frame)
+    {
+        return EC_IllegalParameter;
+    }
+    const Uint16* frame16 = (seg.getBitsAllocated() == 16) ? OFreinterpret_cast(const Uint16*, frame) : NULL;
+
+    for (size_t r = 0; r < rows; r++)
+    {
+        for (size_t c = 0; c < columns; c++)
+        {
+            const size_t label = frame16 ? frame16[r * columns + c] : frame[r * columns + c];
+            // Background, or a value without segment
+            if (!label || (label >= segmentIndices.size()) || (segmentIndices[label] < 0))
+                continue;
+            FrameStatistics& fs = frameStats[segmentIndices[label]];
+            fs.count++;
+            fs.sumColumns += OFstatic_cast(Float64, c);
+            fs.sumRows += OFstatic_cast(Float64, r);
+            fs.minColumn = std::min(fs.minColumn, OFstatic_cast(Sint32, c));
+            fs.maxColumn = std::max(fs.maxColumn, OFstatic_cast(Sint32, c));
+            fs.minRow    = std::min(fs.minRow, OFstatic_cast(Sint32, r));
+            fs.maxRow    = OFstatic_cast(Sint32, r);
+        }
+    }
+    return EC_Normal;
+}
+
+// -------------------------------------------------------------------------------------
+
+OFCondition SegmentationStatistics::getSliceSpacing(const PackedFrameUtil& seg, Float64& spacing)
+{
+    SegmentationInfo::FramesByPosition framesByPosition;
+    OFCondition cond = SegmentationInfo::getFramesByPosition(seg, framesByPosition);
+    if (cond.bad())
+    {
+        return cond;
+    }
+    spacing = 0;
+    for (size_t p = 1; p < framesByPosition.size(); p++)
+    {
+        const Float64 distance = framesByPosition[p].first - framesByPosition[p - 1].first;
+        spacing                = (p == 1) ? distance : std::min(spacing, distance);
+    }
+    if (spacing > 0)
+    {
+        return EC_Normal;
+    }
+
+    // Single position, use declared values
+    DcmItem* sharedItem = NULL;
+    DcmItem* measures   = NULL;
+    if (seg.getDataset()->findAndGetSequenceItem(DCM_SharedFunctionalGroupsSequence, sharedItem, 0).good()
+        && sharedItem->findAndGetSequenceItem(DCM_PixelMeasuresSequence, measures, 0).good())
+    {
+        if (measures->findAndGetFloat64(DCM_SpacingBetweenSlices, spacing).bad() || (spacing <= 0))
+            measures->findAndGetFloat64(DCM_SliceThickness, spacing);
+    }
+    if (spacing <= 0)
+    {
+        DCMSEG_ERROR("getSliceSpacing(): Cannot determine distance between slices");
+        return EC_IllegalParameter;
+    }
+    return EC_Normal;
+}
+
+} // namespace dcmqi
@@ -0,0 +1,99 @@
+// DCMQI includes
+#include "dcmqi/SharedMemoryIO.h"
+#include "dcmqi/ConversionContext.h"
+
+// STD includes
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace dcmqi {
+
+  bool SharedMemoryIO::publish(const std::string &name, const itk::ImageBase<3>* image, const void* voxels,
+                               DataType dataType, const std::string &metadata, size_t* objectSize) {
+#ifdef _WIN32
+    ConversionContext::err() << "ERROR: Shared memory output is not supported on this platform" << std::endl;
+    return false;
+#else
+    const itk::ImageBase<3>::SizeType size = image->GetLargestPossibleRegion().GetSize();
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "DCMQIVOL", 8);
+    header.version = 1;
+    header.headerSize = sizeof(Header);
+    header.dataType = dataType;
+    header.itemSize = dataType == INT16 ? 2 : 4;
+    for(int i=0;i<3;i++){
+      header.size[i] = size[i];
+      header.spacing[i] = image->GetSpacing()[i];
+      header.origin[i] = image->GetOrigin()[i];
+      for(int j=0;j<3;j++)
+        header.direction[3*i+j] = image->GetDirection()[i][j];
+    }
+    header.dataOffset = (sizeof(Header) + 63) / 64 * 64;
+    header.dataSize = uint64_t(size[0]) * size[1] * size[2] * header.itemSize;
+    header.metadataOffset = header.dataOffset + header.dataSize;
+    header.metadataSize = metadata.size();
+    const size_t length = size_t(header.metadataOffset + header.metadataSize);
+
+    int object = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(object < 0){
+      ConversionContext::err() << "ERROR: Failed to create shared memory object " << name << ": "
+                               << strerror(errno) << std::endl;
+      return false;
+    }
+    if(ftruncate(object, off_t(length)) != 0){
+      ConversionContext::err() << "ERROR: Failed to allocate " << length << " bytes of shared memory for "
+                               << name << ": " << strerror(errno) << std::endl;
+      close(object);
+      shm_unlink(name.c_str());
+      return false;
+    }
+    void* mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, object, 0);
+    close(object);
+    if(mapping == MAP_FAILED){
+      ConversionContext::err() << "ERROR: Failed to map shared memory object " << name << ": "
+                               << strerror(errno) << std::endl;
+      shm_unlink(name.c_str());
+      return false;
+    }
+
+    char* bytes = static_cast<char*>(mapping);
+    memcpy(bytes, &header, sizeof(header));
+    memcpy(bytes + header.dataOffset, voxels, size_t(header.dataSize));
+    memcpy(bytes + header.metadataOffset, metadata.data(), metadata.size());
+    munmap(mapping, length);
+
+    if(objectSize)
+      *objectSize = length;
+    return true;
+#endif
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool SharedMemoryIO::unlink(const std::string &name) {
+#ifdef _WIN32
+    return false;
+#else
+    return shm_unlink(name.c_str()) == 0;
+#endif
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool SharedMemoryIO::isSupported() {
+#ifdef _WIN32
+    return false;
+#else
+    return true;
+#endif
+  }
+
+}
@@ -1,3 +1,4 @@
+#include "dcmqi/ConversionContext.h"
 #include "dcmqi/TID1500Reader.h"
 
 DSRCodedEntryValue json2cev(Json::Value& j){
@@ -18,7 +19,7 @@ TID1500Reader::TID1500Reader(const DSRDocumentTree &tree)
   : DSRDocumentTree(tree) {
     // check for expected template identification
     if (!compareTemplateIdentification("1500", "DCMR"))
-      std::cerr << "warning: template identification \"TID 1500 (DCMR)\" not found" << OFendl;
+      dcmqi::ConversionContext::err() << "warning: template identification \"TID 1500 (DCMR)\" not found" << OFendl;
 
 }
 
@@ -39,7 +40,7 @@ Json::Value TID1500Reader::getObserverContext(){
   getCursorToRootNode(rootCursor);
   Json::Value observerType = getContentItem(CODE_DCM_ObserverType, rootCursor);
   if(observerType == Json::nullValue){
-    std::cout << "Observer context not initialized!" << std::endl;
+    dcmqi::ConversionContext::out() << "Observer context not initialized!" << std::endl;
     return Json::nullValue;
   }
   if(json2cev(observerType) == CODE_DCM_Person){
@@ -116,7 +117,7 @@ Json::Value TID1500Reader::getMeasurements() {
           Json::Value algorithmParameters = getContentItem(CODE_DCM_AlgorithmParameters, groupCursor);
           if(algorithmName!=Json::nullValue){
             if(algorithmVersion == Json::nullValue){
-              std::cerr << "ERROR: AlgorithmName is present, but AlgorithmVersion is not!" << std::endl;
+              dcmqi::ConversionContext::err() << "ERROR: AlgorithmName is present, but AlgorithmVersion is not!" << std::endl;
             }
             measurementGroup["measurementAlgorithmIdentification"]["AlgorithmName"] = algorithmName;
             measurementGroup["measurementAlgorithmIdentification"]["AlgorithmVersion"] = algorithmVersion;
@@ -165,7 +166,7 @@ Json::Value TID1500Reader::getMeasurements() {
               if(find(knownConcepts.begin(), knownConcepts.end(), node->getConceptName()) == knownConcepts.end() &&
               find(algorithmIdentificationConcepts.begin(), algorithmIdentificationConcepts.end(), node->getConceptName()) == algorithmIdentificationConcepts.end()){
                 Json::Value singleQualitativeEvaluation;
-                std::cout << "Found concept that is not known, and as such is qualitative: " << node->getConceptName() << std::endl;
+                dcmqi::ConversionContext::out() << "Found concept that is not known, and as such is qualitative: " << node->getConceptName() << std::endl;
                 singleQualitativeEvaluation["conceptCode"] = DSRCodedEntryValue2CodeSequence(node->getConceptName());
                 singleQualitativeEvaluation["conceptValue"] = OFstatic_cast(
                 const DSRTextTreeNode *, node)->getValue().c_str();
@@ -228,7 +229,7 @@ Json::Value TID1500Reader::getContentItem(const DSRCodedEntryValue &conceptName,
           const DSRPNameTreeNode *, node)->getValue().c_str();
           break;
         default:
-          std::cout << "Error: failed to find content item for " << conceptName.getCodeMeaning() << OFendl;
+          dcmqi::ConversionContext::out() << "Error: failed to find content item for " << conceptName.getCodeMeaning() << OFendl;
       }
     }
   }
@@ -280,9 +281,9 @@ Json::Value TID1500Reader::getSingleMeasurement(const DSRNumTreeNode &numNode,
             singleMeasurement["derivationModifier"] = DSRCodedEntryValue2CodeSequence(OFstatic_cast(
             const DSRCodeTreeNode *, node)->getValue());
           } else if (node->getConceptName() == CODE_SCT_FindingSite || node->getConceptName() == CODE_SRT_FindingSite) {
-            std::cerr << "Warning: For now, FindingSite modifier is interpreted only at the MeasurementGroup level." << OFendl;
+            dcmqi::ConversionContext::err() << "Warning: For now, FindingSite modifier is interpreted only at the MeasurementGroup level." << OFendl;
           } else if (node->getConceptName() == CODE_SCT_MeasurementMethod || node->getConceptName() == CODE_SRT_MeasurementMethod) {
-            std::cerr << "Warning: For now, Measurement Method modifier is interpreted only at the MeasurementGroup level." << OFendl;
+            dcmqi::ConversionContext::err() << "Warning: For now, Measurement Method modifier is interpreted only at the MeasurementGroup level." << OFendl;
           } else if (node->getValueType() == VT_Code) {
             // Otherwise, assume that modifier corresponds to row 6.
             // NB: as a consequence, this means other types of concept modifiers must be factored out
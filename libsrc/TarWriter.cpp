@@ -0,0 +1,108 @@
+// DCMQI includes
+#include "dcmqi/TarWriter.h"
+#include "dcmqi/ConversionContext.h"
+
+// STD includes
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace dcmqi {
+
+  namespace {
+    const size_t blockSize = 512;
+
+    // Writes a zero-terminated octal number filling the field
+    void setOctal(char* field, size_t length, unsigned long long value) {
+      snprintf(field, length, "%0*llo", int(length - 1), value);
+    }
+  }
+
+  TarWriter::TarWriter(std::ostream &stream)
+    : m_stream(stream) {
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool TarWriter::addFile(const std::string &name, const std::string &content) {
+    return addFile(name, std::vector<std::pair<const char*, size_t> >(1, std::make_pair(content.data(), content.size())));
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool TarWriter::addFile(const std::string &name, const std::vector<std::pair<const char*, size_t> > &buffers) {
+    size_t size = 0;
+    for(size_t i=0;i<buffers.size();i++)
+      size += buffers[i].second;
+
+    if(!writeHeader(name, size))
+      return false;
+    for(size_t i=0;i<buffers.size();i++)
+      m_stream.write(buffers[i].first, std::streamsize(buffers[i].second));
+
+    // the content is padded to whole blocks
+    const char padding[blockSize] = {0};
+    m_stream.write(padding, std::streamsize((blockSize - size % blockSize) % blockSize));
+    if(!m_stream){
+      ConversionContext::err() << "ERROR: Failed to write " << name << " to the output stream" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool TarWriter::finish() {
+    // two empty blocks mark the end of the archive
+    const char endOfArchive[2*blockSize] = {0};
+    m_stream.write(endOfArchive, sizeof(endOfArchive));
+    m_stream.flush();
+    if(!m_stream){
+      ConversionContext::err() << "ERROR: Failed to write the output stream" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // -------------------------------------------------------------------------------------
+
+  bool TarWriter::writeHeader(const std::string &name, size_t size) {
+    char header[blockSize];
+    memset(header, 0, sizeof(header));
+    if(name.empty() || name.size() > 100){
+      ConversionContext::err() << "ERROR: File name cannot be stored in the output stream: " << name << std::endl;
+      return false;
+    }
+    memcpy(header, name.data(), name.size());
+    setOctal(header + 100, 8, 0644);
+    setOctal(header + 108, 8, 0);
+    setOctal(header + 116, 8, 0);
+    const unsigned long long maxOctalSize = 077777777777ULL;
+    if(size <= maxOctalSize)
+      setOctal(header + 124, 12, size);
+    else {
+      // base-256: a set high bit followed by the big endian size
+      header[124] = char(0x80);
+      unsigned long long value = size;
+      for(int i=11;i>0;i--){
+        header[124+i] = char(value & 0xff);
+        value >>= 8;
+      }
+    }
+    setOctal(header + 136, 12, (unsigned long long)(time(NULL)));
+    header[156] = '0';
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+
+    // the checksum is computed with the checksum field set to spaces
+    memset(header + 148, ' ', 8);
+    unsigned checksum = 0;
+    for(size_t i=0;i<blockSize;i++)
+      checksum += static_cast<unsigned char>(header[i]);
+    setOctal(header + 148, 7, checksum);
+
+    m_stream.write(header, blockSize);
+    return bool(m_stream);
+  }
+
+}
@@ -0,0 +1,370 @@
+// DCMQI includes
+#include "dcmqi/dcmqi_c.h"
+#include "dcmqi/ConversionContext.h"
+#include "dcmqi/Dicom2ItkConverter.h"
+#include "dcmqi/Helper.h"
+#include "dcmqi/Itk2DicomConverter.h"
+#include "dcmqi/ParaMapConverter.h"
+
+// ITK includes
+#include <itkImportImageFilter.h>
+
+// STD includes
+#include <cstddef>
+#include <functional>
+#include <sstream>
+
+struct dcmqi_result {
+  dcmqi_result() : hasDicom(false) {}
+
+  std::vector<ShortImageType::Pointer> labelImages;
+  std::vector<FloatImageType::Pointer> floatImages;
+  std::vector<char> dicom;
+  bool hasDicom;
+  std::string metadata;
+  std::string log;
+  std::string errors;
+};
+
+namespace {
+
+  using dcmqi::ConversionContext;
+
+  // Wraps caller memory into an image without copying; the converters only read their input
+  template<typename TImage>
+  typename TImage::Pointer importImage(const dcmqi_geometry &geometry, const typename TImage::PixelType* voxels) {
+    typedef itk::ImportImageFilter<typename TImage::PixelType, 3> ImportFilterType;
+    typename ImportFilterType::Pointer importFilter = ImportFilterType::New();
+
+    typename ImportFilterType::SizeType size;
+    typename ImportFilterType::IndexType start;
+    typename ImportFilterType::OriginType origin;
+    typename ImportFilterType::SpacingType spacing;
+    typename ImportFilterType::DirectionType direction;
+    for(int i=0;i<3;i++){
+      size[i] = geometry.size[i];
+      start[i] = 0;
+      origin[i] = geometry.origin[i];
+      spacing[i] = geometry.spacing[i];
+      for(int j=0;j<3;j++)
+        direction[i][j] = geometry.direction[3*i+j];
+    }
+    typename ImportFilterType::RegionType region;
+    region.SetIndex(start);
+    region.SetSize(size);
+    importFilter->SetRegion(region);
+    importFilter->SetOrigin(origin);
+    importFilter->SetSpacing(spacing);
+    importFilter->SetDirection(direction);
+
+    const size_t numberOfPixels = size_t(size[0]) * size[1] * size[2];
+    importFilter->SetImportPointer(const_cast<typename TImage::PixelType*>(voxels), numberOfPixels, false);
+    importFilter->Update();
+    return importFilter->GetOutput();
+  }
+
+  template<typename TImage>
+  void exportGeometry(const typename TImage::Pointer &image, dcmqi_geometry* geometry) {
+    const typename TImage::SizeType size = image->GetLargestPossibleRegion().GetSize();
+    for(int i=0;i<3;i++){
+      geometry->size[i] = static_cast<uint32_t>(size[i]);
+      geometry->origin[i] = image->GetOrigin()[i];
+      geometry->spacing[i] = image->GetSpacing()[i];
+      for(int j=0;j<3;j++)
+        geometry->direction[3*i+j] = image->GetDirection()[i][j];
+    }
+  }
+
+  // Size of dcmqi_geometry in version 1 of the interface, which all callers provide at least
+  const size_t geometrySizeV1 = offsetof(dcmqi_geometry, direction) + 9 * sizeof(double);
+
+  bool isValidGeometrySize(const dcmqi_geometry* geometry) {
+    return geometry && geometry->struct_size >= geometrySizeV1;
+  }
+
+  bool isValidGeometry(const dcmqi_geometry* geometry) {
+    return isValidGeometrySize(geometry) && geometry->size[0] && geometry->size[1] && geometry->size[2];
+  }
+
+  // The caller's struct size is the stride of the array, which may differ from sizeof(dcmqi_geometry)
+  const dcmqi_geometry* getGeometry(const dcmqi_geometry* geometries, size_t index) {
+    return reinterpret_cast<const dcmqi_geometry*>(reinterpret_cast<const char*>(geometries)
+                                                   + index * geometries->struct_size);
+  }
+
+  // Parses the source image series; datasets without pixel data are skipped as for file input
+  int loadSources(const void* const* sourceData, const size_t* sourceSizes, size_t sourceCount,
+                  std::vector<DcmDataset*> &datasets) {
+    for(size_t i=0;i<sourceCount;i++){
+      DcmDataset* dataset = dcmqi::Helper::loadDatasetFromBuffer(sourceData[i], sourceSizes[i]);
+      if(dataset == NULL)
+        return DCMQI_ERROR_INVALID_DICOM;
+      if(!dataset->tagExistsWithValue(DCM_PixelData)){
+        ConversionContext::err() << "Source DICOM object " << i << " does not contain PixelData, skipping it" << std::endl;
+        delete dataset;
+        continue;
+      }
+      datasets.push_back(dataset);
+    }
+    if(datasets.empty()){
+      ConversionContext::err() << "ERROR: No source DICOM object with pixel data" << std::endl;
+      return DCMQI_ERROR_INVALID_DICOM;
+    }
+    return DCMQI_OK;
+  }
+
+  void deleteDatasets(std::vector<DcmDataset*> &datasets) {
+    for(size_t i=0;i<datasets.size();i++)
+      delete datasets[i];
+    datasets.clear();
+  }
+
+  // Stores the dataset as DICOM file in the result and takes ownership of it
+  int storeDicom(DcmDataset* dataset, dcmqi_result &result) {
+    if(dataset == NULL)
+      return DCMQI_ERROR_CONVERSION;
+    OFCondition cond = dcmqi::Helper::saveDatasetToBuffer(dataset, result.dicom);
+    delete dataset;
+    if(cond.bad()){
+      ConversionContext::err() << "ERROR: Failed to encode the result: " << cond.text() << std::endl;
+      return DCMQI_ERROR_CONVERSION;
+    }
+    result.hasDicom = true;
+    return DCMQI_OK;
+  }
+
+  // Runs a conversion with its own message streams, turning exceptions into status codes
+  int run(dcmqi_result** result, const std::function<int(dcmqi_result&)> &conversion) {
+    if(result == NULL)
+      return DCMQI_ERROR_INVALID_ARGUMENT;
+    *result = new dcmqi_result;
+    ConversionContext::initialize();
+
+    std::ostringstream out, err;
+    int status = DCMQI_ERROR_CONVERSION;
+    {
+      ConversionContext context(out, err);
+      try {
+        status = conversion(**result);
+      } catch (int) {
+        // the error has been reported already
+      } catch (std::exception &e) {
+        err << "ERROR: " << e.what() << std::endl;
+      } catch (...) {
+        err << "ERROR: Unknown exception during conversion" << std::endl;
+      }
+    }
+    (*result)->log = out.str();
+    (*result)->errors = err.str();
+    return status;
+  }
+
+}
+
+// -------------------------------------------------------------------------------------
+
+int dcmqi_api_version(void) {
+  return DCMQI_C_API_VERSION;
+}
+
+// -------------------------------------------------------------------------------------
+
+const char* dcmqi_version(void) {
+  return DCMQI_VERSION_STRING;
+}
+
+// -------------------------------------------------------------------------------------
+
+int dcmqi_seg_to_labelmaps(const void* segData, size_t segSize, int mergeSegments, dcmqi_result** result) {
+  return run(result, [&](dcmqi_result &res) -> int {
+    if(segData == NULL || !segSize)
+      return DCMQI_ERROR_INVALID_ARGUMENT;
+    DcmDataset* segDataset = dcmqi::Helper::loadDatasetFromBuffer(segData, segSize);
+    if(segDataset == NULL)
+      return DCMQI_ERROR_INVALID_DICOM;
+
+    dcmqi::Dicom2ItkConverter converter;
+    OFCondition cond;
+    try {
+      cond = converter.dcmSegmentation2itkimage(segDataset, res.metadata, mergeSegments != 0);
+    } catch (...) {
+      delete segDataset;
+      throw;
+    }
+    if(cond.good()){
+      for(ShortImageType::Pointer image = converter.begin(); image; image = converter.next())
+        res.labelImages.push_back(image);
+    }
+    delete segDataset;
+    if(cond.bad()){
+      ConversionContext::err() << "ERROR: Failed to convert DICOM SEG to ITK image: " << cond.text() << std::endl;
+      return DCMQI_ERROR_CONVERSION;
+    }
+    return DCMQI_OK;
+  });
+}
+
+// -------------------------------------------------------------------------------------
+
+int dcmqi_labelmaps_to_seg(const void* const* sourceData, const size_t* sourceSizes, size_t sourceCount,
+                           const int16_t* const* labels, const dcmqi_geometry* geometries, size_t labelCount,
+                           const char* metadataJson, int skipEmptySlices, dcmqi_result** result) {
+  return run(result, [&](dcmqi_result &res) -> int {
+    if(sourceData == NULL || sourceSizes == NULL || !sourceCount
+       || labels == NULL || geometries == NULL || !labelCount || metadataJson == NULL)
+      return DCMQI_ERROR_INVALID_ARGUMENT;
+
+    if(!isValidGeometrySize(geometries))
+      return DCMQI_ERROR_INVALID_ARGUMENT;
+    std::vector<ShortImageType::Pointer> segmentations;
+    for(size_t i=0;i<labelCount;i++){
+      const dcmqi_geometry* geometry = getGeometry(geometries, i);
+      if(labels[i] == NULL || !isValidGeometry(geometry) || geometry->struct_size != geometries->struct_size)
+        return DCMQI_ERROR_INVALID_ARGUMENT;
+      segmentations.push_back(importImage<ShortImageType>(*geometry, labels[i]));
+    }
+
+    std::vector<DcmDataset*> datasets;
+    int status = loadSources(sourceData, sourceSizes, sourceCount, datasets);
+    if(status != DCMQI_OK){
+      deleteDatasets(datasets);
+      return status;
+    }
+
+    DcmDataset* seg = NULL;
+    try {
+      seg = dcmqi::Itk2DicomConverter::itkimage2dcmSegmentation(datasets, segmentations, metadataJson,
+                                                                skipEmptySlices != 0);
+    } catch (...) {
+      deleteDatasets(datasets);
+      throw;
+    }
+    deleteDatasets(datasets);
+    return storeDicom(seg, res);
+  });
+}
+
+// -------------------------------------------------------------------------------------
+
+int dcmqi_paramap_to_image(const void* pmapData, size_t pmapSize, dcmqi_result** result) {
+  return run(result, [&](dcmqi_result &res) -> int {
+    if(pmapData == NULL || !pmapSize)
+      return DCMQI_ERROR_INVALID_ARGUMENT;
+    DcmDataset* pmapDataset = dcmqi::Helper::loadDatasetFromBuffer(pmapData, pmapSize);
+    if(pmapDataset == NULL)
+      return DCMQI_ERROR_INVALID_DICOM;
+
+    std::pair<FloatImageType::Pointer, std::string> converted;
+    try {
+      converted = dcmqi::ParaMapConverter::paramap2itkimage(pmapDataset);
+    } catch (...) {
+      delete pmapDataset;
+      throw;
+    }
+    delete pmapDataset;
+    if(converted.first.IsNull())
+      return DCMQI_ERROR_CONVERSION;
+    res.floatImages.push_back(converted.first);
+    res.metadata = converted.second;
+    return DCMQI_OK;
+  });
+}
+
+// -------------------------------------------------------------------------------------
+
+int dcmqi_image_to_paramap(const void* const* sourceData, const size_t* sourceSizes, size_t sourceCount,
+                           const float* voxels, const dcmqi_geometry* geometry, const char* metadataJson,
+                           dcmqi_result** result) {
+  return run(result, [&](dcmqi_result &res) -> int {
+    if(sourceData == NULL || sourceSizes == NULL || !sourceCount
+       || voxels == NULL || !isValidGeometry(geometry) || metadataJson == NULL)
+      return DCMQI_ERROR_INVALID_ARGUMENT;
+
+    FloatImageType::Pointer image = importImage<FloatImageType>(*geometry, voxels);
+
+    std::vector<DcmDataset*> datasets;
+    int status = loadSources(sourceData, sourceSizes, sourceCount, datasets);
+    if(status != DCMQI_OK){
+      deleteDatasets(datasets);
+      return status;
+    }
+
+    DcmDataset* pmap = NULL;
+    try {
+      pmap = dcmqi::ParaMapConverter::itkimage2paramap(image, datasets, metadataJson);
+    } catch (...) {
+      deleteDatasets(datasets);
+      throw;
+    }
+    deleteDatasets(datasets);
+    return storeDicom(pmap, res);
+  });
+}
+
+// -------------------------------------------------------------------------------------
+
+size_t dcmqi_result_image_count(const dcmqi_result* result) {
+  return result ? result->labelImages.size() + result->floatImages.size() : 0;
+}
+
+// -------------------------------------------------------------------------------------
+
+int dcmqi_result_label_image(const dcmqi_result* result, size_t index, dcmqi_geometry* geometry,
+                             const int16_t** voxels) {
+  if(result == NULL || !isValidGeometrySize(geometry) || voxels == NULL)
+    return DCMQI_ERROR_INVALID_ARGUMENT;
+  if(index >= result->labelImages.size())
+    return DCMQI_ERROR_NOT_AVAILABLE;
+  exportGeometry<ShortImageType>(result->labelImages[index], geometry);
+  *voxels = result->labelImages[index]->GetBufferPointer();
+  return DCMQI_OK;
+}
+
+// -------------------------------------------------------------------------------------
+
+int dcmqi_result_float_image(const dcmqi_result* result, size_t index, dcmqi_geometry* geometry,
+                             const float** voxels) {
+  if(result == NULL || !isValidGeometrySize(geometry) || voxels == NULL)
+    return DCMQI_ERROR_INVALID_ARGUMENT;
+  if(index >= result->floatImages.size())
+    return DCMQI_ERROR_NOT_AVAILABLE;
+  exportGeometry<FloatImageType>(result->floatImages[index], geometry);
+  *voxels = result->floatImages[index]->GetBufferPointer();
+  return DCMQI_OK;
+}
+
+// -------------------------------------------------------------------------------------
+
+int dcmqi_result_dicom(const dcmqi_result* result, const void** data, size_t* size) {
+  if(result == NULL || data == NULL || size == NULL)
+    return DCMQI_ERROR_INVALID_ARGUMENT;
+  if(!result->hasDicom)
+    return DCMQI_ERROR_NOT_AVAILABLE;
+  *data = result->dicom.data();
+  *size = result->dicom.size();
+  return DCMQI_OK;
+}
+
+// -------------------------------------------------------------------------------------
+
+const char* dcmqi_result_metadata(const dcmqi_result* result) {
+  return result ? result->metadata.c_str() : "";
+}
+
+// -------------------------------------------------------------------------------------
+
+const char* dcmqi_result_log(const dcmqi_result* result) {
+  return result ? result->log.c_str() : "";
+}
+
+// -------------------------------------------------------------------------------------
+
+const char* dcmqi_result_errors(const dcmqi_result* result) {
+  return result ? result->errors.c_str() : "";
+}
+
+// -------------------------------------------------------------------------------------
+
+void dcmqi_result_free(dcmqi_result* result) {
+  delete result;
+}
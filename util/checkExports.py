@@ -0,0 +1,28 @@
+"""Checks that a shared library only exports the functions of the dcmqi C interface.
+
+The dynamic symbol table of the library is listed with nm -D. Besides the symbols starting
+with a given prefix, only those defined by the linker itself may be exported.
+
+Usage: checkExports.py nm library prefix
+"""
+
+import subprocess, sys
+
+LINKER_SYMBOLS = set(['_init', '_fini', '_edata', '_end', '__bss_start'])
+
+if len(sys.argv) != 4:
+  sys.exit(__doc__)
+nm, library, prefix = sys.argv[1:]
+
+output = subprocess.check_output([nm, '-D', '--defined-only', library]).decode('utf-8')
+symbols = [line.split()[-1] for line in output.splitlines() if len(line.split()) >= 3]
+exported = [symbol for symbol in symbols if symbol.startswith(prefix)]
+unexpected = sorted(symbol for symbol in symbols if not symbol.startswith(prefix) and symbol not in LINKER_SYMBOLS)
+
+if not exported:
+  print('Error: %s exports no symbols starting with %s' % (library, prefix))
+for symbol in unexpected[:50]:
+  print('Error: unexpected export ' + symbol)
+if len(unexpected) > 50:
+  print('Error: ... and %d more unexpected exports' % (len(unexpected) - 50))
+sys.exit(1 if unexpected or not exported else 0)
@@ -0,0 +1,131 @@
+"""Checks a 3D Slicer segmentation file (.seg.nrrd) against one label image per layer.
+
+The file must hold the layers as first axis of a 4D array (or be 3D for a single layer), with
+the geometry and the voxels of the baselines. For every label of a baseline, there must be one
+segment whose Segment<N>_ fields give that LabelValue, the Layer of the baseline and the Extent
+of the label in the baseline, and whose name and color match the expected metadata.
+
+Usage: checkSegNrrd.py output.seg.nrrd expected-meta.json layer0.nrrd [layer1.nrrd ...]
+"""
+
+import gzip, json, struct, sys
+
+TYPES = {'unsigned char': 'B', 'unsigned short': 'H', 'short': 'h'}
+
+def readNrrd(fileName):
+  with open(fileName, 'rb') as f:
+    content = f.read()
+  headerEnd = content.index(b'\n\n')
+  lines = content[:headerEnd].decode('utf-8').split('\n')
+  fields = dict(line.split(': ', 1) for line in lines[1:] if ': ' in line and not line.startswith('#'))
+  keyValuePairs = dict(line.split(':=', 1) for line in lines[1:] if ':=' in line)
+  data = content[headerEnd + 2:]
+  if fields['encoding'] == 'gzip':
+    data = gzip.decompress(data)
+  elif fields['encoding'] != 'raw':
+    sys.exit('Error: unsupported encoding ' + fields['encoding'])
+  itemType = TYPES[fields['type']]
+  byteOrder = '>' if fields.get('endian', 'little') == 'big' else '<'
+  voxels = struct.unpack('%s%d%s' % (byteOrder, len(data) // struct.calcsize(itemType), itemType), data)
+  return fields, keyValuePairs, voxels
+
+def parseVectors(value):
+  return [None if vector == 'none' else [float(x) for x in vector.strip('()').split(',')]
+          for vector in value.split()]
+
+def closeTo(a, b, tolerance=1e-3):
+  return all(abs(x - y) <= tolerance for x, y in zip(a, b))
+
+def getExtent(voxels, size, label):
+  extent = None
+  for position, value in enumerate(voxels):
+    if value != label:
+      continue
+    i = position % size[0]
+    j = position // size[0] % size[1]
+    k = position // (size[0] * size[1])
+    if extent is None:
+      extent = [i, i, j, j, k, k]
+    else:
+      extent = [min(extent[0], i), max(extent[1], i), min(extent[2], j), max(extent[3], j),
+                min(extent[4], k), max(extent[5], k)]
+  return extent
+
+if len(sys.argv) < 4:
+  sys.exit(__doc__)
+outputFileName, metaFileName = sys.argv[1:3]
+baselines = [readNrrd(fileName) for fileName in sys.argv[3:]]
+numberOfLayers = len(baselines)
+fields, keyValuePairs, voxels = readNrrd(outputFileName)
+errors = []
+
+# geometry and layout
+baselineFields = baselines[0][0]
+size = [int(x) for x in baselineFields['sizes'].split()]
+expectedSizes = ([numberOfLayers] if numberOfLayers > 1 else []) + size
+if [int(x) for x in fields['sizes'].split()] != expectedSizes:
+  errors.append('sizes are %s instead of %s' % (fields['sizes'], expectedSizes))
+if int(fields['dimension']) != len(expectedSizes):
+  errors.append('dimension is %s instead of %d' % (fields['dimension'], len(expectedSizes)))
+expectedKinds = ('list ' if numberOfLayers > 1 else '') + 'domain domain domain'
+if fields['kinds'].split() != expectedKinds.split():
+  errors.append('kinds are %s instead of %s' % (fields['kinds'], expectedKinds))
+directions = parseVectors(fields['space directions'])
+if numberOfLayers > 1:
+  if directions[0] is not None:
+    errors.append('the layer axis has a space direction')
+  directions = directions[1:]
+for axis, direction in enumerate(parseVectors(baselineFields['space directions'])):
+  if not closeTo(directions[axis], direction, 1e-4):
+    errors.append('space direction %d is %s instead of %s' % (axis, directions[axis], direction))
+if not closeTo(parseVectors(fields['space origin'])[0], parseVectors(baselineFields['space origin'])[0]):
+  errors.append('space origin is %s instead of %s' % (fields['space origin'], baselineFields['space origin']))
+
+# voxels, with the layer index varying fastest
+layers = [voxels[layer::numberOfLayers] for layer in range(numberOfLayers)]
+for layer, (_, _, baselineVoxels) in enumerate(baselines):
+  if len(layers[layer]) != len(baselineVoxels):
+    errors.append('layer %d has %d voxels instead of %d' % (layer, len(layers[layer]), len(baselineVoxels)))
+  elif any(a != b for a, b in zip(layers[layer], baselineVoxels)):
+    errors.append('voxels of layer %d differ from %s' % (layer, sys.argv[3 + layer]))
+
+# segments, identified by their label value
+with open(metaFileName, 'r') as f:
+  attributes = dict((item['labelID'], item) for group in json.load(f)['segmentAttributes'] for item in group)
+segments = {}
+index = 0
+while 'Segment%d_ID' % index in keyValuePairs:
+  segment = dict((key[len('Segment%d_' % index):], value) for key, value in keyValuePairs.items()
+                 if key.startswith('Segment%d_' % index))
+  segments[int(segment.get('LabelValue', -1))] = segment
+  index += 1
+
+expectedLabels = set()
+for layer, (_, _, baselineVoxels) in enumerate(baselines):
+  for label in sorted(set(baselineVoxels) - set([0])):
+    expectedLabels.add(label)
+    segment = segments.get(label)
+    if segment is None:
+      errors.append('no segment with LabelValue %d' % label)
+      continue
+    if segment.get('ID') != 'Segment_%d' % label:
+      errors.append('ID of label %d is %s' % (label, segment.get('ID')))
+    if int(segment.get('Layer', -1)) != layer:
+      errors.append('Layer of label %d is %s instead of %d' % (label, segment.get('Layer'), layer))
+    extent = getExtent(baselineVoxels, size, label)
+    if [int(x) for x in segment.get('Extent', '').split()] != extent:
+      errors.append('Extent of label %d is %s instead of %s' % (label, segment.get('Extent'), extent))
+    item = attributes.get(label, {})
+    name = item.get('SegmentLabel') or item.get('SegmentDescription')
+    if segment.get('Name') != name:
+      errors.append('Name of label %d is %s instead of %s' % (label, segment.get('Name'), name))
+    color = [value / 255. for value in item.get('recommendedDisplayRGBValue', [])]
+    segmentColor = [float(x) for x in segment.get('Color', '').split()]
+    if len(color) != 3 or len(segmentColor) != 3 or not closeTo(segmentColor, color):
+      errors.append('Color of label %d is %s instead of %s' % (label, segment.get('Color'), color))
+if set(segments) != expectedLabels:
+  errors.append('segments have the label values %s instead of %s' % (sorted(segments), sorted(expectedLabels)))
+
+for error in errors:
+  print('Error: ' + error)
+sys.exit(1 if errors else 0)
@@ -0,0 +1,111 @@
+"""Runs segimage2itkimage with shared memory output and checks the published objects.
+
+Standard output must consist of JSON lines announcing one object per baseline image, and each
+object must hold the voxels and the geometry of its baseline. All announced objects are
+removed afterwards.
+
+With --occupy NAME, a shared memory object NAME is created before running the command, so that
+publishing this object fails. The command must then fail and leave no announced objects behind.
+
+Usage: checkSharedMemoryOutput.py [--occupy NAME] baseline1.nrrd[,baseline2.nrrd...] command...
+"""
+
+import gzip, json, os, struct, subprocess, sys
+
+SHM_DIR = '/dev/shm'
+HEADER = struct.Struct('=8s4I3Q3d3d9d4Q')
+
+def readNrrd(fileName):
+  with open(fileName, 'rb') as f:
+    content = f.read()
+  headerEnd = content.index(b'\n\n')
+  header = content[:headerEnd].decode('ascii').split('\n')
+  fields = dict(line.split(': ', 1) for line in header[1:] if ': ' in line)
+  if fields['type'] != 'short' or fields.get('endian', 'little') != 'little':
+    sys.exit('Error: little endian short images are supported only')
+  data = content[headerEnd + 2:]
+  if fields['encoding'] == 'gzip':
+    data = gzip.decompress(data)
+  size = [int(value) for value in fields['sizes'].split()]
+  origin = [float(value) for value in fields['space origin'].strip('()').split(',')]
+  directions = [[float(value) for value in vector.strip('()').split(',')]
+                for vector in fields['space directions'].split()]
+  voxels = struct.unpack('<%dh' % (len(data) // 2), data)
+  return size, origin, directions, voxels
+
+def objectPath(name):
+  return os.path.join(SHM_DIR, name.lstrip('/'))
+
+def checkObject(name, baselineFileName):
+  size, origin, directions, voxels = readNrrd(baselineFileName)
+  with open(objectPath(name), 'rb') as f:
+    content = f.read()
+  fields = HEADER.unpack_from(content)
+  magic, version, headerSize, dataType, itemSize = fields[:5]
+  if magic != b'DCMQIVOL' or version != 1 or headerSize != HEADER.size or dataType != 1 or itemSize != 2:
+    return 'unexpected header of ' + name
+  objectSize, spacing, objectOrigin, direction = fields[5:8], fields[8:11], fields[11:14], fields[14:23]
+  dataOffset, dataSize, metadataOffset, metadataSize = fields[23:27]
+  if list(objectSize) != size:
+    return 'size of %s is %s instead of %s' % (name, list(objectSize), size)
+  for i in range(3):
+    if abs(objectOrigin[i] - origin[i]) > 1e-3:
+      return 'origin of %s is %s instead of %s' % (name, objectOrigin, origin)
+    # the NRRD space directions are the scaled columns of the direction matrix
+    for j in range(3):
+      if abs(direction[3 * j + i] * spacing[i] - directions[i][j]) > 1e-4:
+        return 'geometry of %s does not match %s' % (name, baselineFileName)
+  if dataOffset % 64 or struct.unpack('=%dh' % (dataSize // 2), content[dataOffset:dataOffset + dataSize]) != voxels:
+    return 'voxels of %s differ from %s' % (name, baselineFileName)
+  metadata = json.loads(content[metadataOffset:metadataOffset + metadataSize].decode('utf-8'))
+  if len(metadata['segmentAttributes']) != 1:
+    return 'metadata of %s does not describe one image' % name
+  return None
+
+args = sys.argv[1:]
+occupied = None
+if len(args) > 1 and args[0] == '--occupy':
+  occupied = args[1]
+  args = args[2:]
+if len(args) < 2:
+  sys.exit(__doc__)
+baselines = args[0].split(',')
+
+if occupied:
+  open(objectPath(occupied), 'wb').close()
+try:
+  process = subprocess.run(args[1:], stdout=subprocess.PIPE)
+finally:
+  if occupied:
+    os.remove(objectPath(occupied))
+
+names = []
+errors = []
+for line in process.stdout.decode('utf-8').splitlines():
+  try:
+    announcement = json.loads(line)
+    names.append(announcement['sharedMemory'])
+  except (ValueError, KeyError):
+    errors.append('standard output is not an announcement: ' + line)
+
+if occupied:
+  if process.returncode == 0:
+    errors.append('the command succeeded although %s exists' % occupied)
+  errors += ['%s was not removed' % name for name in names if os.path.exists(objectPath(name))]
+else:
+  if process.returncode != 0:
+    errors.append('the command failed with exit code %d' % process.returncode)
+  if len(names) != len(baselines):
+    errors.append('%d objects announced instead of %d' % (len(names), len(baselines)))
+  for name, baseline in zip(names, baselines):
+    error = checkObject(name, baseline)
+    if error:
+      errors.append(error)
+
+for name in names:
+  if os.path.exists(objectPath(name)):
+    os.remove(objectPath(name))
+
+for error in errors:
+  print('Error: ' + error)
+sys.exit(1 if errors else 0)
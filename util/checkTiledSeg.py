@@ -0,0 +1,127 @@
+"""Checks a tiled Label Map Segmentation against the 2D label image it was created from.
+
+The tiles must cover the Total Pixel Matrix of the label image. With TILED_FULL, all tiles
+must be present in row major order; with TILED_SPARSE, only the tiles holding labels, each
+with its position in the Plane Position (Slide) Sequence of its per-frame functional groups.
+The RLE Lossless compressed frames must hold the labels of their tile, with background
+padding at the right and bottom border. The labels must equal the segment numbers.
+
+Usage: checkTiledSeg.py seg.dcm labels.mha tileSize TILED_FULL|TILED_SPARSE
+"""
+
+import struct, sys
+import pydicom
+
+def readMetaImage(fileName):
+  with open(fileName, 'rb') as f:
+    content = f.read()
+  fields = {}
+  position = 0
+  while 'ElementDataFile' not in fields:
+    lineEnd = content.index(b'\n', position)
+    key, value = content[position:lineEnd].decode('ascii').split('=', 1)
+    fields[key.strip()] = value.strip()
+    position = lineEnd + 1
+  if fields['ElementType'] != 'MET_USHORT' or fields['ElementDataFile'] != 'LOCAL':
+    sys.exit('Error: uncompressed MET_USHORT images are supported only')
+  columns, rows = [int(x) for x in fields['DimSize'].split()]
+  labels = struct.unpack('<%dH' % (columns * rows), content[position:position + 2 * columns * rows])
+  return columns, rows, labels
+
+def getFragments(pixelData):
+  # items of the encapsulated pixel data, the first of which is the basic offset table
+  fragments = []
+  position = 0
+  while position + 8 <= len(pixelData):
+    group, element, length = struct.unpack_from('<HHI', pixelData, position)
+    if (group, element) != (0xfffe, 0xe000):
+      break
+    fragments.append(pixelData[position + 8:position + 8 + length])
+    position += 8 + length
+  return fragments[1:]
+
+def decodeSegment(data, size):
+  result = bytearray()
+  position = 0
+  while len(result) < size and position < len(data):
+    header = data[position]
+    position += 1
+    if header < 128:
+      result += data[position:position + header + 1]
+      position += header + 1
+    elif header > 128:
+      result += bytes([data[position]]) * (257 - header)
+      position += 1
+  return result[:size]
+
+def decodeFrame(fragment, size, bytesPerPixel):
+  header = struct.unpack_from('<16I', fragment)
+  if header[0] != bytesPerPixel:
+    return None
+  segments = [decodeSegment(fragment[header[1 + i]:], size) for i in range(bytesPerPixel)]
+  if any(len(segment) != size for segment in segments):
+    return None
+  # the most significant byte comes first
+  return [sum(segments[i][pixel] << (8 * (bytesPerPixel - 1 - i)) for i in range(bytesPerPixel))
+          for pixel in range(size)]
+
+def getTile(labels, columns, rows, tileSize, firstColumn, firstRow):
+  tile = [0] * (tileSize * tileSize)
+  for row in range(min(tileSize, rows - firstRow)):
+    for column in range(min(tileSize, columns - firstColumn)):
+      tile[row * tileSize + column] = labels[(firstRow + row) * columns + firstColumn + column]
+  return tile
+
+if len(sys.argv) != 5:
+  sys.exit(__doc__)
+segFileName, labelFileName, tileSize, organization = sys.argv[1:]
+tileSize = int(tileSize)
+columns, rows, labels = readMetaImage(labelFileName)
+ds = pydicom.dcmread(segFileName)
+errors = []
+
+def expect(name, value, expected):
+  if value != expected:
+    errors.append('%s is %s instead of %s' % (name, value, expected))
+
+expect('transfer syntax', str(ds.file_meta.TransferSyntaxUID), '1.2.840.10008.1.2.5')
+expect('SegmentationType', ds.SegmentationType, 'LABELMAP')
+expect('DimensionOrganizationType', ds.DimensionOrganizationType, organization)
+expect('TotalPixelMatrixColumns', ds.TotalPixelMatrixColumns, columns)
+expect('TotalPixelMatrixRows', ds.TotalPixelMatrixRows, rows)
+expect('Rows', ds.Rows, tileSize)
+expect('Columns', ds.Columns, tileSize)
+
+tiles = [(column, row) for row in range(0, rows, tileSize) for column in range(0, columns, tileSize)]
+if organization == 'TILED_SPARSE':
+  tiles = [(column, row) for column, row in tiles
+           if any(getTile(labels, columns, rows, tileSize, column, row))]
+expect('NumberOfFrames', int(ds.NumberOfFrames), len(tiles))
+
+if organization == 'TILED_FULL':
+  if 'PerFrameFunctionalGroupsSequence' in ds:
+    errors.append('TILED_FULL segmentation has per-frame functional groups')
+else:
+  perFrameItems = ds.get('PerFrameFunctionalGroupsSequence', [])
+  expect('number of per-frame functional groups', len(perFrameItems), len(tiles))
+  for frame, (item, (column, row)) in enumerate(zip(perFrameItems, tiles)):
+    if 'PlanePositionSlideSequence' not in item:
+      errors.append('frame %d has no Plane Position (Slide) Sequence' % (frame + 1))
+      continue
+    position = item.PlanePositionSlideSequence[0]
+    expect('column position of frame %d' % (frame + 1), position.ColumnPositionInTotalImagePixelMatrix, column + 1)
+    expect('row position of frame %d' % (frame + 1), position.RowPositionInTotalImagePixelMatrix, row + 1)
+
+bytesPerPixel = ds.BitsAllocated // 8
+fragments = getFragments(ds.PixelData)
+expect('number of fragments', len(fragments), len(tiles))
+for frame, (fragment, (column, row)) in enumerate(zip(fragments, tiles)):
+  if len(fragment) % 2:
+    errors.append('fragment of frame %d has odd length' % (frame + 1))
+  pixels = decodeFrame(fragment, tileSize * tileSize, bytesPerPixel)
+  if pixels != getTile(labels, columns, rows, tileSize, column, row):
+    errors.append('frame %d does not hold the labels of the tile at column %d, row %d' % (frame + 1, column + 1, row + 1))
+
+for error in errors:
+  print('Error: ' + error)
+sys.exit(1 if errors else 0)
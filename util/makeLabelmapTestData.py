@@ -0,0 +1,56 @@
+"""Creates a label map with many labels, for testing segmentations with more than 255 segments.
+
+The non-zero voxels of a NRRD label image are relabeled cyclically with the labels 1..N, and
+a metadata file with one segment per label is written, using the first segment of a template
+metadata file for all of them.
+
+Usage: makeLabelmapTestData.py input.nrrd template.json numberOfLabels output.nrrd output.json
+"""
+
+import copy, gzip, json, struct, sys
+
+if len(sys.argv) != 6:
+  sys.exit(__doc__)
+inputFileName, templateFileName, numberOfLabels, outputFileName, metaFileName = sys.argv[1:]
+numberOfLabels = int(numberOfLabels)
+
+with open(inputFileName, 'rb') as f:
+  content = f.read()
+headerEnd = content.index(b'\n\n')
+header = content[:headerEnd].decode('ascii').split('\n')
+fields = dict(line.split(': ', 1) for line in header[1:] if ': ' in line)
+if fields['type'] != 'short' or fields.get('endian', 'little') != 'little':
+  sys.exit('Error: little endian short images are supported only')
+
+data = content[headerEnd + 2:]
+if fields['encoding'] == 'gzip':
+  data = gzip.decompress(data)
+elif fields['encoding'] != 'raw':
+  sys.exit('Error: unsupported encoding ' + fields['encoding'])
+
+voxels = list(struct.unpack('<%dh' % (len(data) // 2), data))
+nonZero = 0
+for i, value in enumerate(voxels):
+  if value:
+    voxels[i] = 1 + nonZero % numberOfLabels
+    nonZero += 1
+if nonZero < numberOfLabels:
+  sys.exit('Error: the input has fewer non-zero voxels than labels')
+
+header = [line if not line.startswith('encoding:') else 'encoding: gzip' for line in header]
+with open(outputFileName, 'wb') as f:
+  f.write(('\n'.join(header) + '\n\n').encode('ascii'))
+  f.write(gzip.compress(struct.pack('<%dh' % len(voxels), *voxels)))
+
+with open(templateFileName, 'r') as f:
+  meta = json.load(f)
+segment = meta['segmentAttributes'][0][0]
+segments = []
+for label in range(1, numberOfLabels + 1):
+  item = copy.deepcopy(segment)
+  item['labelID'] = label
+  item['SegmentDescription'] = 'Segment %d' % label
+  segments.append(item)
+meta['segmentAttributes'] = [segments]
+with open(metaFileName, 'w') as f:
+  json.dump(meta, f, indent=2)
@@ -0,0 +1,76 @@
+"""Stores a NRRD label image as .npy array of an unsigned type, for testing array input.
+
+With uint8, the labels and the metadata are kept. With uint32, the labels are mapped to large
+values in ascending order, starting above the int16 and uint16 range (label 1 becomes 40000,
+label 2 becomes 70000, ...), and the metadata is changed accordingly; labels not present in
+the image are removed from it. The order of the labels, and thus of the segments, is kept.
+The geometry of the image is written next to the array.
+
+Usage: makeNumpyLabelTestData.py input.nrrd template.json u1|u4 output.npy output-geometry.json output-meta.json
+"""
+
+import gzip, json, struct, sys
+
+TYPES = {'u1': 'B', 'u4': 'I'}
+LARGE_LABELS = [40000, 70000, 100000, 130000]
+
+if len(sys.argv) != 7 or sys.argv[3] not in TYPES:
+  sys.exit(__doc__)
+inputFileName, templateFileName, dtype, outputFileName, geometryFileName, metaFileName = sys.argv[1:]
+
+with open(inputFileName, 'rb') as f:
+  content = f.read()
+headerEnd = content.index(b'\n\n')
+header = content[:headerEnd].decode('ascii').split('\n')
+fields = dict(line.split(': ', 1) for line in header[1:] if ': ' in line)
+if fields['type'] != 'short' or fields.get('endian', 'little') != 'little':
+  sys.exit('Error: little endian short images are supported only')
+data = content[headerEnd + 2:]
+if fields['encoding'] == 'gzip':
+  data = gzip.decompress(data)
+elif fields['encoding'] != 'raw':
+  sys.exit('Error: unsupported encoding ' + fields['encoding'])
+voxels = struct.unpack('<%dh' % (len(data) // 2), data)
+size = [int(x) for x in fields['sizes'].split()]
+origin = [float(x) for x in fields['space origin'].strip('()').split(',')]
+directions = [[float(x) for x in vector.strip('()').split(',')] for vector in fields['space directions'].split()]
+
+labels = sorted(set(voxels) - set([0]))
+if dtype == 'u4':
+  if len(labels) > len(LARGE_LABELS):
+    sys.exit('Error: the input has more than %d labels' % len(LARGE_LABELS))
+  labelMap = dict(zip(labels, LARGE_LABELS))
+else:
+  if labels and (labels[0] < 0 or labels[-1] > 255):
+    sys.exit('Error: the labels do not fit into uint8')
+  labelMap = dict((label, label) for label in labels)
+labelMap[0] = 0
+
+# C order with the slices varying slowest, i.e. shape (slices, rows, columns)
+npyHeader = "{'descr': '<%s', 'fortran_order': False, 'shape': (%d, %d, %d), }" % (dtype, size[2], size[1], size[0])
+npyHeader += ' ' * ((64 - (10 + len(npyHeader) + 1) % 64) % 64) + '\n'
+with open(outputFileName, 'wb') as f:
+  f.write(b'\x93NUMPY\x01\x00' + struct.pack('<H', len(npyHeader)) + npyHeader.encode('ascii'))
+  f.write(struct.pack('<%d%s' % (len(voxels), TYPES[dtype]), *[labelMap[value] for value in voxels]))
+
+# the NRRD space directions are the scaled columns of the direction matrix
+spacing = [sum(x * x for x in vector) ** 0.5 for vector in directions]
+geometry = {
+  'size': size,
+  'spacing': spacing,
+  'origin': origin,
+  'direction': [[directions[j][i] / spacing[j] for j in range(3)] for i in range(3)]
+}
+with open(geometryFileName, 'w') as f:
+  json.dump(geometry, f, indent=2)
+
+with open(templateFileName, 'r') as f:
+  meta = json.load(f)
+if len(meta['segmentAttributes']) != 1:
+  sys.exit('Error: the metadata must describe a single label image')
+segments = [item for item in meta['segmentAttributes'][0] if item['labelID'] in labels]
+for item in segments:
+  item['labelID'] = labelMap[item['labelID']]
+meta['segmentAttributes'] = [segments]
+with open(metaFileName, 'w') as f:
+  json.dump(meta, f, indent=2)
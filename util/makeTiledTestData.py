@@ -0,0 +1,46 @@
+"""Creates a small 2D label image for testing tiled segmentations.
+
+The image has 100 columns and 70 rows, so that tiles of 32x32 pixels do not fit evenly, and
+holds the labels 1 and 2 in 4 of these 12 tiles, including one at the bottom right border. It
+is written as uncompressed MetaImage, which ITK can read in strips.
+
+Usage: makeTiledTestData.py output.mha
+"""
+
+import struct, sys
+
+COLUMNS, ROWS = 100, 70
+
+if len(sys.argv) != 2:
+  sys.exit(__doc__)
+
+labels = [0] * (COLUMNS * ROWS)
+def paint(label, firstColumn, lastColumn, firstRow, lastRow):
+  for row in range(firstRow, lastRow + 1):
+    for column in range(firstColumn, lastColumn + 1):
+      labels[row * COLUMNS + column] = label
+
+# crosses the border between the first two tiles of the first row
+paint(1, 5, 40, 3, 20)
+paint(2, 20, 25, 10, 12)
+# a single pixel in the third tile of the second row
+paint(1, 70, 70, 40, 40)
+# the bottom right corner, in a tile holding 4x6 pixels of the image only
+paint(2, 97, 99, 66, 69)
+
+header = '\n'.join([
+  'ObjectType = Image',
+  'NDims = 2',
+  'BinaryData = True',
+  'BinaryDataByteOrderMSB = False',
+  'CompressedData = False',
+  'TransformMatrix = 1 0 0 1',
+  'Offset = 10 20',
+  'ElementSpacing = 0.5 0.25',
+  'DimSize = %d %d' % (COLUMNS, ROWS),
+  'ElementType = MET_USHORT',
+  'ElementDataFile = LOCAL',
+  ''])
+with open(sys.argv[1], 'wb') as f:
+  f.write(header.encode('ascii'))
+  f.write(struct.pack('<%dH' % len(labels), *labels))
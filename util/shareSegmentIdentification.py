@@ -0,0 +1,22 @@
+"""Moves the Segment Identification Sequence of a single-segment DICOM Segmentation from the
+per-frame functional groups into the shared functional groups, as some writers do.
+
+Usage: shareSegmentIdentification.py input.dcm output.dcm
+"""
+
+import sys
+import pydicom
+
+if len(sys.argv) != 3:
+  sys.exit(__doc__)
+
+ds = pydicom.dcmread(sys.argv[1])
+perFrame = ds.PerFrameFunctionalGroupsSequence
+segmentNumbers = set(item.SegmentIdentificationSequence[0].ReferencedSegmentNumber for item in perFrame)
+if len(segmentNumbers) != 1:
+  sys.exit('Error: all frames must reference the same segment')
+
+ds.SharedFunctionalGroupsSequence[0].SegmentIdentificationSequence = perFrame[0].SegmentIdentificationSequence
+for item in perFrame:
+  del item.SegmentIdentificationSequence
+ds.save_as(sys.argv[2])
@@ -0,0 +1,92 @@
+"""Starts dcmqiserver, sends it one segimage2itkimage job followed by a shutdown job, and checks
+the status lines, the output files and that the service stops and removes its socket.
+
+With --occupied, the socket path is a regular file instead, and the service must refuse to
+start without removing it.
+
+Usage: testDcmqiServer.py [--occupied] dcmqiserver inputSEG.dcm outputDirectory
+"""
+
+import json, os, shutil, socket, subprocess, sys, tempfile, time
+
+TIMEOUT = 120
+
+def fail(message):
+  sys.exit('Error: ' + message)
+
+def readLine(stream):
+  line = stream.readline()
+  if not line:
+    fail('the service closed the connection')
+  return json.loads(line.decode('utf-8'))
+
+args = sys.argv[1:]
+occupied = len(args) > 0 and args[0] == '--occupied'
+if occupied:
+  args = args[1:]
+if len(args) != 3:
+  sys.exit(__doc__)
+server, inputFileName, outputDirectory = args
+
+# socket paths are limited to about 100 characters, so they are kept short
+socketDirectory = tempfile.mkdtemp(prefix='dcmqi')
+socketPath = os.path.join(socketDirectory, 'service.sock')
+try:
+  if occupied:
+    with open(socketPath, 'w') as f:
+      f.write('not a socket')
+    process = subprocess.run([server, '--socket', socketPath], stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                             timeout=TIMEOUT)
+    if process.returncode == 0:
+      fail('the service started on a regular file')
+    with open(socketPath, 'r') as f:
+      if f.read() != 'not a socket':
+        fail('the file at the socket path was changed')
+    sys.exit(0)
+
+  process = subprocess.Popen([server, '--socket', socketPath, '--threads', '2'])
+  try:
+    client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    start = time.time()
+    while True:
+      try:
+        client.connect(socketPath)
+        break
+      except (FileNotFoundError, ConnectionRefusedError):
+        if process.poll() is not None:
+          fail('the service exited with code %d' % process.returncode)
+        if time.time() - start > TIMEOUT:
+          fail('the service did not start listening')
+        time.sleep(0.1)
+    client.settimeout(TIMEOUT)
+    stream = client.makefile('rb')
+
+    job = {'id': 'seg', 'type': 'segimage2itkimage', 'inputDICOM': inputFileName,
+           'outputDirectory': outputDirectory, 'prefix': 'service', 'outputType': 'nrrd'}
+    client.sendall((json.dumps(job) + '\n').encode('utf-8'))
+    status = readLine(stream)
+    if status.get('id') != 'seg' or not status.get('success'):
+      fail('unexpected status of the conversion: %s' % status)
+    outputs = status.get('outputs', [])
+    if not any(name.endswith('service-1.nrrd') for name in outputs) \
+       or not any(name.endswith('service-meta.json') for name in outputs):
+      fail('unexpected outputs of the conversion: %s' % outputs)
+    for name in outputs:
+      if not os.path.isfile(name) or os.path.getsize(name) == 0:
+        fail('output %s was not written' % name)
+
+    client.sendall(b'{"id": "stop", "type": "shutdown"}\n')
+    status = readLine(stream)
+    if status.get('id') != 'stop' or not status.get('success'):
+      fail('unexpected status of the shutdown: %s' % status)
+    client.close()
+
+    if process.wait(timeout=TIMEOUT) != 0:
+      fail('the service exited with code %d' % process.returncode)
+    if os.path.exists(socketPath):
+      fail('the socket was not removed')
+  finally:
+    if process.poll() is None:
+      process.kill()
+finally:
+  shutil.rmtree(socketDirectory, ignore_errors=True)